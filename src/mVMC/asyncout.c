@@ -0,0 +1,287 @@
+/*
+mVMC - A numerical solver package for a wide range of quantum lattice models based on many-variable Variational Monte Carlo method
+Copyright (C) 2016 The University of Tokyo, All rights reserved.
+
+This program is developed based on the mVMC-mini program
+(https://github.com/fiber-miniapp/mVMC-mini)
+which follows "The BSD 3-Clause License".
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see http://www.gnu.org/licenses/.
+*/
+/*-------------------------------------------------------------
+ * Variational Monte Carlo
+ * output of the Green functions by a writer thread
+ *-------------------------------------------------------------*/
+#include "asyncout.h"
+#ifndef _SRC_ASYNCOUT
+#define _SRC_ASYNCOUT
+
+#define D_GreenBinaryVersion 1
+
+/* zvo_*_yyy.bin written when NAsyncOutput=2                              */
+/*   header : magic "mVMCgrn", version, layout, the number of rows n,     */
+/*            the number of indices per row nIdx (int32)                  */
+/*   body   : indices (int32, n x nIdx), values (double complex, n)       */
+/* layout 0: cisajs, 1: cisajs with NLanczosMode>1,                       */
+/*        2: cisajscktaltex (no index), 3: cisajscktalt                   */
+/* The values are stored in the order of the rows of the text file.       */
+
+/* a snapshot of PhysCisAjs, PhysCisAjsCktAlt and PhysCisAjsCktAltDC */
+typedef struct {
+  double complex *vec;
+  int idx;  /* the index of the output files */
+  int full; /* 1 while the snapshot waits for or is in the writer thread */
+} GreenSnapshot;
+
+GreenSnapshot GreenSnap[2];
+int GreenSnapNext=0; /* the snapshot filled by the next AsyncOutPush */
+int GreenWriterRunning=0;
+int GreenWriterExit=0;
+pthread_t GreenWriter;
+pthread_mutex_t GreenMutex=PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t GreenCond=PTHREAD_COND_INITIALIZER;
+
+/* write the Green functions in the text format of outputData */
+/* vec = {PhysCisAjs, PhysCisAjsCktAlt, PhysCisAjsCktAltDC} */
+void WriteGreenFuncText(FILE *fpCisAjs, FILE *fpCisAjsCktAlt, FILE *fpCisAjsCktAltDC,
+                        const double complex *vec) {
+  const double complex *physCisAjs = vec;
+  const double complex *physCisAjsCktAlt = physCisAjs + NCisAjs;
+  const double complex *physCisAjsCktAltDC = physCisAjsCktAlt + NCisAjsCktAlt;
+  int i,idx;
+
+  /* zvo_cisajs.dat */
+  if (NCisAjs > 0) {
+    if(NLanczosMode <2) {
+      for (i = 0; i < NCisAjs; i++) {
+        fprintf(fpCisAjs, "%d %d %d %d % .18e  % .18e \n", CisAjsIdx[i][0], CisAjsIdx[i][1], CisAjsIdx[i][2],
+                CisAjsIdx[i][3], creal(physCisAjs[i]), cimag(physCisAjs[i]));
+      }
+    }
+    else{
+      for (i = 0; i < NCisAjsLz; i++) {
+        idx = iOneBodyGIdx[CisAjsLzIdx[i][0] + CisAjsLzIdx[i][1] * Nsite][CisAjsLzIdx[i][2] +
+                                                                          CisAjsLzIdx[i][3] * Nsite];
+        fprintf(fpCisAjs, "%d %d %d %d % .18e % .18e \n", CisAjsLzIdx[idx][0], CisAjsLzIdx[idx][1],
+                CisAjsLzIdx[idx][2], CisAjsLzIdx[idx][3], creal(physCisAjs[idx]), cimag(physCisAjs[idx]));
+      }
+    }
+    fprintf(fpCisAjs, "\n");
+  }
+  /* zvo_cisajscktalt.dat */
+  if (NCisAjsCktAlt > 0) {
+    for (i = 0; i < NCisAjsCktAlt; i++)
+      fprintf(fpCisAjsCktAlt, "% .18e  % .18e ", creal(physCisAjsCktAlt[i]), cimag(physCisAjsCktAlt[i]));
+    fprintf(fpCisAjsCktAlt, "\n");
+  }
+
+  /* zvo_cisajscktaltdc.dat */
+  if (NCisAjsCktAltDC > 0) {
+    for (i = 0; i < NCisAjsCktAltDC; i++) {
+      fprintf(fpCisAjsCktAltDC, "%d %d %d %d %d %d %d %d % .18e % .18e\n",
+              CisAjsCktAltDCIdx[i][0], CisAjsCktAltDCIdx[i][1], CisAjsCktAltDCIdx[i][2], CisAjsCktAltDCIdx[i][3],
+              CisAjsCktAltDCIdx[i][4], CisAjsCktAltDCIdx[i][5], CisAjsCktAltDCIdx[i][6], CisAjsCktAltDCIdx[i][7],
+              creal(physCisAjsCktAltDC[i]), cimag(physCisAjsCktAltDC[i]));
+    }
+    fprintf(fpCisAjsCktAltDC, "\n");
+  }
+  return;
+}
+
+int writeGreenFuncBinary(const char *fileName, const int layout, const int n, const int nIdx,
+                         const int32_t *idx, const double complex *val) {
+  const char magic[8] = "mVMCgrn";
+  int32_t head[4];
+  FILE *fp;
+  int info=0;
+
+  if((fp=fopen(fileName, "wb"))==NULL) {
+    fprintf(stderr, "error: writeGreenFuncBinary: cannot open %s.\n", fileName);
+    return 1;
+  }
+  head[0] = D_GreenBinaryVersion;
+  head[1] = layout;
+  head[2] = n;
+  head[3] = nIdx;
+  fwrite(magic, sizeof(char), sizeof(magic), fp);
+  fwrite(head, sizeof(int32_t), 4, fp);
+  if(nIdx>0 && fwrite(idx, sizeof(int32_t), (size_t)n*nIdx, fp)!=(size_t)n*nIdx) info=1;
+  if(fwrite(val, sizeof(double complex), n, fp)!=(size_t)n) info=1;
+  if(fclose(fp)!=0) info=1;
+  if(info!=0) fprintf(stderr, "error: writeGreenFuncBinary: cannot write %s.\n", fileName);
+  return info;
+}
+
+/* write the Green functions of the idx-th sampling into their own files */
+void OutputGreenFunc(const int idx, const double complex *vec, const int flagBinary) {
+  char fileName[D_FileNameMax];
+  FILE *fp[3]={NULL,NULL,NULL};
+  const char *name[3]={"cisajs","cisajscktaltex","cisajscktalt"};
+  const int nData[3]={NCisAjs,NCisAjsCktAlt,NCisAjsCktAltDC};
+  const double complex *physCisAjs = vec;
+  const double complex *physCisAjsCktAltDC = vec + NCisAjs + NCisAjsCktAlt;
+  double complex *val;
+  int32_t *rowIdx;
+  int i,k,j;
+
+  if(flagBinary==0) {
+    for(k=0;k<3;k++) {
+      if(nData[k]==0) continue;
+      sprintf(fileName, "%s_%s_%03d.dat", CDataFileHead, name[k], idx);
+      if((fp[k]=fopen(fileName, "w"))==NULL) {
+        fprintf(stderr, "error: OutputGreenFunc: cannot open %s.\n", fileName);
+      }
+    }
+    if((NCisAjs==0 || fp[0]!=NULL) && (NCisAjsCktAlt==0 || fp[1]!=NULL)
+       && (NCisAjsCktAltDC==0 || fp[2]!=NULL)) {
+      WriteGreenFuncText(fp[0], fp[1], fp[2], vec);
+    }
+    for(k=0;k<3;k++) {
+      if(fp[k]!=NULL) fclose(fp[k]);
+    }
+    return;
+  }
+
+  /* zvo_cisajs.bin */
+  if(NCisAjs>0) {
+    k = (NLanczosMode<2) ? NCisAjs : NCisAjsLz;
+    rowIdx = (int32_t*)malloc(sizeof(int32_t)*4*k);
+    val = (double complex*)malloc(sizeof(double complex)*k);
+    for(i=0;i<k;i++) {
+      if(NLanczosMode<2) {
+        for(j=0;j<4;j++) rowIdx[4*i+j] = CisAjsIdx[i][j];
+        val[i] = physCisAjs[i];
+      } else {
+        int gi = iOneBodyGIdx[CisAjsLzIdx[i][0] + CisAjsLzIdx[i][1] * Nsite][CisAjsLzIdx[i][2] +
+                                                                             CisAjsLzIdx[i][3] * Nsite];
+        for(j=0;j<4;j++) rowIdx[4*i+j] = CisAjsLzIdx[gi][j];
+        val[i] = physCisAjs[gi];
+      }
+    }
+    sprintf(fileName, "%s_%s_%03d.bin", CDataFileHead, name[0], idx);
+    writeGreenFuncBinary(fileName, (NLanczosMode<2) ? 0 : 1, k, 4, rowIdx, val);
+    free(val);
+    free(rowIdx);
+  }
+
+  /* zvo_cisajscktaltex.bin */
+  if(NCisAjsCktAlt>0) {
+    sprintf(fileName, "%s_%s_%03d.bin", CDataFileHead, name[1], idx);
+    writeGreenFuncBinary(fileName, 2, NCisAjsCktAlt, 0, NULL, vec+NCisAjs);
+  }
+
+  /* zvo_cisajscktalt.bin */
+  if(NCisAjsCktAltDC>0) {
+    rowIdx = (int32_t*)malloc(sizeof(int32_t)*8*NCisAjsCktAltDC);
+    for(i=0;i<NCisAjsCktAltDC;i++) {
+      for(j=0;j<8;j++) rowIdx[8*i+j] = CisAjsCktAltDCIdx[i][j];
+    }
+    sprintf(fileName, "%s_%s_%03d.bin", CDataFileHead, name[2], idx);
+    writeGreenFuncBinary(fileName, 3, NCisAjsCktAltDC, 8, rowIdx, physCisAjsCktAltDC);
+    free(rowIdx);
+  }
+  return;
+}
+
+/* the writer thread writes the filled snapshots in turn */
+void *greenWriterMain(void *arg) {
+  int k=0;
+  (void)arg;
+
+  pthread_mutex_lock(&GreenMutex);
+  while(1) {
+    while(!GreenSnap[k].full && !GreenWriterExit) {
+      pthread_cond_wait(&GreenCond, &GreenMutex);
+    }
+    if(!GreenSnap[k].full) break; /* GreenWriterExit and nothing to write */
+    pthread_mutex_unlock(&GreenMutex);
+
+    OutputGreenFunc(GreenSnap[k].idx, GreenSnap[k].vec, NAsyncOutput==2);
+
+    pthread_mutex_lock(&GreenMutex);
+    GreenSnap[k].full = 0;
+    pthread_cond_broadcast(&GreenCond);
+    k ^= 1;
+  }
+  pthread_mutex_unlock(&GreenMutex);
+  return NULL;
+}
+
+/* start the writer thread on rank 0 */
+void AsyncOutInit(int rank) {
+  const int n = NCisAjs+NCisAjsCktAlt+NCisAjsCktAltDC;
+  int k;
+
+  if(rank!=0 || NAsyncOutput==0) return;
+
+  for(k=0;k<2;k++) {
+    GreenSnap[k].vec = (double complex*)malloc(sizeof(double complex)*(n+1));
+    GreenSnap[k].full = 0;
+  }
+  GreenSnapNext = 0;
+  GreenWriterExit = 0;
+  GreenWriterRunning = (pthread_create(&GreenWriter, NULL, greenWriterMain, NULL)==0);
+  if(!GreenWriterRunning) {
+    fprintf(stderr, "warning: AsyncOutInit: cannot create the writer thread. The Green functions are written synchronously.\n");
+  }
+  return;
+}
+
+/* pass a copy of the Green functions of the idx-th sampling to the writer thread */
+/* This waits only when both snapshots are still being written. */
+void AsyncOutPush(const int idx, int rank) {
+  const int n = NCisAjs+NCisAjsCktAlt+NCisAjsCktAltDC;
+  GreenSnapshot *snap = GreenSnap + GreenSnapNext;
+
+  if(rank!=0) return;
+  if(!GreenWriterRunning) {
+    OutputGreenFunc(idx, PhysCisAjs, NAsyncOutput==2);
+    return;
+  }
+
+  pthread_mutex_lock(&GreenMutex);
+  while(snap->full) pthread_cond_wait(&GreenCond, &GreenMutex);
+  pthread_mutex_unlock(&GreenMutex);
+
+  memcpy(snap->vec, PhysCisAjs, sizeof(double complex)*n);
+  snap->idx = idx;
+
+  pthread_mutex_lock(&GreenMutex);
+  snap->full = 1;
+  pthread_cond_broadcast(&GreenCond);
+  pthread_mutex_unlock(&GreenMutex);
+
+  GreenSnapNext ^= 1;
+  return;
+}
+
+/* wait for the writer thread to write all the snapshots */
+void AsyncOutFinalize(int rank) {
+  int k;
+
+  if(rank!=0 || NAsyncOutput==0) return;
+
+  if(GreenWriterRunning) {
+    pthread_mutex_lock(&GreenMutex);
+    GreenWriterExit = 1;
+    pthread_cond_broadcast(&GreenCond);
+    pthread_mutex_unlock(&GreenMutex);
+    pthread_join(GreenWriter, NULL);
+    GreenWriterRunning = 0;
+  }
+  for(k=0;k<2;k++) free(GreenSnap[k].vec);
+  return;
+}
+
+#endif
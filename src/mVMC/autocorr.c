@@ -0,0 +1,151 @@
+/*
+mVMC - A numerical solver package for a wide range of quantum lattice models based on many-variable Variational Monte Carlo method
+Copyright (C) 2016 The University of Tokyo, All rights reserved.
+
+This program is developed based on the mVMC-mini program
+(https://github.com/fiber-miniapp/mVMC-mini)
+which follows "The BSD 3-Clause License".
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see http://www.gnu.org/licenses/.
+*/
+/*-------------------------------------------------------------
+ * Variational Monte Carlo
+ * autocorrelation time of the samples and adaptive NVMCInterval
+ *-------------------------------------------------------------*/
+#include "autocorr.h"
+#ifndef _SRC_AUTOCORR
+#define _SRC_AUTOCORR
+
+#define D_AutoCorrNLevel 16 /* bin sizes 1,2,4,...,2^15 */
+#define D_AutoCorrMinBin 32 /* the minimum number of bins used for the estimate */
+#define D_AutoCorrNO 3      /* the number of the components of O (the projection counts) */
+#define D_AutoCorrTauMax 1.0 /* NVMCInterval is increased above this tau */
+#define D_AutoCorrTauMin 0.6 /* NVMCInterval is decreased below this tau */
+
+/* Add the sum of the squared deviations of the averages over the bins of */
+/* size 2^k and its degrees of freedom to sum2[k] and cnt[k].              */
+void binningAutoCorr(const double *x, const int n, double *sum2, double *cnt) {
+  int k,b,nb,i,j;
+  double ave,m,s;
+
+  for(k=0;k<D_AutoCorrNLevel;k++) {
+    b = 1<<k;
+    nb = n/b;
+    if(nb<2) break;
+
+    ave = 0.0;
+    for(i=0;i<nb*b;i++) ave += x[i];
+    ave /= (double)(nb*b);
+
+    s = 0.0;
+    for(j=0;j<nb;j++) {
+      m = 0.0;
+      for(i=j*b;i<(j+1)*b;i++) m += x[i];
+      m = m/(double)b - ave;
+      s += m*m;
+    }
+    sum2[k] += s;
+    cnt[k] += (double)(nb-1);
+  }
+  return;
+}
+
+/* Estimate the integrated autocorrelation times of the local energy and of */
+/* the first D_AutoCorrNO components of O in units of the sampling interval. */
+/* Each process bins the series of the samples measured by itself, and the  */
+/* binned variances are summed over comm. tau=1/2 for uncorrelated samples. */
+void CalcAutoCorr(double *tau, double *varE, double *nSmp, MPI_Comm comm) {
+  const int nO = (NProj<D_AutoCorrNO) ? NProj : D_AutoCorrNO;
+  const int nQ = 1+nO;
+  const int nBuf = 2*nQ*D_AutoCorrNLevel+1;
+  double *x,*buf,*recv,*sum2,*cnt;
+  int q,k,n=0,sample;
+
+  x = (double*)malloc(sizeof(double)*(NVMCSample+2*nBuf));
+  buf = x + NVMCSample;
+  recv = buf + nBuf;
+  for(k=0;k<nBuf;k++) buf[k] = 0.0;
+
+  for(q=0;q<nQ;q++) {
+    n = 0;
+    for(sample=0;sample<NVMCSample;sample++) {
+      /* the samples measured by the other processes */
+      if(isnan(LocalE[sample])) continue;
+      x[n++] = (q==0) ? LocalE[sample] : (double)EleProjCnt[sample*NProj+q-1];
+    }
+    binningAutoCorr(x,n,buf+2*q*D_AutoCorrNLevel,buf+(2*q+1)*D_AutoCorrNLevel);
+  }
+  buf[nBuf-1] = (double)n;
+
+  SafeMpiAllReduce(buf,recv,nBuf,comm);
+
+  for(q=0;q<nQ;q++) {
+    sum2 = recv + 2*q*D_AutoCorrNLevel;
+    cnt  = recv + (2*q+1)*D_AutoCorrNLevel;
+    tau[q] = 0.5;
+    if(cnt[0]<=0.0 || sum2[0]<=0.0) continue;
+    /* the largest bins with enough statistics */
+    for(k=D_AutoCorrNLevel-1;k>0;k--) {
+      if(cnt[k]>=D_AutoCorrMinBin) break;
+    }
+    tau[q] = 0.5*(double)(1<<k)*(sum2[k]/cnt[k])/(sum2[0]/cnt[0]);
+  }
+  *varE = (recv[D_AutoCorrNLevel]>0.0) ? recv[0]/recv[D_AutoCorrNLevel] : 0.0;
+  *nSmp = recv[nBuf-1];
+
+  free(x);
+  return;
+}
+
+/* Write the autocorrelation times of this step to zvo_autocorr.dat and */
+/* adapt NVMCInterval to them when NAutoCorr==2.                         */
+/* Return the error of Etot corrected by the autocorrelation time.      */
+double UpdateAutoCorr(const int step, MPI_Comm comm) {
+  const int nQ = 1+((NProj<D_AutoCorrNO) ? NProj : D_AutoCorrNO);
+  double tau[1+D_AutoCorrNO];
+  double varE,nSmp,tauMax,errE;
+  int rank,q,interval;
+
+  MPI_Comm_rank(comm,&rank);
+
+  CalcAutoCorr(tau,&varE,&nSmp,comm);
+  errE = (nSmp>0.0) ? sqrt(2.0*tau[0]*varE/nSmp) : 0.0;
+
+  if(rank==0) {
+    fprintf(FileAutoCorr, "%d %d % .18e", step, NVMCInterval, errE);
+    for(q=0;q<nQ;q++) fprintf(FileAutoCorr, " % .18e", tau[q]);
+    fprintf(FileAutoCorr, "\n");
+  }
+
+  if(NAutoCorr==2) {
+    tauMax = tau[0];
+    for(q=1;q<nQ;q++) if(tau[q]>tauMax) tauMax = tau[q];
+
+    interval = NVMCInterval;
+    if(tauMax>D_AutoCorrTauMax) {
+      interval = (int)ceil((double)NVMCInterval*tauMax/D_AutoCorrTauMax);
+      if(interval>NVMCIntervalMax) interval = NVMCIntervalMax;
+    } else if(tauMax<D_AutoCorrTauMin) {
+      interval = NVMCInterval - ((NVMCInterval/4>1) ? NVMCInterval/4 : 1);
+      if(interval<1) interval = 1;
+    }
+    /* all the processes must use the same interval */
+    MPI_Bcast(&interval,1,MPI_INT,0,comm);
+    NVMCInterval = interval;
+  }
+
+  return errE;
+}
+
+#endif
@@ -74,27 +74,100 @@ void WeightAverageWE(MPI_Comm comm) {
 }
 
 /* calculate average of SROptOO and SROptHO */
-/* All processes will have the result */
+/* All processes will have the result except for the dense lower triangle of SROptOO */
 void WeightAverageSROpt(MPI_Comm comm) {
-  int i,n;
+  int i,n,ld;
   double invW = 1.0/Wc;
-  double complex *vec,*buf;
+  double complex *vec,*buf,*pack;
   int rank,size;
   MPI_Comm_rank(comm,&rank);
   MPI_Comm_size(comm,&size);
 
-  /* SROptOO and SROptHO */ // except for SROptO 
-  if(NSRCG == 0){
-    n = 2*SROptSize*(2*SROptSize+1);
-  }else{
-    n = 2*SROptSize*3;
+  if(!IsSROptOODiag()){
+#ifdef _lapack
+    int nOO;
+    /* the lower triangle of SROptOO and SROptHO are packed column by column.
+       only rank 0 solves S x = g by DPOSV, so that they are reduced to rank 0. */
+    ld  = 2*SROptSize;
+    nOO = ld*(ld+1)/2;
+    n   = nOO+ld;
+    RequestWorkSpaceComplex(2*n);
+    pack = GetWorkSpaceComplex(n);
+    buf  = GetWorkSpaceComplex(n);
+
+    #pragma omp parallel for default(shared) private(i)
+    for(i=0;i<ld;i++) {
+      memcpy(pack+i*ld-i*(i-1)/2, SROptOO+i*ld+i, sizeof(double complex)*(ld-i));
+    }
+    memcpy(pack+nOO, SROptHO, sizeof(double complex)*ld);
+
+    if(size>1) {
+      StartTimer(27);
+      SafeMpiReduce_fcmp(pack,buf,n,comm);
+      StopTimer(27);
+      vec = buf;
+    } else {
+      vec = pack;
+    }
+
+    if(rank==0) {
+      #pragma omp parallel for default(shared) private(i)
+      for(i=0;i<ld;i++) {
+        double complex *src = vec+i*ld-i*(i-1)/2;
+        double complex *dst = SROptOO+i*ld+i;
+        int j;
+        for(j=0;j<ld-i;j++) dst[j] = src[j] * invW;
+      }
+      for(i=0;i<ld;i++) SROptHO[i] = vec[nOO+i] * invW;
+    }
+
+    ReleaseWorkSpaceComplex();
+#else
+    /* only <O_i>, <O_i O_i> and <HO_i> are averaged here.
+       the rest of the lower triangle is kept as the sum of each process and
+       reduced onto the process grid of S by stcOptReduceS (MPI_Reduce_scatter). */
+    ld = 2*SROptSize;
+    n  = 3*ld;
+    RequestWorkSpaceComplex(2*n);
+    pack = GetWorkSpaceComplex(n);
+    buf  = GetWorkSpaceComplex(n);
+
+    for(i=0;i<ld;i++) {
+      pack[i]      = SROptOO[i];
+      pack[ld+i]   = SROptOO[i*ld+i];
+      pack[2*ld+i] = SROptHO[i];
+    }
+
+    if(size>1) {
+      StartTimer(27);
+      SafeMpiAllReduce_fcmp(pack,buf,n,comm);
+      StopTimer(27);
+      vec = buf;
+    } else {
+      vec = pack;
+    }
+
+    for(i=0;i<ld;i++) {
+      SROptOO[i]       = vec[i] * invW;
+      SROptOO[i*ld+i]  = vec[ld+i] * invW;
+      SROptHO[i]       = vec[2*ld+i] * invW;
+    }
+
+    ReleaseWorkSpaceComplex();
+#endif
+    return;
   }
+
+  /* SROptOO and SROptHO */ // except for SROptO 
+  n = 2*SROptSize*3;
   vec = SROptOO;
   if(size>1) {
     RequestWorkSpaceComplex(n);
     buf = GetWorkSpaceComplex(n);
 
+    StartTimer(27);
     SafeMpiAllReduce_fcmp(vec,buf,n,comm);
+    StopTimer(27);
 
     #pragma omp parallel for default(shared) private(i)
     #pragma loop noalias
@@ -111,27 +184,100 @@ void WeightAverageSROpt(MPI_Comm comm) {
 }
 
 /* calculate average of SROptOO_real and SROptHO_real */
-/* All processes will have the result */
+/* All processes will have the result except for the dense lower triangle of SROptOO_real */
 void WeightAverageSROpt_real(MPI_Comm comm) {
-  int i,n;
+  int i,n,ld;
   double invW = 1.0/Wc;
-  double *vec,*buf;
+  double *vec,*buf,*pack;
   int rank,size;
   MPI_Comm_rank(comm,&rank);
   MPI_Comm_size(comm,&size);
 
-  /* SROptOO and SROptHO */ // except for SROptO 
-  if(NSRCG == 0){
-    n = SROptSize*(SROptSize+1);
-  }else{
-    n = SROptSize*3;
+  if(!IsSROptOODiag()){
+#ifdef _lapack
+    int nOO;
+    /* the lower triangle of SROptOO_real and SROptHO_real are packed column by column.
+       only rank 0 solves S x = g by DPOSV, so that they are reduced to rank 0. */
+    ld  = SROptSize;
+    nOO = ld*(ld+1)/2;
+    n   = nOO+ld;
+    RequestWorkSpaceDouble(2*n);
+    pack = GetWorkSpaceDouble(n);
+    buf  = GetWorkSpaceDouble(n);
+
+    #pragma omp parallel for default(shared) private(i)
+    for(i=0;i<ld;i++) {
+      memcpy(pack+i*ld-i*(i-1)/2, SROptOO_real+i*ld+i, sizeof(double)*(ld-i));
+    }
+    memcpy(pack+nOO, SROptHO_real, sizeof(double)*ld);
+
+    if(size>1) {
+      StartTimer(27);
+      SafeMpiReduce(pack,buf,n,comm);
+      StopTimer(27);
+      vec = buf;
+    } else {
+      vec = pack;
+    }
+
+    if(rank==0) {
+      #pragma omp parallel for default(shared) private(i)
+      for(i=0;i<ld;i++) {
+        double *src = vec+i*ld-i*(i-1)/2;
+        double *dst = SROptOO_real+i*ld+i;
+        int j;
+        for(j=0;j<ld-i;j++) dst[j] = src[j] * invW;
+      }
+      for(i=0;i<ld;i++) SROptHO_real[i] = vec[nOO+i] * invW;
+    }
+
+    ReleaseWorkSpaceDouble();
+#else
+    /* only <O_i>, <O_i O_i> and <HO_i> are averaged here.
+       the rest of the lower triangle is kept as the sum of each process and
+       reduced onto the process grid of S by stcOptReduceS (MPI_Reduce_scatter). */
+    ld = SROptSize;
+    n  = 3*ld;
+    RequestWorkSpaceDouble(2*n);
+    pack = GetWorkSpaceDouble(n);
+    buf  = GetWorkSpaceDouble(n);
+
+    for(i=0;i<ld;i++) {
+      pack[i]      = SROptOO_real[i];
+      pack[ld+i]   = SROptOO_real[i*ld+i];
+      pack[2*ld+i] = SROptHO_real[i];
+    }
+
+    if(size>1) {
+      StartTimer(27);
+      SafeMpiAllReduce(pack,buf,n,comm);
+      StopTimer(27);
+      vec = buf;
+    } else {
+      vec = pack;
+    }
+
+    for(i=0;i<ld;i++) {
+      SROptOO_real[i]       = vec[i] * invW;
+      SROptOO_real[i*ld+i]  = vec[ld+i] * invW;
+      SROptHO_real[i]       = vec[2*ld+i] * invW;
+    }
+
+    ReleaseWorkSpaceDouble();
+#endif
+    return;
   }
+
+  /* SROptOO and SROptHO */ // except for SROptO 
+  n = SROptSize*3;
   vec = SROptOO_real;
   if(size>1) {
     RequestWorkSpaceDouble(n);
     buf = GetWorkSpaceDouble(n);
 
+    StartTimer(27);
     SafeMpiAllReduce(vec,buf,n,comm);
+    StopTimer(27);
 
     #pragma omp parallel for default(shared) private(i)
     #pragma loop noalias
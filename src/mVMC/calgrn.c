@@ -37,6 +37,11 @@ void CalculateGreenFunc(const double w, const double complex ip, int *eleIdx, in
   double complex tmp;
   int *myEleIdx, *myEleNum, *myProjCntNew;
   double complex *myBuffer;
+  int batchCisAjs;
+
+  StartTimer(50);
+  batchCisAjs = GreenFunc1Batch(NCisAjs,CisAjsIdx,ip,eleIdx,eleCfg,eleNum,eleProjCnt,LocalCisAjs);
+  StopTimer(50);
 
   RequestWorkSpaceThreadInt(Nsize+Nsite2+NProj);
   RequestWorkSpaceThreadComplex(NQPFull+2*Nsize);
@@ -55,20 +60,20 @@ void CalculateGreenFunc(const double w, const double complex ip, int *eleIdx, in
     #pragma loop noalias
     for(idx=0;idx<Nsite2;idx++) myEleNum[idx] = eleNum[idx];
 
-    #pragma omp master
-    {StartTimer(50);}
-
-    #pragma omp for private(idx,ri,rj,s,tmp) schedule(dynamic) nowait
-    for(idx=0;idx<NCisAjs;idx++) {
-      ri = CisAjsIdx[idx][0];
-      rj = CisAjsIdx[idx][2];
-      s  = CisAjsIdx[idx][3];
-      tmp = GreenFunc1(ri,rj,s,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,
-                       myProjCntNew,myBuffer);
-      LocalCisAjs[idx] = tmp;
+    StartTimerThread(50);
+
+    if(!batchCisAjs) {
+      #pragma omp for private(idx,ri,rj,s,tmp) schedule(dynamic) nowait
+      for(idx=0;idx<NCisAjs;idx++) {
+        ri = CisAjsIdx[idx][0];
+        rj = CisAjsIdx[idx][2];
+        s  = CisAjsIdx[idx][3];
+        tmp = GreenFunc1(ri,rj,s,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,
+                         myProjCntNew,myBuffer);
+        LocalCisAjs[idx] = tmp;
+      }
     }
-    #pragma omp master
-    {StopTimer(50);StartTimer(51);}
+    StopTimerThread(50);StartTimerThread(51);
     
     #pragma omp for private(idx,ri,rj,s,rk,rl,t,tmp) schedule(dynamic)
     for(idx=0;idx<NCisAjsCktAltDC;idx++) {
@@ -84,16 +89,14 @@ void CalculateGreenFunc(const double w, const double complex ip, int *eleIdx, in
       PhysCisAjsCktAltDC[idx] += w*tmp;
     }
     
-    #pragma omp master
-    {StopTimer(51);StartTimer(52);}
+    StopTimerThread(51);StartTimerThread(52);
 
     #pragma omp for private(idx) nowait
     for(idx=0;idx<NCisAjs;idx++) {
       PhysCisAjs[idx] += w*LocalCisAjs[idx];
     }
 
-    #pragma omp master
-    {StopTimer(52);StartTimer(53);}
+    StopTimerThread(52);StartTimerThread(53);
 
     #pragma omp for private(idx,idx0,idx1) nowait
     for(idx=0;idx<NCisAjsCktAlt;idx++) {
@@ -102,8 +105,7 @@ void CalculateGreenFunc(const double w, const double complex ip, int *eleIdx, in
       PhysCisAjsCktAlt[idx] += w*LocalCisAjs[idx0]*conj(LocalCisAjs[idx1]);// TBC conj ok?
     }
 
-    #pragma omp master
-    {StopTimer(53);}
+    StopTimerThread(53);
   }
 
   ReleaseWorkSpaceThreadInt();
@@ -112,6 +114,95 @@ void CalculateGreenFunc(const double w, const double complex ip, int *eleIdx, in
 }
 
 
+/* CalculateGreenFunc for the real wave function, using InvM_real and PfM_real. */
+/* The local Green functions are also copied to LocalCisAjs for LSLocalCisAjs_real. */
+void CalculateGreenFunc_real(const double w, const double ip, int *eleIdx, int *eleCfg,
+                             int *eleNum, int *eleProjCnt) {
+
+  int idx,idx0,idx1;
+  int ri,rj,s,rk,rl,t;
+  double tmp;
+  int *myEleIdx, *myEleNum, *myProjCntNew;
+  double *myBuffer;
+  double *localCisAjs = LocalCisAjs_real;
+  int batchCisAjs;
+
+  StartTimer(50);
+  batchCisAjs = GreenFunc1Batch_real(NCisAjs,CisAjsIdx,ip,eleIdx,eleCfg,eleNum,eleProjCnt,localCisAjs);
+  StopTimer(50);
+
+  RequestWorkSpaceThreadInt(Nsize+Nsite2+NProj);
+  RequestWorkSpaceThreadDouble(NQPFull+2*Nsize);
+  /* GreenFunc1_real: NQPFull, GreenFunc2_real: NQPFull+2*Nsize */
+
+  #pragma omp parallel default(shared)		\
+  private(myEleIdx,myEleNum,myProjCntNew,myBuffer,idx)
+  {
+    myEleIdx = GetWorkSpaceThreadInt(Nsize);
+    myEleNum = GetWorkSpaceThreadInt(Nsite2);
+    myProjCntNew = GetWorkSpaceThreadInt(NProj);
+    myBuffer = GetWorkSpaceThreadDouble(NQPFull+2*Nsize);
+
+    #pragma loop noalias
+    for(idx=0;idx<Nsize;idx++) myEleIdx[idx] = eleIdx[idx];
+    #pragma loop noalias
+    for(idx=0;idx<Nsite2;idx++) myEleNum[idx] = eleNum[idx];
+
+    StartTimerThread(50);
+
+    if(!batchCisAjs) {
+      #pragma omp for private(idx,ri,rj,s,tmp) schedule(dynamic) nowait
+      for(idx=0;idx<NCisAjs;idx++) {
+        ri = CisAjsIdx[idx][0];
+        rj = CisAjsIdx[idx][2];
+        s  = CisAjsIdx[idx][3];
+        tmp = GreenFunc1_real(ri,rj,s,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,
+                              myProjCntNew,myBuffer);
+        localCisAjs[idx] = tmp;
+      }
+    }
+    StopTimerThread(50);StartTimerThread(51);
+
+    #pragma omp for private(idx,ri,rj,s,rk,rl,t,tmp) schedule(dynamic)
+    for(idx=0;idx<NCisAjsCktAltDC;idx++) {
+      ri = CisAjsCktAltDCIdx[idx][0];
+      rj = CisAjsCktAltDCIdx[idx][2];
+      s  = CisAjsCktAltDCIdx[idx][1];
+      rk = CisAjsCktAltDCIdx[idx][4];
+      rl = CisAjsCktAltDCIdx[idx][6];
+      t  = CisAjsCktAltDCIdx[idx][5];
+
+      tmp = GreenFunc2_real(ri,rj,rk,rl,s,t,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,
+                            myProjCntNew,myBuffer);
+      PhysCisAjsCktAltDC[idx] += w*tmp;
+    }
+
+    StopTimerThread(51);StartTimerThread(52);
+
+    #pragma omp for private(idx) nowait
+    for(idx=0;idx<NCisAjs;idx++) {
+      LocalCisAjs[idx] = localCisAjs[idx];
+      PhysCisAjs[idx] += w*localCisAjs[idx];
+    }
+
+    StopTimerThread(52);StartTimerThread(53);
+
+    #pragma omp for private(idx,idx0,idx1) nowait
+    for(idx=0;idx<NCisAjsCktAlt;idx++) {
+      idx0 = CisAjsCktAltIdx[idx][0];
+      idx1 = CisAjsCktAltIdx[idx][1];
+      PhysCisAjsCktAlt[idx] += w*localCisAjs[idx0]*localCisAjs[idx1];
+    }
+
+    StopTimerThread(53);
+  }
+
+  ReleaseWorkSpaceThreadInt();
+  ReleaseWorkSpaceThreadDouble();
+  return;
+}
+
+
 void CalculateGreenFuncBF(const double w, const double ip, int *eleIdx, int *eleCfg,
                           int *eleNum, int *eleProjCnt, const int *eleProjBFCnt) {
 
@@ -145,8 +236,7 @@ void CalculateGreenFuncBF(const double w, const double ip, int *eleIdx, int *ele
     for(idx=0;idx<Nsite2;idx++) myEleCfg[idx] = eleCfg[idx];
 
     StoreSlaterElmBF_fcmp(mySltBFTmp);
-#pragma omp master
-    {StartTimer(50);}
+    StartTimerThread(50);
 
 #pragma omp for private(idx,ri,rj,s,tmp) schedule(dynamic) nowait
     for(idx=0;idx<NCisAjs;idx++) {
@@ -157,8 +247,7 @@ void CalculateGreenFuncBF(const double w, const double ip, int *eleIdx, int *ele
       LocalCisAjs[idx] = tmp;
     }
 
-#pragma omp master
-    {StopTimer(50);StartTimer(51);}
+    StopTimerThread(50);StartTimerThread(51);
 
 #pragma omp for private(idx,ri,rj,s,rk,rl,t,tmp) schedule(dynamic)
     for(idx=0;idx<NCisAjsCktAltDC;idx++) {
@@ -173,16 +262,14 @@ void CalculateGreenFuncBF(const double w, const double ip, int *eleIdx, int *ele
       PhysCisAjsCktAltDC[idx] += w*tmp;
     }
 
-#pragma omp master
-    {StopTimer(51);StartTimer(52);}
+    StopTimerThread(51);StartTimerThread(52);
 
 #pragma omp for private(idx) nowait
     for(idx=0;idx<NCisAjs;idx++) {
       PhysCisAjs[idx] += w*LocalCisAjs[idx];
     }
 
-#pragma omp master
-    {StopTimer(52);StartTimer(53);}
+    StopTimerThread(52);StartTimerThread(53);
 
 #pragma omp for private(idx,idx0,idx1) nowait
     for(idx=0;idx<NCisAjsCktAlt;idx++) {
@@ -191,8 +278,7 @@ void CalculateGreenFuncBF(const double w, const double ip, int *eleIdx, int *ele
       PhysCisAjsCktAlt[idx] += w*LocalCisAjs[idx0]*LocalCisAjs[idx1];
     }
 
-#pragma omp master
-    {StopTimer(53);}
+    StopTimerThread(53);
   }
 
   ReleaseWorkSpaceThreadInt();
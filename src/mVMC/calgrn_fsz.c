@@ -59,8 +59,7 @@ void CalculateGreenFunc_fsz(const double w, const double complex ip, int *eleIdx
     #pragma loop noalias
     for(idx=0;idx<Nsite2;idx++) myEleNum[idx] = eleNum[idx];
 
-    #pragma omp master
-    {StartTimer(50);}
+    StartTimerThread(50);
 
     #pragma omp for private(idx,ri,rj,s,tmp) schedule(dynamic) nowait
     for(idx=0;idx<NCisAjs;idx++) {
@@ -78,8 +77,7 @@ void CalculateGreenFunc_fsz(const double w, const double complex ip, int *eleIdx
       LocalCisAjs[idx] = tmp;
     }
 
-    #pragma omp master
-    {StopTimer(50);StartTimer(51);}
+    StopTimerThread(50);StartTimerThread(51);
     
     #pragma omp for private(idx,ri,rj,s,rk,rl,t,tmp) schedule(dynamic)
     for(idx=0;idx<NCisAjsCktAltDC;idx++) {
@@ -111,16 +109,14 @@ void CalculateGreenFunc_fsz(const double w, const double complex ip, int *eleIdx
       PhysCisAjsCktAltDC[idx] += w*tmp;
     }
     
-    #pragma omp master
-    {StopTimer(51);StartTimer(52);}
+    StopTimerThread(51);StartTimerThread(52);
 
     #pragma omp for private(idx) nowait
     for(idx=0;idx<NCisAjs;idx++) {
       PhysCisAjs[idx] += w*LocalCisAjs[idx];
     }
     
-    #pragma omp master
-    {StopTimer(52);StartTimer(53);}
+    StopTimerThread(52);StartTimerThread(53);
 
     #pragma omp for private(idx,idx0,idx1) nowait
     for(idx=0;idx<NCisAjsCktAlt;idx++) {
@@ -129,8 +125,7 @@ void CalculateGreenFunc_fsz(const double w, const double complex ip, int *eleIdx
       PhysCisAjsCktAlt[idx] += w*LocalCisAjs[idx0]*conj(LocalCisAjs[idx1]);// TBC conj ok?
     }
 
-    #pragma omp master
-    {StopTimer(53);}
+    StopTimerThread(53);
   }
 
   ReleaseWorkSpaceThreadInt();
@@ -66,6 +66,13 @@ double complex CalculateHamiltonian(const double complex ip, int *eleIdx, const
   int *myEleIdx, *myEleNum, *myProjCntNew;
   double complex *myBuffer;
   double complex myEnergy;
+  double complex *greenTransfer;
+  int batchTransfer;
+
+  StartTimer(73);
+  greenTransfer = GreenTransfer;
+  batchTransfer = GreenFunc1Batch(NTransfer,Transfer,ip,eleIdx,eleCfg,eleNum,eleProjCnt,greenTransfer);
+  StopTimer(73);
 
   RequestWorkSpaceThreadInt(Nsize+Nsite2+NProj);
   RequestWorkSpaceThreadComplex(NQPFull+2*Nsize);
@@ -97,8 +104,7 @@ double complex CalculateHamiltonian(const double complex ip, int *eleIdx, const
     
     myEnergy = 0.0;
 
-    #pragma omp master
-    {StartTimer(70);}
+    StartTimerThread(70);
 
     /* CoulombIntra */
     #pragma omp for private(idx,ri) nowait
@@ -124,23 +130,29 @@ double complex CalculateHamiltonian(const double complex ip, int *eleIdx, const
       /* Caution: negative sign */
     }
 
-    #pragma omp master
-    {StopTimer(70);StartTimer(71);}
+    StopTimerThread(70);StartTimerThread(71);
 
     /* Transfer */
-    #pragma omp for private(idx,ri,rj,s) schedule(dynamic) nowait
-    for(idx=0;idx<NTransfer;idx++) {
-      ri = Transfer[idx][0];
-      rj = Transfer[idx][2];
-      s  = Transfer[idx][3];
-      
-      myEnergy -= ParaTransfer[idx]
-        * GreenFunc1(ri,rj,s,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,myProjCntNew,myBuffer);
-      /* Caution: negative sign */
+    if(batchTransfer) {
+      #pragma omp for private(idx) nowait
+      for(idx=0;idx<NTransfer;idx++) {
+        myEnergy -= ParaTransfer[idx] * greenTransfer[idx];
+        /* Caution: negative sign */
+      }
+    } else {
+      #pragma omp for private(idx,ri,rj,s) schedule(dynamic) nowait
+      for(idx=0;idx<NTransfer;idx++) {
+        ri = Transfer[idx][0];
+        rj = Transfer[idx][2];
+        s  = Transfer[idx][3];
+
+        myEnergy -= ParaTransfer[idx]
+          * GreenFunc1(ri,rj,s,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,myProjCntNew,myBuffer);
+        /* Caution: negative sign */
+      }
     }
 
-    #pragma omp master
-    {StopTimer(71);StartTimer(72);}
+    StopTimerThread(71);StartTimerThread(72);
 
     /* Pair Hopping */
     #pragma omp for private(idx,ri,rj) schedule(dynamic) nowait
@@ -177,8 +189,7 @@ double complex CalculateHamiltonian(const double complex ip, int *eleIdx, const
         * GreenFunc2(ri,rj,rk,rl,s,t,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,myProjCntNew,myBuffer);
     }
 
-    #pragma omp master
-    {StopTimer(72);}
+    StopTimerThread(72);
 
     e += myEnergy;
   }
@@ -188,6 +199,86 @@ double complex CalculateHamiltonian(const double complex ip, int *eleIdx, const
   return e;
 }
 
+/* CalculateHamiltonian for the given pfM and invM instead of the global ones. */
+/* It runs serially, so that each thread can evaluate its own configuration. */
+/* projCntNew size = NProj, buffer size = NQPFull+2*Nsize */
+double complex CalculateHamiltonianChain(const double complex ip, int *eleIdx, const int *eleCfg,
+                                         int *eleNum, const int *eleProjCnt,
+                                         double complex *pfM, double complex *invM,
+                                         int *projCntNew, double complex *buffer) {
+  const int *n0 = eleNum;
+  const int *n1 = eleNum + Nsite;
+  double complex e=0.0, tmp;
+  int idx;
+  int ri,rj,s,rk,rl,t;
+
+  /* CoulombIntra */
+  for(idx=0;idx<NCoulombIntra;idx++) {
+    ri = CoulombIntra[idx];
+    e += ParaCoulombIntra[idx] * n0[ri] * n1[ri];
+  }
+
+  /* CoulombInter */
+  for(idx=0;idx<NCoulombInter;idx++) {
+    ri = CoulombInter[idx][0];
+    rj = CoulombInter[idx][1];
+    e += ParaCoulombInter[idx] * (n0[ri]+n1[ri]) * (n0[rj]+n1[rj]);
+  }
+
+  /* HundCoupling */
+  for(idx=0;idx<NHundCoupling;idx++) {
+    ri = HundCoupling[idx][0];
+    rj = HundCoupling[idx][1];
+    e -= ParaHundCoupling[idx] * (n0[ri]*n0[rj] + n1[ri]*n1[rj]);
+    /* Caution: negative sign */
+  }
+
+  /* Transfer */
+  for(idx=0;idx<NTransfer;idx++) {
+    ri = Transfer[idx][0];
+    rj = Transfer[idx][2];
+    s  = Transfer[idx][3];
+
+    e -= ParaTransfer[idx]
+      * GreenFunc1Chain(ri,rj,s,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,pfM,invM);
+    /* Caution: negative sign */
+  }
+
+  /* Pair Hopping */
+  for(idx=0;idx<NPairHopping;idx++) {
+    ri = PairHopping[idx][0];
+    rj = PairHopping[idx][1];
+
+    e += ParaPairHopping[idx]
+      * GreenFunc2Chain(ri,rj,ri,rj,0,1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,pfM,invM);
+  }
+
+  /* Exchange Coupling */
+  for(idx=0;idx<NExchangeCoupling;idx++) {
+    ri = ExchangeCoupling[idx][0];
+    rj = ExchangeCoupling[idx][1];
+
+    tmp =  GreenFunc2Chain(ri,rj,rj,ri,0,1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,pfM,invM);
+    tmp += GreenFunc2Chain(ri,rj,rj,ri,1,0,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,pfM,invM);
+    e += ParaExchangeCoupling[idx] * tmp;
+  }
+
+  /* Inter All */
+  for(idx=0;idx<NInterAll;idx++) {
+    ri = InterAll[idx][0];
+    rj = InterAll[idx][2];
+    s  = InterAll[idx][3];
+    rk = InterAll[idx][4];
+    rl = InterAll[idx][6];
+    t  = InterAll[idx][7];
+
+    e += ParaInterAll[idx]
+      * GreenFunc2Chain(ri,rj,rk,rl,s,t,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,pfM,invM);
+  }
+
+  return e;
+}
+
 /* Calculate the CoulombIntra, CoulombInter, Hund terms, */
 /* which can be calculated by number operators. */
 /* This function will be used in the Lanczos mode */
@@ -408,8 +499,7 @@ double complex CalculateHamiltonianBF_fcmp(const double complex ip, int *eleIdx,
 
     myEnergy = 0.0;
 
-#pragma omp master
-    {StartTimer(70);}
+    StartTimerThread(70);
 
     /* CoulombIntra */
 #pragma omp for private(idx,ri) nowait
@@ -435,8 +525,7 @@ double complex CalculateHamiltonianBF_fcmp(const double complex ip, int *eleIdx,
       /* Caution: negative sign */
     }
 
-#pragma omp master
-    {StopTimer(70);StartTimer(71);}
+    StopTimerThread(70);StartTimerThread(71);
 
     /* Transfer */
 #pragma omp for private(idx,ri,rj,s) schedule(dynamic) nowait
@@ -451,8 +540,7 @@ double complex CalculateHamiltonianBF_fcmp(const double complex ip, int *eleIdx,
       /* Caution: negative sign */
     }
 
-#pragma omp master
-    {StopTimer(71);StartTimer(72);}
+    StopTimerThread(71);StartTimerThread(72);
 
     /* Pair Hopping */
 #pragma omp for private(idx,ri,rj) schedule(dynamic) nowait
@@ -488,8 +576,7 @@ double complex CalculateHamiltonianBF_fcmp(const double complex ip, int *eleIdx,
                   * GreenFunc2(ri,rj,rk,rl,s,t,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,myProjCntNew,myBuffer);
     }
 
-#pragma omp master
-    {StopTimer(72);}
+    StopTimerThread(72);
 
     e += myEnergy;
   }
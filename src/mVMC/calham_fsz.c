@@ -90,8 +90,7 @@ double complex CalculateHamiltonian_fsz(const double complex ip, int *eleIdx, co
     
     myEnergy = 0.0;
 
-    #pragma omp master
-    {StartTimer(70);}
+    StartTimerThread(70);
 
     /* CoulombIntra */
     #pragma omp for private(idx,ri) nowait
@@ -117,8 +116,7 @@ double complex CalculateHamiltonian_fsz(const double complex ip, int *eleIdx, co
       /* Caution: negative sign */
     }
 
-    #pragma omp master
-    {StopTimer(70);StartTimer(71);}
+    StopTimerThread(70);StartTimerThread(71);
 
     /* Transfer */
     #pragma omp for private(idx,ri,rj,s,t) schedule(dynamic) nowait
@@ -137,8 +135,7 @@ double complex CalculateHamiltonian_fsz(const double complex ip, int *eleIdx, co
       /* Caution: negative sign */
     }
 
-    #pragma omp master
-    {StopTimer(71);StartTimer(72);}
+    StopTimerThread(71);StartTimerThread(72);
 
     /* Pair Hopping */
     #pragma omp for private(idx,ri,rj) schedule(dynamic) nowait
@@ -185,8 +182,7 @@ double complex CalculateHamiltonian_fsz(const double complex ip, int *eleIdx, co
       } 
     }
 
-    #pragma omp master
-    {StopTimer(72);}
+    StopTimerThread(72);
 
     e += myEnergy;
   }
@@ -73,8 +73,7 @@ double CalculateHamiltonian_fsz_real(const double ip, int *eleIdx, const int *el
     
     myEnergy = 0.0;
 
-    #pragma omp master
-    {StartTimer(70);}
+    StartTimerThread(70);
 
     /* CoulombIntra */
     #pragma omp for private(idx,ri) nowait
@@ -100,8 +99,7 @@ double CalculateHamiltonian_fsz_real(const double ip, int *eleIdx, const int *el
       /* Caution: negative sign */
     }
 
-    #pragma omp master
-    {StopTimer(70);StartTimer(71);}
+    StopTimerThread(70);StartTimerThread(71);
 
     /* Transfer */
     #pragma omp for private(idx,ri,rj,s,t) schedule(dynamic) nowait
@@ -120,8 +118,7 @@ double CalculateHamiltonian_fsz_real(const double ip, int *eleIdx, const int *el
       /* Caution: negative sign */
     }
 
-    #pragma omp master
-    {StopTimer(71);StartTimer(72);}
+    StopTimerThread(71);StartTimerThread(72);
 
     /* Pair Hopping */
     #pragma omp for private(idx,ri,rj) schedule(dynamic) nowait
@@ -165,8 +162,7 @@ double CalculateHamiltonian_fsz_real(const double ip, int *eleIdx, const int *el
       } 
     }
 
-    #pragma omp master
-    {StopTimer(72);}
+    StopTimerThread(72);
 
     e += myEnergy;
   }
@@ -50,6 +50,13 @@ double CalculateHamiltonian_real(const double ip, int *eleIdx, const int *eleCfg
   int *myEleIdx, *myEleNum, *myProjCntNew;
   double  *myBuffer;
   double  myEnergy;
+  double  *greenTransfer;
+  int batchTransfer;
+
+  StartTimer(73);
+  greenTransfer = GreenTransfer_real;
+  batchTransfer = GreenFunc1Batch_real(NTransfer,Transfer,ip,eleIdx,eleCfg,eleNum,eleProjCnt,greenTransfer);
+  StopTimer(73);
 
   RequestWorkSpaceThreadInt(Nsize+Nsite2+NProj);
   RequestWorkSpaceThreadDouble(NQPFull+2*Nsize);
@@ -81,8 +88,7 @@ double CalculateHamiltonian_real(const double ip, int *eleIdx, const int *eleCfg
     
     myEnergy = 0.0;
 
-    #pragma omp master
-    {StartTimer(70);}
+    StartTimerThread(70);
 #ifdef _DEBUG
 #pragma omp master
     printf("    Debug: CoulombIntra\n");
@@ -119,27 +125,33 @@ double CalculateHamiltonian_real(const double ip, int *eleIdx, const int *eleCfg
       /* Caution: negative sign */
     }
 
-    #pragma omp master
-    {StopTimer(70);StartTimer(71);}
+    StopTimerThread(70);StartTimerThread(71);
 
 #ifdef _DEBUG
 #pragma omp master
     printf("    Debug: Transfer\n");
 #endif
     /* Transfer */
+    if(batchTransfer) {
+#pragma omp for private(idx) nowait
+      for(idx=0;idx<NTransfer;idx++) {
+        myEnergy -= creal(ParaTransfer[idx]) * greenTransfer[idx];
+        /* Caution: negative sign */
+      }
+    } else {
 #pragma omp for private(idx,ri,rj,s) schedule(dynamic) nowait
-    for(idx=0;idx<NTransfer;idx++) {
-      ri = Transfer[idx][0];
-      rj = Transfer[idx][2];
-      s  = Transfer[idx][3];
-      
-      myEnergy -= creal(ParaTransfer[idx])
-        * GreenFunc1_real(ri,rj,s,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,myProjCntNew,myBuffer);
-      /* Caution: negative sign */
+      for(idx=0;idx<NTransfer;idx++) {
+        ri = Transfer[idx][0];
+        rj = Transfer[idx][2];
+        s  = Transfer[idx][3];
+
+        myEnergy -= creal(ParaTransfer[idx])
+          * GreenFunc1_real(ri,rj,s,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,myProjCntNew,myBuffer);
+        /* Caution: negative sign */
+      }
     }
 
-    #pragma omp master
-    {StopTimer(71);StartTimer(72);}
+    StopTimerThread(71);StartTimerThread(72);
 
 #ifdef _DEBUG
 #pragma omp master
@@ -189,8 +201,7 @@ double CalculateHamiltonian_real(const double ip, int *eleIdx, const int *eleCfg
         * GreenFunc2_real(ri,rj,rk,rl,s,t,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,myProjCntNew,myBuffer);
     }
 
-    #pragma omp master
-    {StopTimer(72);}
+    StopTimerThread(72);
 #ifdef _DEBUG    
     printf("    Debug: myEnergy=%lf\n", myEnergy);
 #endif
@@ -251,8 +262,7 @@ double CalculateHamiltonianBF_real(const double ip, int *eleIdx, const int *eleC
 
     myEnergy = 0.0;
 
-#pragma omp master
-    {StartTimer(70);}
+    StartTimerThread(70);
 
     /* CoulombIntra */
 #pragma omp for private(idx,ri) nowait
@@ -278,8 +288,7 @@ double CalculateHamiltonianBF_real(const double ip, int *eleIdx, const int *eleC
       /* Caution: negative sign */
     }
 
-#pragma omp master
-    {StopTimer(70);StartTimer(71);}
+    StopTimerThread(70);StartTimerThread(71);
 
     /* Transfer */
 #pragma omp for private(idx,ri,rj,s) schedule(dynamic) nowait
@@ -294,8 +303,7 @@ double CalculateHamiltonianBF_real(const double ip, int *eleIdx, const int *eleC
       /* Caution: negative sign */
     }
 
-#pragma omp master
-    {StopTimer(71);StartTimer(72);}
+    StopTimerThread(71);StartTimerThread(72);
 
     /* Pair Hopping */
 #pragma omp for private(idx,ri,rj) schedule(dynamic) nowait
@@ -331,8 +339,7 @@ double CalculateHamiltonianBF_real(const double ip, int *eleIdx, const int *eleC
         * GreenFunc2_real(ri,rj,rk,rl,s,t,ip,myEleIdx,eleCfg,myEleNum,eleProjCnt,myProjCntNew,myBuffer);
     }
 
-#pragma omp master
-    {StopTimer(72);}
+    StopTimerThread(72);
 
     e += myEnergy;
   }
@@ -342,6 +349,89 @@ double CalculateHamiltonianBF_real(const double ip, int *eleIdx, const int *eleC
   return e;
 }
 
+/* CalculateHamiltonian_real for the given pfM and invM instead of the global ones. */
+/* It runs serially, so that each thread can evaluate its own configuration. */
+///
+/// \param projCntNew [in] work array of NProj
+/// \param buffer [in] work array of NQPFull+2*Nsize
+/// \return e
+double CalculateHamiltonianChain_real(const double ip, int *eleIdx, const int *eleCfg,
+                                      int *eleNum, const int *eleProjCnt,
+                                      double *pfM, double *invM,
+                                      int *projCntNew, double *buffer) {
+  const int *n0 = eleNum;
+  const int *n1 = eleNum + Nsite;
+  double e=0.0, tmp;
+  int idx;
+  int ri,rj,s,rk,rl,t;
+
+  /* CoulombIntra */
+  for(idx=0;idx<NCoulombIntra;idx++) {
+    ri = CoulombIntra[idx];
+    e += ParaCoulombIntra[idx] * n0[ri] * n1[ri];
+  }
+
+  /* CoulombInter */
+  for(idx=0;idx<NCoulombInter;idx++) {
+    ri = CoulombInter[idx][0];
+    rj = CoulombInter[idx][1];
+    e += ParaCoulombInter[idx] * (n0[ri]+n1[ri]) * (n0[rj]+n1[rj]);
+  }
+
+  /* HundCoupling */
+  for(idx=0;idx<NHundCoupling;idx++) {
+    ri = HundCoupling[idx][0];
+    rj = HundCoupling[idx][1];
+    e -= ParaHundCoupling[idx] * (n0[ri]*n0[rj] + n1[ri]*n1[rj]);
+    /* Caution: negative sign */
+  }
+
+  /* Transfer */
+  for(idx=0;idx<NTransfer;idx++) {
+    ri = Transfer[idx][0];
+    rj = Transfer[idx][2];
+    s  = Transfer[idx][3];
+
+    e -= creal(ParaTransfer[idx])
+      * GreenFunc1Chain_real(ri,rj,s,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,pfM,invM);
+    /* Caution: negative sign */
+  }
+
+  /* Pair Hopping */
+  for(idx=0;idx<NPairHopping;idx++) {
+    ri = PairHopping[idx][0];
+    rj = PairHopping[idx][1];
+
+    e += ParaPairHopping[idx]
+      * GreenFunc2Chain_real(ri,rj,ri,rj,0,1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,pfM,invM);
+  }
+
+  /* Exchange Coupling */
+  for(idx=0;idx<NExchangeCoupling;idx++) {
+    ri = ExchangeCoupling[idx][0];
+    rj = ExchangeCoupling[idx][1];
+
+    tmp =  GreenFunc2Chain_real(ri,rj,rj,ri,0,1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,pfM,invM);
+    tmp += GreenFunc2Chain_real(ri,rj,rj,ri,1,0,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,pfM,invM);
+    e += ParaExchangeCoupling[idx] * tmp;
+  }
+
+  /* Inter All */
+  for(idx=0;idx<NInterAll;idx++) {
+    ri = InterAll[idx][0];
+    rj = InterAll[idx][2];
+    s  = InterAll[idx][3];
+    rk = InterAll[idx][4];
+    rl = InterAll[idx][6];
+    t  = InterAll[idx][7];
+
+    e += creal(ParaInterAll[idx])
+      * GreenFunc2Chain_real(ri,rj,rk,rl,s,t,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,pfM,invM);
+  }
+
+  return e;
+}
+
 /* Calculate the CoulombIntra, CoulombInter, Hund terms, */
 /* which can be calculated by number operators. */
 ///
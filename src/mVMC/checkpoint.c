@@ -0,0 +1,174 @@
+/*
+mVMC - A numerical solver package for a wide range of quantum lattice models based on many-variable Variational Monte Carlo method
+Copyright (C) 2016 The University of Tokyo, All rights reserved.
+
+This program is developed based on the mVMC-mini program
+(https://github.com/fiber-miniapp/mVMC-mini)
+which follows "The BSD 3-Clause License".
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details. 
+
+You should have received a copy of the GNU General Public License 
+along with this program. If not, see http://www.gnu.org/licenses/. 
+*/
+/*-------------------------------------------------------------
+ * Variational Monte Carlo
+ * checkpoint and restart of the parameter optimization
+ *-------------------------------------------------------------*/
+#include "checkpoint.h"
+#ifndef _SRC_CHECKPOINT
+#define _SRC_CHECKPOINT
+
+#define D_CheckpointVersion 2
+
+/* Each process writes its own file zvo_checkpoint_<rank>.bin containing */
+/*   header   : version, MPI size, NThread, NPara, Nsize, Nsite2, NProj,  */
+/*              NSROptItrSmp, NMultiChain, the next SR step,              */
+/*              NVMCInterval, NVMCIntervalMax                             */
+/*   Para[NPara], BurnFlag, BurnEleIdx (and ChainBurnEleIdx),            */
+/*   Counter, the SFMT state of the master thread and of every chain,    */
+/*   SROptData                                                            */
+
+void checkpointFileName(char *fileName, const int rank) {
+  sprintf(fileName, "%s_checkpoint_%d.bin", CDataFileHead, rank);
+  return;
+}
+
+int checkpointBurnSize() {
+  return 2*Ne+2*Nsite+2*Nsite+NProj+2*Ne;
+}
+
+int checkpointChainSize() {
+  return (NMultiChain>0) ? NThread*(Nsize+2*Nsite2+NProj) : 0;
+}
+
+/* Write the state after the SR step "step" has been finished. */
+void WriteCheckpoint(const int step, MPI_Comm comm) {
+  char fileName[D_FileNameMax];
+  char fileNameTmp[D_FileNameMax+4];
+  FILE *fp;
+  int header[12];
+  int rank,size;
+  const int stateSize = get_state_size32();
+  uint32_t *state;
+  int n,info=0;
+
+  MPI_Comm_rank(comm,&rank);
+  MPI_Comm_size(comm,&size);
+
+  /* the stream of the master thread and those of the chains 1,...,NThread-1 */
+  state = (uint32_t*)malloc(sizeof(uint32_t)*NThread*stateSize);
+  if(NMultiChain>0) memcpy(state, ChainRandState, sizeof(uint32_t)*NThread*stateSize);
+  get_gen_state(state);
+  if(NMultiChain==0) {
+    for(n=1;n<NThread;n++) memcpy(state+n*stateSize, state, sizeof(uint32_t)*stateSize);
+  }
+
+  header[0] = D_CheckpointVersion;
+  header[1] = size;
+  header[2] = NThread;
+  header[3] = NPara;
+  header[4] = Nsize;
+  header[5] = Nsite2;
+  header[6] = NProj;
+  header[7] = NSROptItrSmp;
+  header[8] = NMultiChain;
+  header[9] = step+1;
+  header[10] = NVMCInterval; /* adapted by NAutoCorr==2 */
+  header[11] = NVMCIntervalMax;
+
+  checkpointFileName(fileName,rank);
+  sprintf(fileNameTmp, "%s.tmp", fileName);
+  if((fp=fopen(fileNameTmp, "wb"))==NULL) {
+    fprintf(stderr, "error: WriteCheckpoint: cannot open %s.\n", fileNameTmp);
+    info=1;
+  } else {
+    fwrite(header, sizeof(int), 12, fp);
+    fwrite(Para, sizeof(double complex), NPara, fp);
+    fwrite(&BurnFlag, sizeof(int), 1, fp);
+    fwrite(BurnEleIdx, sizeof(int), checkpointBurnSize(), fp);
+    fwrite(ChainBurnEleIdx, sizeof(int), checkpointChainSize(), fp);
+    fwrite(Counter, sizeof(int), Counter_max, fp);
+    fwrite(state, sizeof(uint32_t), NThread*stateSize, fp);
+    fwrite(SROptData, sizeof(double complex), NSROptItrSmp*(2+NPara), fp);
+    if(fclose(fp)!=0) info=1;
+    /* replace the previous checkpoint only after the new one is complete */
+    if(info==0 && rename(fileNameTmp, fileName)!=0) info=1;
+    if(info!=0) fprintf(stderr, "error: WriteCheckpoint: cannot write %s.\n", fileName);
+  }
+
+  free(state);
+  if(info!=0) MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+  return;
+}
+
+/* Restore the state written by WriteCheckpoint. */
+/* Returns the SR step from which the optimization is resumed. */
+int ReadCheckpoint(MPI_Comm comm) {
+  char fileName[D_FileNameMax];
+  FILE *fp;
+  int header[12];
+  int rank,size;
+  const int stateSize = get_state_size32();
+  uint32_t *state=NULL;
+  int n;
+  int info=0;
+
+  MPI_Comm_rank(comm,&rank);
+  MPI_Comm_size(comm,&size);
+
+  checkpointFileName(fileName,rank);
+  if((fp=fopen(fileName, "rb"))==NULL) {
+    fprintf(stderr, "error: ReadCheckpoint: %s does not exist.\n", fileName);
+    info=1;
+  } else {
+    if(fread(header, sizeof(int), 12, fp)!=12
+       || header[0]!=D_CheckpointVersion || header[1]!=size
+       || header[3]!=NPara || header[4]!=Nsize || header[5]!=Nsite2
+       || header[6]!=NProj || header[7]!=NSROptItrSmp || header[8]!=NMultiChain
+       || (NMultiChain>0 && header[2]!=NThread)) {
+      fprintf(stderr, "error: ReadCheckpoint: %s does not match this calculation.\n", fileName);
+      info=1;
+    } else {
+      state = (uint32_t*)malloc(sizeof(uint32_t)*header[2]*stateSize);
+      n = 0;
+      n += fread(Para, sizeof(double complex), NPara, fp);
+      n += fread(&BurnFlag, sizeof(int), 1, fp);
+      n += fread(BurnEleIdx, sizeof(int), checkpointBurnSize(), fp);
+      n += fread(ChainBurnEleIdx, sizeof(int), checkpointChainSize(), fp);
+      n += fread(Counter, sizeof(int), Counter_max, fp);
+      n += fread(state, sizeof(uint32_t), header[2]*stateSize, fp);
+      n += fread(SROptData, sizeof(double complex), NSROptItrSmp*(2+NPara), fp);
+      if(n != NPara+1+checkpointBurnSize()+checkpointChainSize()+Counter_max
+         +header[2]*stateSize+NSROptItrSmp*(2+NPara)) {
+        fprintf(stderr, "error: ReadCheckpoint: %s is incomplete.\n", fileName);
+        info=1;
+      }
+    }
+    fclose(fp);
+  }
+
+  if(info!=0) MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+
+  NVMCInterval = header[10];
+  NVMCIntervalMax = header[11];
+
+  /* the backflow walkers are longer than BurnEleIdx and are thermalized again */
+  if(NProjBF>0) BurnFlag = 0;
+
+  set_gen_state(state);
+  if(NMultiChain>0) memcpy(ChainRandState, state, sizeof(uint32_t)*NThread*stateSize);
+
+  free(state);
+  return header[9];
+}
+
+#endif
@@ -0,0 +1,321 @@
+/*
+mVMC - A numerical solver package for a wide range of quantum lattice models based on many-variable Variational Monte Carlo method
+Copyright (C) 2016 The University of Tokyo, All rights reserved.
+
+This program is developed based on the mVMC-mini program
+(https://github.com/fiber-miniapp/mVMC-mini)
+which follows "The BSD 3-Clause License".
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see http://www.gnu.org/licenses/.
+*/
+/*-------------------------------------------------------------
+ * Variational Monte Carlo
+ * binary container of the index and parameter def files
+ *-------------------------------------------------------------*/
+#include "defbinary.h"
+#include "readdef.h"
+#ifndef _SRC_DEFBINARY
+#define _SRC_DEFBINARY
+
+#define D_DefBinaryVersion 3
+#define D_DefBinaryNSize 8
+#define D_DefBinaryNSection 5
+#define D_DefBinaryNFile (KWIdxInt_end-KWLocSpin) /* the def files except for modpara.def */
+#define D_DefBinaryFNVBasis 14695981039346656037ULL
+
+/* zvo_def.bin keeps the arrays filled by ReadDefFileIdxPara()           */
+/*   header  : magic "mVMCdef", version, the number of sections,         */
+/*             Nsite, NTotalDefInt, NTotalDefDouble, NTransfer,          */
+/*             NInterAll, NQPTrans, the number of Lz indices, NPara,     */
+/*             {size, mtime, FNV-1a hash} of each def file from LocSpin  */
+/*             to BFRange; only the size and mtime are compared on read  */
+/*   table   : {type, count, checksum, offset} for each section          */
+/*   section : 0 LocSpn ... OptFlag           (int)                      */
+/*             1 CisAjsCktAltLzIdx            (int)                      */
+/*             2 ParaTransfer, ParaInterAll   (double complex)           */
+/*             3 ParaCoulombIntra ... ParaQPOptTrans (double)            */
+/*             4 ParaQPTrans                  (double complex)           */
+/* Each section starts at an 8-byte boundary. */
+
+typedef struct {
+  int32_t type;      /* 0: int, 1: double */
+  int32_t reserved;
+  int64_t count;     /* the number of int or double elements */
+  uint64_t checksum; /* FNV-1a hash of the section */
+  int64_t offset;    /* the position of the section in bytes */
+} DefBinarySection;
+
+typedef struct {
+  int64_t size;  /* st_size of the def file (-1 if not given) */
+  int64_t mtime; /* st_mtime of the def file */
+  uint64_t hash; /* FNV-1a hash of the contents, for reference */
+} DefBinaryFile;
+
+void defBinaryFileName(char *fileName) {
+  sprintf(fileName, "%s_def.bin", CDataFileHead);
+  return;
+}
+
+uint64_t defBinaryHash(uint64_t h, const void *data, const size_t n) {
+  const unsigned char *p = (const unsigned char*)data;
+  size_t i;
+  for(i=0;i<n;i++) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+uint64_t defBinaryChecksum(const void *data, const size_t n) {
+  return defBinaryHash(D_DefBinaryFNVBasis, data, n);
+}
+
+/* size and mtime of the def files listed in namelist.def */
+/* The contents are hashed only if withHash is nonzero, i.e. by WriteDefBinary(). */
+/* The file names are known only by rank 0, which broadcasts the result. */
+void defBinaryStatFiles(DefBinaryFile *file, const int withHash, MPI_Comm comm) {
+  char buf[4096];
+  FILE *fp;
+  struct stat st;
+  size_t n;
+  int i,rank;
+
+  MPI_Comm_rank(comm,&rank);
+  if(rank==0) {
+    for(i=0;i<D_DefBinaryNFile;i++) {
+      file[i].size = -1;
+      file[i].mtime = 0;
+      file[i].hash = 0;
+      if(strcmp(cFileNameListFile[KWLocSpin+i], "")==0) continue;
+      if(stat(cFileNameListFile[KWLocSpin+i], &st)!=0) continue;
+      file[i].size = (int64_t)st.st_size;
+      file[i].mtime = (int64_t)st.st_mtime;
+      if(withHash==0) continue;
+      if((fp=fopen(cFileNameListFile[KWLocSpin+i], "rb"))==NULL) continue;
+      file[i].hash = D_DefBinaryFNVBasis;
+      while((n=fread(buf, 1, sizeof(buf), fp))>0) file[i].hash = defBinaryHash(file[i].hash, buf, n);
+      fclose(fp);
+    }
+  }
+  MPI_Bcast(file, D_DefBinaryNFile*sizeof(DefBinaryFile), MPI_BYTE, 0, comm);
+  return;
+}
+
+int defBinaryNLz() {
+  return (NLanczosMode>1) ? NCisAjsCktAltDC : 0;
+}
+
+void defBinarySize(int32_t *size) {
+  size[0] = Nsite;
+  size[1] = NTotalDefInt;
+  size[2] = NTotalDefDouble;
+  size[3] = NTransfer;
+  size[4] = NInterAll;
+  size[5] = NQPTrans;
+  size[6] = defBinaryNLz();
+  size[7] = NPara;
+  return;
+}
+
+/* the type and the number of elements of each section */
+void defBinaryCount(int32_t *type, int64_t *count) {
+  type[0] = 0; count[0] = NTotalDefInt;
+  type[1] = 0; count[1] = 2*defBinaryNLz();
+  type[2] = 1; count[2] = 2*(NTransfer+NInterAll);
+  type[3] = 1; count[3] = NTotalDefDouble;
+  type[4] = 1; count[4] = 2*NQPTrans;
+  return;
+}
+
+/* Write the def files read by ReadDefFileIdxPara() into zvo_def.bin. */
+/* Only rank 0 writes the file. */
+int WriteDefBinary(MPI_Comm comm) {
+  char fileName[D_FileNameMax];
+  char fileNameTmp[D_FileNameMax+4];
+  FILE *fp;
+  const char magic[8] = "mVMCdef";
+  const int32_t version = D_DefBinaryVersion;
+  const int32_t nSection = D_DefBinaryNSection;
+  int32_t size[D_DefBinaryNSize];
+  DefBinaryFile file[D_DefBinaryNFile];
+  int32_t type[D_DefBinaryNSection];
+  int64_t count[D_DefBinaryNSection];
+  DefBinarySection section[D_DefBinaryNSection];
+  const void *data[D_DefBinaryNSection];
+  const char pad[8] = {0};
+  int *lzIdx=NULL;
+  int64_t offset;
+  size_t nByte;
+  int i,is,rank,info=0;
+
+  MPI_Comm_rank(comm,&rank);
+  defBinaryStatFiles(file, 1, comm);
+  if(rank!=0) return 0;
+
+  /* CisAjsCktAltLzIdx is not contiguous */
+  lzIdx = (int*)malloc(sizeof(int)*(2*defBinaryNLz()+1));
+  for(i=0;i<defBinaryNLz();i++) {
+    lzIdx[2*i]   = CisAjsCktAltLzIdx[i][0];
+    lzIdx[2*i+1] = CisAjsCktAltLzIdx[i][1];
+  }
+
+  data[0] = LocSpn;
+  data[1] = lzIdx;
+  data[2] = ParaTransfer;
+  data[3] = ParaCoulombIntra;
+  data[4] = ParaQPTrans;
+
+  defBinarySize(size);
+  defBinaryCount(type, count);
+  offset = sizeof(magic) + 2*sizeof(int32_t) + sizeof(size) + sizeof(file) + sizeof(section);
+  for(is=0;is<nSection;is++) {
+    nByte = count[is] * (type[is]==0 ? sizeof(int) : sizeof(double));
+    section[is].type = type[is];
+    section[is].reserved = 0;
+    section[is].count = count[is];
+    section[is].checksum = defBinaryChecksum(data[is], nByte);
+    section[is].offset = offset;
+    offset += (nByte+7)/8*8;
+  }
+
+  defBinaryFileName(fileName);
+  sprintf(fileNameTmp, "%s.tmp", fileName);
+  if((fp=fopen(fileNameTmp, "wb"))==NULL) {
+    fprintf(stderr, "error: WriteDefBinary: cannot open %s.\n", fileNameTmp);
+    free(lzIdx);
+    return 1;
+  }
+  fwrite(magic, sizeof(char), sizeof(magic), fp);
+  fwrite(&version, sizeof(int32_t), 1, fp);
+  fwrite(&nSection, sizeof(int32_t), 1, fp);
+  fwrite(size, sizeof(int32_t), D_DefBinaryNSize, fp);
+  fwrite(file, sizeof(DefBinaryFile), D_DefBinaryNFile, fp);
+  fwrite(section, sizeof(DefBinarySection), nSection, fp);
+  for(is=0;is<nSection;is++) {
+    nByte = count[is] * (type[is]==0 ? sizeof(int) : sizeof(double));
+    if(fwrite(data[is], 1, nByte, fp)!=nByte) info=1;
+    fwrite(pad, 1, (nByte+7)/8*8-nByte, fp);
+  }
+  if(fclose(fp)!=0) info=1;
+  if(info==0 && rename(fileNameTmp, fileName)!=0) info=1;
+  if(info!=0) {
+    fprintf(stderr, "error: WriteDefBinary: cannot write %s.\n", fileName);
+  } else {
+    fprintf(stdout, "  Write File '%s'.\n", fileName);
+  }
+
+  free(lzIdx);
+  return info;
+}
+
+/* Read zvo_def.bin instead of parsing the def files. */
+/* Every process maps the file by itself, so that no broadcast is needed. */
+int ReadDefBinary(MPI_Comm comm) {
+  char fileName[D_FileNameMax];
+  const char magic[8] = "mVMCdef";
+  int32_t size[D_DefBinaryNSize], sizeFile[D_DefBinaryNSize];
+  DefBinaryFile file[D_DefBinaryNFile], fileFile[D_DefBinaryNFile];
+  int32_t type[D_DefBinaryNSection];
+  int64_t count[D_DefBinaryNSection];
+  DefBinarySection section[D_DefBinaryNSection];
+  void *data[D_DefBinaryNSection];
+  const size_t nHeader = sizeof(magic) + 2*sizeof(int32_t) + sizeof(size) + sizeof(file) + sizeof(section);
+  const char *map;
+  struct stat st;
+  int32_t version, nSection;
+  size_t nByte;
+  int *lzIdx;
+  int i,is,fd,rank;
+  int info=0;
+
+  MPI_Comm_rank(comm,&rank);
+  defBinaryFileName(fileName);
+  if(rank==0) fprintf(stdout, "     %s\n", fileName);
+  defBinaryStatFiles(file, 0, comm);
+
+  fd = open(fileName, O_RDONLY);
+  if(fd<0 || fstat(fd, &st)!=0 || (size_t)st.st_size<nHeader) {
+    fprintf(stderr, "error: ReadDefBinary: cannot read %s.\n", fileName);
+    if(fd>=0) close(fd);
+    return 1;
+  }
+  map = (const char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map==MAP_FAILED) {
+    fprintf(stderr, "error: ReadDefBinary: cannot map %s.\n", fileName);
+    return 1;
+  }
+
+  memcpy(&version, map+sizeof(magic), sizeof(int32_t));
+  memcpy(&nSection, map+sizeof(magic)+sizeof(int32_t), sizeof(int32_t));
+  memcpy(sizeFile, map+sizeof(magic)+2*sizeof(int32_t), sizeof(sizeFile));
+  memcpy(fileFile, map+sizeof(magic)+2*sizeof(int32_t)+sizeof(sizeFile), sizeof(fileFile));
+  memcpy(section, map+sizeof(magic)+2*sizeof(int32_t)+sizeof(sizeFile)+sizeof(fileFile), sizeof(section));
+
+  defBinarySize(size);
+  defBinaryCount(type, count);
+  if(memcmp(map, magic, sizeof(magic))!=0 || version!=D_DefBinaryVersion
+     || nSection!=D_DefBinaryNSection) {
+    fprintf(stderr, "error: ReadDefBinary: %s is not a def container.\n", fileName);
+    info=1;
+  } else if(memcmp(size, sizeFile, sizeof(size))!=0) {
+    fprintf(stderr, "error: ReadDefBinary: %s does not match the def files.\n", fileName);
+    info=1;
+  } else {
+    /* a def file edited after the container was written */
+    for(i=0;i<D_DefBinaryNFile;i++) {
+      if(file[i].size!=fileFile[i].size || file[i].mtime!=fileFile[i].mtime) {
+        if(rank==0) fprintf(stderr, "error: ReadDefBinary: %s is older than the def file of %s.\n",
+                            fileName, cKWListOfFileNameList[KWLocSpin+i]);
+        info=1;
+        break;
+      }
+    }
+  }
+
+  /* CisAjsCktAltLzIdx is not contiguous */
+  lzIdx = (int*)malloc(sizeof(int)*(2*defBinaryNLz()+1));
+  data[0] = LocSpn;
+  data[1] = lzIdx;
+  data[2] = ParaTransfer;
+  data[3] = ParaCoulombIntra;
+  data[4] = ParaQPTrans;
+
+  for(is=0;is<D_DefBinaryNSection && info==0;is++) {
+    nByte = count[is] * (type[is]==0 ? sizeof(int) : sizeof(double));
+    if(section[is].type!=type[is] || section[is].count!=count[is]
+       || section[is].offset<(int64_t)nHeader || section[is].offset+(int64_t)nByte>(int64_t)st.st_size) {
+      fprintf(stderr, "error: ReadDefBinary: section %d of %s is broken.\n", is, fileName);
+      info=1;
+    } else if(defBinaryChecksum(map+section[is].offset, nByte)!=section[is].checksum) {
+      fprintf(stderr, "error: ReadDefBinary: checksum of section %d of %s does not match.\n", is, fileName);
+      info=1;
+    } else {
+      memcpy(data[is], map+section[is].offset, nByte);
+    }
+  }
+
+  if(info==0) {
+    for(i=0;i<defBinaryNLz();i++) {
+      CisAjsCktAltLzIdx[i][0] = lzIdx[2*i];
+      CisAjsCktAltLzIdx[i][1] = lzIdx[2*i+1];
+    }
+  }
+
+  free(lzIdx);
+  munmap((void*)map, st.st_size);
+  return info;
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef _ASYNCOUT
+#define _ASYNCOUT
+#include <stdint.h>
+#include <pthread.h>
+
+void WriteGreenFuncText(FILE *fpCisAjs, FILE *fpCisAjsCktAlt, FILE *fpCisAjsCktAltDC,
+                        const double complex *vec);
+int writeGreenFuncBinary(const char *fileName, const int layout, const int n, const int nIdx,
+                         const int32_t *idx, const double complex *val);
+void OutputGreenFunc(const int idx, const double complex *vec, const int flagBinary);
+void *greenWriterMain(void *arg);
+void AsyncOutInit(int rank);
+void AsyncOutPush(const int idx, int rank);
+void AsyncOutFinalize(int rank);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _AUTOCORR
+#define _AUTOCORR
+#include <mpi.h>
+
+void binningAutoCorr(const double *x, const int n, double *sum2, double *cnt);
+void CalcAutoCorr(double *tau, double *varE, double *nSmp, MPI_Comm comm);
+double UpdateAutoCorr(const int step, MPI_Comm comm);
+
+#endif
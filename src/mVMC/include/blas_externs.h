@@ -33,10 +33,12 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 #define M_DGEMM  dgemm_
 #define M_DGEMV  dgemv_
 #define M_DGER  dger_
+#define M_DSYRK dsyrk_
 #define M_ZAXPY zaxpy_
 #define M_ZGEMM zgemm_
 #define M_ZGEMV zgemv_
 #define M_ZGERC zgerc_
+#define M_ZHERK zherk_
 
 // LAPACK
 #define M_DGETRF dgetrf_
@@ -58,6 +60,7 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 
 // pBLAS
 #define M_PDGEMV  pdgemv_
+#define M_PDSYRK  pdsyrk_
 
 // ScaLAPACK
 #define M_PDPOSV  pdposv_
@@ -90,6 +93,12 @@ extern void M_DGER(const int *m, const int *n, const double *alpha, const double
                    const double *y, const int *incy, double *a, const int *lda);
 extern void M_ZGERC(const int *m, const int *n, const double complex *alpha, const double complex *x, const int *incx,
                     const double complex *y, const int *incy, double complex *a, const int *lda);
+extern void M_DSYRK(const char *uplo, const char *trans, const int *n, const int *k,
+                    const double *alpha, const double *a, const int *lda,
+                    const double *beta, double *c, const int *ldc);
+extern void M_ZHERK(const char *uplo, const char *trans, const int *n, const int *k,
+                    const double *alpha, const double complex *a, const int *lda,
+                    const double *beta, double complex *c, const int *ldc);
 extern void M_DAXPY(const int *n, const double *alpha, const double *x, const int *incx, double *y, const int *incy);
 extern void M_ZAXPY(const int *n, const double complex *alpha, const double complex *x, const int *incx, double complex *y, const int *incy);
 
@@ -127,6 +136,9 @@ extern void M_PDGEMV(const char *trans, const int *m, const int *n,
                      const double *alpha, const double *a, const int *ia, const int *ja, const int *desca,
                      const double *x, const int *ix, const int *jx, const int *descx, const int *incx,
                      const double *beta, double *y, const int *iy, const int *jy, const int *descy, const int *incy );
+extern void M_PDSYRK(const char *uplo, const char *trans, const int *n, const int *k,
+                     const double *alpha, const double *a, const int *ia, const int *ja, const int *desca,
+                     const double *beta, double *c, const int *ic, const int *jc, const int *descc);
 
 // ScaLAPACK
 extern void	M_PDSYEVD(const char* jobz, const char* uplo,
@@ -146,5 +158,7 @@ extern int Cblacs_gridinfo(int ictxt, int *nprow, int *npcol, int *myprow, int *
 extern int M_NUMROC(int *n, int *nb, int *iproc, int *isrcproc, int *nprocs);
 extern int M_DESCINIT(int *desc, int *m, int *n, int *mb, int *nb, int *irsrc,
                       int *icsrc, int *ictxt, int *lld, int *info);
+extern void Cpdgemr2d(int m, int n, double *a, int ia, int ja, int *desca,
+                      double *b, int ib, int jb, int *descb, int ictxt);
 
 #endif // _BLAS_EXTERNS_H
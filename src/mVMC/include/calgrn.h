@@ -5,6 +5,9 @@
 void CalculateGreenFunc(const double w, const double complex ip, int *eleIdx, int *eleCfg,
                          int *eleNum, int *eleProjCnt);
 
+void CalculateGreenFunc_real(const double w, const double ip, int *eleIdx, int *eleCfg,
+                             int *eleNum, int *eleProjCnt);
+
 void CalculateGreenFuncBF(const double w, const double ip, int *eleIdx, int *eleCfg,
                           int *eleNum, int *eleProjCnt, const int *eleProjBFCnt);
 #endif
@@ -4,6 +4,11 @@
 
 double complex CalculateHamiltonian(const double complex ip, int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt);
 
+double complex CalculateHamiltonianChain(const double complex ip, int *eleIdx, const int *eleCfg,
+                                         int *eleNum, const int *eleProjCnt,
+                                         double complex *pfM, double complex *invM,
+                                         int *projCntNew, double complex *buffer);
+
 double complex CalculateHamiltonian0(const int *eleNum);
 
 double CalculateDoubleOccupation(int *eleIdx, const int *eleCfg,
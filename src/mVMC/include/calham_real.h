@@ -7,6 +7,10 @@ double CalculateHamiltonian_real(const double ip, int *eleIdx, const int *eleCfg
 double CalculateHamiltonianBF_real(const double ip, int *eleIdx, const int *eleCfg,
                               int *eleNum, const int *eleProjCnt, const int *eleProjBFCnt);
 
+double CalculateHamiltonianChain_real(const double ip, int *eleIdx, const int *eleCfg,
+                                      int *eleNum, const int *eleProjCnt,
+                                      double *pfM, double *invM,
+                                      int *projCntNew, double *buffer);
 
 double CalculateHamiltonian0_real(const int *eleNum);
 
@@ -31,6 +31,8 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 #include <complex.h>
 #include "stdio.h"
 #define D_FileNameMax 256
+#define D_SROptPanelMem (16*1024*1024) /* bytes of the panel of O in SR */
+#define D_HopNbrRatio 0.75 /* probability of hopping to a site connected by Transfer (NHopProposal!=0) */
 
 /***** definition *****/
 char CDataFileHead[D_FileNameMax]; /* prefix of output files */
@@ -43,7 +45,18 @@ int NLanczosMode; /* mode of the single Lanczos step
                      0: none, 1: only energy, 2: Green functions */
 
 int NStoreO; /* choice of store O: 0-> normal other-> store  */
-int NSRCG; /* choice of solver for Sx=g: 0-> (Sca)LAPACK other-> CG  */
+int NSRCG; /* choice of solver for Sx=g: 0-> (Sca)LAPACK 1-> CG 2-> sample space  */
+int NInlineMeasure; /* 0-> measure after sampling, other-> measure in VMCMakeSample reusing InvM */
+int NMultiChain; /* 0-> one Markov chain per process, other-> one Markov chain per thread */
+int NCompressSlater; /* 0-> dense SlaterElm, other-> SlaterElm rebuilt from the compressed tables */
+int NDelayUpdate; /* 0-> InvM is updated at each acceptance, k-> the updates are flushed every k acceptances */
+int NCheckpoint; /* 0-> no checkpoint, k-> the checkpoint files are written every k SR steps */
+int NDefBinary; /* 0-> parse the def files, other-> read the binary container zvo_def.bin */
+int NProfile; /* 0-> zvo_CalcTimer.dat only, other-> per-thread timers and zvo_CalcTimerStat.dat */
+int NSplitChain; /* 0-> the QP indices are split over NSplitSize processes, other-> one Markov chain per process */
+int NAsyncOutput; /* 0-> the Green functions are written by rank 0, 1-> by a writer thread, 2-> in binary by a writer thread */
+int NHopProposal; /* 0-> hopping to a random empty site, other-> mostly to the sites connected by Transfer */
+int NAutoCorr; /* 0-> off, 1-> the autocorrelation times are written in zvo_autocorr.dat, 2-> and NVMCInterval is adapted */
 
 int NDataIdxStart; /* starting value of the file index */
 int NDataQtySmp; /* the number of output files */
@@ -72,10 +85,13 @@ double DSROptStepDt; /* step width of the SR method */
 
 int NSROptCGMaxIter; /* the number of maximum iterations in SR-CG method */
 double DSROptCGTol; /* the tolerance for SR-CG method */
+int NSROptCGPrecond; /* the preconditioner for SR-CG method: 0-> none, 1-> Jacobi */
 
 int NVMCWarmUp; /* Monte Carlo steps for warming up */
 int NVMCInterval; /* sampling interval [MCS] */ 
+int NVMCIntervalMax; /* the upper bound of NVMCInterval adapted by NAutoCorr==2 */
 int NVMCSample; /* the number of samples */
+double DVMCErrorTarget; /* the bins of VMCPhysCal stop when the error of Etot is below it (NAutoCorr!=0), 0-> off */
 int NExUpdatePath; /* update by exchange hopping  0: off, 1: on */
 int NBlockUpdateSize; /* {DEFINED: _pf_block_update} size of block Pfaffian update */
 
@@ -122,6 +138,7 @@ double complex*ParaInterAll;
 /* for variational parameters */
 int NGutzwillerIdx, *GutzwillerIdx; /* [Nsite] */
 int NJastrowIdx, **JastrowIdx; /* [Nsite][Nsite] */
+int *ProjSiteIdx; /* ProjSiteIdx[ri][rk]: index of the Jastrow factor of (ri,rk) in projCnt */
 int NDoublonHolon2siteIdx, **DoublonHolon2siteIdx; /* DoublonHolon2siteIdx[idx][2*Nsite] */
 int NDoublonHolon4siteIdx, **DoublonHolon4siteIdx; /* DoublonHolon4siteIdx[idx][4*Nsite] */
 int NOrbitalIdx, **OrbitalIdx; /* [Nsite][Nsite] */
@@ -169,6 +186,14 @@ int FlagBinary=0;
 /* flag for file flush */
 int NFileFlushInterval=1;
 
+/* flag for Restart mode */
+/* resume the parameter optimization from the checkpoint files */
+int FlagRestart=0;
+
+/* flag for DefConvert mode */
+/* write the def files into the binary container and exit */
+int FlagDefConvert=0;
+
 /***** Variational Parameters *****/
 int NPara; /* the total number of variational prameters NPara= NProj + NSlater+ NOptTrans */ 
 int NProj;    /* the number of correlation factor */
@@ -200,11 +225,7 @@ int *EleSpn;     /* EleIdx[sample][mi+si*Ne] */ //fsz
 int *EleProjBFCnt; /* EleProjCnt[sample][proj] */
 //[e] MERGE BY TM
 double *logSqPfFullSlater; /* logSqPfFullSlater[sample] */
-//double complex *SmpSltElmBF; /* logSqPfFullSlater[sample] */
-double *SmpSltElmBF_real; /* logSqPfFullSlater[sample] */
-
-int    *SmpEtaFlag; /* logSqPfFullSlater[sample] */
-double *SmpEta; /* logSqPfFullSlater[sample] */
+double *LocalE; /* LocalE[sample]: real part of the local energy, NAN if not measured here (NAutoCorr!=0) */
 
 int *TmpEleIdx;
 int *TmpEleCfg;
@@ -214,6 +235,11 @@ int *TmpEleProjCnt;
 int *TmpEleSpn;
 int *TmpEleProjBFCnt;
 //[e] MERGE BY TM
+int *TmpEleLst; /* [SizeEleLst()] lists of sites and electrons for the proposals */
+
+/* used only when NHopProposal!=0 */
+int *HopNbrIdx; /* [Nsite+1] */
+int *HopNbr; /* HopNbr[HopNbrIdx[ri]..HopNbrIdx[ri+1]-1]: conduction sites connected to ri by Transfer */
 
 int *BurnEleIdx;
 int *BurnEleCfg;
@@ -222,6 +248,14 @@ int *BurnEleProjCnt;
 int *BurnEleSpn;
 int BurnFlag=0; /* 0: off, 1: on */
 
+/* used only when NMultiChain!=0 */
+int *ChainEleIdx; /* ChainEleIdx[chain][Nsize+2*Nsite2+NProj]: eleIdx,eleCfg,eleNum,eleProjCnt */
+int *ChainBurnEleIdx; /* ChainBurnEleIdx[chain][Nsize+2*Nsite2+NProj] */
+int *ChainEleLst; /* ChainEleLst[chain][SizeEleLst()] */
+double complex *ChainInvM; /* ChainInvM[chain][NQPFull*(Nsize*Nsize+1)]: InvM and PfM of each chain */
+double *ChainInvM_real; /* shares the memory with ChainInvM */
+uint32_t *ChainRandState; /* ChainRandState[chain][get_state_size32()]: the random number stream of each chain */
+
 /***** Slater Elements ******/
 double complex *SlaterElm; /* SlaterElm[QPidx][ri+si*Nsite][rj+sj*Nsite] */
 double complex *InvM; /* InvM[QPidx][mi+si*Ne][mj+sj*Ne] */
@@ -230,6 +264,25 @@ double complex *PfM; /* PfM[QPidx] */
 double *SlaterElm_real; /* SlaterElm[QPidx][ri+si*Nsite][rj+sj*Nsite] */
 double *InvM_real; /* InvM[QPidx][mi+si*Ne][mj+sj*Ne] */
 double *PfM_real; /* PfM[QPidx] */
+
+/* used only when NDelayUpdate!=0 */
+double complex *InvMDelay; /* InvMDelay[QPidx][mi+si*Ne][2*NDelayUpdate]: pending rank-2 updates of InvM */
+double *InvMDelay_real; /* shares the memory with InvMDelay */
+int InvMDelayCount=0; /* number of the pending rank-2 updates */
+
+/* GreenFunc1Batch does not use the serial workspace, */
+/* which the callers of CalculateHamiltonian may be holding. */
+int *GreenBatchWork; /* [3*max(NTransfer,NCisAjs)+2*Nsize+2*Nsite2] */
+double complex *GreenTransfer; /* [NTransfer] batched Green functions of Transfer */
+double *GreenTransfer_real; /* shares the memory with GreenTransfer */
+
+/* compressed SlaterElm: SlaterElm and SlaterElm_real are NULL when it is used. */
+/* Read them through SlaterElmRow_fcmp() and SlaterElmRow_real(), or SlaterElmAt_*() for one element. */
+double complex *SlaterElmBase; /* SlaterElmBase[tri][trj] = OrbitalSgn[tri][trj]*Slater[OrbitalIdx[tri][trj]] */
+double *SlaterElmBase_real; /* SlaterElmBase_real[tri][trj] = Re SlaterElmBase[tri][trj] */
+int *SlaterElmTrans; /* SlaterElmTrans[optidx*NMPTrans+mpidx][ri]: translated site tri */
+int *SlaterElmTransSgn; /* SlaterElmTransSgn[optidx*NMPTrans+mpidx][ri]: sign of the translation */
+double *SlaterElmSPCoef; /* SlaterElmSPCoef[spidx][3]: Re of SPGLCosSin, SPGLCosCos, SPGLSinSin */
 double complex *SlaterElmBF; /* SlaterElm[QPidx][ri+si*Nsite][rj+sj*Nsite] */
 double complex *InvM; /* InvM[QPidx][mi+si*Ne][mj+sj*Ne] */
 double complex *PfM; /* PfM[QPidx] */
@@ -246,15 +299,19 @@ double complex *SPGLCosSin, *SPGLCosCos, *SPGLSinSin; /* [NSPGaussLeg] */
 
 /***** Stocastic Reconfiguration *****/
 int    SROptSize; /* 1+NPara */
-double complex *SROptOO; /* [SROptSize*SROptSize] <O^\dagger O> */
+double complex *SROptOO; /* [SROptSize*SROptSize] <O^\dagger O>, only the lower triangle */
 double complex *SROptHO; /* [SROptSize]            < HO > */
 double complex *SROptO;  /* [SROptSize] calculation buffar */
 double complex *SROptO_Store;  /* [SROptSize*NVMCSample] calculation buffer */
 //for real
-double *SROptOO_real; /* [SROptSize*SROptSize] <O^\dagger O> */ //TBC
+double *SROptOO_real; /* [SROptSize*SROptSize] <O^\dagger O>, only the lower triangle */ //TBC
 double *SROptHO_real; /* [SROptSize]            < HO > */       //TBC
 double *SROptO_real;  /* [SROptSize] calculation buffar */      //TBC
 double *SROptO_Store_real;  /* [SROptSize*NVMCSample] calculation buffer */
+/* sqrt(w)*O of up to NSROptPanel samples, added to SROptOO by ZHERK (DSYRK) */
+int NSROptPanel, SROptPanelCnt;
+double complex *SROptO_Panel; /* [2*SROptSize*NSROptPanel] */
+double *SROptO_Panel_real; /* [SROptSize*NSROptPanel] shares memory with SROptO_Panel */
 
 double complex *SROptData; /* [2+NPara] storage for energy and variational parameters */
 
@@ -269,6 +326,7 @@ double complex *PhysCisAjs; /* [NCisAjs] */
 double complex *PhysCisAjsCktAlt; /* [NCisAjsCktAlt] */
 double complex *PhysCisAjsCktAltDC; /* [NCisAjsCktAltDC] */
 double complex *LocalCisAjs; /* [NCisAjs] */
+double *LocalCisAjs_real; /* [NCisAjs] */
 
 double complex Sztot,Sztot2; /* <Sz>,<Sz^2> */
 
@@ -292,12 +350,23 @@ double *QCisAjsQ_real; /* QCisAjsQ[NLSHam][NLSHam][NCisAjs]*/ //TBC
 double *QCisAjsCktAltQ_real; /* QCisAjsCktAltQ[NLSHam][NLSHam][NCisAjsCktAlt]*/ //TBC
 double *LSLCisAjs_real; /* [NLSHam][NCisAjs]*/                //TBC
 
+/* distinct hops C_is A_js of Transfer and CisAjsIdx for the Lanczos step */
+int NLSHop;
+int *LSHopIdx; /* LSHopIdx[NLSHop][3] = {ri,rj,s} */
+int *LSHopTransfer; /* [NTransfer] index of LSHopIdx */
+int *LSHopCisAjs; /* [NCisAjs] index of LSHopIdx (NLanczosMode>1) */
+int NLSTerm; /* NPairHopping+2*NExchangeCoupling+NInterAll */
+int *LSTermFlag; /* [NLSHop+NLSTerm] */
+double complex *LSHopVal; /* [NLSHop+NLSTerm] <psi|H CA|x>/<psi|x>, <psi|H CACA|x>/<psi|x> */
+double *LSHopVal_real; /* shares the memory with LSHopVal */
+
 /***** Output File *****/
 /* FILE *FileCfg; */
 FILE *FileOut;
 FILE *FileVar;
 FILE *FileTime;
 FILE *FileSRinfo; /* zvo_SRinfo.dat */
+FILE *FileAutoCorr; /* zvo_autocorr.dat */
 FILE *FileCisAjs;
 FILE *FileCisAjsCktAlt;
 FILE *FileCisAjsCktAltDC;
@@ -315,6 +384,8 @@ FILE *FileLSCisAjsCktAlt;
 /***** HitachiTimer *****/
 const int NTimer=1000;
 double Timer[1000], TimerStart[1000];
+/* per-thread timers [NThread][NTimer] used when NProfile!=0 */
+double *TimerThread=NULL, *TimerThreadStart=NULL;
 
 /* flag for  SROptimization*/
 int SRFlag; /* 0: periodic, 1: Diagonalization */
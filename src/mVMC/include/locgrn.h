@@ -6,10 +6,22 @@
 double complex GreenFunc1(const int ri, const int rj, const int s, const double complex ip,
                   int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
                   int *projCntNew, double complex *buffer);
+int GreenFunc1Batch(const int nTerm, int **termIdx, const double complex ip,
+                    int *eleIdx, const int *eleCfg, const int *eleNum, const int *eleProjCnt,
+                    double complex *green);
 double complex GreenFunc2(const int ri, const int rj, const int rk, const int rl,
                   const int s, const int t, const double complex  ip,
                   int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
                   int *projCntNew, double complex *buffer);
+double complex GreenFunc1Chain(const int ri, const int rj, const int s, const double complex ip,
+                       int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
+                       int *projCntNew, double complex *buffer,
+                       const double complex *pfM, const double complex *invM);
+double complex GreenFunc2Chain(const int ri, const int rj, const int rk, const int rl,
+                       const int s, const int t, const double complex ip,
+                       int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
+                       int *projCntNew, double complex *buffer,
+                       double complex *pfM, double complex *invM);
 
 double complex GreenFuncN(const int n, int *rsi, int *rsj, const double complex  ip,
                   int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
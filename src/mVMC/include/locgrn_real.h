@@ -4,10 +4,22 @@
 double GreenFunc1_real(const int ri, const int rj, const int s, const double ip,
                   int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
                   int *projCntNew, double *buffer);
+int GreenFunc1Batch_real(const int nTerm, int **termIdx, const double ip,
+                         int *eleIdx, const int *eleCfg, const int *eleNum, const int *eleProjCnt,
+                         double *green);
 double GreenFunc2_real(const int ri, const int rj, const int rk, const int rl,
                   const int s, const int t, const double  ip,
                   int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
                   int *projCntNew, double *buffer);
+double GreenFunc1Chain_real(const int ri, const int rj, const int s, const double ip,
+                           int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
+                           int *projCntNew, double *buffer,
+                           const double *pfM, const double *invM);
+double GreenFunc2Chain_real(const int ri, const int rj, const int rk, const int rl,
+                           const int s, const int t, const double ip,
+                           int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
+                           int *projCntNew, double *buffer,
+                           double *pfM, double *invM);
 
 double GreenFuncN_real(const int n, int *rsi, int *rsj, const double ip,
                   int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
@@ -7,5 +7,7 @@ void LSLocalQ(const double complex h1, const double complex ip, int *eleIdx, int
 
 void LSLocalCisAjs(const double complex h1, const double complex ip, int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt);
 
+void getLSTermOp(const int term, int *op);
+
 
 #endif
@@ -3,6 +3,9 @@
 
 void LSLocalQ_real(const double h1, const double ip, int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt, double *_LSLQ_real);
 
+void calculateLSHop_real(const double h1, const double ip, int *eleIdx, int *eleCfg,
+                         int *eleNum, int *eleProjCnt);
+
 double calculateHK_real(const double h1, const double ip, int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt);
 
 double calHCA_real(const int ri, const int rj, const int s,
@@ -38,6 +41,17 @@ double calHCACA2_real(const int ri, const int rj, const int rk, const int rl,
                       const int si,const int sk,
                       const double ip, int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt);
 
+int calHCAChain_real(const int ri, const int rj, const int s,
+                     const double h1, const double ip, int *eleIdx, int *eleCfg,
+                     int *eleNum, int *eleProjCnt, double *pfM, double *invM,
+                     int *projCntNew, double *buffer, double *val);
+
+int calHCACAChain_real(const int ri, const int rj, const int rk, const int rl,
+                       const int si,const int sk,
+                       const double h1, const double ip, int *eleIdx, int *eleCfg,
+                       int *eleNum, int *eleProjCnt, double *pfM, double *invM,
+                       int *projCntNew, double *buffer, double *val);
+
 void LSLocalCisAjs_real(const double h1, const double ip, int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt);
 
 void copyMAll_real(double *invM_from, double *pfM_from, double *invM_to, double *pfM_to);
@@ -7,9 +7,24 @@ void CalculateNewPfM2(const int mi, const int s, double complex *pfMNew, const i
                      const int qpStart, const int qpEnd);
 void UpdateMAll(const int mi, const int s, const int *eleIdx,
                 const int qpStart, const int qpEnd);
+void CalculateNewPfMChain(const int ma, const int s, double complex *pfMNew, const int *eleIdx,
+                          const double complex *pfM, const double complex *invM);
+void UpdateMAllChain(const int ma, const int s, const int *eleIdx,
+                     double complex *pfM, double complex *invM, double complex *buffer);
 void updateMAll_child(const int ma, const int s, const int *eleIdx,
                       const int qpStart, const int qpEnd, const int qpidx,
-                      double complex *vec1, double complex *vec2);
+                      double complex *vec1, double complex *vec2,
+                      double complex *pfM, double complex *invM);
+
+void CalculateNewPfMDelay(const int ma, const int s, double complex *pfMNew, const int *eleIdx,
+                          const int qpStart, const int qpEnd);
+void UpdateMAllDelay(const int ma, const int s, const int *eleIdx,
+                     const int qpStart, const int qpEnd);
+void updateMAllDelay_child(const int ma, const int s, const int *eleIdx,
+                           const int qpStart, const int qpEnd, const int qpidx,
+                           const int nDelay, double complex *vec1, double complex *work);
+void flushMAllDelay_child(const int qpidx, const int nDelay, double complex *work);
+void FlushMAllDelay(const int qpStart, const int qpEnd);
 
 void CalculateNewPfMBF(const int *icount, const int *msaTmp,double complex*pfMNew, const int *eleIdx,
                        const int qpStart, const int qpEnd, const double complex*bufM) ;
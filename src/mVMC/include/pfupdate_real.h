@@ -6,6 +6,20 @@ void CalculateNewPfM2_real(const int mi, const int s, double *pfMNew_real, const
                      const int qpStart, const int qpEnd);
 void UpdateMAll_real(const int mi, const int s, const int *eleIdx,
                 const int qpStart, const int qpEnd);
+void CalculateNewPfMChain_real(const int ma, const int s, double *pfMNew_real, const int *eleIdx,
+                               const double *pfM_real, const double *invM_real);
+void UpdateMAllChain_real(const int ma, const int s, const int *eleIdx,
+                          double *pfM_real, double *invM_real, double *buffer);
+
+void CalculateNewPfMDelay_real(const int ma, const int s, double *pfMNew_real, const int *eleIdx,
+                               const int qpStart, const int qpEnd);
+void UpdateMAllDelay_real(const int ma, const int s, const int *eleIdx,
+                          const int qpStart, const int qpEnd);
+void updateMAllDelay_child_real(const int ma, const int s, const int *eleIdx,
+                                const int qpStart, const int qpEnd, const int qpidx,
+                                const int nDelay, double *vec1, double *work);
+void flushMAllDelay_child_real(const int qpidx, const int nDelay, double *work);
+void FlushMAllDelay_real(const int qpStart, const int qpEnd);
 
 void CalculateNewPfMBF_real(const int *icount, const int *msaTmp,
                             double *pfMNew, const int *eleIdx,
@@ -12,4 +12,10 @@ void UpdateMAllTwo_fcmp(const int ma, const int s, const int mb, const int t,
                    const int raOld, const int rbOld,
                    const int *eleIdx, const int qpStart, const int qpEnd);
 
+void CalculateNewPfMTwoChain_fcmp(const int ma, const int s, const int mb, const int t,
+                             double complex *pfMNew, const int *eleIdx,
+                             double complex *pfM, double complex *invM, double complex *buffer);
+void UpdateMAllTwoChain_fcmp(const int ma, const int s, const int mb, const int t,
+                        const int raOld, const int rbOld, const int *eleIdx,
+                        double complex *pfM, double complex *invM, double complex *buffer);
 #endif
@@ -10,4 +10,10 @@ void CalculateNewPfMTwo2_real(const int ma, const int s, const int mb, const int
 void UpdateMAllTwo_real(const int ma, const int s, const int mb, const int t,
                    const int raOld, const int rbOld,
                    const int *eleIdx, const int qpStart, const int qpEnd);
+void CalculateNewPfMTwoChain_real(const int ma, const int s, const int mb, const int t,
+                             double *pfMNew_real, const int *eleIdx,
+                             double *pfM_real, double *invM_real, double *buffer);
+void UpdateMAllTwoChain_real(const int ma, const int s, const int mb, const int t,
+                        const int raOld, const int rbOld, const int *eleIdx,
+                        double *pfM_real, double *invM_real, double *buffer);
 #endif
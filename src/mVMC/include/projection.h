@@ -9,6 +9,13 @@ void UpdateProjCnt(const int ri, const int rj, const int s,
 				   int *projCntNew, const int *projCntOld,
 				   const int *eleNum);
 
+int IsProjCntDelta();
+int UpdateProjCntDelta(const int ri, const int rj, const int s,
+                       int *projDelta, const int nDelta, const int *eleNum);
+double LogProjRatioDelta(const int *projDelta, const int nDelta);
+double ProjRatioDelta(const int *projDelta, const int nDelta);
+void AddProjCntDelta(int *projCnt, const int *projDelta, const int nDelta);
+
 void MakeProjBFCnt(int *projCnt, const int *eleNum);
 
 #endif
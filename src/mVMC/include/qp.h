@@ -4,7 +4,9 @@
 void InitQPWeight();
 
 double complex CalculateLogIP_fcmp(double complex * const pfM, const int qpStart, const int qpEnd, MPI_Comm comm);
+double complex CalculateLogIPChain_fcmp(const double complex *pfM);
 double complex CalculateIP_fcmp(double complex * const pfM, const int qpStart, const int qpEnd, MPI_Comm comm);
+double complex CalculateIPChain_fcmp(const double complex *pfM);
 void UpdateQPWeight();
 
 #endif
@@ -2,6 +2,8 @@
 #define _QP_REAL
 
 double CalculateLogIP_real(double* const pfM, const int qpStart, const int qpEnd, MPI_Comm comm);
+double CalculateLogIPChain_real(const double *pfM);
 double CalculateIP_real(double* const pfM, const int qpStart, const int qpEnd, MPI_Comm comm);
+double CalculateIPChain_real(const double *pfM);
 
 #endif
@@ -90,7 +90,7 @@ enum ParamIdxInt{
 
 enum ParamIdxDouble{
   IdxSROptRedCut, IdxSROptStaDel, IdxSROptStepDt,
-  IdxSROptCGTol,
+  IdxSROptCGTol, IdxVMCErrorTarget,
   ParamIdxDouble_End
 };
 
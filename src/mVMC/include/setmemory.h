@@ -3,6 +3,8 @@
 
 void SetMemoryDef();
 void FreeMemoryDef();
+void setLSHopIdx();
+void setHopNbr();
 void SetMemory();
 void FreeMemory();
 
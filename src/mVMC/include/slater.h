@@ -1,7 +1,15 @@
 #ifndef _SLATER
 #define _SLATER
+int IsComplexSlaterElm();
 void UpdateSlaterElm_fcmp();
+void updateSlaterElmCompress();
+double complex SlaterElmAt_fcmp(const int qpidx, const int rsi, const int rsj);
+double SlaterElmAt_real(const int qpidx, const int rsi, const int rsj);
+const double complex *SlaterElmRow_fcmp(const int qpidx, const int rsi, double complex *buf);
+const double *SlaterElmRow_real(const int qpidx, const int rsi, double *buf);
+void UpdateSlaterElm_real();
 void SlaterElmDiff_fcmp(double complex *srOptO, const double complex ip, int *eleIdx);
+void SlaterElmDiff_real(double *srOptO, const double ip, int *eleIdx);
 
 void SlaterElmBFDiff_fcmp(double complex*srOptO, const double complex ip, int *eleIdx, int *eleNum, int *eleCfg, int *eleProjConst,const int * eleProjBFCnt);
 
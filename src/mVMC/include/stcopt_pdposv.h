@@ -2,6 +2,14 @@
 #ifndef _STCOPT_PDPOSV
 #define _STCOPT_PDPOSV
 
+void StcOptGridInit(MPI_Comm comm);
+void StcOptGridFree();
+void stcOptReduceS(double *s, const int nSmat, const int *smatToParaIdx,
+                   const int mlocr, const int mlocc,
+                   const int *irToParaIdx, const int *icToParaIdx, MPI_Comm comm);
+void stcOptMakeSStore(double *s, int *descs, double *o, double *a,
+                      const int nSmat, const int *smatToParaIdx, const int mlocr, const int mlocc,
+                      const int *irToParaIdx, const int *icToParaIdx, MPI_Comm comm);
 int StochasticOptDiag(MPI_Comm comm);
 int stcOptMainDiag(double *const r, int const nSmat, int *const smatToParaIdx,
                MPI_Comm comm, int const optNum);
@@ -2,6 +2,9 @@
 #define _VMCCAL
 #include <complex.h>
 void VMCMainCal(MPI_Comm comm);
+int IsInlineMeasure(MPI_Comm comm);
+void VMCMainCalSample(const int sample, const int flagMAll, const int rank);
+void clearPhysQuantity();
 void VMC_BF_MainCal(MPI_Comm comm);
 #endif
 
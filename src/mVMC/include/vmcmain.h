@@ -79,6 +79,7 @@ extern int omp_get_thread_num(void);
 #include "../legendrepoly.c"
 #include "../avevar.c"
 #include "../average.c"
+#include "../autocorr.c"
 #include "../parameter.c"
 #include "../projection.c"
 #include "../slater.c"
@@ -105,8 +106,11 @@ extern int omp_get_thread_num(void);
 #include "../calgrn.c"
 #include "../calgrn_fsz.c"
 #include "../setmemory.c"
+#include "../defbinary.c"
 #include "../readdef.c"
 #include "../initfile.c"
+#include "../asyncout.c"
+#include "../checkpoint.c"
 
 #include "../vmcmake.c"
 #include "../vmcmake_real.c"
@@ -4,6 +4,19 @@
 #include <mpi.h>
 
 void VMCMakeSample(MPI_Comm comm);
+void InitPfUpdator_fcmp(int *eleIdx, int *eleSpn);
+void FreePfUpdator();
+int IsMultiChain(MPI_Comm comm);
+int IsSplitChain(MPI_Comm comm);
+void initSplitChainRand(const int rank);
+void InitChainRand();
+void VMCMakeSampleChain(MPI_Comm comm);
+void makeSampleChain_child(const int chain, const int nChain,
+                           int *iwork, double complex *buffer, double *rwork);
+int makeInitialSampleChain(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt,
+                           double complex *pfM, double complex *invM, double complex *bufM,
+                           int *iwork, double complex *work, double *rwork);
+void makeInitialEleConfig(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt);
 int makeInitialSample(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt,
                       const int qpStart, const int qpEnd, MPI_Comm comm);
 void copyFromBurnSample(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt);
@@ -12,14 +25,19 @@ void saveEleConfig(const int sample, const double complex logIp,
                    const int *eleIdx, const int *eleCfg, const int *eleNum, const int *eleProjCnt);
 void sortEleConfig(int *eleIdx, int *eleCfg, const int *eleNum);
 void ReduceCounter(MPI_Comm comm);
-void makeCandidate_hopping(int *mi_, int *ri_, int *rj_, int *s_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg);
+void makeCandidate_hopping(int *mi_, int *ri_, int *rj_, int *s_, int *rejectFlag_, double *qRatio_,
+                           const int *eleIdx, const int *eleLst);
+double hopProposalRatio(const int ri, const int rj, const int nEmp);
 void makeCandidate_exchange(int *mi_, int *ri_, int *rj_, int *s_, int *rejectFlag_,
-                            const int *eleIdx, const int *eleCfg, const int *eleNum);
+                            const int *eleIdx, const int *eleCfg, const int *eleLst);
 void updateEleConfig(int mi, int ri, int rj, int s,
-                     int *eleIdx, int *eleCfg, int *eleNum);
+                     int *eleIdx, int *eleCfg, int *eleNum, int *eleLst);
 void revertEleConfig(int mi, int ri, int rj, int s,
-                     int *eleIdx, int *eleCfg, int *eleNum);
+                     int *eleIdx, int *eleCfg, int *eleNum, int *eleLst);
+int SizeEleLst();
+int *getEleLstSet(const int *eleLst, const int k);
+void makeEleLst(int *eleLst, const int *eleIdx, const int *eleNum);
+void updateEleLst(int *eleLst, const int msi, const int ri, const int rj, const int *eleNum);
 
 
 /*[s] BackFlow */
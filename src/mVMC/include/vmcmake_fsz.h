@@ -12,22 +12,22 @@ void saveEleConfig_fsz(const int sample, const double complex logIp,
                    const int *eleIdx, const int *eleCfg, const int *eleNum, const int *eleProjCnt,const int *eleSpn);
 //void sortEleConfig(int *eleIdx, int *eleCfg, const int *eleNum);
 void makeCandidate_hopping_fsz(int *mi_, int *ri_, int *rj_, int *s_,int *t_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg,const int *eleNum,const int *eleSpn);
+                           const int *eleIdx, const int *eleSpn, const int *eleLst);
 void makeCandidate_hopping_csz(int *mi_, int *ri_, int *rj_, int *s_,int *t_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg,const int *eleNum,const int *eleSpn);
+                           const int *eleIdx, const int *eleSpn, const int *eleLst);
 
 void makeCandidate_exchange_fsz(int *mi_, int *ri_, int *rj_, int *s_, int *rejectFlag_,
-                            const int *eleIdx, const int *eleCfg, const int *eleNum,const int *eleSpn);
+                            const int *eleIdx, const int *eleCfg, const int *eleLst);
 void updateEleConfig_fsz(int mi, int org_r, int dst_r, int org_spn,int dst_spn,
-                     int *eleIdx, int *eleCfg, int *eleNum, int *eleSpn) ;
+                     int *eleIdx, int *eleCfg, int *eleNum, int *eleSpn, int *eleLst) ;
 void revertEleConfig_fsz(int mi, int org_ri, int dst_r, int org_spn,int dst_spn,
-                     int *eleIdx, int *eleCfg, int *eleNum,int *eleSpn);
+                     int *eleIdx, int *eleCfg, int *eleNum,int *eleSpn, int *eleLst);
 void CheckEleConfig_fsz(int *eleIdx, int *eleCfg, int *eleNum,int *eleSpn,MPI_Comm comm);
 int CheckEleNum_fsz(int *eleIdx, int *eleCfg, int *eleNum,int *eleSpn,MPI_Comm comm);
 void makeCandidate_LocalSpinFlip_localspin(int *mi_, int *ri_, int *rj_, int *s_,int *t_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg,const int *eleNum,const int *eleSpn);
+                           const int *eleIdx, const int *eleSpn, const int *eleLst);
 void makeCandidate_LocalSpinFlip_conduction(int *mi_, int *ri_, int *rj_, int *s_,int *t_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg,const int *eleNum,const int *eleSpn);
+                           const int *eleIdx, const int *eleCfg, const int *eleLst);
 
 
 #endif
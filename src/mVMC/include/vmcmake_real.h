@@ -4,7 +4,12 @@
 #include <mpi.h>
 
 void VMCMakeSample_real(MPI_Comm comm);
+void InitPfUpdator_real(int *eleIdx, int *eleSpn);
 void VMC_BF_MakeSample_real(MPI_Comm comm);
+void VMCMakeSampleChain_real(MPI_Comm comm);
+void makeSampleChain_child_real(const int chain, const int nChain, int *iwork, double *buffer);
+int makeInitialSampleChain_real(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt,
+                                double *pfM, double *invM, double *bufM, int *iwork, double *work);
 
 int makeInitialSample_real(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt,
                            const int qpStart, const int qpEnd, MPI_Comm comm);
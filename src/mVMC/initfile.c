@@ -32,6 +32,8 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 
 void InitFile(char *xNameListFile, int rank) {
   char fileName[D_FileNameMax];
+  /* the optimization resumed from a checkpoint continues the output files */
+  const int flagAppend = (FlagRestart && NVMCCalMode==0);
 
   if(rank!=0) return;
 
@@ -39,12 +41,22 @@ void InitFile(char *xNameListFile, int rank) {
   //writeConfig(xNameListFile, fileName);
 
   sprintf(fileName, "%s_time_%03d.dat", CDataFileHead, NDataIdxStart);
-  FileTime = fopen(fileName, "w");
+  FileTime = fopen(fileName, flagAppend ? "a" : "w");
+
+  if(NAutoCorr!=0) {
+    sprintf(fileName, "%s_autocorr.dat", CDataFileHead);
+    FileAutoCorr = fopen(fileName, flagAppend ? "a" : "w");
+    if(!flagAppend) {
+      fprintf(FileAutoCorr, "#step NVMCInterval dEtot tauE tauO...\n");
+    }
+  }
 
   if(NVMCCalMode==0) {
     sprintf(fileName, "%s_SRinfo.dat", CDataFileHead);
-    FileSRinfo = fopen(fileName, "w");
-    if(SRFlag == 0){
+    FileSRinfo = fopen(fileName, flagAppend ? "a" : "w");
+    if(flagAppend){
+      /* the header has been written by the previous run */
+    }else if(SRFlag == 0){
       fprintf(FileSRinfo,
             "#Npara Msize optCut diagCut sDiagMax  sDiagMin    absRmax       imax\n");
     }else{
@@ -53,16 +65,18 @@ void InitFile(char *xNameListFile, int rank) {
     }
 
     sprintf(fileName, "%s_out_%03d.dat", CDataFileHead, NDataIdxStart);
-    FileOut = fopen(fileName, "w");
+    FileOut = fopen(fileName, flagAppend ? "a" : "w");
 
     if(FlagBinary==0) {
       sprintf(fileName, "%s_var_%03d.dat", CDataFileHead, NDataIdxStart);
-      FileVar = fopen(fileName, "w");
+      FileVar = fopen(fileName, flagAppend ? "a" : "w");
     } else {
       sprintf(fileName, "%s_varbin_%03d.dat", CDataFileHead, NDataIdxStart);
-      FileVar = fopen(fileName, "wb");
-      fwrite(&NPara,sizeof(int),1,FileVar);
-      fwrite(&NSROptItrStep,sizeof(int),1,FileVar);
+      FileVar = fopen(fileName, flagAppend ? "ab" : "wb");
+      if(!flagAppend) {
+        fwrite(&NPara,sizeof(int),1,FileVar);
+        fwrite(&NSROptItrStep,sizeof(int),1,FileVar);
+      }
     }
   }
 
@@ -90,17 +104,18 @@ void InitFilePhysCal(int i, int rank) {
   }
 
   /* Green function */
-  if(NCisAjs>0){
+  /* The writer thread opens its own files when NAsyncOutput!=0. */
+  if(NCisAjs>0 && NAsyncOutput==0){
     sprintf(fileName, "%s_cisajs_%03d.dat", CDataFileHead, idx);
     FileCisAjs = fopen(fileName, "w");
   }
 
-  if(NCisAjsCktAlt>0){
+  if(NCisAjsCktAlt>0 && NAsyncOutput==0){
     sprintf(fileName, "%s_cisajscktaltex_%03d.dat", CDataFileHead, idx);
     FileCisAjsCktAlt = fopen(fileName, "w");
   }
 
-  if(NCisAjsCktAltDC>0){
+  if(NCisAjsCktAltDC>0 && NAsyncOutput==0){
     sprintf(fileName, "%s_cisajscktalt_%03d.dat", CDataFileHead, idx);
     FileCisAjsCktAltDC = fopen(fileName, "w");
   }
@@ -139,6 +154,7 @@ void CloseFile(int rank) {
   if(rank!=0) return;
 
   fclose(FileTime);
+  if(NAutoCorr!=0) fclose(FileAutoCorr);
 
   if(NVMCCalMode==0) {
     fclose(FileSRinfo);
@@ -155,13 +171,13 @@ void CloseFilePhysCal(int rank) {
   fclose(FileOut);
   fclose(FileVar);
   
-  if(NCisAjs>0){
+  if(NCisAjs>0 && NAsyncOutput==0){
     fclose(FileCisAjs);
   }
-  if(NCisAjsCktAlt>0){
+  if(NCisAjsCktAlt>0 && NAsyncOutput==0){
     fclose(FileCisAjsCktAlt);
   }
-  if(NCisAjsCktAltDC>0){
+  if(NCisAjsCktAltDC>0 && NAsyncOutput==0){
     fclose(FileCisAjsCktAltDC);
   }
   
@@ -187,6 +203,7 @@ void FlushFile(int step, int rank) {
 
   if(step%NFileFlushInterval==0) {
     fflush(FileTime);
+    if(NAutoCorr!=0) fflush(FileAutoCorr);
     if(NVMCCalMode==0) {
       fflush(FileSRinfo);
       fflush(FileOut);
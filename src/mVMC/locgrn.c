@@ -40,8 +40,20 @@ double complex calculateNewPfMN_child(const int qpidx, const int n, const int *m
 double complex GreenFunc1(const int ri, const int rj, const int s, const double complex  ip,
                   int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
                   int *projCntNew, double complex *buffer) {
+  return GreenFunc1Chain(ri,rj,s,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,PfM,InvM);
+}
+
+/* GreenFunc1 for the given pfM and invM instead of PfM and InvM */
+/* buffer size = NQPFull */
+double complex GreenFunc1Chain(const int ri, const int rj, const int s, const double complex  ip,
+                       int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
+                       int *projCntNew, double complex *buffer,
+                       const double complex *pfM, const double complex *invM) {
   double complex z;
   int mj,msj,rsi,rsj;
+  int projDelta[2*(2*Nsite+1)]; /* sparse change of projCnt */
+  int nDelta;
+  const int sparseProj=IsProjCntDelta();
   double complex *pfMNew = buffer; /* NQPFull */
 
   if(ri==rj) return eleNum[ri+s*Nsite];
@@ -56,12 +68,17 @@ double complex GreenFunc1(const int ri, const int rj, const int s, const double
   eleIdx[msj] = ri;
   eleNum[rsj] = 0;
   eleNum[rsi] = 1;
-  UpdateProjCnt(rj, ri, s, projCntNew, eleProjCnt, eleNum);
-  z = ProjRatio(projCntNew,eleProjCnt);
+  if(sparseProj) {
+    nDelta = UpdateProjCntDelta(rj, ri, s, projDelta, 0, eleNum);
+    z = ProjRatioDelta(projDelta, nDelta);
+  } else {
+    UpdateProjCnt(rj, ri, s, projCntNew, eleProjCnt, eleNum);
+    z = ProjRatio(projCntNew,eleProjCnt);
+  }
 
   /* calculate Pfaffian */
-  CalculateNewPfM(mj, s, pfMNew, eleIdx, 0, NQPFull);
-  z *= CalculateIP_fcmp(pfMNew, 0, NQPFull, MPI_COMM_SELF);
+  CalculateNewPfMChain(mj, s, pfMNew, eleIdx, pfM, invM);
+  z *= CalculateIPChain_fcmp(pfMNew);
 
   /* revert hopping */
   eleIdx[msj] = rj;
@@ -71,15 +88,175 @@ double complex GreenFunc1(const int ri, const int rj, const int s, const double
   return conj(z/ip);//TBC
 }
 
+/* Calculate 1-body Green functions <CisAjs> of nTerm terms at once. */
+/* termIdx[idx] = {ri,s,rj,s} in the same layout as Transfer and CisAjsIdx. */
+/* The terms annihilating the same electron mj share a row of InvM, so that */
+/* the Pfaffian ratios of all the terms are given by one matrix product per qpidx: */
+/*   ratio[mj][ri] = sum_k InvM[mj][k] SlaterElm[ri][rk]. */
+/* Returns 0 without touching green if the terms fill less than a quarter of */
+/* the matrix product. The caller then uses GreenFunc1 term by term. */
+/* This must be called before the caller requests the thread workspace. */
+int GreenFunc1Batch(const int nTerm, int **termIdx, const double complex ip,
+                    int *eleIdx, const int *eleCfg, const int *eleNum, const int *eleProjCnt,
+                    double complex *green) {
+  const int nsize=Nsize;
+  const int ne=Ne;
+  const int sparseProj=IsProjCntDelta();
+  int idx,k,l,r,ri,rj,s,msj,rsi,qpidx;
+  int nRow=0,nCol=0,nBatch=0;
+  int *batchIdx,*termRow,*termCol,*rowMs,*msToRow,*colRs,*rsToCol;
+  int *myEleNum,*myProjCntNew;
+  int nDelta;
+  double complex *matA,*matB,*matC,*myIP;
+  double complex *invM,*invM_r,*matB_l;
+  double complex z;
+  char transA='T', transB='N';
+  double complex one=1.0, zero=0.0;
+
+  batchIdx = GreenBatchWork;
+  termRow  = batchIdx + nTerm;
+  termCol  = termRow + nTerm;
+  rowMs    = termCol + nTerm;
+  msToRow  = rowMs + Nsize;
+  colRs    = msToRow + Nsize;
+  rsToCol  = colRs + Nsite2;
+
+  for(k=0;k<Nsize;k++) msToRow[k] = -1;
+  for(k=0;k<Nsite2;k++) rsToCol[k] = -1;
+
+  /* group the terms by the annihilated electron and the created site */
+  for(idx=0;idx<nTerm;idx++) {
+    ri = termIdx[idx][0];
+    rj = termIdx[idx][2];
+    s  = termIdx[idx][3];
+    if(ri==rj || eleNum[ri+s*Nsite]==1 || eleNum[rj+s*Nsite]==0) continue;
+    msj = eleCfg[rj+s*Nsite] + s*Ne;
+    rsi = ri + s*Nsite;
+    if(msToRow[msj]<0) { msToRow[msj] = nRow; rowMs[nRow++] = msj; }
+    if(rsToCol[rsi]<0) { rsToCol[rsi] = nCol; colRs[nCol++] = rsi; }
+    termRow[nBatch] = msToRow[msj];
+    termCol[nBatch] = rsToCol[rsi];
+    batchIdx[nBatch++] = idx;
+  }
+
+  if(4*nBatch < nRow*nCol) {
+    return 0;
+  }
+
+  for(idx=0;idx<nTerm;idx++) {
+    ri = termIdx[idx][0];
+    rj = termIdx[idx][2];
+    s  = termIdx[idx][3];
+    if(ri==rj) green[idx] = eleNum[ri+s*Nsite];
+    else green[idx] = 0.0;
+  }
+  if(nBatch==0) {
+    return 1;
+  }
+
+  RequestWorkSpaceThreadInt(Nsite2+NProj);
+  RequestWorkSpaceThreadComplex(nRow*Nsize+Nsize*nCol+nRow*nCol+nBatch);
+
+  #pragma omp parallel default(shared)                                 \
+    private(matA,matB,matC,myIP,myEleNum,myProjCntNew,nDelta,          \
+            invM,invM_r,matB_l,z,idx,k,l,r,ri,rj,s,msj,rsi,qpidx)
+  {
+    int projDelta[2*(2*Nsite+1)]; /* sparse change of projCnt */
+    double complex sltRow[Nsite2];
+    const double complex *sltE_l;
+    matA = GetWorkSpaceThreadComplex(nRow*Nsize); /* matA[r][k] = InvM[rowMs[r]][k] */
+    matB = GetWorkSpaceThreadComplex(Nsize*nCol); /* matB[l][k] = SlaterElm[colRs[l]][rk] */
+    matC = GetWorkSpaceThreadComplex(nRow*nCol);  /* matC[l][r] = ratio */
+    myIP = GetWorkSpaceThreadComplex(nBatch);
+    myEleNum = GetWorkSpaceThreadInt(Nsite2);
+    myProjCntNew = GetWorkSpaceThreadInt(NProj);
+
+    for(k=0;k<nBatch;k++) myIP[k] = 0.0;
+
+    #pragma omp for
+    for(qpidx=0;qpidx<NQPFull;qpidx++) {
+      invM = InvM + qpidx*Nsize*Nsize;
+      for(r=0;r<nRow;r++) {
+        invM_r = invM + rowMs[r]*Nsize;
+        for(k=0;k<nsize;k++) matA[r*nsize+k] = invM_r[k];
+      }
+      for(l=0;l<nCol;l++) {
+        rsi = colRs[l];
+        matB_l = matB + l*nsize;
+        sltE_l = SlaterElmRow_fcmp(qpidx, rsi, sltRow);
+        for(k=0;k<ne;k++) matB_l[k] = sltE_l[eleIdx[k]];
+        for(k=ne;k<nsize;k++) matB_l[k] = sltE_l[eleIdx[k]+Nsite];
+      }
+
+      M_ZGEMM(&transA, &transB, &nRow, &nCol, &nsize, &one, matA, &nsize,
+              matB, &nsize, &zero, matC, &nRow);
+
+      z = -QPFullWeight[qpidx]*PfM[qpidx];
+      for(k=0;k<nBatch;k++) myIP[k] += z * matC[termRow[k]+termCol[k]*nRow];
+    }
+
+    #pragma omp critical
+    {
+      for(k=0;k<nBatch;k++) green[batchIdx[k]] += myIP[k];
+    }
+    #pragma omp barrier
+
+    /* projection factors */
+    for(k=0;k<Nsite2;k++) myEleNum[k] = eleNum[k];
+
+    #pragma omp for
+    for(k=0;k<nBatch;k++) {
+      idx = batchIdx[k];
+      ri = termIdx[idx][0];
+      rj = termIdx[idx][2];
+      s  = termIdx[idx][3];
+
+      /* hopping */
+      myEleNum[rj+s*Nsite] = 0;
+      myEleNum[ri+s*Nsite] = 1;
+      if(sparseProj) {
+        nDelta = UpdateProjCntDelta(rj, ri, s, projDelta, 0, myEleNum);
+        z = ProjRatioDelta(projDelta, nDelta);
+      } else {
+        UpdateProjCnt(rj, ri, s, myProjCntNew, eleProjCnt, myEleNum);
+        z = ProjRatio(myProjCntNew,eleProjCnt);
+      }
+      /* revert hopping */
+      myEleNum[rj+s*Nsite] = 1;
+      myEleNum[ri+s*Nsite] = 0;
+
+      green[idx] = conj(z*green[idx]/ip);
+    }
+  }
+
+  ReleaseWorkSpaceThreadInt();
+  ReleaseWorkSpaceThreadComplex();
+  return 1;
+}
+
 /* Calculate 2-body Green function <psi|CisAjsCktAlt|x>/<psi|x> */
 /* buffer size = NQPFull+2*Nsize */
 double complex GreenFunc2(const int ri, const int rj, const int rk, const int rl,
                   const int s, const int t, const double complex ip,
                   int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
                   int *projCntNew, double complex *buffer) {
+  return GreenFunc2Chain(ri,rj,rk,rl,s,t,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,
+                         PfM,InvM);
+}
+
+/* GreenFunc2 for the given pfM and invM instead of PfM and InvM */
+/* buffer size = NQPFull+2*Nsize */
+double complex GreenFunc2Chain(const int ri, const int rj, const int rk, const int rl,
+                       const int s, const int t, const double complex ip,
+                       int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
+                       int *projCntNew, double complex *buffer,
+                       double complex *pfM, double complex *invM) {
   double complex z;
   int mj,msj,ml,mtl;
   int rsi,rsj,rtk,rtl;
+  int projDelta[4*(2*Nsite+1)]; /* sparse change of projCnt */
+  int nDelta=0;
+  const int sparseProj=IsProjCntDelta();
   double complex *pfMNew = buffer; /* [NQPFull] */
   double complex *bufV   = buffer+NQPFull; /* 2*Nsize */
 
@@ -91,37 +268,37 @@ double complex GreenFunc2(const int ri, const int rj, const int rk, const int rl
   if(s==t) {
     if(rk==rl) { /* CisAjsNks */
       if(eleNum[rtk]==0) return 0.0;
-      else return GreenFunc1(ri,rj,s,ip,eleIdx,eleCfg,eleNum,
-                             eleProjCnt,projCntNew,buffer); /* CisAjs */
+      else return GreenFunc1Chain(ri,rj,s,ip,eleIdx,eleCfg,eleNum,
+                             eleProjCnt,projCntNew,buffer,pfM,invM); /* CisAjs */
     }else if(rj==rl) {
       return 0.0; /* CisAjsCksAjs (j!=k) */
     }else if(ri==rl) { /* AjsCksNis */
       if(eleNum[rsi]==0) return 0.0;
       else if(rj==rk) return 1.0-eleNum[rsj];
-      else return -GreenFunc1(rk,rj,s,ip,eleIdx,eleCfg,eleNum,
-                              eleProjCnt,projCntNew,buffer); /* -CksAjs */
+      else return -GreenFunc1Chain(rk,rj,s,ip,eleIdx,eleCfg,eleNum,
+                              eleProjCnt,projCntNew,buffer,pfM,invM); /* -CksAjs */
     }else if(rj==rk) { /* CisAls(1-Njs) */
       if(eleNum[rsj]==1) return 0.0;
       else if(ri==rl) return eleNum[rsi];
-      else return GreenFunc1(ri,rl,s,ip,eleIdx,eleCfg,eleNum,
-                             eleProjCnt,projCntNew,buffer); /* CisAls */
+      else return GreenFunc1Chain(ri,rl,s,ip,eleIdx,eleCfg,eleNum,
+                             eleProjCnt,projCntNew,buffer,pfM,invM); /* CisAls */
     }else if(ri==rk) {
       return 0.0; /* CisAjsCisAls (i!=j) */
     }else if(ri==rj) { /* NisCksAls (i!=k,l) */
       if(eleNum[rsi]==0) return 0.0;
-      else return GreenFunc1(rk,rl,s,ip,eleIdx,eleCfg,eleNum,
-                             eleProjCnt,projCntNew,buffer); /* CksAls */
+      else return GreenFunc1Chain(rk,rl,s,ip,eleIdx,eleCfg,eleNum,
+                             eleProjCnt,projCntNew,buffer,pfM,invM); /* CksAls */
     }
   }else{
     if(rk==rl) { /* CisAjsNkt */
       if(eleNum[rtk]==0) return 0.0;
       else if(ri==rj) return eleNum[rsi];
-      else return GreenFunc1(ri,rj,s,ip,eleIdx,eleCfg,eleNum,
-                             eleProjCnt,projCntNew,buffer); /* CisAjs */
+      else return GreenFunc1Chain(ri,rj,s,ip,eleIdx,eleCfg,eleNum,
+                             eleProjCnt,projCntNew,buffer,pfM,invM); /* CisAjs */
     }else if(ri==rj) { /* NisCktAlt */
       if(eleNum[rsi]==0) return 0.0;
-      else return GreenFunc1(rk,rl,t,ip,eleIdx,eleCfg,eleNum,
-                             eleProjCnt,projCntNew,buffer); /* CktAlt */
+      else return GreenFunc1Chain(rk,rl,t,ip,eleIdx,eleCfg,eleNum,
+                             eleProjCnt,projCntNew,buffer,pfM,invM); /* CktAlt */
     }
   }
 
@@ -136,17 +313,20 @@ double complex GreenFunc2(const int ri, const int rj, const int rk, const int rl
   eleIdx[mtl] = rk;
   eleNum[rtl] = 0;
   eleNum[rtk] = 1;
-  UpdateProjCnt(rl, rk, t, projCntNew, eleProjCnt, eleNum);
+  if(sparseProj) nDelta = UpdateProjCntDelta(rl, rk, t, projDelta, 0, eleNum);
+  else UpdateProjCnt(rl, rk, t, projCntNew, eleProjCnt, eleNum);
   eleIdx[msj] = ri;
   eleNum[rsj] = 0;
   eleNum[rsi] = 1;
-  UpdateProjCnt(rj, ri, s, projCntNew, projCntNew, eleNum);
+  if(sparseProj) nDelta = UpdateProjCntDelta(rj, ri, s, projDelta, nDelta, eleNum);
+  else UpdateProjCnt(rj, ri, s, projCntNew, projCntNew, eleNum);
 
-  z = ProjRatio(projCntNew,eleProjCnt);
+  if(sparseProj) z = ProjRatioDelta(projDelta, nDelta);
+  else z = ProjRatio(projCntNew,eleProjCnt);
 
   /* calculate Pfaffian */
-  CalculateNewPfMTwo_fcmp(ml, t, mj, s, pfMNew, eleIdx, 0, NQPFull, bufV);
-  z *= CalculateIP_fcmp(pfMNew, 0, NQPFull, MPI_COMM_SELF);
+  CalculateNewPfMTwoChain_fcmp(ml, t, mj, s, pfMNew, eleIdx, pfM, invM, bufV);
+  z *= CalculateIPChain_fcmp(pfMNew);
 
   /* revert hopping */
   eleIdx[mtl] = rl;
@@ -295,13 +475,13 @@ double complex calculateNewPfMN_child(const int qpidx, const int n, const int *m
                               const int *eleIdx, double complex *buffer) {
   const int nsize = Nsize;
   const int n2 = 2*n;
-  const double complex *sltE;
-  const double complex *sltE_k;
   const double complex *invM;
   const double complex *invM_i, *invM_k, *invM_l;
 
   double complex *vec; /* vec[n][nsize] */
   double complex *vec_k, *vec_l;
+  double complex sltRow[Nsite2];
+  const double complex *sltE_k;
   double complex mat[n2*n2]; /* mat[n2][n2] */
   double complex *mat_k;
   double sgn;
@@ -321,7 +501,6 @@ double complex calculateNewPfMN_child(const int qpidx, const int n, const int *m
   //int nn;
   //nn=lda=n2;
 
-  sltE = SlaterElm + qpidx*Nsite2*Nsite2;
   invM = InvM + qpidx*Nsize*Nsize;
 
   vec = buffer; /* n*nsize */
@@ -329,8 +508,8 @@ double complex calculateNewPfMN_child(const int qpidx, const int n, const int *m
   #pragma loop noalias
   for(k=0;k<n;k++) {
     rsk = eleIdx[msa[k]] + (msa[k]/Ne)*Nsite;
-    sltE_k = sltE + rsk*Nsite2;
     vec_k = vec + k*nsize;
+    sltE_k = SlaterElmRow_fcmp(qpidx, rsk, sltRow);
     #pragma loop norecurrence
     for(msi=0;msi<nsize;msi++) {
       rsi = eleIdx[msi] + (msi/Ne)*Nsite;
@@ -44,8 +44,21 @@ double calculateNewPfMN_real_child(const int qpidx, const int n, const int *msa,
 double  GreenFunc1_real(const int ri, const int rj, const int s, const double ip,
                   int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
                   int *projCntNew, double *buffer) {
+  return GreenFunc1Chain_real(ri,rj,s,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,
+                              PfM_real,InvM_real);
+}
+
+/* GreenFunc1_real for the given pfM and invM instead of PfM_real and InvM_real */
+/* buffer size = NQPFull */
+double GreenFunc1Chain_real(const int ri, const int rj, const int s, const double ip,
+                           int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
+                           int *projCntNew, double *buffer,
+                           const double *pfM, const double *invM) {
   double  z;
   int mj,msj,rsi,rsj;
+  int projDelta[2*(2*Nsite+1)]; /* sparse change of projCnt */
+  int nDelta;
+  const int sparseProj=IsProjCntDelta();
   double  *pfMNew_real = buffer; /* NQPFull */
 
   if(ri==rj) return eleNum[ri+s*Nsite];
@@ -60,12 +73,17 @@ double  GreenFunc1_real(const int ri, const int rj, const int s, const double ip
   eleIdx[msj] = ri;
   eleNum[rsj] = 0;
   eleNum[rsi] = 1;
-  UpdateProjCnt(rj, ri, s, projCntNew, eleProjCnt, eleNum);
-  z = ProjRatio(projCntNew,eleProjCnt);
+  if(sparseProj) {
+    nDelta = UpdateProjCntDelta(rj, ri, s, projDelta, 0, eleNum);
+    z = ProjRatioDelta(projDelta, nDelta);
+  } else {
+    UpdateProjCnt(rj, ri, s, projCntNew, eleProjCnt, eleNum);
+    z = ProjRatio(projCntNew,eleProjCnt);
+  }
 
   /* calculate Pfaffian */
-  CalculateNewPfM_real(mj, s, pfMNew_real, eleIdx, 0, NQPFull);
-  z *= CalculateIP_real(pfMNew_real, 0, NQPFull, MPI_COMM_SELF);
+  CalculateNewPfMChain_real(mj, s, pfMNew_real, eleIdx, pfM, invM);
+  z *= CalculateIPChain_real(pfMNew_real);
 
   /* revert hopping */
   eleIdx[msj] = rj;
@@ -75,15 +93,168 @@ double  GreenFunc1_real(const int ri, const int rj, const int s, const double ip
   return z/ip;//TBC
 }
 
+/* real version of GreenFunc1Batch */
+int GreenFunc1Batch_real(const int nTerm, int **termIdx, const double ip,
+                         int *eleIdx, const int *eleCfg, const int *eleNum, const int *eleProjCnt,
+                         double *green) {
+  const int nsize=Nsize;
+  const int ne=Ne;
+  const int sparseProj=IsProjCntDelta();
+  int idx,k,l,r,ri,rj,s,msj,rsi,qpidx;
+  int nRow=0,nCol=0,nBatch=0;
+  int *batchIdx,*termRow,*termCol,*rowMs,*msToRow,*colRs,*rsToCol;
+  int *myEleNum,*myProjCntNew;
+  int nDelta;
+  double *matA,*matB,*matC,*myIP;
+  double *invM,*invM_r,*matB_l;
+  double z;
+  char transA='T', transB='N';
+  double one=1.0, zero=0.0;
+
+  batchIdx = GreenBatchWork;
+  termRow  = batchIdx + nTerm;
+  termCol  = termRow + nTerm;
+  rowMs    = termCol + nTerm;
+  msToRow  = rowMs + Nsize;
+  colRs    = msToRow + Nsize;
+  rsToCol  = colRs + Nsite2;
+
+  for(k=0;k<Nsize;k++) msToRow[k] = -1;
+  for(k=0;k<Nsite2;k++) rsToCol[k] = -1;
+
+  /* group the terms by the annihilated electron and the created site */
+  for(idx=0;idx<nTerm;idx++) {
+    ri = termIdx[idx][0];
+    rj = termIdx[idx][2];
+    s  = termIdx[idx][3];
+    if(ri==rj || eleNum[ri+s*Nsite]==1 || eleNum[rj+s*Nsite]==0) continue;
+    msj = eleCfg[rj+s*Nsite] + s*Ne;
+    rsi = ri + s*Nsite;
+    if(msToRow[msj]<0) { msToRow[msj] = nRow; rowMs[nRow++] = msj; }
+    if(rsToCol[rsi]<0) { rsToCol[rsi] = nCol; colRs[nCol++] = rsi; }
+    termRow[nBatch] = msToRow[msj];
+    termCol[nBatch] = rsToCol[rsi];
+    batchIdx[nBatch++] = idx;
+  }
+
+  if(4*nBatch < nRow*nCol) {
+    return 0;
+  }
+
+  for(idx=0;idx<nTerm;idx++) {
+    ri = termIdx[idx][0];
+    rj = termIdx[idx][2];
+    s  = termIdx[idx][3];
+    if(ri==rj) green[idx] = eleNum[ri+s*Nsite];
+    else green[idx] = 0.0;
+  }
+  if(nBatch==0) {
+    return 1;
+  }
+
+  RequestWorkSpaceThreadInt(Nsite2+NProj);
+  RequestWorkSpaceThreadDouble(nRow*Nsize+Nsize*nCol+nRow*nCol+nBatch);
+
+  #pragma omp parallel default(shared)                                 \
+    private(matA,matB,matC,myIP,myEleNum,myProjCntNew,nDelta,          \
+            invM,invM_r,matB_l,z,idx,k,l,r,ri,rj,s,msj,rsi,qpidx)
+  {
+    int projDelta[2*(2*Nsite+1)]; /* sparse change of projCnt */
+    double sltRow[Nsite2];
+    const double *sltE_l;
+    matA = GetWorkSpaceThreadDouble(nRow*Nsize); /* matA[r][k] = InvM[rowMs[r]][k] */
+    matB = GetWorkSpaceThreadDouble(Nsize*nCol); /* matB[l][k] = SlaterElm[colRs[l]][rk] */
+    matC = GetWorkSpaceThreadDouble(nRow*nCol);  /* matC[l][r] = ratio */
+    myIP = GetWorkSpaceThreadDouble(nBatch);
+    myEleNum = GetWorkSpaceThreadInt(Nsite2);
+    myProjCntNew = GetWorkSpaceThreadInt(NProj);
+
+    for(k=0;k<nBatch;k++) myIP[k] = 0.0;
+
+    #pragma omp for
+    for(qpidx=0;qpidx<NQPFull;qpidx++) {
+      invM = InvM_real + qpidx*Nsize*Nsize;
+      for(r=0;r<nRow;r++) {
+        invM_r = invM + rowMs[r]*Nsize;
+        for(k=0;k<nsize;k++) matA[r*nsize+k] = invM_r[k];
+      }
+      for(l=0;l<nCol;l++) {
+        rsi = colRs[l];
+        matB_l = matB + l*nsize;
+        sltE_l = SlaterElmRow_real(qpidx, rsi, sltRow);
+        for(k=0;k<ne;k++) matB_l[k] = sltE_l[eleIdx[k]];
+        for(k=ne;k<nsize;k++) matB_l[k] = sltE_l[eleIdx[k]+Nsite];
+      }
+
+      M_DGEMM(&transA, &transB, &nRow, &nCol, &nsize, &one, matA, &nsize,
+              matB, &nsize, &zero, matC, &nRow);
+
+      z = -QPFullWeight[qpidx]*PfM_real[qpidx];
+      for(k=0;k<nBatch;k++) myIP[k] += z * matC[termRow[k]+termCol[k]*nRow];
+    }
+
+    #pragma omp critical
+    {
+      for(k=0;k<nBatch;k++) green[batchIdx[k]] += myIP[k];
+    }
+    #pragma omp barrier
+
+    /* projection factors */
+    for(k=0;k<Nsite2;k++) myEleNum[k] = eleNum[k];
+
+    #pragma omp for
+    for(k=0;k<nBatch;k++) {
+      idx = batchIdx[k];
+      ri = termIdx[idx][0];
+      rj = termIdx[idx][2];
+      s  = termIdx[idx][3];
+
+      /* hopping */
+      myEleNum[rj+s*Nsite] = 0;
+      myEleNum[ri+s*Nsite] = 1;
+      if(sparseProj) {
+        nDelta = UpdateProjCntDelta(rj, ri, s, projDelta, 0, myEleNum);
+        z = ProjRatioDelta(projDelta, nDelta);
+      } else {
+        UpdateProjCnt(rj, ri, s, myProjCntNew, eleProjCnt, myEleNum);
+        z = ProjRatio(myProjCntNew,eleProjCnt);
+      }
+      /* revert hopping */
+      myEleNum[rj+s*Nsite] = 1;
+      myEleNum[ri+s*Nsite] = 0;
+
+      green[idx] = z*green[idx]/ip;
+    }
+  }
+
+  ReleaseWorkSpaceThreadInt();
+  ReleaseWorkSpaceThreadDouble();
+  return 1;
+}
+
 /* Calculate 2-body Green function <psi|CisAjsCktAlt|x>/<psi|x> */
 /* buffer size = NQPFull+2*Nsize */
 double GreenFunc2_real(const int ri, const int rj, const int rk, const int rl,
                   const int s, const int t, const double ip,
                   int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
                   int *projCntNew, double *buffer) {
+  return GreenFunc2Chain_real(ri,rj,rk,rl,s,t,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer,
+                              PfM_real,InvM_real);
+}
+
+/* GreenFunc2_real for the given pfM and invM instead of PfM_real and InvM_real */
+/* buffer size = NQPFull+2*Nsize */
+double GreenFunc2Chain_real(const int ri, const int rj, const int rk, const int rl,
+                           const int s, const int t, const double ip,
+                           int *eleIdx, const int *eleCfg, int *eleNum, const int *eleProjCnt,
+                           int *projCntNew, double *buffer,
+                           double *pfM, double *invM) {
   double z;
   int mj,msj,ml,mtl;
   int rsi,rsj,rtk,rtl;
+  int projDelta[4*(2*Nsite+1)]; /* sparse change of projCnt */
+  int nDelta=0;
+  const int sparseProj=IsProjCntDelta();
   double *pfMNew_real = buffer; /* [NQPFull] */
   double *bufV   = buffer+NQPFull; /* 2*Nsize */
 
@@ -95,37 +266,37 @@ double GreenFunc2_real(const int ri, const int rj, const int rk, const int rl,
   if(s==t) {
     if(rk==rl) { /* CisAjsNks */
       if(eleNum[rtk]==0) return 0.0;
-      else return GreenFunc1_real(ri,rj,s,ip,eleIdx,eleCfg,eleNum,
-                             eleProjCnt,projCntNew,buffer); /* CisAjs */
+      else return GreenFunc1Chain_real(ri,rj,s,ip,eleIdx,eleCfg,eleNum,
+                             eleProjCnt,projCntNew,buffer,pfM,invM); /* CisAjs */
     }else if(rj==rl) {
       return 0.0; /* CisAjsCksAjs (j!=k) */
     }else if(ri==rl) { /* AjsCksNis */
       if(eleNum[rsi]==0) return 0.0;
       else if(rj==rk) return 1.0-eleNum[rsj];
-      else return -GreenFunc1_real(rk,rj,s,ip,eleIdx,eleCfg,eleNum,
-                              eleProjCnt,projCntNew,buffer); /* -CksAjs */
+      else return -GreenFunc1Chain_real(rk,rj,s,ip,eleIdx,eleCfg,eleNum,
+                              eleProjCnt,projCntNew,buffer,pfM,invM); /* -CksAjs */
     }else if(rj==rk) { /* CisAls(1-Njs) */
       if(eleNum[rsj]==1) return 0.0;
       else if(ri==rl) return eleNum[rsi];
-      else return GreenFunc1_real(ri,rl,s,ip,eleIdx,eleCfg,eleNum,
-                             eleProjCnt,projCntNew,buffer); /* CisAls */
+      else return GreenFunc1Chain_real(ri,rl,s,ip,eleIdx,eleCfg,eleNum,
+                             eleProjCnt,projCntNew,buffer,pfM,invM); /* CisAls */
     }else if(ri==rk) {
       return 0.0; /* CisAjsCisAls (i!=j) */
     }else if(ri==rj) { /* NisCksAls (i!=k,l) */
       if(eleNum[rsi]==0) return 0.0;
-      else return GreenFunc1_real(rk,rl,s,ip,eleIdx,eleCfg,eleNum,
-                             eleProjCnt,projCntNew,buffer); /* CksAls */
+      else return GreenFunc1Chain_real(rk,rl,s,ip,eleIdx,eleCfg,eleNum,
+                             eleProjCnt,projCntNew,buffer,pfM,invM); /* CksAls */
     }
   }else{
     if(rk==rl) { /* CisAjsNkt */
       if(eleNum[rtk]==0) return 0.0;
       else if(ri==rj) return eleNum[rsi];
-      else return GreenFunc1_real(ri,rj,s,ip,eleIdx,eleCfg,eleNum,
-                             eleProjCnt,projCntNew,buffer); /* CisAjs */
+      else return GreenFunc1Chain_real(ri,rj,s,ip,eleIdx,eleCfg,eleNum,
+                             eleProjCnt,projCntNew,buffer,pfM,invM); /* CisAjs */
     }else if(ri==rj) { /* NisCktAlt */
       if(eleNum[rsi]==0) return 0.0;
-      else return GreenFunc1_real(rk,rl,t,ip,eleIdx,eleCfg,eleNum,
-                             eleProjCnt,projCntNew,buffer); /* CktAlt */
+      else return GreenFunc1Chain_real(rk,rl,t,ip,eleIdx,eleCfg,eleNum,
+                             eleProjCnt,projCntNew,buffer,pfM,invM); /* CktAlt */
     }
   }
 
@@ -140,17 +311,20 @@ double GreenFunc2_real(const int ri, const int rj, const int rk, const int rl,
   eleIdx[mtl] = rk;
   eleNum[rtl] = 0;
   eleNum[rtk] = 1;
-  UpdateProjCnt(rl, rk, t, projCntNew, eleProjCnt, eleNum);
+  if(sparseProj) nDelta = UpdateProjCntDelta(rl, rk, t, projDelta, 0, eleNum);
+  else UpdateProjCnt(rl, rk, t, projCntNew, eleProjCnt, eleNum);
   eleIdx[msj] = ri;
   eleNum[rsj] = 0;
   eleNum[rsi] = 1;
-  UpdateProjCnt(rj, ri, s, projCntNew, projCntNew, eleNum);
+  if(sparseProj) nDelta = UpdateProjCntDelta(rj, ri, s, projDelta, nDelta, eleNum);
+  else UpdateProjCnt(rj, ri, s, projCntNew, projCntNew, eleNum);
 
-  z = ProjRatio(projCntNew,eleProjCnt);
+  if(sparseProj) z = ProjRatioDelta(projDelta, nDelta);
+  else z = ProjRatio(projCntNew,eleProjCnt);
 
   /* calculate Pfaffian */
-  CalculateNewPfMTwo_real(ml, t, mj, s, pfMNew_real, eleIdx, 0, NQPFull, bufV);
-  z *= CalculateIP_real(pfMNew_real, 0, NQPFull, MPI_COMM_SELF);
+  CalculateNewPfMTwoChain_real(ml, t, mj, s, pfMNew_real, eleIdx, pfM, invM, bufV);
+  z *= CalculateIPChain_real(pfMNew_real);
 
   /* revert hopping */
   eleIdx[mtl] = rl;
@@ -305,13 +479,13 @@ double calculateNewPfMN_real_child(const int qpidx, const int n, const int *msa,
                               const int *eleIdx, double *buffer) {
   const int nsize = Nsize;
   const int n2 = 2*n;
-  const double  *sltE;
-  const double  *sltE_k;
   const double  *invM;
   const double  *invM_i, *invM_k, *invM_l;
 
   double  *vec; /* vec[n][nsize] */
   double  *vec_k, *vec_l;
+  double sltRow[Nsite2];
+  const double *sltE_k;
   double  mat[n2*n2]; /* mat[n2][n2] */
   double  *mat_k;
   double sgn;
@@ -328,7 +502,6 @@ double calculateNewPfMN_real_child(const int qpidx, const int n, const int *msa,
   int lwork = n2*n2;
   nn=lda=n2;
 
-  sltE = SlaterElm_real + qpidx*Nsite2*Nsite2;
   invM = InvM_real + qpidx*Nsize*Nsize;
 
   vec = buffer; /* n*nsize */
@@ -336,8 +509,8 @@ double calculateNewPfMN_real_child(const int qpidx, const int n, const int *msa,
   #pragma loop noalias
   for(k=0;k<n;k++) {
     rsk = eleIdx[msa[k]] + (msa[k]/Ne)*Nsite;
-    sltE_k = sltE + rsk*Nsite2;
     vec_k = vec + k*nsize;
+    sltE_k = SlaterElmRow_real(qpidx, rsk, sltRow);
     #pragma loop norecurrence
     for(msi=0;msi<nsize;msi++) {
       rsi = eleIdx[msi] + (msi/Ne)*Nsite;
@@ -39,6 +39,8 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 #include "pfupdate_two_fcmp.h"
 #include "projection.h"
 
+void calculateLSHop(const double complex h1, const double complex ip, int *eleIdx, int *eleCfg,
+                    int *eleNum, int *eleProjCnt);
 double complex calculateHK(const double complex h1, const double complex ip, int *eleIdx, int *eleCfg,
                    int *eleNum, int *eleProjCnt);
 double complex calculateHW(const double complex h1, const double complex ip, int *eleIdx, int *eleCfg,
@@ -71,6 +73,16 @@ double complex calHCACA2(const int ri, const int rj, const int rk, const int rl,
                  const int si,const int sk,
                  const double complex ip, int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt);
 
+int calHCAChain(const int ri, const int rj, const int s,
+                const double complex h1, const double complex ip, int *eleIdx, int *eleCfg,
+                int *eleNum, int *eleProjCnt, double complex *pfM, double complex *invM,
+                int *projCntNew, double complex *buffer, double complex *val);
+int calHCACAChain(const int ri, const int rj, const int rk, const int rl,
+                  const int si,const int sk,
+                  const double complex h1, const double complex ip, int *eleIdx, int *eleCfg,
+                  int *eleNum, int *eleProjCnt, double complex *pfM, double complex *invM,
+                  int *projCntNew, double complex *buffer, double complex *val);
+
 void copyMAll(double complex *invM_from, double complex *pfM_from, double complex *invM_to, double complex *pfM_to);
 
 /* Calculate <psi|QQ|x>/<psi|x> */
@@ -80,6 +92,9 @@ void LSLocalQ(const double complex h1, const double complex ip, int *eleIdx, int
 
   e0 = CalculateHamiltonian0(eleNum); /* V */
 
+  /* <psi|H CA|x>/<psi|x> and <psi|H CACA|x>/<psi|x> of all the terms */
+  calculateLSHop(h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+
   h2 = h1*e0; /* HV = (V+K+W)V */
   h2 += calculateHK(h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
   h2 += calculateHW(h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
@@ -96,11 +111,11 @@ void LSLocalQ(const double complex h1, const double complex ip, int *eleIdx, int
 }
 
 /* Calculate <psi|QCisAjs|x>/<psi|x> */
+/* The values of the hops are given by LSLocalQ for the same sample. */
 void LSLocalCisAjs(const double complex h1, const double complex ip, int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt) {
   const int nCisAjs=NCisAjs;
   double complex*lsLCisAjs = LSLCisAjs;
   double complex*localCisAjs = LocalCisAjs;
-  int ri,rj,s;
   int idx;
 
   /* copy local ICisAjs */
@@ -109,69 +124,158 @@ void LSLocalCisAjs(const double complex h1, const double complex ip, int *eleIdx
     lsLCisAjs[idx] = localCisAjs[idx];
   }
 
+  /* local HCisAjs */
   for(idx=0;idx<nCisAjs;idx++){
-    ri = CisAjsIdx[idx][0];
-    rj = CisAjsIdx[idx][2];
-    s  = CisAjsIdx[idx][3];
+    lsLCisAjs[idx+nCisAjs] = LSHopVal[LSHopCisAjs[idx]];
+  }
+  return;
+}
+
+/* Calculate <psi|H CA|x>/<psi|x> of the hops LSHopIdx */
+/* and <psi|H CACA|x>/<psi|x> of the terms of W, and store them in LSHopVal. */
+/* Each thread evaluates the terms with its own copy of the configuration, */
+/* PfM and InvM. The terms with <psi|x'>/<psi|x>=0 are calculated afterwards */
+/* by calHCA and calHCACA, which use the threads by themselves. */
+void calculateLSHop(const double complex h1, const double complex ip, int *eleIdx, int *eleCfg,
+                    int *eleNum, int *eleProjCnt) {
+  const int nsize=Nsize;
+  const int nsite2=Nsite2;
+  const int nHop=NLSHop;
+  const int nTerm=NLSHop+NLSTerm;
+  int idx;
+  int op[6];
+
+  int *myEleIdx, *myEleCfg, *myEleNum, *myProjCntNew;
+  double complex *myInvM, *myPfM, *myBuffer;
+
+  RequestWorkSpaceThreadInt(Nsize+2*Nsite2+2*NProj);
+  RequestWorkSpaceThreadComplex(NQPFull*(Nsize*Nsize+2)+4*Nsize);
+
+#pragma omp parallel default(shared)\
+  private(idx,op,myEleIdx,myEleCfg,myEleNum,myProjCntNew,myInvM,myPfM,myBuffer)
+  {
+    myEleIdx = GetWorkSpaceThreadInt(Nsize);
+    myEleCfg = GetWorkSpaceThreadInt(Nsite2);
+    myEleNum = GetWorkSpaceThreadInt(Nsite2);
+    myProjCntNew = GetWorkSpaceThreadInt(2*NProj);
+    myInvM = GetWorkSpaceThreadComplex(NQPFull*Nsize*Nsize);
+    myPfM = GetWorkSpaceThreadComplex(NQPFull);
+    myBuffer = GetWorkSpaceThreadComplex(NQPFull+4*Nsize);
+
+    #pragma loop noalias
+    for(idx=0;idx<nsize;idx++) myEleIdx[idx] = eleIdx[idx];
+    #pragma loop noalias
+    for(idx=0;idx<nsite2;idx++) myEleCfg[idx] = eleCfg[idx];
+    #pragma loop noalias
+    for(idx=0;idx<nsite2;idx++) myEleNum[idx] = eleNum[idx];
 
-    /* calculate local HCisAjs */
-    LSLCisAjs[idx+nCisAjs] = calHCA(ri,rj,s,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+    #pragma omp for schedule(dynamic)
+    for(idx=0;idx<nTerm;idx++) {
+      if(idx<nHop) {
+        LSTermFlag[idx] = calHCAChain(LSHopIdx[3*idx],LSHopIdx[3*idx+1],LSHopIdx[3*idx+2],h1,ip,
+                                      myEleIdx,myEleCfg,myEleNum,eleProjCnt,myPfM,myInvM,
+                                      myProjCntNew,myBuffer,LSHopVal+idx);
+      } else {
+        getLSTermOp(idx-nHop,op);
+        LSTermFlag[idx] = calHCACAChain(op[0],op[1],op[2],op[3],op[4],op[5],h1,ip,
+                                        myEleIdx,myEleCfg,myEleNum,eleProjCnt,myPfM,myInvM,
+                                        myProjCntNew,myBuffer,LSHopVal+idx);
+      }
+    }
   }
+
+  ReleaseWorkSpaceThreadInt();
+  ReleaseWorkSpaceThreadComplex();
+
+  for(idx=0;idx<nTerm;idx++) {
+    if(LSTermFlag[idx]==0) continue;
+    if(idx<nHop) {
+      LSHopVal[idx] = calHCA(LSHopIdx[3*idx],LSHopIdx[3*idx+1],LSHopIdx[3*idx+2],h1,ip,
+                             eleIdx,eleCfg,eleNum,eleProjCnt);
+    } else {
+      getLSTermOp(idx-nHop,op);
+      LSHopVal[idx] = calHCACA(op[0],op[1],op[2],op[3],op[4],op[5],h1,ip,
+                               eleIdx,eleCfg,eleNum,eleProjCnt);
+    }
+  }
+
+  return;
+}
+
+/* op = {ri,rj,rk,rl,si,sk} of C_ri,si A_rj,si C_rk,sk A_rl,sk for the term-th term of W */
+/* in the order of PairHopping, ExchangeCoupling (two terms each) and InterAll */
+void getLSTermOp(const int term, int *op) {
+  int idx=term;
+
+  if(idx<NPairHopping) {
+    op[0] = PairHopping[idx][0];
+    op[1] = PairHopping[idx][1];
+    op[2] = op[0];
+    op[3] = op[1];
+    op[4] = 0;
+    op[5] = 1;
+    return;
+  }
+  idx -= NPairHopping;
+
+  if(idx<2*NExchangeCoupling) {
+    op[0] = ExchangeCoupling[idx/2][0];
+    op[1] = ExchangeCoupling[idx/2][1];
+    op[2] = op[1];
+    op[3] = op[0];
+    op[4] = idx%2;
+    op[5] = 1-idx%2;
+    return;
+  }
+  idx -= 2*NExchangeCoupling;
+
+  op[0] = InterAll[idx][0];
+  op[1] = InterAll[idx][2];
+  op[2] = InterAll[idx][4];
+  op[3] = InterAll[idx][6];
+  op[4] = InterAll[idx][3];
+  op[5] = InterAll[idx][7];
   return;
 }
 
+/* The values of the hops are given by calculateLSHop. */
 double complex calculateHK(const double complex h1, const double complex ip, int *eleIdx, int *eleCfg,
                    int *eleNum, int *eleProjCnt) {
-  int idx,ri,rj,s;
+  int idx;
   double complex val=0.0;
 
   for(idx=0;idx<NTransfer;idx++) {
-    ri = Transfer[idx][0];
-    rj = Transfer[idx][2];
-    s  = Transfer[idx][3];
-    
-    val -= ParaTransfer[idx] * calHCA(ri,rj,s,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+    val -= ParaTransfer[idx] * LSHopVal[LSHopTransfer[idx]];
     /* Caution: negative sign */
   }
 
   return val;
 }
 
+/* The values of the terms are given by calculateLSHop. */
 double complex calculateHW(const double complex h1, const double complex ip, int *eleIdx, int *eleCfg,
                    int *eleNum, int *eleProjCnt) {
-  int idx,ri,rj,s,rk,rl,t;
+  const double complex *hw = LSHopVal + NLSHop;
+  int idx;
   double complex val=0.0,tmp;
 
   /* Pair Hopping */
   for(idx=0;idx<NPairHopping;idx++) {
-    ri = PairHopping[idx][0];
-    rj = PairHopping[idx][1];
-    
-    val += ParaPairHopping[idx]
-      * calHCACA(ri,rj,ri,rj,0,1,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+    val += ParaPairHopping[idx] * hw[idx];
   }
+  hw += NPairHopping;
 
   /* Exchange Coupling */
   for(idx=0;idx<NExchangeCoupling;idx++) {
-    ri = ExchangeCoupling[idx][0];
-    rj = ExchangeCoupling[idx][1];
-    
-    tmp =  calHCACA(ri,rj,rj,ri,0,1,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
-    tmp += calHCACA(ri,rj,rj,ri,1,0,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+    tmp =  hw[2*idx];
+    tmp += hw[2*idx+1];
     val += ParaExchangeCoupling[idx] * tmp;
   }
+  hw += 2*NExchangeCoupling;
 
   /* Inter All */
   for(idx=0;idx<NInterAll;idx++) {
-    ri = InterAll[idx][0];
-    rj = InterAll[idx][2];
-    s  = InterAll[idx][3];
-    rk = InterAll[idx][4];
-    rl = InterAll[idx][6];
-    t  = InterAll[idx][7];
-      
-    val += ParaInterAll[idx]
-      * calHCACA(ri,rj,rk,rl,s,t,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+    val += ParaInterAll[idx] * hw[idx];
   }
 
   return val;
@@ -237,28 +341,60 @@ double complex checkGF1(const int ri, const int rj, const int s, const double co
 double complex calHCA1(const int ri, const int rj, const int s,
                const double complex ip, int *eleIdx, int *eleCfg,
                int *eleNum, int *eleProjCnt) {
-  complex double *oldInvM; /* [NQPFull*Nsize*Nsize;] */
-  complex double *oldPfM;  /* [NQPFull] */
   int *projCntNew;
+  double complex *invM; /* [NQPFull*Nsize*Nsize] */
+  double complex *pfM;  /* [NQPFull] */
+  double complex *buffer;
+  double complex val=0.0;
+
+  RequestWorkSpaceInt(2*NProj);
+  RequestWorkSpaceComplex(NQPFull*(Nsize*Nsize+2)+4*Nsize);
 
+  projCntNew = GetWorkSpaceInt(2*NProj);
+  invM = GetWorkSpaceComplex(NQPFull*Nsize*Nsize);
+  pfM = GetWorkSpaceComplex(NQPFull);
+  buffer = GetWorkSpaceComplex(NQPFull+4*Nsize);
+
+  /* PfM and InvM of the hopped configuration are kept in pfM and invM */
+  calHCAChain(ri,rj,s,0.0,ip,eleIdx,eleCfg,eleNum,eleProjCnt,pfM,invM,projCntNew,buffer,&val);
+
+  ReleaseWorkSpaceInt();
+  ReleaseWorkSpaceComplex();
+  return val;
+}
+
+/* calHCA for a copy of the configuration. The new PfM and InvM are given in pfM and invM. */
+/* Returns 1 without val for <psi|CA|x>/<psi|x>=0, which is left to calHCA2. */
+/* projCntNew size = 2*NProj, buffer size = NQPFull+4*Nsize */
+int calHCAChain(const int ri, const int rj, const int s,
+                const double complex h1, const double complex ip, int *eleIdx, int *eleCfg,
+                int *eleNum, int *eleProjCnt, double complex *pfM, double complex *invM,
+                int *projCntNew, double complex *buffer, double complex *val) {
   int rsi=ri+s*Nsite;
   int rsj=rj+s*Nsite;
   int mj;
   double complex ipNew,z,e;
 
-  RequestWorkSpaceInt(NProj);
-  RequestWorkSpaceComplex(NQPFull*(Nsize*Nsize+1));
-
-  projCntNew = GetWorkSpaceInt(NProj);
-  oldInvM = GetWorkSpaceComplex(NQPFull*Nsize*Nsize);
-  oldPfM  = GetWorkSpaceComplex(NQPFull);
-
-  /* copy InvM and PfM */
-  copyMAll(InvM,PfM,oldInvM,oldPfM);
+  /* check */
+  if(rsi==rsj) {
+    *val = (eleNum[rsi]==1) ? h1 : 0.0;
+    return 0;
+  } else if(eleNum[rsj]==0 || eleNum[rsi]==1) {
+    *val = 0.0;
+    return 0;
+  }
 
   /* The mj-th electron with spin s hops to site ri */
   mj = eleCfg[rsj];
   eleIdx[mj+s*Ne] = ri;
+
+  /* same as checkGF1 */
+  CalculateNewPfMChain(mj, s, buffer, eleIdx, PfM, InvM);
+  if(cabs(CalculateIPChain_fcmp(buffer)/ip)<=1.0e-12) {
+    eleIdx[mj+s*Ne] = rj;
+    return 1;
+  }
+
   eleCfg[rsj] = -1;
   eleCfg[rsi] = mj;
   eleNum[rsj] = 0;
@@ -267,10 +403,12 @@ double complex calHCA1(const int ri, const int rj, const int s,
   UpdateProjCnt(rj, ri, s, projCntNew, eleProjCnt, eleNum);
   z = ProjRatio(projCntNew,eleProjCnt);
 
-  UpdateMAll(mj,s,eleIdx,0,NQPFull);
-  ipNew = CalculateIP_fcmp(PfM,0,NQPFull,MPI_COMM_SELF);
+  copyMAll(InvM,PfM,invM,pfM);
+  UpdateMAllChain(mj,s,eleIdx,pfM,invM,buffer);
+  ipNew = CalculateIPChain_fcmp(pfM);
 
-  e = CalculateHamiltonian(ipNew,eleIdx,eleCfg,eleNum,projCntNew);
+  e = CalculateHamiltonianChain(ipNew,eleIdx,eleCfg,eleNum,projCntNew,pfM,invM,
+                                projCntNew+NProj,buffer);
 
   /* revert hopping */
   eleIdx[mj+s*Ne] = rj;
@@ -279,12 +417,8 @@ double complex calHCA1(const int ri, const int rj, const int s,
   eleNum[rsj] = 1;
   eleNum[rsi] = 0;
 
-  /* restore InvM and PfM */
-  copyMAll(oldInvM,oldPfM,InvM,PfM);
-
-  ReleaseWorkSpaceInt();
-  ReleaseWorkSpaceComplex();
-  return e*conj(z*ipNew/ip);
+  *val = e*conj(z*ipNew/ip);
+  return 0;
 }
 
 /* calculate <psi| H C_is A_js |x>/<psi|x> for <psi|CA|x>/<psi|x>=0 */
@@ -533,39 +667,101 @@ double complex calHCACA1(const int ri, const int rj, const int rk, const int rl,
                  const int si,const int sk,
                  const double complex ip, int *eleIdx, int *eleCfg,
                  int *eleNum, int *eleProjCnt) {
-  double complex *oldInvM; /* [NQPFull*Nsize*Nsize;] */
-  double complex *oldPfM;  /* [NQPFull] */
   int *projCntNew;
+  double complex *invM; /* [NQPFull*Nsize*Nsize] */
+  double complex *pfM;  /* [NQPFull] */
+  double complex *buffer;
+  double complex val=0.0;
 
+  RequestWorkSpaceInt(2*NProj);
+  RequestWorkSpaceComplex(NQPFull*(Nsize*Nsize+2)+4*Nsize);
+
+  projCntNew = GetWorkSpaceInt(2*NProj);
+  invM = GetWorkSpaceComplex(NQPFull*Nsize*Nsize);
+  pfM = GetWorkSpaceComplex(NQPFull);
+  buffer = GetWorkSpaceComplex(NQPFull+4*Nsize);
+
+  /* PfM and InvM of the hopped configuration are kept in pfM and invM */
+  calHCACAChain(ri,rj,rk,rl,si,sk,0.0,ip,eleIdx,eleCfg,eleNum,eleProjCnt,
+                pfM,invM,projCntNew,buffer,&val);
+
+  ReleaseWorkSpaceInt();
+  ReleaseWorkSpaceComplex();
+  return val;
+}
+
+/* calHCACA for a copy of the configuration. The new PfM and InvM are given in pfM and invM. */
+/* Returns 1 without val for <psi|CACA|x>/<psi|x>=0, which is left to calHCACA2. */
+/* projCntNew size = 2*NProj, buffer size = NQPFull+4*Nsize */
+int calHCACAChain(const int ri, const int rj, const int rk, const int rl,
+                  const int si,const int sk,
+                  const double complex h1, const double complex ip, int *eleIdx, int *eleCfg,
+                  int *eleNum, int *eleProjCnt, double complex *pfM, double complex *invM,
+                  int *projCntNew, double complex *buffer, double complex *val) {
   int rsi=ri+si*Nsite;
   int rsj=rj+si*Nsite;
   int rsk=rk+sk*Nsite;
   int rsl=rl+sk*Nsite;
-  int mj,ml;
+  int mj,ml,info;
   double complex ipNew,z,e;
 
-  RequestWorkSpaceInt(NProj);
-  RequestWorkSpaceComplex(NQPFull*(Nsize*Nsize+1));
-
-  projCntNew = GetWorkSpaceInt(NProj);
-  oldInvM = GetWorkSpaceComplex(NQPFull*Nsize*Nsize);
-  oldPfM  = GetWorkSpaceComplex(NQPFull);
-
-  /* copy InvM and PfM */
-  copyMAll(InvM,PfM,oldInvM,oldPfM);
+  /* check */
+  *val = 0.0;
+  if(rsk==rsl) {
+    if(eleNum[rsk]==1) {
+      return calHCAChain(ri,rj,si,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,
+                         pfM,invM,projCntNew,buffer,val);
+    } else return 0;
+  } else if(rsj==rsk) {
+    if(eleNum[rsj]==1) return 0;
+    else {
+      return calHCAChain(ri,rl,si,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,
+                         pfM,invM,projCntNew,buffer,val);
+    }
+  } else if(rsj==rsl) {
+    return 0;
+  } else if(rsi==rsj) {
+    if(eleNum[rsi]==1) {
+      return calHCAChain(rk,rl,sk,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,
+                         pfM,invM,projCntNew,buffer,val);
+    } else return 0;
+  } else if(rsi==rsk) {
+    return 0;
+  } else if(rsi==rsl) {
+    if(eleNum[rsi]==1) {
+      info = calHCAChain(rk,rj,sk,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,
+                         pfM,invM,projCntNew,buffer,val);
+      *val = -(*val);
+      return info;
+    } else return 0;
+  } else {
+    if(eleNum[rsl]==0) return 0;
+    if(eleNum[rsk]==1) return 0;
+    if(eleNum[rsj]==0) return 0;
+    if(eleNum[rsi]==1) return 0;
+  }
 
   /* The ml-th electron with spin sk hops from rl to rk */
+  /* and the mj-th electron with spin si hops from rj to ri */
   ml = eleCfg[rsl];
+  mj = eleCfg[rsj];
   eleIdx[ml+sk*Ne] = rk;
+  eleIdx[mj+si*Ne] = ri;
+
+  /* same as checkGF2 */
+  CalculateNewPfMTwoChain_fcmp(ml, sk, mj, si, buffer, eleIdx, PfM, InvM, buffer+NQPFull);
+  if(cabs(CalculateIPChain_fcmp(buffer)/ip)<=1.0e-12) {
+    eleIdx[mj+si*Ne] = rj;
+    eleIdx[ml+sk*Ne] = rl;
+    return 1;
+  }
+
   eleCfg[rsl] = -1;
   eleCfg[rsk] = ml;
   eleNum[rsl] = 0;
   eleNum[rsk] = 1;
   UpdateProjCnt(rl, rk, sk, projCntNew, eleProjCnt, eleNum);
 
-  /* The mj-th electron with spin si hops from rj to ri */
-  mj = eleCfg[rsj];
-  eleIdx[mj+si*Ne] = ri;
   eleCfg[rsj] = -1;
   eleCfg[rsi] = mj;
   eleNum[rsj] = 0;
@@ -574,10 +770,12 @@ double complex calHCACA1(const int ri, const int rj, const int rk, const int rl,
 
   z = ProjRatio(projCntNew,eleProjCnt);
 
-  UpdateMAllTwo_fcmp(ml, sk, mj, si, rl, rj, eleIdx, 0, NQPFull);
-  ipNew = CalculateIP_fcmp(PfM,0,NQPFull,MPI_COMM_SELF);
+  copyMAll(InvM,PfM,invM,pfM);
+  UpdateMAllTwoChain_fcmp(ml, sk, mj, si, rl, rj, eleIdx, pfM, invM, buffer);
+  ipNew = CalculateIPChain_fcmp(pfM);
 
-  e = CalculateHamiltonian(ipNew,eleIdx,eleCfg,eleNum,projCntNew);
+  e = CalculateHamiltonianChain(ipNew,eleIdx,eleCfg,eleNum,projCntNew,pfM,invM,
+                                projCntNew+NProj,buffer);
 
   /* revert hopping */
   eleIdx[mj+si*Ne] = rj;
@@ -592,12 +790,8 @@ double complex calHCACA1(const int ri, const int rj, const int rk, const int rl,
   eleNum[rsl] = 1;
   eleNum[rsk] = 0;
 
-  /* restore InvM and PfM */
-  copyMAll(oldInvM,oldPfM,InvM,PfM);
-
-  ReleaseWorkSpaceInt();
-  ReleaseWorkSpaceComplex();
-  return e*z*ipNew/ip;
+  *val = e*z*ipNew/ip;
+  return 0;
 }
 
 /* calculate <psi| H C_is A_js C_kt A_lt|x>/<psi|x> for <psi|CACA|x>/<psi|x>=0 */
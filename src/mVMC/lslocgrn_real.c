@@ -26,6 +26,7 @@ along with this program. If not, see http://www.gnu.org/licenses/.
  * by Satoshi Morita
  *-------------------------------------------------------------*/
 #include "lslocgrn_real.h"
+#include "lslocgrn.h"
 #ifndef _SRC_LSLOCGRN_REAL
 #define _SRC_LSLOCGRN_REAL
 #include "calham_real.h"
@@ -48,6 +49,9 @@ void LSLocalQ_real(const double h1, const double ip, int *eleIdx, int *eleCfg, i
 
   e0 = CalculateHamiltonian0_real(eleNum); /* V */
 
+  /* <psi|H CA|x>/<psi|x> and <psi|H CACA|x>/<psi|x> of all the terms */
+  calculateLSHop_real(h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+
   h2 = h1*e0; /* HV = (V+K+W)V */
   h2 += calculateHK_real(h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
   h2 += calculateHW_real(h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
@@ -63,7 +67,85 @@ void LSLocalQ_real(const double h1, const double ip, int *eleIdx, int *eleCfg, i
   return;
 }
 
-///
+/// Calculate <psi|H CA|x>/<psi|x> of the hops LSHopIdx
+/// and <psi|H CACA|x>/<psi|x> of the terms of W, and store them in LSHopVal_real.
+/// Each thread evaluates the terms with its own copy of the configuration,
+/// PfM and InvM. The terms with <psi|x'>/<psi|x>=0 are calculated afterwards
+/// by calHCA_real and calHCACA_real, which use the threads by themselves.
+/// \param h1
+/// \param ip
+/// \param eleIdx
+/// \param eleCfg
+/// \param eleNum
+/// \param eleProjCnt
+/// \version 1.0
+void calculateLSHop_real(const double h1, const double ip, int *eleIdx, int *eleCfg,
+                         int *eleNum, int *eleProjCnt) {
+  const int nsize=Nsize;
+  const int nsite2=Nsite2;
+  const int nHop=NLSHop;
+  const int nTerm=NLSHop+NLSTerm;
+  int idx;
+  int op[6];
+
+  int *myEleIdx, *myEleCfg, *myEleNum, *myProjCntNew;
+  double *myInvM, *myPfM, *myBuffer;
+
+  RequestWorkSpaceThreadInt(Nsize+2*Nsite2+2*NProj);
+  RequestWorkSpaceThreadDouble(NQPFull*(Nsize*Nsize+2)+4*Nsize);
+
+#pragma omp parallel default(shared)\
+  private(idx,op,myEleIdx,myEleCfg,myEleNum,myProjCntNew,myInvM,myPfM,myBuffer)
+  {
+    myEleIdx = GetWorkSpaceThreadInt(Nsize);
+    myEleCfg = GetWorkSpaceThreadInt(Nsite2);
+    myEleNum = GetWorkSpaceThreadInt(Nsite2);
+    myProjCntNew = GetWorkSpaceThreadInt(2*NProj);
+    myInvM = GetWorkSpaceThreadDouble(NQPFull*Nsize*Nsize);
+    myPfM = GetWorkSpaceThreadDouble(NQPFull);
+    myBuffer = GetWorkSpaceThreadDouble(NQPFull+4*Nsize);
+
+#pragma loop noalias
+    for(idx=0;idx<nsize;idx++) myEleIdx[idx] = eleIdx[idx];
+#pragma loop noalias
+    for(idx=0;idx<nsite2;idx++) myEleCfg[idx] = eleCfg[idx];
+#pragma loop noalias
+    for(idx=0;idx<nsite2;idx++) myEleNum[idx] = eleNum[idx];
+
+#pragma omp for schedule(dynamic)
+    for(idx=0;idx<nTerm;idx++) {
+      if(idx<nHop) {
+        LSTermFlag[idx] = calHCAChain_real(LSHopIdx[3*idx],LSHopIdx[3*idx+1],LSHopIdx[3*idx+2],h1,ip,
+                                           myEleIdx,myEleCfg,myEleNum,eleProjCnt,myPfM,myInvM,
+                                           myProjCntNew,myBuffer,LSHopVal_real+idx);
+      } else {
+        getLSTermOp(idx-nHop,op);
+        LSTermFlag[idx] = calHCACAChain_real(op[0],op[1],op[2],op[3],op[4],op[5],h1,ip,
+                                             myEleIdx,myEleCfg,myEleNum,eleProjCnt,myPfM,myInvM,
+                                             myProjCntNew,myBuffer,LSHopVal_real+idx);
+      }
+    }
+  }
+
+  ReleaseWorkSpaceThreadInt();
+  ReleaseWorkSpaceThreadDouble();
+
+  for(idx=0;idx<nTerm;idx++) {
+    if(LSTermFlag[idx]==0) continue;
+    if(idx<nHop) {
+      LSHopVal_real[idx] = calHCA_real(LSHopIdx[3*idx],LSHopIdx[3*idx+1],LSHopIdx[3*idx+2],h1,ip,
+                                       eleIdx,eleCfg,eleNum,eleProjCnt);
+    } else {
+      getLSTermOp(idx-nHop,op);
+      LSHopVal_real[idx] = calHCACA_real(op[0],op[1],op[2],op[3],op[4],op[5],h1,ip,
+                                         eleIdx,eleCfg,eleNum,eleProjCnt);
+    }
+  }
+
+  return;
+}
+
+/// The values of the hops are given by calculateLSHop_real.
 /// \param h1
 /// \param ip
 /// \param eleIdx
@@ -74,15 +156,11 @@ void LSLocalQ_real(const double h1, const double ip, int *eleIdx, int *eleCfg, i
 /// \version 1.0
 double calculateHK_real(const double h1, const double ip, int *eleIdx, int *eleCfg,
                            int *eleNum, int *eleProjCnt) {
-  int idx,ri,rj,s;
+  int idx;
   double val=0.0;
 
   for(idx=0;idx<NTransfer;idx++) {
-    ri = Transfer[idx][0];
-    rj = Transfer[idx][2];
-    s  = Transfer[idx][3];
-
-    val -= creal(ParaTransfer[idx]) * calHCA_real(ri,rj,s,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+    val -= creal(ParaTransfer[idx]) * LSHopVal_real[LSHopTransfer[idx]];
     /* Caution: negative sign */
   }
 
@@ -180,28 +258,64 @@ double checkGF1_real(const int ri, const int rj, const int s, const double ip,
 double calHCA1_real(const int ri, const int rj, const int s,
                const double ip, int *eleIdx, int *eleCfg,
                int *eleNum, int *eleProjCnt) {
-  double *oldInvM; /* [NQPFull*Nsize*Nsize;] */
-  double *oldPfM;  /* [NQPFull] */
   int *projCntNew;
+  double *invM; /* [NQPFull*Nsize*Nsize] */
+  double *pfM;  /* [NQPFull] */
+  double *buffer;
+  double val=0.0;
+
+  RequestWorkSpaceInt(2*NProj);
+  RequestWorkSpaceDouble(NQPFull*(Nsize*Nsize+2)+4*Nsize);
+
+  projCntNew = GetWorkSpaceInt(2*NProj);
+  invM = GetWorkSpaceDouble(NQPFull*Nsize*Nsize);
+  pfM = GetWorkSpaceDouble(NQPFull);
+  buffer = GetWorkSpaceDouble(NQPFull+4*Nsize);
+
+  /* PfM and InvM of the hopped configuration are kept in pfM and invM */
+  calHCAChain_real(ri,rj,s,0.0,ip,eleIdx,eleCfg,eleNum,eleProjCnt,pfM,invM,projCntNew,buffer,&val);
+
+  ReleaseWorkSpaceInt();
+  ReleaseWorkSpaceDouble();
+  return val;
+}
 
+/// calHCA_real for a copy of the configuration. The new PfM and InvM are given in pfM and invM.
+/// Returns 1 without val for <psi|CA|x>/<psi|x>=0, which is left to calHCA2_real.
+/// \param projCntNew [in] work array of 2*NProj
+/// \param buffer [in] work array of NQPFull+4*Nsize
+/// \param val [out] <psi| H C_is A_js |x>/<psi|x>
+/// \return 0 or 1
+/// \version 1.0
+int calHCAChain_real(const int ri, const int rj, const int s,
+                     const double h1, const double ip, int *eleIdx, int *eleCfg,
+                     int *eleNum, int *eleProjCnt, double *pfM, double *invM,
+                     int *projCntNew, double *buffer, double *val) {
   int rsi=ri+s*Nsite;
   int rsj=rj+s*Nsite;
   int mj;
   double ipNew,z,e;
 
-  RequestWorkSpaceInt(NProj);
-  RequestWorkSpaceDouble(NQPFull*(Nsize*Nsize+1));
-
-  projCntNew = GetWorkSpaceInt(NProj);
-  oldInvM = GetWorkSpaceDouble(NQPFull*Nsize*Nsize);
-  oldPfM  = GetWorkSpaceDouble(NQPFull);
-
-  /* copy InvM and PfM */
-  copyMAll_real(InvM_real,PfM_real,oldInvM,oldPfM);
+  /* check */
+  if(rsi==rsj) {
+    *val = (eleNum[rsi]==1) ? h1 : 0.0;
+    return 0;
+  } else if(eleNum[rsj]==0 || eleNum[rsi]==1) {
+    *val = 0.0;
+    return 0;
+  }
 
   /* The mj-th electron with spin s hops to site ri */
   mj = eleCfg[rsj];
   eleIdx[mj+s*Ne] = ri;
+
+  /* same as checkGF1_real */
+  CalculateNewPfMChain_real(mj, s, buffer, eleIdx, PfM_real, InvM_real);
+  if(fabs(CalculateIPChain_real(buffer)/ip)<=1.0e-12) {
+    eleIdx[mj+s*Ne] = rj;
+    return 1;
+  }
+
   eleCfg[rsj] = -1;
   eleCfg[rsi] = mj;
   eleNum[rsj] = 0;
@@ -210,10 +324,12 @@ double calHCA1_real(const int ri, const int rj, const int s,
   UpdateProjCnt(rj, ri, s, projCntNew, eleProjCnt, eleNum);
   z = ProjRatio(projCntNew,eleProjCnt);
 
-  UpdateMAll_real(mj,s,eleIdx,0,NQPFull);
-  ipNew = CalculateIP_real(PfM_real,0,NQPFull,MPI_COMM_SELF);
+  copyMAll_real(InvM_real,PfM_real,invM,pfM);
+  UpdateMAllChain_real(mj,s,eleIdx,pfM,invM,buffer);
+  ipNew = CalculateIPChain_real(pfM);
 
-  e = CalculateHamiltonian_real(ipNew,eleIdx,eleCfg,eleNum,projCntNew);
+  e = CalculateHamiltonianChain_real(ipNew,eleIdx,eleCfg,eleNum,projCntNew,pfM,invM,
+                                     projCntNew+NProj,buffer);
 
   /* revert hopping */
   eleIdx[mj+s*Ne] = rj;
@@ -222,12 +338,8 @@ double calHCA1_real(const int ri, const int rj, const int s,
   eleNum[rsj] = 1;
   eleNum[rsi] = 0;
 
-  /* restore InvM and PfM */
-  copyMAll_real(oldInvM,oldPfM,InvM_real,PfM_real);
-
-  ReleaseWorkSpaceInt();
-  ReleaseWorkSpaceDouble();
-  return e*z*ipNew/ip;
+  *val = e*z*ipNew/ip;
+  return 0;
 }
 
 /* calculate <psi| H C_is A_js |x>/<psi|x> for <psi|CA|x>/<psi|x>=0 */
@@ -395,39 +507,27 @@ void copyMAll_real(double *invM_from, double *pfM_from, double *invM_to, double
 
 double calculateHW_real(const double h1, const double ip, int *eleIdx, int *eleCfg,
                            int *eleNum, int *eleProjCnt) {
-  int idx,ri,rj,s,rk,rl,t;
+  const double *hw = LSHopVal_real + NLSHop;
+  int idx;
   double val=0.0,tmp;
 
   /* Pair Hopping */
   for(idx=0;idx<NPairHopping;idx++) {
-    ri = PairHopping[idx][0];
-    rj = PairHopping[idx][1];
-
-    val += ParaPairHopping[idx]
-      * calHCACA_real(ri,rj,ri,rj,0,1,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+    val += ParaPairHopping[idx] * hw[idx];
   }
+  hw += NPairHopping;
 
   /* Exchange Coupling */
   for(idx=0;idx<NExchangeCoupling;idx++) {
-    ri = ExchangeCoupling[idx][0];
-    rj = ExchangeCoupling[idx][1];
-
-    tmp =  calHCACA_real(ri,rj,rj,ri,0,1,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
-    tmp += calHCACA_real(ri,rj,rj,ri,1,0,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+    tmp =  hw[2*idx];
+    tmp += hw[2*idx+1];
     val += ParaExchangeCoupling[idx] * tmp;
   }
+  hw += 2*NExchangeCoupling;
 
   /* Inter All */
   for(idx=0;idx<NInterAll;idx++) {
-    ri = InterAll[idx][0];
-    rj = InterAll[idx][2];
-    s  = InterAll[idx][3];
-    rk = InterAll[idx][4];
-    rl = InterAll[idx][6];
-    t  = InterAll[idx][7];
-
-    val += creal(ParaInterAll[idx])
-      * calHCACA_real(ri,rj,rk,rl,s,t,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+    val += creal(ParaInterAll[idx]) * hw[idx];
   }
 
   return val;
@@ -537,39 +637,105 @@ double calHCACA1_real(const int ri, const int rj, const int rk, const int rl,
                  const int si,const int sk,
                  const double ip, int *eleIdx, int *eleCfg,
                  int *eleNum, int *eleProjCnt) {
-  double *oldInvM; /* [NQPFull*Nsize*Nsize;] */
-  double *oldPfM;  /* [NQPFull] */
   int *projCntNew;
+  double *invM; /* [NQPFull*Nsize*Nsize] */
+  double *pfM;  /* [NQPFull] */
+  double *buffer;
+  double val=0.0;
 
+  RequestWorkSpaceInt(2*NProj);
+  RequestWorkSpaceDouble(NQPFull*(Nsize*Nsize+2)+4*Nsize);
+
+  projCntNew = GetWorkSpaceInt(2*NProj);
+  invM = GetWorkSpaceDouble(NQPFull*Nsize*Nsize);
+  pfM = GetWorkSpaceDouble(NQPFull);
+  buffer = GetWorkSpaceDouble(NQPFull+4*Nsize);
+
+  /* PfM and InvM of the hopped configuration are kept in pfM and invM */
+  calHCACAChain_real(ri,rj,rk,rl,si,sk,0.0,ip,eleIdx,eleCfg,eleNum,eleProjCnt,
+                     pfM,invM,projCntNew,buffer,&val);
+
+  ReleaseWorkSpaceInt();
+  ReleaseWorkSpaceDouble();
+  return val;
+}
+
+/// calHCACA_real for a copy of the configuration. The new PfM and InvM are given in pfM and invM.
+/// Returns 1 without val for <psi|CACA|x>/<psi|x>=0, which is left to calHCACA2_real.
+/// \param projCntNew [in] work array of 2*NProj
+/// \param buffer [in] work array of NQPFull+4*Nsize
+/// \param val [out] <psi| H C_is A_js C_kt A_lt |x>/<psi|x>
+/// \return 0 or 1
+/// \version 1.0
+int calHCACAChain_real(const int ri, const int rj, const int rk, const int rl,
+                       const int si,const int sk,
+                       const double h1, const double ip, int *eleIdx, int *eleCfg,
+                       int *eleNum, int *eleProjCnt, double *pfM, double *invM,
+                       int *projCntNew, double *buffer, double *val) {
   int rsi=ri+si*Nsite;
   int rsj=rj+si*Nsite;
   int rsk=rk+sk*Nsite;
   int rsl=rl+sk*Nsite;
-  int mj,ml;
+  int mj,ml,info;
   double ipNew,z,e;
 
-  RequestWorkSpaceInt(NProj);
-  RequestWorkSpaceDouble(NQPFull*(Nsize*Nsize+1));
-
-  projCntNew = GetWorkSpaceInt(NProj);
-  oldInvM = GetWorkSpaceDouble(NQPFull*Nsize*Nsize);
-  oldPfM  = GetWorkSpaceDouble(NQPFull);
-
-  /* copy InvM and PfM */
-  copyMAll_real(InvM_real,PfM_real,oldInvM,oldPfM);
+  /* check */
+  *val = 0.0;
+  if(rsk==rsl) {
+    if(eleNum[rsk]==1) {
+      return calHCAChain_real(ri,rj,si,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,
+                              pfM,invM,projCntNew,buffer,val);
+    } else return 0;
+  } else if(rsj==rsk) {
+    if(eleNum[rsj]==1) return 0;
+    else {
+      return calHCAChain_real(ri,rl,si,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,
+                              pfM,invM,projCntNew,buffer,val);
+    }
+  } else if(rsj==rsl) {
+    return 0;
+  } else if(rsi==rsj) {
+    if(eleNum[rsi]==1) {
+      return calHCAChain_real(rk,rl,sk,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,
+                              pfM,invM,projCntNew,buffer,val);
+    } else return 0;
+  } else if(rsi==rsk) {
+    return 0;
+  } else if(rsi==rsl) {
+    if(eleNum[rsi]==1) {
+      info = calHCAChain_real(rk,rj,sk,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt,
+                              pfM,invM,projCntNew,buffer,val);
+      *val = -(*val);
+      return info;
+    } else return 0;
+  } else {
+    if(eleNum[rsl]==0) return 0;
+    if(eleNum[rsk]==1) return 0;
+    if(eleNum[rsj]==0) return 0;
+    if(eleNum[rsi]==1) return 0;
+  }
 
   /* The ml-th electron with spin sk hops from rl to rk */
+  /* and the mj-th electron with spin si hops from rj to ri */
   ml = eleCfg[rsl];
+  mj = eleCfg[rsj];
   eleIdx[ml+sk*Ne] = rk;
+  eleIdx[mj+si*Ne] = ri;
+
+  /* same as checkGF2_real */
+  CalculateNewPfMTwoChain_real(ml, sk, mj, si, buffer, eleIdx, PfM_real, InvM_real, buffer+NQPFull);
+  if(fabs(CalculateIPChain_real(buffer)/ip)<=1.0e-12) {
+    eleIdx[mj+si*Ne] = rj;
+    eleIdx[ml+sk*Ne] = rl;
+    return 1;
+  }
+
   eleCfg[rsl] = -1;
   eleCfg[rsk] = ml;
   eleNum[rsl] = 0;
   eleNum[rsk] = 1;
   UpdateProjCnt(rl, rk, sk, projCntNew, eleProjCnt, eleNum);
 
-  /* The mj-th electron with spin si hops from rj to ri */
-  mj = eleCfg[rsj];
-  eleIdx[mj+si*Ne] = ri;
   eleCfg[rsj] = -1;
   eleCfg[rsi] = mj;
   eleNum[rsj] = 0;
@@ -578,10 +744,12 @@ double calHCACA1_real(const int ri, const int rj, const int rk, const int rl,
 
   z = ProjRatio(projCntNew,eleProjCnt);
 
-  UpdateMAllTwo_real(ml, sk, mj, si, rl, rj, eleIdx, 0, NQPFull);
-  ipNew = CalculateIP_real(PfM_real,0,NQPFull,MPI_COMM_SELF);
+  copyMAll_real(InvM_real,PfM_real,invM,pfM);
+  UpdateMAllTwoChain_real(ml, sk, mj, si, rl, rj, eleIdx, pfM, invM, buffer);
+  ipNew = CalculateIPChain_real(pfM);
 
-  e = CalculateHamiltonian_real(ipNew,eleIdx,eleCfg,eleNum,projCntNew);
+  e = CalculateHamiltonianChain_real(ipNew,eleIdx,eleCfg,eleNum,projCntNew,pfM,invM,
+                                     projCntNew+NProj,buffer);
 
   /* revert hopping */
   eleIdx[mj+si*Ne] = rj;
@@ -596,12 +764,8 @@ double calHCACA1_real(const int ri, const int rj, const int rk, const int rl,
   eleNum[rsl] = 1;
   eleNum[rsk] = 0;
 
-  /* restore InvM and PfM */
-  copyMAll_real(oldInvM,oldPfM,InvM_real,PfM_real);
-
-  ReleaseWorkSpaceInt();
-  ReleaseWorkSpaceDouble();
-  return e*z*ipNew/ip;
+  *val = e*z*ipNew/ip;
+  return 0;
 }
 
 /* calculate <psi| H C_is A_js C_kt A_lt|x>/<psi|x> for <psi|CACA|x>/<psi|x>=0 */
@@ -767,11 +931,11 @@ double calHCACA2_real(const int ri, const int rj, const int rk, const int rl,
 
 
 /* Calculate <psi|QCisAjs|x>/<psi|x> */
+/* The values of the hops are given by LSLocalQ_real for the same sample. */
 void LSLocalCisAjs_real(const double h1, const double ip, int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt) {
   const int nCisAjs=NCisAjs;
   double *lsLCisAjs_real = LSLCisAjs_real;
   double complex*localCisAjs = LocalCisAjs;
-  int ri,rj,s;
   int idx;
 
   /* copy local ICisAjs */
@@ -780,13 +944,9 @@ void LSLocalCisAjs_real(const double h1, const double ip, int *eleIdx, int *eleC
     lsLCisAjs_real[idx] = creal(localCisAjs[idx]);
   }
 
+  /* local HCisAjs */
   for(idx=0;idx<nCisAjs;idx++){
-    ri = CisAjsIdx[idx][0];
-    rj = CisAjsIdx[idx][2];
-    s  = CisAjsIdx[idx][3];
-
-    /* calculate local HCisAjs */
-    LSLCisAjs_real[idx+nCisAjs] = calHCA_real(ri,rj,s,h1,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+    lsLCisAjs_real[idx+nCisAjs] = LSHopVal_real[LSHopCisAjs[idx]];
   }
   return;
 }
@@ -363,7 +363,7 @@ int CalculateMAll_fcmp(const int *eleIdx, const int qpStart, const int qpEnd) {
       if(info!=0) continue;
 
       myInfo = calculateMAll_child_fcmp(eleIdx, qpStart, qpEnd, qpidx,
-          myBufM, myIWork, myWork, LapackLWork,myRWork);
+          myBufM, myIWork, myWork, LapackLWork,myRWork, PfM, InvM);
       if(myInfo!=0) {
 #pragma omp critical
         info=myInfo;
@@ -374,11 +374,13 @@ int CalculateMAll_fcmp(const int *eleIdx, const int qpStart, const int qpEnd) {
   ReleaseWorkSpaceThreadInt();
   ReleaseWorkSpaceThreadComplex();
   ReleaseWorkSpaceThreadDouble();
+  InvMDelayCount = 0; /* pending updates are discarded with the old InvM */
   return info;
 }
 
 int calculateMAll_child_fcmp(const int *eleIdx, const int qpStart, const int qpEnd, const int qpidx,
-    double complex *bufM, int *iwork, double complex *work, int lwork,double *rwork) {
+    double complex *bufM, int *iwork, double complex *work, int lwork,double *rwork,
+    double complex *pfM, double complex *invM) {
 #pragma procedure serial
   /* const int qpNum = qpEnd-qpStart; */
   int msi,msj;
@@ -391,10 +393,9 @@ int calculateMAll_child_fcmp(const int *eleIdx, const int qpStart, const int qpE
   /* optimization for Kei */
   const int nsize = Nsize;
 
-  const double complex *sltE = SlaterElm + (qpidx+qpStart)*Nsite2*Nsite2;
+  double complex *invM_q = invM + qpidx*Nsize*Nsize;
   const double complex *sltE_i;
-
-  double complex *invM = InvM + qpidx*Nsize*Nsize;
+  double complex sltRow[Nsite2];
   double complex *invM_i;
 
   double complex *bufM_i, *bufM_i2;
@@ -411,7 +412,7 @@ int calculateMAll_child_fcmp(const int *eleIdx, const int qpStart, const int qpE
   for(msi=0;msi<nsize;msi++) {
     rsi = eleIdx[msi] + (msi/Ne)*Nsite;
     bufM_i = bufM + msi*Nsize;
-    sltE_i = sltE + rsi*Nsite2;
+    sltE_i = SlaterElmRow_fcmp(qpidx+qpStart, rsi, sltRow);
 #pragma loop norecurrence
     for(msj=0;msj<nsize;msj++) {
       rsj = eleIdx[msj] + (msj/Ne)*Nsite;
@@ -426,7 +427,7 @@ int calculateMAll_child_fcmp(const int *eleIdx, const int qpStart, const int qpE
   /* Pfaffian/inverse computed separately. */
   /* Copy bufM to invM before using bufM to compute Pfaffian. */
   for(msi=0;msi<nsize*nsize;msi++)
-    invM[msi] = bufM[msi];
+    invM_q[msi] = bufM[msi];
 
   /* Calculate Pf M */
   M_ZSKPFA(&uplo, &mthd, &n, bufM, &lda, &pfaff, iwork, work, &lwork, rwork, &info);
@@ -434,26 +435,43 @@ int calculateMAll_child_fcmp(const int *eleIdx, const int qpStart, const int qpE
 
   if(info!=0) return info;
   if(!isfinite(creal(pfaff) + cimag(pfaff))) return qpidx+1;
-  PfM[qpidx] = pfaff;
+  pfM[qpidx] = pfaff;
 
 #ifdef _pfaffine
   /* inv(M) already stored in bufM.
    * Transpose (.* -1) to invM. */
   for(msi=0;msi<nsize*nsize;msi++)
-    invM[msi] = -bufM[msi];
+    invM_q[msi] = -bufM[msi];
 #else
   /* Calculate inverse. */
-  M_ZGETRF(&m, &n, invM, &lda, iwork, &info); /* ipiv = iwork */
-  M_ZGETRI(&n, invM, &lda, iwork, work, &lwork, &info);
+  M_ZGETRF(&m, &n, invM_q, &lda, iwork, &info); /* ipiv = iwork */
+  M_ZGETRI(&n, invM_q, &lda, iwork, work, &lwork, &info);
 
   /* mVMC's handling InvM as row-major,
    * i.e. InvM needs a transpose, InvM -> -InvM according antisymmetric properties. */
-  M_ZSCAL(&nsq, &minus_one, invM, &one);
+  M_ZSCAL(&nsq, &minus_one, invM_q, &one);
 #endif
 
   return info;
 }
 
+/* Calculate PfM and InvM of all QP indices for one Markov chain. */
+/* pfM and invM are owned by the chain and no thread is spawned. */
+/* bufM: Nsize*Nsize, iwork: Nsize, work, rwork: LapackLWork */
+int CalculateMAllChain_fcmp(const int *eleIdx, double complex *pfM, double complex *invM,
+                            double complex *bufM, int *iwork, double complex *work, double *rwork) {
+  int qpidx;
+  int info = 0;
+
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    info = calculateMAll_child_fcmp(eleIdx, 0, NQPFull, qpidx,
+                                    bufM, iwork, work, LapackLWork, rwork, pfM, invM);
+    if(info!=0) break;
+  }
+
+  return info;
+}
+
 int CalculateMAll_BF_fcmp(const int *eleIdx, const int qpStart, const int qpEnd) {
   const int qpNum = qpEnd-qpStart;
   int qpidx;
@@ -631,13 +649,14 @@ int CalculateMAll_real(const int *eleIdx, const int qpStart, const int qpEnd) {
 
   ReleaseWorkSpaceThreadInt();
   ReleaseWorkSpaceThreadDouble();
+  InvMDelayCount = 0; /* pending updates are discarded with the old InvM */
   return info;
 }
 
 //int calculateMAll_child_real(const int *eleIdx, const int qpStart, const int qpEnd, const int qpidx,
 //                        double *bufM, int *iwork, double *work, int lwork) {
 int calculateMAll_child_real(const int *eleIdx, const int qpStart, const int qpEnd, const int qpidx,
-    double *bufM, int *iwork, double *work, int lwork, double* PfM_real, double *InvM_real) {
+    double *bufM, int *iwork, double *work, int lwork, double* pfM_real, double *invM_real) {
 #pragma procedure serial
   /* const int qpNum = qpEnd-qpStart; */
   int msi,msj;
@@ -650,10 +669,9 @@ int calculateMAll_child_real(const int *eleIdx, const int qpStart, const int qpE
   /* optimization for Kei */
   const int nsize = Nsize;
 
-  const double *sltE = SlaterElm_real + (qpidx+qpStart)*Nsite2*Nsite2;
+  double *invM = invM_real + qpidx*Nsize*Nsize;
   const double *sltE_i;
-
-  double *invM = InvM_real + qpidx*Nsize*Nsize;
+  double sltRow[Nsite2];
   double *invM_i;
 
   double *bufM_i, *bufM_i2;
@@ -670,7 +688,7 @@ int calculateMAll_child_real(const int *eleIdx, const int qpStart, const int qpE
   for(msi=0;msi<nsize;msi++) {
     rsi = eleIdx[msi] + (msi/Ne)*Nsite;
     bufM_i = bufM + msi*Nsize;
-    sltE_i = sltE + rsi*Nsite2;
+    sltE_i = SlaterElmRow_real(qpidx+qpStart, rsi, sltRow);
 #pragma loop norecurrence
     for(msj=0;msj<nsize;msj++) {
       rsj = eleIdx[msj] + (msj/Ne)*Nsite;
@@ -693,7 +711,7 @@ int calculateMAll_child_real(const int *eleIdx, const int qpStart, const int qpE
 
   if(info!=0) return info;
   if(!isfinite(pfaff)) return qpidx+1;
-  PfM_real[qpidx] = pfaff;
+  pfM_real[qpidx] = pfaff;
 
 #ifdef _pfaffine
   /* inv(M) already stored in bufM.
@@ -712,6 +730,22 @@ int calculateMAll_child_real(const int *eleIdx, const int qpStart, const int qpE
   return info;
 }
 
+/* Calculate PfM_real and InvM_real of all QP indices for one Markov chain. */
+/* bufM: Nsize*Nsize, iwork: Nsize, work: LapackLWork */
+int CalculateMAllChain_real(const int *eleIdx, double *pfM_real, double *invM_real,
+                            double *bufM, int *iwork, double *work) {
+  int qpidx;
+  int info = 0;
+
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    info = calculateMAll_child_real(eleIdx, 0, NQPFull, qpidx,
+                                    bufM, iwork, work, LapackLWork, pfM_real, invM_real);
+    if(info!=0) break;
+  }
+
+  return info;
+}
+
 int CalculateMAll_BF_real(const int *eleIdx, const int qpStart, const int qpEnd){
   const int qpNum = qpEnd-qpStart;
   int qpidx;
@@ -45,8 +45,8 @@ void CalculateNewPfM(const int ma, const int s, double complex *pfMNew, const in
 
   int qpidx;
   int msj,rsj;
-  const double complex *sltE_a; /* update elements of msa-th row */
-  const double complex *invM_a;
+  const double complex *invM_a,*sltE_a;
+  double complex sltRow[Nsite2];
   double complex ratio;
 
   /* optimization for Kei */
@@ -55,8 +55,8 @@ void CalculateNewPfM(const int ma, const int s, double complex *pfMNew, const in
 
   #pragma loop noalias
   for(qpidx=0;qpidx<qpNum;qpidx++) {
-    sltE_a = SlaterElm + (qpidx+qpStart)*Nsite2*Nsite2 + rsa*Nsite2;
     invM_a = InvM + qpidx*Nsize*Nsize + msa*Nsize;
+    sltE_a = SlaterElmRow_fcmp(qpidx+qpStart, rsa, sltRow);
 
     ratio = 0.0;
     for(msj=0;msj<ne;msj++) {
@@ -83,8 +83,8 @@ void CalculateNewPfM2(const int ma, const int s, double complex *pfMNew, const i
 
   int qpidx;
   int msj,rsj;
-  const double complex *sltE_a; /* update elements of msa-th row */
-  const double complex *invM_a;
+  const double complex *invM_a,*sltE_a;
+  double complex sltRow[Nsite2];
   double complex ratio;
 
   /* optimization for Kei */
@@ -92,17 +92,16 @@ void CalculateNewPfM2(const int ma, const int s, double complex *pfMNew, const i
   const int ne = Ne;
 
   #pragma omp parallel for default(shared)        \
-    private(qpidx,msj,sltE_a,invM_a,ratio,rsj)
+    private(qpidx,msj,invM_a,sltE_a,sltRow,ratio,rsj)
   #pragma loop noalias
   for(qpidx=0;qpidx<qpNum;qpidx++) {
-    sltE_a = SlaterElm + (qpidx+qpStart)*Nsite2*Nsite2 + rsa*Nsite2;
     invM_a = InvM + qpidx*Nsize*Nsize + msa*Nsize;
+    sltE_a = SlaterElmRow_fcmp(qpidx+qpStart, rsa, sltRow);
 
     ratio = 0.0;
     for(msj=0;msj<ne;msj++) {
       rsj = eleIdx[msj];
       ratio += invM_a[msj] * sltE_a[rsj];
-      //printf("DEBUG:msj=%d rsj=%d: invM=%lf %lf : slt=%lf %lf \n",msj,rsj,creal(invM_a[msj]),cimag(invM_a[msj]),creal(sltE_a[rsj]),cimag(sltE_a[rsj]));
     }
     for(msj=ne;msj<nsize;msj++) {
       rsj = eleIdx[msj] + Nsite;
@@ -115,6 +114,43 @@ void CalculateNewPfM2(const int ma, const int s, double complex *pfMNew, const i
   return;
 }
 
+/* CalculateNewPfM for one Markov chain owning pfM and invM */
+void CalculateNewPfMChain(const int ma, const int s, double complex *pfMNew, const int *eleIdx,
+                          const double complex *pfM, const double complex *invM) {
+  const int msa = ma+s*Ne;
+  const int rsa = eleIdx[msa] + s*Nsite;
+
+  int qpidx;
+  int msj,rsj;
+  const double complex *invM_a,*sltE_a;
+  double complex sltRow[Nsite2];
+  double complex ratio;
+
+  /* optimization for Kei */
+  const int nsize = Nsize;
+  const int ne = Ne;
+
+  #pragma loop noalias
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    invM_a = invM + qpidx*Nsize*Nsize + msa*Nsize;
+    sltE_a = SlaterElmRow_fcmp(qpidx, rsa, sltRow);
+
+    ratio = 0.0;
+    for(msj=0;msj<ne;msj++) {
+      rsj = eleIdx[msj];
+      ratio += invM_a[msj] * sltE_a[rsj];
+    }
+    for(msj=ne;msj<nsize;msj++) {
+      rsj = eleIdx[msj] + Nsite;
+      ratio += invM_a[msj] * sltE_a[rsj];
+    }
+
+    pfMNew[qpidx] = -ratio*pfM[qpidx];
+  }
+
+  return;
+}
+
 /* Update PfM and InvM. The ma-th electron with spin s hops to site ra=eleIdx[msi] */
 void UpdateMAll(const int ma, const int s, const int *eleIdx,
                 const int qpStart, const int qpEnd) {
@@ -132,7 +168,7 @@ void UpdateMAll(const int ma, const int s, const int *eleIdx,
     #pragma omp for private(qpidx)
     #pragma loop nounroll
     for(qpidx=0;qpidx<qpNum;qpidx++) {
-      updateMAll_child(ma, s, eleIdx, qpStart, qpEnd, qpidx, vec1, vec2);
+      updateMAll_child(ma, s, eleIdx, qpStart, qpEnd, qpidx, vec1, vec2, PfM, InvM);
     }
   }
 
@@ -140,9 +176,25 @@ void UpdateMAll(const int ma, const int s, const int *eleIdx,
   return;
 }
 
+/* UpdateMAll for one Markov chain owning pfM and invM */
+/* buffer size = 2*Nsize */
+void UpdateMAllChain(const int ma, const int s, const int *eleIdx,
+                     double complex *pfM, double complex *invM, double complex *buffer) {
+  int qpidx;
+  double complex *vec1 = buffer;
+  double complex *vec2 = buffer + Nsize;
+
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    updateMAll_child(ma, s, eleIdx, 0, NQPFull, qpidx, vec1, vec2, pfM, invM);
+  }
+
+  return;
+}
+
 void updateMAll_child(const int ma, const int s, const int *eleIdx,
                       const int qpStart, const int qpEnd, const int qpidx,
-                      double complex *vec1, double complex *vec2) {
+                      double complex *vec1, double complex *vec2,
+                      double complex *pfM, double complex *invM) {
   #pragma procedure serial
   /* const int qpNum = qpEnd-qpStart; */
   const int msa = ma+s*Ne;
@@ -151,19 +203,19 @@ void updateMAll_child(const int ma, const int s, const int *eleIdx,
 
   int msi,msj,rsj;
 
-  const double complex *sltE_a; /* update elements of msa-th row */
   double complex sltE_aj;
-  double complex *invM;
+  const double complex *sltE_a;
+  double complex sltRow[Nsite2];
+  double complex *invM_q;
   double complex *invM_i,*invM_j,*invM_a;
 
   double complex vec1_i,vec2_i;
   double complex invVec1_a;
   double complex tmp;
 
-  sltE_a = SlaterElm + (qpidx+qpStart)*Nsite2*Nsite2 + rsa*Nsite2;
-
-  invM = InvM + qpidx*Nsize*Nsize;
-  invM_a = invM + msa*Nsize;
+  invM_q = invM + qpidx*Nsize*Nsize;
+  invM_a = invM_q + msa*Nsize;
+  sltE_a = SlaterElmRow_fcmp(qpidx+qpStart, rsa, sltRow);
 
   for(msi=0;msi<nsize;msi++) vec1[msi] = 0.0+0.0*I; //TBC
 
@@ -173,7 +225,7 @@ void updateMAll_child(const int ma, const int s, const int *eleIdx,
   for(msj=0;msj<nsize;msj++) {
     rsj = eleIdx[msj] + (msj/Ne)*Nsite;
     sltE_aj = sltE_a[rsj];
-    invM_j = invM + msj*Nsize;
+    invM_j = invM_q + msj*Nsize;
 
     for(msi=0;msi<nsize;msi++) {
       vec1[msi] += -invM_j[msi] * sltE_aj;
@@ -183,7 +235,7 @@ void updateMAll_child(const int ma, const int s, const int *eleIdx,
   /* Update Pfaffian */
   /* Calculate -1.0/bufV_a to reduce devision */
   tmp = vec1[msa];
-  PfM[qpidx] *= -tmp;
+  pfM[qpidx] *= -tmp;
   invVec1_a = -1.0/tmp;
 
   /* Calculate vec2[i] = -InvM[a][i]/vec1[a] */
@@ -195,7 +247,7 @@ void updateMAll_child(const int ma, const int s, const int *eleIdx,
   /* Update InvM */
   #pragma loop noalias
   for(msi=0;msi<nsize;msi++) {
-    invM_i = invM + msi*Nsize;
+    invM_i = invM_q + msi*Nsize;
     vec1_i = vec1[msi];
     vec2_i = vec2[msi];
 
@@ -215,6 +267,227 @@ void updateMAll_child(const int ma, const int s, const int *eleIdx,
   return;
 }
 
+/* Delayed update of InvM (NDelayUpdate>0) */
+/* InvM keeps the inverse at the last flush. The current inverse is */
+/*   InvM[i][j] + sum_l ( u_l[i] v_l[j] - v_l[i] u_l[j] ), */
+/* where InvMDelay[qpidx][i][2*l] = u_l[i], InvMDelay[qpidx][i][2*l+1] = v_l[i] */
+/* and l < InvMDelayCount. They are flushed into InvM every NDelayUpdate acceptance. */
+
+/* CalculateNewPfM2 with the pending updates of InvM */
+void CalculateNewPfMDelay(const int ma, const int s, double complex *pfMNew, const int *eleIdx,
+                          const int qpStart, const int qpEnd) {
+  const int qpNum = qpEnd-qpStart;
+  const int msa = ma+s*Ne;
+  const int rsa = eleIdx[msa] + s*Nsite;
+  const int nDelay = InvMDelayCount;
+  const int ld = 2*NDelayUpdate;
+
+  int qpidx,l;
+  int msj,rsj;
+  const double complex *invM_a,*sltE_a;
+  const double complex *delay,*delay_a,*delay_j;
+  double complex sltRow[Nsite2];
+  double complex ratio,invM_aj;
+
+  /* optimization for Kei */
+  const int nsize = Nsize;
+
+  #pragma omp parallel for default(shared)        \
+    private(qpidx,l,msj,rsj,invM_a,sltE_a,sltRow,delay,delay_a,delay_j,ratio,invM_aj)
+  #pragma loop noalias
+  for(qpidx=0;qpidx<qpNum;qpidx++) {
+    invM_a = InvM + qpidx*Nsize*Nsize + msa*Nsize;
+    sltE_a = SlaterElmRow_fcmp(qpidx+qpStart, rsa, sltRow);
+    delay = InvMDelay + qpidx*Nsize*ld;
+    delay_a = delay + msa*ld;
+
+    ratio = 0.0;
+    for(msj=0;msj<nsize;msj++) {
+      rsj = eleIdx[msj] + (msj/Ne)*Nsite;
+      delay_j = delay + msj*ld;
+      invM_aj = invM_a[msj];
+      for(l=0;l<nDelay;l++) {
+        invM_aj += delay_a[2*l]*delay_j[2*l+1] - delay_a[2*l+1]*delay_j[2*l];
+      }
+      ratio += invM_aj * sltE_a[rsj];
+    }
+
+    pfMNew[qpidx] = -ratio*PfM[qpidx];
+  }
+
+  return;
+}
+
+/* UpdateMAll storing the rank-2 update into InvMDelay */
+void UpdateMAllDelay(const int ma, const int s, const int *eleIdx,
+                     const int qpStart, const int qpEnd) {
+  const int qpNum = qpEnd-qpStart;
+  const int nDelay = InvMDelayCount;
+  int qpidx;
+  double complex *vec1,*work;
+
+  RequestWorkSpaceThreadComplex(Nsize+2*NDelayUpdate*Nsize);
+
+  #pragma omp parallel default(shared) private(vec1,work)
+  {
+    vec1 = GetWorkSpaceThreadComplex(Nsize);
+    work = GetWorkSpaceThreadComplex(2*NDelayUpdate*Nsize);
+
+    #pragma omp for private(qpidx)
+    #pragma loop nounroll
+    for(qpidx=0;qpidx<qpNum;qpidx++) {
+      updateMAllDelay_child(ma, s, eleIdx, qpStart, qpEnd, qpidx, nDelay, vec1, work);
+      if(nDelay+1==NDelayUpdate) flushMAllDelay_child(qpidx, nDelay+1, work);
+    }
+  }
+
+  ReleaseWorkSpaceThreadComplex();
+
+  InvMDelayCount = (nDelay+1==NDelayUpdate) ? 0 : nDelay+1;
+  return;
+}
+
+void updateMAllDelay_child(const int ma, const int s, const int *eleIdx,
+                           const int qpStart, const int qpEnd, const int qpidx,
+                           const int nDelay, double complex *vec1, double complex *work) {
+  #pragma procedure serial
+  const int msa = ma+s*Ne;
+  const int rsa = eleIdx[msa] + s*Nsite;
+  const int nsize = Nsize; /* optimization for Kei */
+  const int ld = 2*NDelayUpdate;
+
+  int msi,msj,rsj,l;
+
+  double complex sltE_aj;
+  const double complex *sltE_a;
+  double complex sltRow[Nsite2];
+  double complex *invM;
+  double complex *invM_j,*invM_a;
+  double complex *delay,*delay_i,*delay_a;
+  double complex *delayX; /* delayX[2*l] = u_l.x, delayX[2*l+1] = v_l.x */
+
+  double complex invVec1_a;
+  double complex tmp;
+
+  invM = InvM + qpidx*Nsize*Nsize;
+  invM_a = invM + msa*Nsize;
+  sltE_a = SlaterElmRow_fcmp(qpidx+qpStart, rsa, sltRow);
+  delay = InvMDelay + qpidx*Nsize*ld;
+  delay_a = delay + msa*ld;
+  delayX = work;
+
+  for(msi=0;msi<nsize;msi++) vec1[msi] = 0.0;
+  for(l=0;l<2*nDelay;l++) delayX[l] = 0.0;
+
+  /* Calculate vec1[i] = sum_j invM[i][j] sltE[a][j] with the current invM */
+  #pragma loop noalias
+  for(msj=0;msj<nsize;msj++) {
+    rsj = eleIdx[msj] + (msj/Ne)*Nsite;
+    sltE_aj = sltE_a[rsj];
+    invM_j = invM + msj*Nsize;
+
+    for(msi=0;msi<nsize;msi++) {
+      vec1[msi] += -invM_j[msi] * sltE_aj;
+    }
+    for(l=0;l<2*nDelay;l++) {
+      delayX[l] += delay[msj*ld+l] * sltE_aj;
+    }
+  }
+  #pragma loop noalias
+  for(msi=0;msi<nsize;msi++) {
+    delay_i = delay + msi*ld;
+    for(l=0;l<nDelay;l++) {
+      vec1[msi] += delay_i[2*l]*delayX[2*l+1] - delay_i[2*l+1]*delayX[2*l];
+    }
+  }
+
+  /* Update Pfaffian */
+  tmp = vec1[msa];
+  PfM[qpidx] *= -tmp;
+  invVec1_a = -1.0/tmp;
+
+  /* v[i] = -InvM[a][i]/vec1[a] with the current invM */
+  #pragma loop noalias
+  for(msi=0;msi<nsize;msi++) {
+    delay_i = delay + msi*ld;
+    tmp = invM_a[msi];
+    for(l=0;l<nDelay;l++) {
+      tmp += delay_a[2*l]*delay_i[2*l+1] - delay_a[2*l+1]*delay_i[2*l];
+    }
+    delay_i[2*nDelay+1] = tmp * invVec1_a;
+  }
+
+  /* u[i] = vec1[i] + delta_{ia} */
+  /* invM[i][j] += u[i] v[j] - v[i] u[j] gives the same update as updateMAll_child */
+  #pragma loop noalias
+  for(msi=0;msi<nsize;msi++) {
+    delay[msi*ld+2*nDelay] = vec1[msi];
+  }
+  delay_a[2*nDelay] += 1.0;
+
+  return;
+}
+
+/* Flush the pending updates into InvM by one ZGEMM */
+/* work size = 2*NDelayUpdate*Nsize */
+void flushMAllDelay_child(const int qpidx, const int nDelay, double complex *work) {
+  #pragma procedure serial
+  const int ld = 2*NDelayUpdate;
+  const double complex *delay = InvMDelay + qpidx*Nsize*ld;
+  double complex *invM = InvM + qpidx*Nsize*Nsize;
+  double complex *delayW = work; /* delayW[i][2*l] = v_l[i], delayW[i][2*l+1] = -u_l[i] */
+
+  char transA='T', transB='N';
+  int m,n,k,lda;
+  double complex alpha=-1.0, beta=1.0;
+  int msi,l;
+
+  if(nDelay==0) return;
+
+  for(msi=0;msi<Nsize;msi++) {
+    for(l=0;l<nDelay;l++) {
+      delayW[msi*ld+2*l]   =  delay[msi*ld+2*l+1];
+      delayW[msi*ld+2*l+1] = -delay[msi*ld+2*l];
+    }
+  }
+
+  /* InvM is row-major and seen as its transpose -InvM by ZGEMM. */
+  /* -InvM -= U W^T, i.e., InvM[i][j] += sum_l u_l[i] v_l[j] - v_l[i] u_l[j] */
+  m = n = Nsize;
+  k = 2*nDelay;
+  lda = ld;
+  M_ZGEMM(&transA, &transB, &m, &n, &k, &alpha, delay, &lda, delayW, &lda, &beta, invM, &m);
+
+  return;
+}
+
+/* Flush all the pending updates of InvM */
+void FlushMAllDelay(const int qpStart, const int qpEnd) {
+  const int qpNum = qpEnd-qpStart;
+  const int nDelay = InvMDelayCount;
+  int qpidx;
+  double complex *work;
+
+  if(nDelay==0) return;
+
+  RequestWorkSpaceThreadComplex(2*NDelayUpdate*Nsize);
+
+  #pragma omp parallel default(shared) private(work)
+  {
+    work = GetWorkSpaceThreadComplex(2*NDelayUpdate*Nsize);
+
+    #pragma omp for private(qpidx)
+    for(qpidx=0;qpidx<qpNum;qpidx++) {
+      flushMAllDelay_child(qpidx, nDelay, work);
+    }
+  }
+
+  ReleaseWorkSpaceThreadComplex();
+
+  InvMDelayCount = 0;
+  return;
+}
+
 
 /* Calculate new pfaffian with Backflow effects.
    The ma-th electron with spin s hops from ra to rb */
@@ -222,24 +495,15 @@ void CalculateNewPfMBF(const int *icount, const int *msaTmp,
                        double complex* pfMNew, const int *eleIdx,
                        const int qpStart, const int qpEnd, const double complex* bufM) {
   //#pragma procedure serial
-  int i;
   const int qpNum = qpEnd-qpStart;
   int qpidx;
-  int *msa;
+  const int *msa;
 
   for(qpidx=0;qpidx<qpNum;qpidx++) {
-    //Store msa//
-    msa=(int *)malloc(sizeof(int)*icount[qpidx]);
-    //printf("Total=%d\n",icount[qpidx]);
-    for(i=0;i<icount[qpidx];i++){
-      msa[i] = msaTmp[i+qpidx*Nsite];
-      //printf("hop[%d]=%d\n",i,msa[i]);
-    }
+    msa = msaTmp + qpidx*Nsite;
 
     /* calculateNewPfM */
     pfMNew[qpidx] = calculateNewPfMBFN4_child(qpidx,icount[qpidx],msa,eleIdx,bufM);
-
-    free(msa);
   }
 
   return;
@@ -253,19 +517,24 @@ double complex calculateNewPfMBFN4_child(const int qpidx, const int n, const int
   const double complex *sltE;
   const double complex *sltE_k;
   double complex *invM;
-  double complex *invM_i, *invM_k, *invM_l;
+  double complex *invM_k, *invM_l;
 
   double complex *vec; /* vec[n][nsize] */
   //double complex vec[n*nsize]; /* vec[n][nsize] */
-  double complex *vec_k, *vec_l;
+  double complex *vec_k;
   //double complex mat[n2*n2]; /* mat[n2][n2] */
   double complex *mat; /* mat[n2][n2] */
   double complex *mat_k;
   //double complex matUV[n2*nsize]; /* mat[n2][nsize] */
   double sgn;
 
-  int rsi,rsk,msi,msj,k,l;
-  double complex val,tmp;
+  double complex *invMVec; /* invMVec[n][nsize] */
+  double complex *matX; /* matX[n][n] */
+
+  int rsi,rsk,msi,k,l;
+  double complex val;
+  double complex one=1.0, zero=0.0;
+  char transN='N', transT='T';
 
   /* for ZSKPFA */
   char uplo='U', mthd='P';
@@ -282,10 +551,12 @@ double complex calculateNewPfMBFN4_child(const int qpidx, const int n, const int
   invM = InvM + qpidx*Nsize*Nsize;
 
   vec = (double complex*)malloc(sizeof(double complex)*n*nsize);
+  invMVec = (double complex*)malloc(sizeof(double complex)*n*nsize);
   //invMat = (double *)malloc(sizeof(double)*n2*n2);
   mat = (double complex*)malloc(sizeof(double complex)*n2*n2);
   //matUV = (double *)malloc(sizeof(double)*n2*nsize);
   work = (double complex*)malloc(sizeof(double complex)*n2*n2);
+  matX = work; /* work is used by SKPFA only after X_kl is built */
 
   //#pragma loop noalias
   for(k=0;k<n;k++) {
@@ -299,22 +570,19 @@ double complex calculateNewPfMBFN4_child(const int qpidx, const int n, const int
     }
   }
 
+  /* invMVec[l][msi] = sum_msj invM[msi][msj] * vec[l][msj] */
+  M_ZGEMM(&transT, &transN, &nsize, &n, &nsize, &one, invM, &nsize,
+          vec, &nsize, &zero, invMVec, &nsize);
+  /* matX[l][k] = sum_msi vec[k][msi] * invMVec[l][msi] */
+  M_ZGEMM(&transT, &transN, &n, &n, &nsize, &one, vec, &nsize,
+          invMVec, &nsize, &zero, matX, &n);
+
   /* X_kl */
   for(k=0;k<n;k++) {
     mat_k = mat + n2*k;
     vec_k = vec + k*nsize;
     for(l=k+1;l<n;l++) {
-      vec_l = vec + l*nsize;
-      val = 0.0;
-      for(msi=0;msi<nsize;msi++) {
-        invM_i = invM + msi*nsize;
-        tmp = 0.0;
-        for(msj=0;msj<nsize;msj++) {
-          tmp += invM_i[msj] * vec_l[msj];
-        }
-        val += tmp * vec_k[msi];
-      }
-      mat_k[l] = val + vec_k[msa[l]];
+      mat_k[l] = matX[k+n*l] + vec_k[msa[l]];
     }
   }
 
@@ -365,6 +633,7 @@ double complex calculateNewPfMBFN4_child(const int qpidx, const int n, const int
   //free(matUV);
   free(mat);
   free(vec);
+  free(invMVec);
   //free(invMat);
   free(work);
   return sgn * pfaff * PfM[qpidx];
@@ -379,22 +648,15 @@ void UpdateMAll_BF_fcmp(const int *icount, const int *msaTmp,
   int qpidx;
   //double complex *sltE;
   //double complex *sltE_i;
-  int *msa;
-  int i;
+  const int *msa;
   //int *hop;
   //double complex diff;
 
   for(qpidx=0;qpidx<qpNum;qpidx++) {
-    //Store msa//
-    msa=(int *)malloc(sizeof(int)*icount[qpidx]);
-    for(i=0;i<icount[qpidx];i++){
-      msa[i] = msaTmp[i+qpidx*Nsite];
-    }
+    msa = msaTmp + qpidx*Nsite;
 
     /* calculateNewPfM */
     pfMNew[qpidx] = updateMAll_BF_fcmp_child(qpidx,icount[qpidx],msa,eleIdx);
-
-    free(msa);
   }
 
   return;
@@ -416,7 +678,7 @@ double complex updateMAll_BF_fcmp_child(
   double complex *invM_i, *invM_k, *invM_l;
 
   double complex*vec; /* vec[n][nsize] */
-  double complex*vec_k, *vec_l;
+  double complex*vec_k;
   //double complex mat[n2*n2]; /* mat[n2][n2] */
   double complex*mat; /* mat[n2][n2] */
   double complex*mat_k;
@@ -424,11 +686,17 @@ double complex updateMAll_BF_fcmp_child(
   double complex*invMat; /* mat[n2][n2] */
   //double complex matUV[n2*nsize]; /* mat[n2][nsize] */
   double complex*matUV; /* mat[n2][nsize] */
-  double complex*invMat_k, *matUV_i, *matUV_j;
+  double complex*matUV_i;
   double complex sgn;
 
+  double complex *invMVec; /* invMVec[n][nsize] */
+  double complex *matX; /* matX[n][n] */
+  double complex *matUVInv; /* matUVInv[nsize][n2] */
+
   int rsi,rsk,msi,msj,k,l;
-  double complex val,tmp;
+  double complex val;
+  double complex one=1.0, zero=0.0, mone=-1.0;
+  char transN='N', transT='T';
 
   /* for DSKPFA */
   char uplo='U', mthd='P';
@@ -449,10 +717,13 @@ double complex updateMAll_BF_fcmp_child(
 
   //vec = bufferc; /* n*nsize */
   vec = (double complex*)malloc(sizeof(double complex)*n*nsize);
+  invMVec = (double complex*)malloc(sizeof(double complex)*n*nsize);
+  matUVInv = (double complex*)malloc(sizeof(double complex)*n2*nsize);
   invMat = (double complex*)malloc(sizeof(double complex)*n2*n2);
   mat = (double complex*)malloc(sizeof(double complex)*n2*n2);
   matUV = (double complex*)malloc(sizeof(double complex)*n2*nsize);
   work = (double complex*)malloc(sizeof(double complex)*n2*n2);
+  matX = work; /* work is used by SKPFA only after X_kl is built */
   work2 = (double complex*)malloc(sizeof(double complex)*n2);
 
 #pragma loop noalias
@@ -467,22 +738,19 @@ double complex updateMAll_BF_fcmp_child(
     }
   }
 
+  /* invMVec[l][msi] = sum_msj invM[msi][msj] * vec[l][msj] */
+  M_ZGEMM(&transT, &transN, &nsize, &n, &nsize, &one, invM, &nsize,
+          vec, &nsize, &zero, invMVec, &nsize);
+  /* matX[l][k] = sum_msi vec[k][msi] * invMVec[l][msi] */
+  M_ZGEMM(&transT, &transN, &n, &n, &nsize, &one, vec, &nsize,
+          invMVec, &nsize, &zero, matX, &n);
+
   /* X_kl */
   for(k=0;k<n;k++) {
     mat_k = mat + n2*k;
     vec_k = vec + k*nsize;
     for(l=k+1;l<n;l++) {
-      vec_l = vec + l*nsize;
-      val = 0.0;
-      for(msi=0;msi<nsize;msi++) {
-        invM_i = invM + msi*nsize;
-        tmp = 0.0;
-        for(msj=0;msj<nsize;msj++) {
-          tmp += invM_i[msj] * vec_l[msj];
-        }
-        val += tmp * vec_k[msi];
-      }
-      mat_k[l] = val + vec_k[msa[l]];
+      mat_k[l] = matX[k+n*l] + vec_k[msa[l]];
     }
   }
 
@@ -531,11 +799,7 @@ double complex updateMAll_BF_fcmp_child(
     matUV_i = matUV + n2*msi;
     invM_i = invM + msi*nsize;
     for(k=0;k<n;k++) {
-      vec_k = vec + k*nsize;
-      val = 0.0;
-      for(msj=0;msj<nsize;msj++) {
-        val -= invM_i[msj] * vec_k[msj];
-      }
+      val = -invMVec[msi+k*nsize];
       if(msa[k]==msi){val -= 1.0;}
       matUV_i[k] = val;
       matUV_i[k+n] = invM_i[msa[k]];
@@ -557,38 +821,25 @@ double complex updateMAll_BF_fcmp_child(
     //return;
   }
 
-  for(msi=0;msi<nsize;msi++) {
-    matUV_i = matUV + n2*msi;
-    invM_i = invM + msi*nsize;
-    for(msj=0;msj<nsize;msj++) {
-      matUV_j = matUV + n2*msj;
-      val = 0.0;
-      for(k=0;k<n2;k++) {
-        invMat_k = invMat + k*n2;
-        tmp=0.0;
-        for(l=0;l<n2;l++) {
-          tmp += invMat_k[l]*matUV_j[l];
-        }
-        val += matUV_i[k]*tmp;
-      }
-      invM_i[msj] -= val;
-    }
-  }
+  /* invM[msi][msj] -= sum_kl matUV[msi][k] * invMat[k][l] * matUV[msj][l] */
+  M_ZGEMM(&transN, &transN, &n2, &nsize, &n2, &one, invMat, &n2,
+          matUV, &n2, &zero, matUVInv, &n2);
+  M_ZGEMM(&transT, &transN, &nsize, &nsize, &n2, &mone, matUV, &n2,
+          matUVInv, &n2, &one, invM, &nsize);
 
   for(msi=0;msi<Ne;msi++) {
-    //invM_i = invM + msi*nsize;
     for(msj=Ne;msj<Nsize;msj++) {
-      InvM[msj*nsize+msi] = -InvM[msi*nsize+msj];
+      invM[msj*nsize+msi] = -invM[msi*nsize+msj];
     }
   }
   for(msi=Ne;msi<Nsize;msi++) {
     for(msj=Ne;msj<Nsize;msj++) {
-      InvM[msi*nsize+msj] = 0.0;
+      invM[msi*nsize+msj] = 0.0;
     }
   }
   for(msi=0;msi<Ne;msi++) {
     for(msj=0;msj<Ne;msj++) {
-      InvM[msi*nsize+msj] = 0.0;
+      invM[msi*nsize+msj] = 0.0;
     }
   }
 
@@ -607,6 +858,8 @@ double complex updateMAll_BF_fcmp_child(
   free(matUV);
   free(mat);
   free(vec);
+  free(invMVec);
+  free(matUVInv);
   free(invMat);
   free(work);
   free(work2);
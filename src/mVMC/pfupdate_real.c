@@ -32,7 +32,7 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 
 void updateMAll_child_real(const int ma, const int s, const int *eleIdx,
                       const int qpStart, const int qpEnd, const int qpidx,
-                      double *vec1, double *vec2);
+                      double *vec1, double *vec2, double *pfM_real, double *invM_real);
 
 double calculateNewPfMBFN4_real_child(const int qpidx, const int n, const int *msa,
                                  const int *eleIdx, const double *bufM);
@@ -50,8 +50,8 @@ void CalculateNewPfM_real(const int ma, const int s, double *pfMNew_real, const
 
   int qpidx;
   int msj,rsj;
-  const double *sltE_a; /* update elements of msa-th row */
-  const double *invM_a;
+  const double *invM_a,*sltE_a;
+  double sltRow[Nsite2];
   double ratio;
 
   /* optimization for Kei */
@@ -60,8 +60,8 @@ void CalculateNewPfM_real(const int ma, const int s, double *pfMNew_real, const
 
   #pragma loop noalias
   for(qpidx=0;qpidx<qpNum;qpidx++) {
-    sltE_a = SlaterElm_real + (qpidx+qpStart)*Nsite2*Nsite2 + rsa*Nsite2;
     invM_a = InvM_real + qpidx*Nsize*Nsize + msa*Nsize;
+    sltE_a = SlaterElmRow_real(qpidx+qpStart, rsa, sltRow);
 
     ratio = 0.0;
     for(msj=0;msj<ne;msj++) {
@@ -88,8 +88,8 @@ void CalculateNewPfM2_real(const int ma, const int s, double *pfMNew_real, const
 
   int qpidx;
   int msj,rsj;
-  const double *sltE_a; /* update elements of msa-th row */
-  const double *invM_a;
+  const double *invM_a,*sltE_a;
+  double sltRow[Nsite2];
   double ratio;
 
   /* optimization for Kei */
@@ -97,11 +97,11 @@ void CalculateNewPfM2_real(const int ma, const int s, double *pfMNew_real, const
   const int ne = Ne;
 
   #pragma omp parallel for default(shared)        \
-    private(qpidx,msj,sltE_a,invM_a,ratio,rsj)
+    private(qpidx,msj,invM_a,sltE_a,sltRow,ratio,rsj)
   #pragma loop noalias
   for(qpidx=0;qpidx<qpNum;qpidx++) {
-    sltE_a = SlaterElm_real + (qpidx+qpStart)*Nsite2*Nsite2 + rsa*Nsite2;
     invM_a = InvM_real + qpidx*Nsize*Nsize + msa*Nsize;
+    sltE_a = SlaterElmRow_real(qpidx+qpStart, rsa, sltRow);
 
     ratio = 0.0;
     for(msj=0;msj<ne;msj++) {
@@ -119,6 +119,43 @@ void CalculateNewPfM2_real(const int ma, const int s, double *pfMNew_real, const
   return;
 }
 
+/* CalculateNewPfM_real for one Markov chain owning pfM_real and invM_real */
+void CalculateNewPfMChain_real(const int ma, const int s, double *pfMNew_real, const int *eleIdx,
+                               const double *pfM_real, const double *invM_real) {
+  const int msa = ma+s*Ne;
+  const int rsa = eleIdx[msa] + s*Nsite;
+
+  int qpidx;
+  int msj,rsj;
+  const double *invM_a,*sltE_a;
+  double sltRow[Nsite2];
+  double ratio;
+
+  /* optimization for Kei */
+  const int nsize = Nsize;
+  const int ne = Ne;
+
+  #pragma loop noalias
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    invM_a = invM_real + qpidx*Nsize*Nsize + msa*Nsize;
+    sltE_a = SlaterElmRow_real(qpidx, rsa, sltRow);
+
+    ratio = 0.0;
+    for(msj=0;msj<ne;msj++) {
+      rsj = eleIdx[msj];
+      ratio += invM_a[msj] * sltE_a[rsj];
+    }
+    for(msj=ne;msj<nsize;msj++) {
+      rsj = eleIdx[msj] + Nsite;
+      ratio += invM_a[msj] * sltE_a[rsj];
+    }
+
+    pfMNew_real[qpidx] = -ratio*pfM_real[qpidx];
+  }
+
+  return;
+}
+
 /* Update PfM_real and InvM_real. The ma-th electron with spin s hops to site ra=eleIdx[msi] */
 void UpdateMAll_real(const int ma, const int s, const int *eleIdx,
                 const int qpStart, const int qpEnd) {
@@ -136,7 +173,7 @@ void UpdateMAll_real(const int ma, const int s, const int *eleIdx,
     #pragma omp for private(qpidx)
     #pragma loop nounroll
     for(qpidx=0;qpidx<qpNum;qpidx++) {
-      updateMAll_child_real(ma, s, eleIdx, qpStart, qpEnd, qpidx, vec1, vec2);
+      updateMAll_child_real(ma, s, eleIdx, qpStart, qpEnd, qpidx, vec1, vec2, PfM_real, InvM_real);
     }
   }
 
@@ -144,9 +181,24 @@ void UpdateMAll_real(const int ma, const int s, const int *eleIdx,
   return;
 }
 
+/* UpdateMAll_real for one Markov chain owning pfM_real and invM_real */
+/* buffer size = 2*Nsize */
+void UpdateMAllChain_real(const int ma, const int s, const int *eleIdx,
+                          double *pfM_real, double *invM_real, double *buffer) {
+  int qpidx;
+  double *vec1 = buffer;
+  double *vec2 = buffer + Nsize;
+
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    updateMAll_child_real(ma, s, eleIdx, 0, NQPFull, qpidx, vec1, vec2, pfM_real, invM_real);
+  }
+
+  return;
+}
+
 void updateMAll_child_real(const int ma, const int s, const int *eleIdx,
                       const int qpStart, const int qpEnd, const int qpidx,
-                      double *vec1, double *vec2) {
+                      double *vec1, double *vec2, double *pfM_real, double *invM_real) {
   #pragma procedure serial
   /* const int qpNum = qpEnd-qpStart; */
   const int msa = ma+s*Ne;
@@ -155,8 +207,9 @@ void updateMAll_child_real(const int ma, const int s, const int *eleIdx,
 
   int msi,msj,rsj;
 
-  const double *sltE_a; /* update elements of msa-th row */
   double sltE_aj;
+  const double *sltE_a;
+  double sltRow[Nsite2];
   double *invM;
   double *invM_i,*invM_j,*invM_a;
 
@@ -164,10 +217,9 @@ void updateMAll_child_real(const int ma, const int s, const int *eleIdx,
   double invVec1_a;
   double tmp;
 
-  sltE_a = SlaterElm_real + (qpidx+qpStart)*Nsite2*Nsite2 + rsa*Nsite2;
-
-  invM = InvM_real + qpidx*Nsize*Nsize;
+  invM = invM_real + qpidx*Nsize*Nsize;
   invM_a = invM + msa*Nsize;
+  sltE_a = SlaterElmRow_real(qpidx+qpStart, rsa, sltRow);
 
   for(msi=0;msi<nsize;msi++) vec1[msi] = 0.0;
 
@@ -187,7 +239,7 @@ void updateMAll_child_real(const int ma, const int s, const int *eleIdx,
   /* Update Pfaffian */
   /* Calculate -1.0/bufV_a to reduce devision */
   tmp = vec1[msa];
-  PfM_real[qpidx] *= -tmp;
+  pfM_real[qpidx] *= -tmp;
   invVec1_a = -1.0/tmp;
 
   /* Calculate vec2[i] = -InvM[a][i]/vec1[a] */
@@ -219,35 +271,244 @@ void updateMAll_child_real(const int ma, const int s, const int *eleIdx,
   return;
 }
 
+/* Delayed update of InvM_real (NDelayUpdate>0). See UpdateMAllDelay in pfupdate.c */
+/* InvMDelay_real[qpidx][i][2*l] = u_l[i], InvMDelay_real[qpidx][i][2*l+1] = v_l[i] */
+
+/* CalculateNewPfM2_real with the pending updates of InvM */
+void CalculateNewPfMDelay_real(const int ma, const int s, double *pfMNew_real, const int *eleIdx,
+                          const int qpStart, const int qpEnd) {
+  const int qpNum = qpEnd-qpStart;
+  const int msa = ma+s*Ne;
+  const int rsa = eleIdx[msa] + s*Nsite;
+  const int nDelay = InvMDelayCount;
+  const int ld = 2*NDelayUpdate;
+
+  int qpidx,l;
+  int msj,rsj;
+  const double *invM_a,*sltE_a;
+  const double *delay,*delay_a,*delay_j;
+  double sltRow[Nsite2];
+  double ratio,invM_aj;
+
+  /* optimization for Kei */
+  const int nsize = Nsize;
+
+  #pragma omp parallel for default(shared)        \
+    private(qpidx,l,msj,rsj,invM_a,sltE_a,sltRow,delay,delay_a,delay_j,ratio,invM_aj)
+  #pragma loop noalias
+  for(qpidx=0;qpidx<qpNum;qpidx++) {
+    invM_a = InvM_real + qpidx*Nsize*Nsize + msa*Nsize;
+    sltE_a = SlaterElmRow_real(qpidx+qpStart, rsa, sltRow);
+    delay = InvMDelay_real + qpidx*Nsize*ld;
+    delay_a = delay + msa*ld;
+
+    ratio = 0.0;
+    for(msj=0;msj<nsize;msj++) {
+      rsj = eleIdx[msj] + (msj/Ne)*Nsite;
+      delay_j = delay + msj*ld;
+      invM_aj = invM_a[msj];
+      for(l=0;l<nDelay;l++) {
+        invM_aj += delay_a[2*l]*delay_j[2*l+1] - delay_a[2*l+1]*delay_j[2*l];
+      }
+      ratio += invM_aj * sltE_a[rsj];
+    }
+
+    pfMNew_real[qpidx] = -ratio*PfM_real[qpidx];
+  }
+
+  return;
+}
+
+/* UpdateMAll storing the rank-2 update into InvMDelay_real */
+void UpdateMAllDelay_real(const int ma, const int s, const int *eleIdx,
+                     const int qpStart, const int qpEnd) {
+  const int qpNum = qpEnd-qpStart;
+  const int nDelay = InvMDelayCount;
+  int qpidx;
+  double *vec1,*work;
+
+  RequestWorkSpaceThreadDouble(Nsize+2*NDelayUpdate*Nsize);
+
+  #pragma omp parallel default(shared) private(vec1,work)
+  {
+    vec1 = GetWorkSpaceThreadDouble(Nsize);
+    work = GetWorkSpaceThreadDouble(2*NDelayUpdate*Nsize);
+
+    #pragma omp for private(qpidx)
+    #pragma loop nounroll
+    for(qpidx=0;qpidx<qpNum;qpidx++) {
+      updateMAllDelay_child_real(ma, s, eleIdx, qpStart, qpEnd, qpidx, nDelay, vec1, work);
+      if(nDelay+1==NDelayUpdate) flushMAllDelay_child_real(qpidx, nDelay+1, work);
+    }
+  }
+
+  ReleaseWorkSpaceThreadDouble();
+
+  InvMDelayCount = (nDelay+1==NDelayUpdate) ? 0 : nDelay+1;
+  return;
+}
+
+void updateMAllDelay_child_real(const int ma, const int s, const int *eleIdx,
+                           const int qpStart, const int qpEnd, const int qpidx,
+                           const int nDelay, double *vec1, double *work) {
+  #pragma procedure serial
+  const int msa = ma+s*Ne;
+  const int rsa = eleIdx[msa] + s*Nsite;
+  const int nsize = Nsize; /* optimization for Kei */
+  const int ld = 2*NDelayUpdate;
+
+  int msi,msj,rsj,l;
+
+  double sltE_aj;
+  const double *sltE_a;
+  double sltRow[Nsite2];
+  double *invM;
+  double *invM_j,*invM_a;
+  double *delay,*delay_i,*delay_a;
+  double *delayX; /* delayX[2*l] = u_l.x, delayX[2*l+1] = v_l.x */
+
+  double invVec1_a;
+  double tmp;
+
+  invM = InvM_real + qpidx*Nsize*Nsize;
+  invM_a = invM + msa*Nsize;
+  sltE_a = SlaterElmRow_real(qpidx+qpStart, rsa, sltRow);
+  delay = InvMDelay_real + qpidx*Nsize*ld;
+  delay_a = delay + msa*ld;
+  delayX = work;
+
+  for(msi=0;msi<nsize;msi++) vec1[msi] = 0.0;
+  for(l=0;l<2*nDelay;l++) delayX[l] = 0.0;
+
+  /* Calculate vec1[i] = sum_j invM[i][j] sltE[a][j] with the current invM */
+  #pragma loop noalias
+  for(msj=0;msj<nsize;msj++) {
+    rsj = eleIdx[msj] + (msj/Ne)*Nsite;
+    sltE_aj = sltE_a[rsj];
+    invM_j = invM + msj*Nsize;
+
+    for(msi=0;msi<nsize;msi++) {
+      vec1[msi] += -invM_j[msi] * sltE_aj;
+    }
+    for(l=0;l<2*nDelay;l++) {
+      delayX[l] += delay[msj*ld+l] * sltE_aj;
+    }
+  }
+  #pragma loop noalias
+  for(msi=0;msi<nsize;msi++) {
+    delay_i = delay + msi*ld;
+    for(l=0;l<nDelay;l++) {
+      vec1[msi] += delay_i[2*l]*delayX[2*l+1] - delay_i[2*l+1]*delayX[2*l];
+    }
+  }
+
+  /* Update Pfaffian */
+  tmp = vec1[msa];
+  PfM_real[qpidx] *= -tmp;
+  invVec1_a = -1.0/tmp;
+
+  /* v[i] = -InvM[a][i]/vec1[a] with the current invM */
+  #pragma loop noalias
+  for(msi=0;msi<nsize;msi++) {
+    delay_i = delay + msi*ld;
+    tmp = invM_a[msi];
+    for(l=0;l<nDelay;l++) {
+      tmp += delay_a[2*l]*delay_i[2*l+1] - delay_a[2*l+1]*delay_i[2*l];
+    }
+    delay_i[2*nDelay+1] = tmp * invVec1_a;
+  }
+
+  /* u[i] = vec1[i] + delta_{ia} */
+  /* invM[i][j] += u[i] v[j] - v[i] u[j] gives the same update as updateMAll_child */
+  #pragma loop noalias
+  for(msi=0;msi<nsize;msi++) {
+    delay[msi*ld+2*nDelay] = vec1[msi];
+  }
+  delay_a[2*nDelay] += 1.0;
+
+  return;
+}
+
+/* Flush the pending updates into InvM by one DGEMM */
+/* work size = 2*NDelayUpdate*Nsize */
+void flushMAllDelay_child_real(const int qpidx, const int nDelay, double *work) {
+  #pragma procedure serial
+  const int ld = 2*NDelayUpdate;
+  const double *delay = InvMDelay_real + qpidx*Nsize*ld;
+  double *invM = InvM_real + qpidx*Nsize*Nsize;
+  double *delayW = work; /* delayW[i][2*l] = v_l[i], delayW[i][2*l+1] = -u_l[i] */
+
+  char transA='T', transB='N';
+  int m,n,k,lda;
+  double alpha=-1.0, beta=1.0;
+  int msi,l;
+
+  if(nDelay==0) return;
+
+  for(msi=0;msi<Nsize;msi++) {
+    for(l=0;l<nDelay;l++) {
+      delayW[msi*ld+2*l]   =  delay[msi*ld+2*l+1];
+      delayW[msi*ld+2*l+1] = -delay[msi*ld+2*l];
+    }
+  }
+
+  /* InvM is row-major and seen as its transpose -InvM by DGEMM. */
+  /* -InvM -= U W^T, i.e., InvM[i][j] += sum_l u_l[i] v_l[j] - v_l[i] u_l[j] */
+  m = n = Nsize;
+  k = 2*nDelay;
+  lda = ld;
+  M_DGEMM(&transA, &transB, &m, &n, &k, &alpha, delay, &lda, delayW, &lda, &beta, invM, &m);
+
+  return;
+}
+
+/* Flush all the pending updates of InvM */
+void FlushMAllDelay_real(const int qpStart, const int qpEnd) {
+  const int qpNum = qpEnd-qpStart;
+  const int nDelay = InvMDelayCount;
+  int qpidx;
+  double *work;
+
+  if(nDelay==0) return;
+
+  RequestWorkSpaceThreadDouble(2*NDelayUpdate*Nsize);
+
+  #pragma omp parallel default(shared) private(work)
+  {
+    work = GetWorkSpaceThreadDouble(2*NDelayUpdate*Nsize);
+
+    #pragma omp for private(qpidx)
+    for(qpidx=0;qpidx<qpNum;qpidx++) {
+      flushMAllDelay_child_real(qpidx, nDelay, work);
+    }
+  }
+
+  ReleaseWorkSpaceThreadDouble();
+
+  InvMDelayCount = 0;
+  return;
+}
+
 /* Calculate new pfaffian with Backflow effects.
    The ma-th electron with spin s hops from ra to rb */
 void CalculateNewPfMBF_real(const int *icount, const int *msaTmp,
                        double *pfMNew, const int *eleIdx,
                        const int qpStart, const int qpEnd, const double *bufM) {
   //#pragma procedure serial
-  int i;
   const int qpNum = qpEnd-qpStart;
   int qpidx;
   //double *sltE;
   //double *sltE_i;
-  int *msa;
+  const int *msa;
   //int msi,msj,rsi,rsj,i;
   //int *hop;
   //double complex diff;
 
   for(qpidx=0;qpidx<qpNum;qpidx++) {
-    //Store msa//
-    msa=(int *)malloc(sizeof(int)*icount[qpidx]);
-    //printf("Total=%d\n",icount[qpidx]);
-    for(i=0;i<icount[qpidx];i++){
-      msa[i] = msaTmp[i+qpidx*Nsite];
-      //printf("hop[%d]=%d\n",i,msa[i]);
-    }
+    msa = msaTmp + qpidx*Nsite;
 
     /* calculateNewPfM */
     pfMNew[qpidx] = calculateNewPfMBFN4_real_child(qpidx,icount[qpidx],msa,eleIdx,bufM);
-
-    free(msa);
   }
   //icount = UpdateSlaterElmBFTmp3(ma, rb, ra, s, eleCfg, eleNum, msaTmp);
 
@@ -265,18 +526,23 @@ double calculateNewPfMBFN4_real_child(const int qpidx, const int n, const int *m
   const double *sltE;
   const double *sltE_k;
   double *invM;
-  double *invM_i, *invM_k, *invM_l;
+  double *invM_k, *invM_l;
 
   double *vec; /* vec[n][nsize] */
   //double complex vec[n*nsize]; /* vec[n][nsize] */
-  double *vec_k, *vec_l;
+  double *vec_k;
   //double complex mat[n2*n2]; /* mat[n2][n2] */
   double *mat; /* mat[n2][n2] */
   double *mat_k;
   double sgn;
 
-  int rsi,rsk,msi,msj,k,l;
-  double val,tmp;
+  double *invMVec; /* invMVec[n][nsize] */
+  double *matX; /* matX[n][n] */
+
+  int rsi,rsk,msi,k,l;
+  double val;
+  double one=1.0, zero=0.0;
+  char transN='N', transT='T';
 
   /* for ZSKPFA */
   char uplo='U', mthd='P';
@@ -292,10 +558,12 @@ double calculateNewPfMBFN4_real_child(const int qpidx, const int n, const int *m
   invM = InvM_real + qpidx*Nsize*Nsize;
 
   vec = (double *)malloc(sizeof(double)*n*nsize);
+  invMVec = (double*)malloc(sizeof(double)*n*nsize);
   //invMat = (double *)malloc(sizeof(double)*n2*n2);
   mat = (double *)malloc(sizeof(double)*n2*n2);
   //matUV = (double *)malloc(sizeof(double)*n2*nsize);
   work = (double *)malloc(sizeof(double)*n2*n2);
+  matX = work; /* work is used by SKPFA only after X_kl is built */
 
   //#pragma loop noalias
   for(k=0;k<n;k++) {
@@ -309,22 +577,19 @@ double calculateNewPfMBFN4_real_child(const int qpidx, const int n, const int *m
     }
   }
 
+  /* invMVec[l][msi] = sum_msj invM[msi][msj] * vec[l][msj] */
+  M_DGEMM(&transT, &transN, &nsize, &n, &nsize, &one, invM, &nsize,
+          vec, &nsize, &zero, invMVec, &nsize);
+  /* matX[l][k] = sum_msi vec[k][msi] * invMVec[l][msi] */
+  M_DGEMM(&transT, &transN, &n, &n, &nsize, &one, vec, &nsize,
+          invMVec, &nsize, &zero, matX, &n);
+
   /* X_kl */
   for(k=0;k<n;k++) {
     mat_k = mat + n2*k;
     vec_k = vec + k*nsize;
     for(l=k+1;l<n;l++) {
-      vec_l = vec + l*nsize;
-      val = 0.0;
-      for(msi=0;msi<nsize;msi++) {
-        invM_i = invM + msi*nsize;
-        tmp = 0.0;
-        for(msj=0;msj<nsize;msj++) {
-          tmp += invM_i[msj] * vec_l[msj];
-        }
-        val += tmp * vec_k[msi];
-      }
-      mat_k[l] = val + vec_k[msa[l]];
+      mat_k[l] = matX[k+n*l] + vec_k[msa[l]];
     }
   }
 
@@ -370,6 +635,7 @@ double calculateNewPfMBFN4_real_child(const int qpidx, const int n, const int *m
   //free(matUV);
   free(mat);
   free(vec);
+  free(invMVec);
   //free(invMat);
   free(work);
   return sgn * pfaff * PfM_real[qpidx];
@@ -385,22 +651,15 @@ void UpdateMAll_BF_real(const int *icount, const int *msaTmp,
   int qpidx;
   //double complex *sltE;
   //double complex *sltE_i;
-  int *msa;
-  int i;
+  const int *msa;
   //int *hop;
   //double complex diff;
 
   for(qpidx=0;qpidx<qpNum;qpidx++) {
-    //Store msa//
-    msa=(int *)malloc(sizeof(int)*icount[qpidx]);
-    for(i=0;i<icount[qpidx];i++){
-      msa[i] = msaTmp[i+qpidx*Nsite];
-    }
+    msa = msaTmp + qpidx*Nsite;
 
     /* calculateNewPfM */
     pfMNew[qpidx] = updateMAll_BF_real_child(qpidx,icount[qpidx],msa,eleIdx);
-
-    free(msa);
   }
 
   return;
@@ -419,7 +678,7 @@ double updateMAll_BF_real_child(const int qpidx, const int n, const int *msa,
   double *invM_i, *invM_k, *invM_l;
 
   double *vec; /* vec[n][nsize] */
-  double *vec_k, *vec_l;
+  double *vec_k;
   //double complex mat[n2*n2]; /* mat[n2][n2] */
   double *mat; /* mat[n2][n2] */
   double *mat_k;
@@ -427,11 +686,17 @@ double updateMAll_BF_real_child(const int qpidx, const int n, const int *msa,
   double *invMat; /* mat[n2][n2] */
   //double complex matUV[n2*nsize]; /* mat[n2][nsize] */
   double *matUV; /* mat[n2][nsize] */
-  double *invMat_k, *matUV_i, *matUV_j;
+  double *matUV_i;
   double sgn;
 
+  double *invMVec; /* invMVec[n][nsize] */
+  double *matX; /* matX[n][n] */
+  double *matUVInv; /* matUVInv[nsize][n2] */
+
   int rsi,rsk,msi,msj,k,l;
-  double val,tmp;
+  double val;
+  double one=1.0, zero=0.0, mone=-1.0;
+  char transN='N', transT='T';
 
   /* for DSKPFA */
   char uplo='U', mthd='P';
@@ -451,10 +716,13 @@ double updateMAll_BF_real_child(const int qpidx, const int n, const int *msa,
 
   //vec = bufferc; /* n*nsize */
   vec = (double *)malloc(sizeof(double)*n*nsize);
+  invMVec = (double*)malloc(sizeof(double)*n*nsize);
+  matUVInv = (double*)malloc(sizeof(double)*n2*nsize);
   invMat = (double *)malloc(sizeof(double)*n2*n2);
   mat = (double *)malloc(sizeof(double)*n2*n2);
   matUV = (double *)malloc(sizeof(double)*n2*nsize);
   work = (double *)malloc(sizeof(double)*n2*n2);
+  matX = work; /* work is used by SKPFA only after X_kl is built */
   work2 = (double *)malloc(sizeof(double)*n2);
 
 #pragma loop noalias
@@ -469,22 +737,19 @@ double updateMAll_BF_real_child(const int qpidx, const int n, const int *msa,
     }
   }
 
+  /* invMVec[l][msi] = sum_msj invM[msi][msj] * vec[l][msj] */
+  M_DGEMM(&transT, &transN, &nsize, &n, &nsize, &one, invM, &nsize,
+          vec, &nsize, &zero, invMVec, &nsize);
+  /* matX[l][k] = sum_msi vec[k][msi] * invMVec[l][msi] */
+  M_DGEMM(&transT, &transN, &n, &n, &nsize, &one, vec, &nsize,
+          invMVec, &nsize, &zero, matX, &n);
+
   /* X_kl */
   for(k=0;k<n;k++) {
     mat_k = mat + n2*k;
     vec_k = vec + k*nsize;
     for(l=k+1;l<n;l++) {
-      vec_l = vec + l*nsize;
-      val = 0.0;
-      for(msi=0;msi<nsize;msi++) {
-        invM_i = invM + msi*nsize;
-        tmp = 0.0;
-        for(msj=0;msj<nsize;msj++) {
-          tmp += invM_i[msj] * vec_l[msj];
-        }
-        val += tmp * vec_k[msi];
-      }
-      mat_k[l] = val + vec_k[msa[l]];
+      mat_k[l] = matX[k+n*l] + vec_k[msa[l]];
     }
   }
 
@@ -533,11 +798,7 @@ double updateMAll_BF_real_child(const int qpidx, const int n, const int *msa,
     matUV_i = matUV + n2*msi;
     invM_i = invM + msi*nsize;
     for(k=0;k<n;k++) {
-      vec_k = vec + k*nsize;
-      val = 0.0;
-      for(msj=0;msj<nsize;msj++) {
-        val -= invM_i[msj] * vec_k[msj];
-      }
+      val = -invMVec[msi+k*nsize];
       if(msa[k]==msi){val -= 1.0;}
       matUV_i[k] = val;
       matUV_i[k+n] = invM_i[msa[k]];
@@ -563,38 +824,25 @@ double updateMAll_BF_real_child(const int qpidx, const int n, const int *msa,
     //return;
   }
 
-  for(msi=0;msi<nsize;msi++) {
-    matUV_i = matUV + n2*msi;
-    invM_i = invM + msi*nsize;
-    for(msj=0;msj<nsize;msj++) {
-      matUV_j = matUV + n2*msj;
-      val = 0.0;
-      for(k=0;k<n2;k++) {
-        invMat_k = invMat + k*n2;
-        tmp=0.0;
-        for(l=0;l<n2;l++) {
-          tmp += invMat_k[l]*matUV_j[l];
-        }
-        val += matUV_i[k]*tmp;
-      }
-      invM_i[msj] -= val;
-    }
-  }
+  /* invM[msi][msj] -= sum_kl matUV[msi][k] * invMat[k][l] * matUV[msj][l] */
+  M_DGEMM(&transN, &transN, &n2, &nsize, &n2, &one, invMat, &n2,
+          matUV, &n2, &zero, matUVInv, &n2);
+  M_DGEMM(&transT, &transN, &nsize, &nsize, &n2, &mone, matUV, &n2,
+          matUVInv, &n2, &one, invM, &nsize);
 
   for(msi=0;msi<Ne;msi++) {
-    //invM_i = invM + msi*nsize;
     for(msj=Ne;msj<Nsize;msj++) {
-      InvM[msj*nsize+msi] = -InvM[msi*nsize+msj];
+      invM[msj*nsize+msi] = -invM[msi*nsize+msj];
     }
   }
   for(msi=Ne;msi<Nsize;msi++) {
     for(msj=Ne;msj<Nsize;msj++) {
-      InvM[msi*nsize+msj] = 0.0;
+      invM[msi*nsize+msj] = 0.0;
     }
   }
   for(msi=0;msi<Ne;msi++) {
     for(msj=0;msj<Ne;msj++) {
-      InvM[msi*nsize+msj] = 0.0;
+      invM[msi*nsize+msj] = 0.0;
     }
   }
 
@@ -610,6 +858,8 @@ double updateMAll_BF_real_child(const int qpidx, const int n, const int *msa,
   free(matUV);
   free(mat);
   free(vec);
+  free(invMVec);
+  free(matUVInv);
   free(invMat);
   free(work);
   free(work2);
@@ -32,11 +32,13 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 void calculateNewPfMTwo_child_fcmp(const int ma, const int s, const int mb, const int t,
                               double complex *pfMNew, const int *eleIdx,
                               const int qpStart, const int qpEnd, const int qpidx,
-                              double complex *vec_a, double complex *vec_b);
+                              double complex *vec_a, double complex *vec_b,
+                              double complex *pfM, double complex *invM);
 void updateMAllTwo_child_fcmp(const int ma, const int s, const int mb, const int t,
                          const int raOld, const int rbOld,
                          const int *eleIdx, const int qpStart, const int qpEnd, const int qpidx,
-                         double complex *vecP, double complex *vecQ, double complex *vecS, double complex *vecT);
+                         double complex *vecP, double complex *vecQ, double complex *vecS, double complex *vecT,
+                         double complex *pfM, double complex *invM);
 
 /* Calculate new pfaffian. 
    The ma-th electron with spin s hops
@@ -60,7 +62,7 @@ void CalculateNewPfMTwo_fcmp(const int ma, const int s, const int mb, const int
 
   for(qpidx=0;qpidx<qpNum;qpidx++) {
     calculateNewPfMTwo_child_fcmp(ma, s, mb, t, pfMNew, eleIdx,
-                             qpStart, qpEnd, qpidx, vec_a, vec_b);
+                             qpStart, qpEnd, qpidx, vec_a, vec_b, PfM, InvM);
   }
 
   return;
@@ -95,7 +97,7 @@ void CalculateNewPfMTwo2_fcmp(const int ma, const int s, const int mb, const int
     #pragma loop nounroll
     for(qpidx=0;qpidx<qpNum;qpidx++) {
       calculateNewPfMTwo_child_fcmp(ma, s, mb, t, pfMNew, eleIdx,
-                               qpStart, qpEnd, qpidx, vec_a, vec_b);
+                               qpStart, qpEnd, qpidx, vec_a, vec_b, PfM, InvM);
     }
   }
   
@@ -107,7 +109,8 @@ void CalculateNewPfMTwo2_fcmp(const int ma, const int s, const int mb, const int
 void calculateNewPfMTwo_child_fcmp(const int ma, const int s, const int mb, const int t,
                               double complex *pfMNew, const int *eleIdx,
                               const int qpStart, const int qpEnd, const int qpidx,
-                              double complex *vec_a, double complex *vec_b) {
+                              double complex *vec_a, double complex *vec_b,
+                              double complex *pfM, double complex *invM) {
   #pragma procedure serial
   /* const int qpNum = qpEnd-qpStart; */
   const int msa = ma+s*Ne;
@@ -122,20 +125,16 @@ void calculateNewPfMTwo_child_fcmp(const int ma, const int s, const int mb, cons
   double complex p_a,p_b,q_a,q_b,bMa;
   double complex ratio,tmp;
 
-  const double complex *sltE;
-  const double complex *sltE_a; /* update elements of msa-th row */
-  const double complex *sltE_b; /* update elements of msb-th row */
-
-  double complex *invM;
+  double complex *invM_q;
   const double complex *invM_a, *invM_b, *invM_i;
   double complex invM_ab,invM_ai,invM_bi;
 
   double complex vec_ba,vec_ai,vec_bi;
+  const double complex *sltE_a,*sltE_b;
+  double complex sltRow[2*Nsite2];
 
-  sltE = SlaterElm + (qpidx+qpStart)*Nsite2*Nsite2;
-  sltE_a = sltE + rsa*Nsite2;
-  sltE_b = sltE + rsb*Nsite2;
-
+  sltE_a = SlaterElmRow_fcmp(qpidx+qpStart, rsa, sltRow);
+  sltE_b = SlaterElmRow_fcmp(qpidx+qpStart, rsb, sltRow+Nsite2);
   #pragma loop noalias
   for(msi=0;msi<nsize;msi++) {
     rsi = eleIdx[msi] + (msi/Ne)*Nsite;
@@ -144,9 +143,9 @@ void calculateNewPfMTwo_child_fcmp(const int ma, const int s, const int mb, cons
   }
   vec_ba = vec_b[msa];
 
-  invM = InvM + qpidx*Nsize*Nsize;
-  invM_a = invM + msa*Nsize;
-  invM_b = invM + msb*Nsize;
+  invM_q = invM + qpidx*Nsize*Nsize;
+  invM_a = invM_q + msa*Nsize;
+  invM_b = invM_q + msb*Nsize;
   invM_ab = invM_a[msb];
 
   p_a = p_b = q_a = q_b = bMa = 0.0;
@@ -166,7 +165,7 @@ void calculateNewPfMTwo_child_fcmp(const int ma, const int s, const int mb, cons
 
   #pragma loop noalias
   for(msi=0;msi<nsize;msi++) {
-    invM_i = invM + msi*Nsize;
+    invM_i = invM_q + msi*Nsize;
     tmp = 0.0;
     for(msj=0;msj<nsize;msj++) {
       tmp += invM_i[msj] * vec_a[msj];
@@ -178,7 +177,7 @@ void calculateNewPfMTwo_child_fcmp(const int ma, const int s, const int mb, cons
   ratio = invM_ab*vec_ba + invM_ab*bMa + p_a*q_b - p_b*q_a;
 
   /* Update pfMNew */
-  pfMNew[qpidx] = ratio*PfM[qpidx];
+  pfMNew[qpidx] = ratio*pfM[qpidx];
 
   return;
 }
@@ -206,7 +205,7 @@ void UpdateMAllTwo_fcmp(const int ma, const int s, const int mb, const int t,
     #pragma loop nounroll
     for(qpidx=0;qpidx<qpNum;qpidx++) {
       updateMAllTwo_child_fcmp(ma, s, mb, t, raOld, rbOld, eleIdx, qpStart, qpEnd, qpidx,
-                          vec1, vec2, vec3, vec4);
+                          vec1, vec2, vec3, vec4, PfM, InvM);
     }
   }
 
@@ -214,10 +213,50 @@ void UpdateMAllTwo_fcmp(const int ma, const int s, const int mb, const int t,
   return;
 }
 
+/* CalculateNewPfMTwo_fcmp for one Markov chain owning pfM and invM */
+/* buffer size = 2*Nsize */
+void CalculateNewPfMTwoChain_fcmp(const int ma, const int s, const int mb, const int t,
+                             double complex *pfMNew, const int *eleIdx,
+                             double complex *pfM, double complex *invM, double complex *buffer) {
+  const int msa = ma+s*Ne;
+  const int msb = mb+t*Ne;
+  int qpidx;
+  double complex *vec_a = buffer;
+  double complex *vec_b = buffer + Nsize;
+
+  if(msa==msb) {
+    CalculateNewPfMChain(mb, t, pfMNew, eleIdx, pfM, invM);
+    return;
+  }
+
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    calculateNewPfMTwo_child_fcmp(ma, s, mb, t, pfMNew, eleIdx,
+                             0, NQPFull, qpidx, vec_a, vec_b, pfM, invM);
+  }
+
+  return;
+}
+
+/* UpdateMAllTwo_fcmp for one Markov chain owning pfM and invM */
+/* buffer size = 4*Nsize */
+void UpdateMAllTwoChain_fcmp(const int ma, const int s, const int mb, const int t,
+                        const int raOld, const int rbOld, const int *eleIdx,
+                        double complex *pfM, double complex *invM, double complex *buffer) {
+  int qpidx;
+
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    updateMAllTwo_child_fcmp(ma, s, mb, t, raOld, rbOld, eleIdx, 0, NQPFull, qpidx,
+                        buffer, buffer+Nsize, buffer+2*Nsize, buffer+3*Nsize, pfM, invM);
+  }
+
+  return;
+}
+
 void updateMAllTwo_child_fcmp(const int ma, const int s, const int mb, const int t,
                          const int raOld, const int rbOld,
                          const int *eleIdx, const int qpStart, const int qpEnd, const int qpidx,
-                         double complex *vecP, double complex *vecQ, double complex *vecS, double complex *vecT) {
+                         double complex *vecP, double complex *vecQ, double complex *vecS, double complex *vecT,
+                         double complex *pfM, double complex *invM) {
   #pragma procedure serial
   const int msa = ma+s*Ne;
   const int msb = mb+t*Ne;
@@ -227,14 +266,11 @@ void updateMAllTwo_child_fcmp(const int ma, const int s, const int mb, const int
   const int rsbOld = raOld + t*Nsite;
   const int nsize = Nsize;
 
-  const double complex *sltE = SlaterElm + (qpidx+qpStart)*Nsite2*Nsite2;;
-  const double complex *sltE_a = sltE + rsa*Nsite2; /* update elements of msa-th row */
-  const double complex *sltE_b = sltE + rsb*Nsite2; /* update elements of msb-th row */
-  const double complex mOld_ab = sltE[rsaOld*Nsite2 + rsbOld];
+  const double complex mOld_ab = SlaterElmAt_fcmp(qpidx+qpStart, rsaOld, rsbOld);
 
-  double complex *invM = InvM + qpidx*Nsize*Nsize;
-  double complex *invM_a = invM + msa*Nsize;
-  double complex *invM_b = invM + msb*Nsize;
+  double complex *invM_q = invM + qpidx*Nsize*Nsize;
+  double complex *invM_a = invM_q + msa*Nsize;
+  double complex *invM_b = invM_q + msb*Nsize;
   double complex *invM_i;
   double complex invM_ab = invM_a[msb];
 
@@ -242,12 +278,16 @@ void updateMAllTwo_child_fcmp(const int ma, const int s, const int mb, const int
   double complex a,b,c,d,e,f;
   double complex p_i,p_j,q_i,q_j,s_i,s_j,t_i,t_j;
 
+  const double complex *sltE_a,*sltE_b;
+  double complex sltRow[2*Nsite2];
   int msi,msj;
   int rsi;
 
   /* initialize vecP[i], vecQ[i] */
   /* vecS[i], vecT[i] are temporally used as
      vecS[i] = sltE[a][j], vecT[i] = sltE[b][j]. */
+  sltE_a = SlaterElmRow_fcmp(qpidx+qpStart, rsa, sltRow);
+  sltE_b = SlaterElmRow_fcmp(qpidx+qpStart, rsb, sltRow+Nsite2);
   #pragma loop noalias
   for(msi=0;msi<nsize;msi++) {
     vecP[msi]=0.0;
@@ -264,7 +304,7 @@ void updateMAllTwo_child_fcmp(const int ma, const int s, const int mb, const int
   /* vecQ[i]= sum_j invM[i][j]*sltE[b][j] */
   #pragma loop noalias
   for(msi=0;msi<nsize;msi++) {
-    invM_i = invM + msi*Nsize;
+    invM_i = invM_q + msi*Nsize;
     for(msj=0;msj<nsize;msj++) {
       vecP[msi] += invM_i[msj]*vecS[msj];
       vecQ[msi] += invM_i[msj]*vecT[msj];
@@ -279,7 +319,7 @@ void updateMAllTwo_child_fcmp(const int ma, const int s, const int mb, const int
   }
   ratio = invM_ab*vecT[msa] + invM_ab*bMa
         + vecP[msa]*vecQ[msb] - vecP[msb]*vecQ[msa];
-  PfM[qpidx] *= ratio;
+  pfM[qpidx] *= ratio;
 
   /* Set coefficients */
   a = -vecP[msa];
@@ -303,7 +343,7 @@ void updateMAllTwo_child_fcmp(const int ma, const int s, const int mb, const int
   /* Update InvM */
   #pragma loop noalias
   for(msi=0;msi<nsize;msi++) {
-    invM_i = invM + msi*Nsize;
+    invM_i = invM_q + msi*Nsize;
     p_i = vecP[msi];
     q_i = vecQ[msi];
     s_i = vecS[msi];
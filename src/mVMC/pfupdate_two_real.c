@@ -33,12 +33,14 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 void calculateNewPfMTwo_child_real(const int ma, const int s, const int mb, const int t,
                               double *pfMNew_real, const int *eleIdx,
                               const int qpStart, const int qpEnd, const int qpidx,
-                              double *vec_a, double *vec_b);
+                              double *vec_a, double *vec_b,
+                              double *pfM_real, double *invM_real);
 
 void updateMAllTwo_child_real(const int ma, const int s, const int mb, const int t,
                          const int raOld, const int rbOld,
                          const int *eleIdx, const int qpStart, const int qpEnd, const int qpidx,
-                         double *vecP, double *vecQ, double *vecS, double *vecT);
+                         double *vecP, double *vecQ, double *vecS, double *vecT,
+                         double *pfM_real, double *invM_real);
 
 /* Calculate new pfaffian. 
    The ma-th electron with spin s hops
@@ -62,7 +64,7 @@ void CalculateNewPfMTwo_real(const int ma, const int s, const int mb, const int
 
   for(qpidx=0;qpidx<qpNum;qpidx++) {
     calculateNewPfMTwo_child_real(ma, s, mb, t, pfMNew_real, eleIdx,
-                             qpStart, qpEnd, qpidx, vec_a, vec_b);
+                             qpStart, qpEnd, qpidx, vec_a, vec_b, PfM_real, InvM_real);
   }
 
   return;
@@ -97,7 +99,7 @@ void CalculateNewPfMTwo2_real(const int ma, const int s, const int mb, const int
     #pragma loop nounroll
     for(qpidx=0;qpidx<qpNum;qpidx++) {
       calculateNewPfMTwo_child_real(ma, s, mb, t, pfMNew_real, eleIdx,
-                               qpStart, qpEnd, qpidx, vec_a, vec_b);
+                               qpStart, qpEnd, qpidx, vec_a, vec_b, PfM_real, InvM_real);
     }
   }
   
@@ -108,7 +110,8 @@ void CalculateNewPfMTwo2_real(const int ma, const int s, const int mb, const int
 void calculateNewPfMTwo_child_real(const int ma, const int s, const int mb, const int t,
                               double *pfMNew_real, const int *eleIdx,
                               const int qpStart, const int qpEnd, const int qpidx,
-                              double *vec_a, double *vec_b) {
+                              double *vec_a, double *vec_b,
+                              double *pfM_real, double *invM_real) {
   #pragma procedure serial
   /* const int qpNum = qpEnd-qpStart; */
   const int msa = ma+s*Ne;
@@ -123,20 +126,16 @@ void calculateNewPfMTwo_child_real(const int ma, const int s, const int mb, cons
   double p_a,p_b,q_a,q_b,bMa;
   double ratio,tmp;
 
-  const double *sltE;
-  const double *sltE_a; /* update elements of msa-th row */
-  const double *sltE_b; /* update elements of msb-th row */
-
   double *invM;
   const double *invM_a, *invM_b, *invM_i;
   double invM_ab,invM_ai,invM_bi;
 
   double vec_ba,vec_ai,vec_bi;
+  const double *sltE_a,*sltE_b;
+  double sltRow[2*Nsite2];
 
-  sltE = SlaterElm_real + (qpidx+qpStart)*Nsite2*Nsite2;//TBC
-  sltE_a = sltE + rsa*Nsite2;
-  sltE_b = sltE + rsb*Nsite2;
-
+  sltE_a = SlaterElmRow_real(qpidx+qpStart, rsa, sltRow);
+  sltE_b = SlaterElmRow_real(qpidx+qpStart, rsb, sltRow+Nsite2);
   #pragma loop noalias
   for(msi=0;msi<nsize;msi++) {
     rsi = eleIdx[msi] + (msi/Ne)*Nsite;
@@ -145,7 +144,7 @@ void calculateNewPfMTwo_child_real(const int ma, const int s, const int mb, cons
   }
   vec_ba = vec_b[msa];
 
-  invM = InvM_real + qpidx*Nsize*Nsize; //TBC
+  invM = invM_real + qpidx*Nsize*Nsize; //TBC
   invM_a = invM + msa*Nsize;
   invM_b = invM + msb*Nsize;
   invM_ab = invM_a[msb];
@@ -179,7 +178,7 @@ void calculateNewPfMTwo_child_real(const int ma, const int s, const int mb, cons
   ratio = invM_ab*vec_ba + invM_ab*bMa + p_a*q_b - p_b*q_a;
 
   /* Update pfMNew_real */
-  pfMNew_real[qpidx] = ratio*PfM_real[qpidx];
+  pfMNew_real[qpidx] = ratio*pfM_real[qpidx];
 
   return;
 }
@@ -206,7 +205,7 @@ void UpdateMAllTwo_real(const int ma, const int s, const int mb, const int t,
     #pragma loop nounroll
     for(qpidx=0;qpidx<qpNum;qpidx++) {
       updateMAllTwo_child_real(ma, s, mb, t, raOld, rbOld, eleIdx, qpStart, qpEnd, qpidx,
-                          vec1, vec2, vec3, vec4);
+                          vec1, vec2, vec3, vec4, PfM_real, InvM_real);
     }
   }
 
@@ -214,10 +213,50 @@ void UpdateMAllTwo_real(const int ma, const int s, const int mb, const int t,
   return;
 }
 
+/* CalculateNewPfMTwo_real for one Markov chain owning pfM_real and invM_real */
+/* buffer size = 2*Nsize */
+void CalculateNewPfMTwoChain_real(const int ma, const int s, const int mb, const int t,
+                             double *pfMNew_real, const int *eleIdx,
+                             double *pfM_real, double *invM_real, double *buffer) {
+  const int msa = ma+s*Ne;
+  const int msb = mb+t*Ne;
+  int qpidx;
+  double *vec_a = buffer;
+  double *vec_b = buffer + Nsize;
+
+  if(msa==msb) {
+    CalculateNewPfMChain_real(mb, t, pfMNew_real, eleIdx, pfM_real, invM_real);
+    return;
+  }
+
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    calculateNewPfMTwo_child_real(ma, s, mb, t, pfMNew_real, eleIdx,
+                             0, NQPFull, qpidx, vec_a, vec_b, pfM_real, invM_real);
+  }
+
+  return;
+}
+
+/* UpdateMAllTwo_real for one Markov chain owning pfM_real and invM_real */
+/* buffer size = 4*Nsize */
+void UpdateMAllTwoChain_real(const int ma, const int s, const int mb, const int t,
+                        const int raOld, const int rbOld, const int *eleIdx,
+                        double *pfM_real, double *invM_real, double *buffer) {
+  int qpidx;
+
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    updateMAllTwo_child_real(ma, s, mb, t, raOld, rbOld, eleIdx, 0, NQPFull, qpidx,
+                        buffer, buffer+Nsize, buffer+2*Nsize, buffer+3*Nsize, pfM_real, invM_real);
+  }
+
+  return;
+}
+
 void updateMAllTwo_child_real(const int ma, const int s, const int mb, const int t,
                          const int raOld, const int rbOld,
                          const int *eleIdx, const int qpStart, const int qpEnd, const int qpidx,
-                         double *vecP, double *vecQ, double *vecS, double *vecT) {
+                         double *vecP, double *vecQ, double *vecS, double *vecT,
+                         double *pfM_real, double *invM_real) {
   #pragma procedure serial
   const int msa = ma+s*Ne;
   const int msb = mb+t*Ne;
@@ -227,12 +266,9 @@ void updateMAllTwo_child_real(const int ma, const int s, const int mb, const int
   const int rsbOld = raOld + t*Nsite;
   const int nsize = Nsize;
 
-  const double *sltE = SlaterElm_real + (qpidx+qpStart)*Nsite2*Nsite2;; //TBC
-  const double *sltE_a = sltE + rsa*Nsite2; /* update elements of msa-th row */
-  const double *sltE_b = sltE + rsb*Nsite2; /* update elements of msb-th row */
-  const double mOld_ab = sltE[rsaOld*Nsite2 + rsbOld];
+  const double mOld_ab = SlaterElmAt_real(qpidx+qpStart, rsaOld, rsbOld);
 
-  double *invM = InvM_real + qpidx*Nsize*Nsize;
+  double *invM = invM_real + qpidx*Nsize*Nsize;
   double *invM_a = invM + msa*Nsize;
   double *invM_b = invM + msb*Nsize;
   double *invM_i;
@@ -242,12 +278,16 @@ void updateMAllTwo_child_real(const int ma, const int s, const int mb, const int
   double a,b,c,d,e,f;
   double p_i,p_j,q_i,q_j,s_i,s_j,t_i,t_j;
 
+  const double *sltE_a,*sltE_b;
+  double sltRow[2*Nsite2];
   int msi,msj;
   int rsi;
 
   /* initialize vecP[i], vecQ[i] */
   /* vecS[i], vecT[i] are temporally used as
      vecS[i] = sltE[a][j], vecT[i] = sltE[b][j]. */
+  sltE_a = SlaterElmRow_real(qpidx+qpStart, rsa, sltRow);
+  sltE_b = SlaterElmRow_real(qpidx+qpStart, rsb, sltRow+Nsite2);
   #pragma loop noalias
   for(msi=0;msi<nsize;msi++) {
     vecP[msi]=0.0;
@@ -279,7 +319,7 @@ void updateMAllTwo_child_real(const int ma, const int s, const int mb, const int
   }
   ratio = invM_ab*vecT[msa] + invM_ab*bMa
         + vecP[msa]*vecQ[msb] - vecP[msb]*vecQ[msa];
-  PfM_real[qpidx] *= ratio;
+  pfM_real[qpidx] *= ratio;
 
   /* Set coefficients */
   a = -vecP[msa];
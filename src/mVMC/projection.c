@@ -265,6 +265,83 @@ void UpdateProjCnt(const int ri, const int rj, const int s,
 
 }
 
+/* Return 1 if the change of projCnt by a hop is handled by UpdateProjCntDelta. */
+/* The doublon-holon factors are recounted over all the sites by UpdateProjCnt. */
+int IsProjCntDelta() {
+  return (NDoublonHolon2siteIdx==0 && NDoublonHolon4siteIdx==0);
+}
+
+/* Sparse version of UpdateProjCnt for the Gutzwiller and Jastrow factors. */
+/* An electron with spin s hops from ri to rj (eleNum is already updated). */
+/* The changes are appended to projDelta after the nDelta entries: */
+/*   projDelta[2*k] = idx, projDelta[2*k+1] = change of projCnt[idx]. */
+/* At most 2*Nsite entries are added. Returns the new number of entries. */
+int UpdateProjCntDelta(const int ri, const int rj, const int s,
+                       int *projDelta, const int nDelta, const int *eleNum) {
+  const int *n0=eleNum;
+  const int *n1=eleNum+Nsite;
+  const int *siteIdx_i, *siteIdx_j;
+  int n=nDelta;
+  int rk,xk;
+  /* optimization for Kei */
+  const int nSite=Nsite;
+
+  if(ri==rj) return n;
+
+  if(NGutzwillerIdx>0){
+    projDelta[2*n] = GutzwillerIdx[ri];
+    projDelta[2*n+1] = -(n0[ri]+n1[ri]);
+    n++;
+    projDelta[2*n] = GutzwillerIdx[rj];
+    projDelta[2*n+1] = n0[rj]*n1[rj];
+    n++;
+  }
+
+  if(NJastrowIdx>0){
+    siteIdx_i = ProjSiteIdx + ri*nSite;
+    siteIdx_j = ProjSiteIdx + rj*nSite;
+    /* update [ri][rj] */
+    projDelta[2*n] = siteIdx_i[rj];
+    projDelta[2*n+1] = n0[ri]+n1[ri]-n0[rj]-n1[rj]+1;
+    n++;
+    /* update [ri][rk] and [rj][rk] (rk != ri, rj) */
+    for(rk=0;rk<nSite;rk++) {
+      if(rk==ri || rk==rj) continue;
+      xk = n0[rk]+n1[rk]-1;
+      if(xk==0 || siteIdx_i[rk]==siteIdx_j[rk]) continue;
+      projDelta[2*n] = siteIdx_i[rk];
+      projDelta[2*n+1] = -xk;
+      n++;
+      projDelta[2*n] = siteIdx_j[rk];
+      projDelta[2*n+1] = xk;
+      n++;
+    }
+  }
+
+  return n;
+}
+
+double LogProjRatioDelta(const int *projDelta, const int nDelta) {
+  int k;
+  double z=0;
+  for(k=0;k<nDelta;k++) {
+    z += creal(Proj[projDelta[2*k]]) * (double)(projDelta[2*k+1]);
+  }
+  return z;
+}
+
+double ProjRatioDelta(const int *projDelta, const int nDelta) {
+  return exp(LogProjRatioDelta(projDelta,nDelta));
+}
+
+void AddProjCntDelta(int *projCnt, const int *projDelta, const int nDelta) {
+  int k;
+  for(k=0;k<nDelta;k++) {
+    projCnt[projDelta[2*k]] += projDelta[2*k+1];
+  }
+  return;
+}
+
 //[s] MERGE BY TM
 /* An electron with spin s hops from ri to rj with t. */
 // (ri,s) -> (rj,t) assuming s!=t
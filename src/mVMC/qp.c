@@ -106,6 +106,19 @@ double complex CalculateLogIP_fcmp(double complex * const pfM, const int qpStart
   return clog(ip);
 }
 
+/* Calculate logarithm of inner product <phi|L|x> over all QP indices */
+/* without communication. This is used by each Markov chain. */
+double complex CalculateLogIPChain_fcmp(const double complex *pfM) {
+  double complex ip=0.0+0.0*I;
+  int qpidx;
+
+  #pragma loop noalias
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    ip += QPFullWeight[qpidx] * pfM[qpidx];
+  }
+  return clog(ip);
+}
+
 /* Calculate inner product <phi|L|x> */
 double complex CalculateIP_fcmp(double complex * const pfM, const int qpStart, const int qpEnd, MPI_Comm comm) {
   const int qpNum = qpEnd-qpStart;
@@ -126,6 +139,18 @@ double complex CalculateIP_fcmp(double complex * const pfM, const int qpStart, c
   return ip;
 }
 
+/* Calculate inner product <phi|L|x> over all QP indices without communication */
+double complex CalculateIPChain_fcmp(const double complex *pfM) {
+  double complex ip=0.0+0.0*I;
+  int qpidx;
+
+  #pragma loop noalias
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    ip += QPFullWeight[qpidx] * pfM[qpidx];
+  }
+  return ip;
+}
+
 void UpdateQPWeight() {
   int i,j,offset;
   double complex tmp; //TBC
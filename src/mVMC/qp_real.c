@@ -49,6 +49,19 @@ double CalculateLogIP_real(double* const pfM, const int qpStart, const int qpEnd
   return clog(ip);
 }
 
+/* Calculate logarithm of inner product <phi|L|x> over all QP indices */
+/* without communication. This is used by each Markov chain. */
+double CalculateLogIPChain_real(const double *pfM) {
+  double ip=0.0;
+  int qpidx;
+
+  #pragma loop noalias
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    ip += creal(QPFullWeight[qpidx]) * pfM[qpidx];
+  }
+  return log(fabs(ip));
+}
+
 /* Calculate inner product <phi|L|x> */
 double  CalculateIP_real(double* const pfM, const int qpStart, const int qpEnd, MPI_Comm comm) {
   const int qpNum = qpEnd-qpStart;
@@ -68,5 +81,17 @@ double  CalculateIP_real(double* const pfM, const int qpStart, const int qpEnd,
   }
   return ip;
 }
+
+/* Calculate inner product <phi|L|x> over all QP indices without communication */
+double CalculateIPChain_real(const double *pfM) {
+  double ip=0.0;
+  int qpidx;
+
+  #pragma loop noalias
+  for(qpidx=0;qpidx<NQPFull;qpidx++) {
+    ip += creal(QPFullWeight[qpidx]) * pfM[qpidx];
+  }
+  return ip;
+}
 #endif
 
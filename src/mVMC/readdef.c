@@ -565,6 +565,12 @@ int ReadDefFileNInt(char *xNameListFile, MPI_Comm comm) {
       }
     }
 
+    //Check the sample-space SR
+    if (NSRCG == 2 && bufDouble[IdxSROptStaDel] <= 0.0) {
+      fprintf(stderr, "Error: DSROptStaDel (in modpara.def) must be positive when NSRCG = 2.\n");
+      info = 1;
+    }
+
   }//rank 0
 
   if (rank == 0) {
@@ -593,6 +599,18 @@ int ReadDefFileNInt(char *xNameListFile, MPI_Comm comm) {
   MPI_Bcast(bufInt, nBufInt, MPI_INT, 0, comm);
   MPI_Bcast(&NStoreO, 1, MPI_INT, 0, comm); // for NStoreO
   MPI_Bcast(&NSRCG, 1, MPI_INT, 0, comm); // for NCG
+  MPI_Bcast(&NInlineMeasure, 1, MPI_INT, 0, comm); // for NInlineMeasure
+  MPI_Bcast(&NMultiChain, 1, MPI_INT, 0, comm); // for NMultiChain
+  MPI_Bcast(&NCompressSlater, 1, MPI_INT, 0, comm); // for NCompressSlater
+  MPI_Bcast(&NDelayUpdate, 1, MPI_INT, 0, comm); // for NDelayUpdate
+  MPI_Bcast(&NCheckpoint, 1, MPI_INT, 0, comm); // for NCheckpoint
+  MPI_Bcast(&NSROptCGPrecond, 1, MPI_INT, 0, comm); // for NSROptCGPrecond
+  MPI_Bcast(&NDefBinary, 1, MPI_INT, 0, comm); // for NDefBinary
+  MPI_Bcast(&NProfile, 1, MPI_INT, 0, comm); // for NProfile
+  MPI_Bcast(&NSplitChain, 1, MPI_INT, 0, comm); // for NSplitChain
+  MPI_Bcast(&NAsyncOutput, 1, MPI_INT, 0, comm); // for NAsyncOutput
+  MPI_Bcast(&NHopProposal, 1, MPI_INT, 0, comm); // for NHopProposal
+  MPI_Bcast(&NAutoCorr, 1, MPI_INT, 0, comm); // for NAutoCorr
   MPI_Bcast(&AllComplexFlag, 1, MPI_INT, 0, comm); // for Real
   MPI_Bcast(&iFlgOrbitalGeneral, 1, MPI_INT, 0, comm); // for fsz
   MPI_Bcast(bufDouble, nBufDouble, MPI_DOUBLE, 0, comm);
@@ -614,6 +632,7 @@ int ReadDefFileNInt(char *xNameListFile, MPI_Comm comm) {
   NSROptFixSmp = bufInt[IdxSROptFixSmp];
   NVMCWarmUp = bufInt[IdxVMCWarmUp];
   NVMCInterval = bufInt[IdxVMCInterval];
+  NVMCIntervalMax = 4*NVMCInterval;
   NVMCSample = bufInt[IdxVMCSample];
   NExUpdatePath = bufInt[IdxExUpdatePath];
   RndSeed = bufInt[IdxRndSeed];
@@ -644,6 +663,7 @@ int ReadDefFileNInt(char *xNameListFile, MPI_Comm comm) {
   DSROptStaDel = bufDouble[IdxSROptStaDel];
   DSROptStepDt = bufDouble[IdxSROptStepDt];
   DSROptCGTol = bufDouble[IdxSROptCGTol];
+  DVMCErrorTarget = bufDouble[IdxVMCErrorTarget];
   TwoSz = bufInt[Idx2Sz];
 
   if (NMPTrans < 0) {
@@ -749,10 +769,15 @@ int ReadDefFileIdxPara(char *xNameListFile, MPI_Comm comm) {
   int rank;
 
   int iNOneBodyG;
+  /* the container is read by every process in place of the def files */
+  const int flagDefBinary = (NDefBinary != 0 && FlagDefConvert == 0);
 
   MPI_Comm_rank(comm, &rank);
 
-  if (rank == 0) {
+  if (flagDefBinary) {
+    info = ReadDefBinary(comm);
+    if (rank == 0) fprintf(stdout, "finish reading parameters.\n");
+  } else if (rank == 0) {
     for (iKWidx = KWLocSpin; iKWidx < KWIdxInt_end; iKWidx++) {
       strcpy(defname, cFileNameListFile[iKWidx]);
       if (strcmp(defname, "") == 0) continue;
@@ -980,13 +1005,15 @@ int ReadDefFileIdxPara(char *xNameListFile, MPI_Comm comm) {
   }
   */
 #ifdef _mpi_use
-  SafeMpiBcastInt(LocSpn, NTotalDefInt, comm);
-  if (NLanczosMode > 1) {
-    SafeMpiBcastInt(CisAjsCktAltLzIdx[0], NCisAjsCktAltDC * 2, comm);
+  if (!flagDefBinary) {
+    SafeMpiBcastInt(LocSpn, NTotalDefInt, comm);
+    if (NLanczosMode > 1) {
+      SafeMpiBcastInt(CisAjsCktAltLzIdx[0], NCisAjsCktAltDC * 2, comm);
+    }
+    SafeMpiBcast_fcmp(ParaTransfer, NTransfer + NInterAll, comm);
+    SafeMpiBcast(ParaCoulombIntra, NTotalDefDouble, comm);
+    SafeMpiBcast_fcmp(ParaQPTrans, NQPTrans, comm);
   }
-  SafeMpiBcast_fcmp(ParaTransfer, NTransfer + NInterAll, comm);
-  SafeMpiBcast(ParaCoulombIntra, NTotalDefDouble, comm);
-  SafeMpiBcast_fcmp(ParaQPTrans, NQPTrans, comm);
 #endif /* _mpi_use */
 
   /* set FlagShift */
@@ -1493,8 +1520,21 @@ void SetDefaultValuesModPara(int *bufInt, double *bufDouble) {
   bufDouble[IdxSROptStaDel] = 0.02;
   bufDouble[IdxSROptStepDt] = 0.02;
   bufDouble[IdxSROptCGTol] = 1.0e-10;
+  bufDouble[IdxVMCErrorTarget] = 0.0;
   NStoreO = 1;
   NSRCG = 0;
+  NInlineMeasure = 0;
+  NMultiChain = 0;
+  NCompressSlater = 0;
+  NDelayUpdate = 0;
+  NCheckpoint = 0;
+  NSROptCGPrecond = 1;
+  NDefBinary = 0;
+  NProfile = 0;
+  NSplitChain = 0;
+  NAsyncOutput = 0;
+  NHopProposal = 0;
+  NAutoCorr = 0;
 }
 
 int GetInfoFromModPara(int *bufInt, double *bufDouble) {
@@ -1592,6 +1632,8 @@ int GetInfoFromModPara(int *bufInt, double *bufDouble) {
               bufInt[IdxSROptCGMaxIter] = (int) dtmp;
             } else if (CheckWords(ctmp, "DSROptCGTol") == 0) {
               bufDouble[IdxSROptCGTol] = (double) dtmp;
+            } else if (CheckWords(ctmp, "NSROptCGPrecond") == 0) {
+              NSROptCGPrecond = (int) dtmp;
             } else if (CheckWords(ctmp, "NVMCWarmUp") == 0) {
               bufInt[IdxVMCWarmUp] = (int) dtmp;
             } else if (CheckWords(ctmp, "NVMCInterval") == 0) {
@@ -1608,6 +1650,30 @@ int GetInfoFromModPara(int *bufInt, double *bufDouble) {
               NStoreO = (int) dtmp;
             } else if (CheckWords(ctmp, "NSRCG") == 0) {
               NSRCG = (int) dtmp;
+            } else if (CheckWords(ctmp, "NInlineMeasure") == 0) {
+              NInlineMeasure = (int) dtmp;
+            } else if (CheckWords(ctmp, "NMultiChain") == 0) {
+              NMultiChain = (int) dtmp;
+            } else if (CheckWords(ctmp, "NCompressSlater") == 0) {
+              NCompressSlater = (int) dtmp;
+            } else if (CheckWords(ctmp, "NDelayUpdate") == 0) {
+              NDelayUpdate = (int) dtmp;
+            } else if (CheckWords(ctmp, "NCheckpoint") == 0) {
+              NCheckpoint = (int) dtmp;
+            } else if (CheckWords(ctmp, "NDefBinary") == 0) {
+              NDefBinary = (int) dtmp;
+            } else if (CheckWords(ctmp, "NProfile") == 0) {
+              NProfile = (int) dtmp;
+            } else if (CheckWords(ctmp, "NSplitChain") == 0) {
+              NSplitChain = (int) dtmp;
+            } else if (CheckWords(ctmp, "NAsyncOutput") == 0) {
+              NAsyncOutput = (int) dtmp;
+            } else if (CheckWords(ctmp, "NHopProposal") == 0) {
+              NHopProposal = (int) dtmp;
+            } else if (CheckWords(ctmp, "NAutoCorr") == 0) {
+              NAutoCorr = (int) dtmp;
+            } else if (CheckWords(ctmp, "DVMCErrorTarget") == 0) {
+              bufDouble[IdxVMCErrorTarget] = (double) dtmp;
             } else {
               fprintf(stderr, "  Error: keyword \" %s \" is incorrect. \n", ctmp);
               iret = ReadDefFileError(defname);
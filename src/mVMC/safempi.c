@@ -27,6 +27,7 @@ along with this program. If not, see http://www.gnu.org/licenses/.
  *-------------------------------------------------------------*/
 
 #define D_MpiSendMax  1048576 /* 2^20 */
+#define D_MpiPipeDepth 4 /* the number of chunks reduced concurrently */
 
 void SafeMpiReduce(double *send, double *recv, int nData, MPI_Comm comm);
 void SafeMpiAllReduce(double *send, double *recv, int nData, MPI_Comm comm);
@@ -37,12 +38,26 @@ void SafeMpiReduce(double *send, double *recv, int nData, MPI_Comm comm) {
   #ifdef _mpi_use
   int nSend = D_MpiSendMax; /* defined in global.h */
   int idx = 0;
+  #if MPI_VERSION >= 3
+  /* the chunks are pipelined: up to D_MpiPipeDepth reductions are in flight */
+  MPI_Request req[D_MpiPipeDepth];
+  int k = 0;
 
+  while(idx<nData) {
+    if(idx+nSend > nData) nSend = nData-idx;
+    if(k>=D_MpiPipeDepth) MPI_Wait(&req[k%D_MpiPipeDepth],MPI_STATUS_IGNORE);
+    MPI_Ireduce(send+idx,recv+idx,nSend,MPI_DOUBLE,MPI_SUM,0,comm,&req[k%D_MpiPipeDepth]);
+    idx += nSend;
+    k++;
+  }
+  MPI_Waitall((k<D_MpiPipeDepth ? k : D_MpiPipeDepth),req,MPI_STATUSES_IGNORE);
+  #else
   while(idx<nData) {
     if(idx+nSend > nData) nSend = nData-idx;
     MPI_Reduce(send+idx,recv+idx,nSend,MPI_DOUBLE,MPI_SUM,0,comm);
     idx += nSend;
   }
+  #endif
 
   #endif
   return;
@@ -52,12 +67,26 @@ void SafeMpiAllReduce(double *send, double *recv, int nData, MPI_Comm comm) {
   #ifdef _mpi_use
   int nSend = D_MpiSendMax; /* defined in global.h */
   int idx = 0;
+  #if MPI_VERSION >= 3
+  /* the chunks are pipelined: up to D_MpiPipeDepth reductions are in flight */
+  MPI_Request req[D_MpiPipeDepth];
+  int k = 0;
 
+  while(idx<nData) {
+    if(idx+nSend > nData) nSend = nData-idx;
+    if(k>=D_MpiPipeDepth) MPI_Wait(&req[k%D_MpiPipeDepth],MPI_STATUS_IGNORE);
+    MPI_Iallreduce(send+idx,recv+idx,nSend,MPI_DOUBLE,MPI_SUM,comm,&req[k%D_MpiPipeDepth]);
+    idx += nSend;
+    k++;
+  }
+  MPI_Waitall((k<D_MpiPipeDepth ? k : D_MpiPipeDepth),req,MPI_STATUSES_IGNORE);
+  #else
   while(idx<nData) {
     if(idx+nSend > nData) nSend = nData-idx;
     MPI_Allreduce(send+idx,recv+idx,nSend,MPI_DOUBLE,MPI_SUM,comm);
     idx += nSend;
   }
+  #endif
 
   #endif
   return;
@@ -30,6 +30,8 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 #include <complex.h>
 #include "global.h"
 #include "setmemory.h"
+#include "slater.h"
+#include "vmcmake.h"
 
 #ifndef _SRC_SETMEMORY
 #define _SRC_SETMEMORY
@@ -255,9 +257,88 @@ void FreeMemoryDef() {
   return;
 }
 
-void SetMemory() {
+static int cmpLSHop(const void *a, const void *b) {
+  const int ka = ((const int*)a)[0];
+  const int kb = ((const int*)b)[0];
+  return (ka>kb) - (ka<kb);
+}
+
+/* Set the distinct hops C_is A_js of Transfer and CisAjsIdx, */
+/* whose <psi|H CA|x>/<psi|x> are shared in the Lanczos step. */
+void setLSHopIdx() {
+  const int nHop = NTransfer + ((NLanczosMode>1) ? NCisAjs : 0);
+  int *key; /* key[nHop][2] = {rsi*Nsite2+rsj, index of the term} */
+  int *op;
   int i;
 
+  NLSTerm = NPairHopping + 2*NExchangeCoupling + NInterAll;
+  LSHopIdx = (int*)malloc(sizeof(int)*(3*nHop+nHop+nHop+NLSTerm));
+  LSHopTransfer = LSHopIdx + 3*nHop;
+  LSHopCisAjs = LSHopTransfer + NTransfer;
+  LSTermFlag = LSHopTransfer + nHop;
+
+  key = (int*)malloc(sizeof(int)*2*nHop);
+  for(i=0;i<nHop;i++) {
+    op = (i<NTransfer) ? Transfer[i] : CisAjsIdx[i-NTransfer];
+    key[2*i] = (op[0]+op[3]*Nsite)*Nsite2 + op[2]+op[3]*Nsite;
+    key[2*i+1] = i;
+  }
+  qsort(key, nHop, 2*sizeof(int), cmpLSHop);
+
+  NLSHop = 0;
+  for(i=0;i<nHop;i++) {
+    if(i==0 || key[2*i]!=key[2*i-2]) {
+      op = (key[2*i+1]<NTransfer) ? Transfer[key[2*i+1]] : CisAjsIdx[key[2*i+1]-NTransfer];
+      LSHopIdx[3*NLSHop]   = op[0];
+      LSHopIdx[3*NLSHop+1] = op[2];
+      LSHopIdx[3*NLSHop+2] = op[3];
+      NLSHop++;
+    }
+    LSHopTransfer[key[2*i+1]] = NLSHop-1;
+  }
+  free(key);
+
+  LSHopVal = (double complex*)malloc(sizeof(double complex)*(NLSHop+NLSTerm));
+  LSHopVal_real = (double*)LSHopVal;
+  return;
+}
+
+/* Set the conduction sites connected to each site by Transfer, */
+/* which are the targets of the hopping proposals with NHopProposal!=0. */
+void setHopNbr() {
+  char *flag; /* flag[ri*Nsite+rj] = 1 if ri and rj are connected */
+  int idx,ri,rj,n;
+
+  flag = (char*)calloc((size_t)Nsite*Nsite, sizeof(char));
+  for(idx=0;idx<NTransfer;idx++) {
+    ri = Transfer[idx][0];
+    rj = Transfer[idx][2];
+    if(ri==rj || LocSpn[ri]==1 || LocSpn[rj]==1) continue;
+    flag[ri*Nsite+rj] = 1;
+    flag[rj*Nsite+ri] = 1;
+  }
+
+  n = 0;
+  for(idx=0;idx<Nsite*Nsite;idx++) n += flag[idx];
+
+  HopNbrIdx = (int*)malloc(sizeof(int)*(Nsite+1+n));
+  HopNbr = HopNbrIdx + Nsite+1;
+  n = 0;
+  for(ri=0;ri<Nsite;ri++) {
+    HopNbrIdx[ri] = n;
+    for(rj=0;rj<Nsite;rj++) {
+      if(flag[ri*Nsite+rj]) HopNbr[n++] = rj;
+    }
+  }
+  HopNbrIdx[Nsite] = n;
+  free(flag);
+  return;
+}
+
+void SetMemory() {
+  int i,j;
+  int flagCompress;
+
   /***** Variational Parameters *****/
   //printf("DEBUG:opt=%d %d %d %d %d Ne=%d\n", AllComplexFlag,NPara,NProj,NSlater,NOrbitalIdx,Ne);
   Para     = (double complex*)malloc(sizeof(double complex)*(NPara));
@@ -276,11 +357,9 @@ void SetMemory() {
   EleSpn            = (int*)malloc(sizeof(int)*( NVMCSample*2*Ne ));//fsz
 //[e] MERGE BY TM
   logSqPfFullSlater = (double*)malloc(sizeof(double)*(NVMCSample));
+  if(NAutoCorr!=0) LocalE = (double*)malloc(sizeof(double)*(NVMCSample));
   if (NBackFlowIdx > 0) {
     EleProjBFCnt = (int*)malloc(sizeof(int)*( NVMCSample*4*4*Nsite*Nrange));
-    SmpSltElmBF_real = (double *)malloc(sizeof(double)*(NVMCSample*NQPFull*(2*Nsite)*(2*Nsite)));
-    SmpEta = (double*)malloc(sizeof(double*)*NVMCSample*NQPFull*Nsite*Nsite);
-    SmpEtaFlag = (int*)malloc(sizeof(int*)*NVMCSample*NQPFull*Nsite*Nsite);
     SlaterElmBF_real = (double*)malloc( sizeof(double)*(NQPFull*(2*Nsite)*(2*Nsite)) );
     eta = (double complex**)malloc(sizeof(double complex*)*Nsite);
       for(i=0;i<Nsite;i++) {
@@ -304,6 +383,8 @@ void SetMemory() {
   TmpEleSpn         = TmpEleProjCnt + NProj; //fsz
   TmpEleProjBFCnt = TmpEleProjCnt + NProj;
 //[e] MERGE BY TM
+  TmpEleLst         = (int*)malloc(sizeof(int)*SizeEleLst());
+  if(NHopProposal!=0) setHopNbr();
 
   BurnEleIdx        = (int*)malloc(sizeof(int)*(2*Ne+2*Nsite+2*Nsite+NProj+2*Ne)); //fsz
   BurnEleCfg        = BurnEleIdx + 2*Ne;
@@ -311,15 +392,73 @@ void SetMemory() {
   BurnEleProjCnt    = BurnEleNum + 2*Nsite;
   BurnEleSpn        = BurnEleProjCnt + NProj; //fsz
 
+  if(NMultiChain>0) {
+    ChainEleIdx     = (int*)malloc(sizeof(int)*NThread*2*(Nsize+2*Nsite2+NProj));
+    ChainBurnEleIdx = ChainEleIdx + NThread*(Nsize+2*Nsite2+NProj);
+    ChainEleLst     = (int*)malloc(sizeof(int)*NThread*SizeEleLst());
+    ChainInvM       = (double complex*)malloc(sizeof(double complex)*NThread*NQPFull*(Nsize*Nsize+1));
+    ChainInvM_real  = (double*)ChainInvM;
+    ChainRandState  = (uint32_t*)malloc(sizeof(uint32_t)*NThread*get_state_size32());
+  }
+
+  /***** Site index of the Jastrow factors ******/
+  if(NJastrowIdx>0) {
+    ProjSiteIdx = (int*)malloc(sizeof(int)*(Nsite*Nsite));
+    for(i=0;i<Nsite;i++) {
+      for(j=0;j<Nsite;j++) {
+        if(i<j) ProjSiteIdx[i*Nsite+j] = NGutzwillerIdx + JastrowIdx[i][j];
+        else ProjSiteIdx[i*Nsite+j] = NGutzwillerIdx + JastrowIdx[j][i];
+      }
+    }
+  }
+
   /***** Slater Elements ******/
-  SlaterElm = (double complex*)malloc( sizeof(double complex)*(NQPFull*(2*Nsite)*(2*Nsite)) );
-  InvM = (double complex*)malloc( sizeof(double complex)*(NQPFull*(Nsize*Nsize+1)) );
-  PfM = InvM + NQPFull*Nsize*Nsize;
-// for real TBC
-  SlaterElm_real = (double*)malloc(sizeof(double)*(NQPFull*(2*Nsite)*(2*Nsite)) );
+  flagCompress = (NCompressSlater>0 && iFlgOrbitalGeneral==0 && NProjBF==0);
+#ifdef _pf_block_update
+  flagCompress = 0; /* the block update reads the dense SlaterElm */
+#endif
+  if(flagCompress) {
+    SlaterElm = NULL;
+    SlaterElm_real = NULL;
+    SlaterElmBase = (double complex*)malloc(sizeof(double complex)*(Nsite*Nsite));
+    SlaterElmBase_real = (double*)malloc(sizeof(double)*(Nsite*Nsite+3*NSPGaussLeg));
+    SlaterElmSPCoef = SlaterElmBase_real + Nsite*Nsite;
+    SlaterElmTrans = (int*)malloc(sizeof(int)*(2*NMPTrans*NQPOptTrans*Nsite));
+    SlaterElmTransSgn = SlaterElmTrans + NMPTrans*NQPOptTrans*Nsite;
+  } else {
+    SlaterElm = NULL;
+    SlaterElm_real = NULL;
+    if(IsComplexSlaterElm()) {
+      SlaterElm = (double complex*)malloc( sizeof(double complex)*(NQPFull*(2*Nsite)*(2*Nsite)) );
+    }
+    if(AllComplexFlag==0) {
+      SlaterElm_real = (double*)malloc(sizeof(double)*(NQPFull*(2*Nsite)*(2*Nsite)) );
+    }
+    SlaterElmBase = NULL;
+  }
+  /* only the arrays of the type of the wave function are allocated */
+  InvM = NULL;
+  PfM = NULL;
+  InvM_real = NULL;
+  PfM_real = NULL;
+  if(IsComplexSlaterElm()) {
+    InvM = (double complex*)malloc( sizeof(double complex)*(NQPFull*(Nsize*Nsize+1)) );
+    PfM = InvM + NQPFull*Nsize*Nsize;
+  }
+  if(AllComplexFlag==0) {
+    InvM_real      = (double*)malloc(sizeof(double)*(NQPFull*(Nsize*Nsize+1)) );
+    PfM_real       = InvM_real + NQPFull*Nsize*Nsize;
+  }
+  if(NDelayUpdate>0) {
+    InvMDelay = (double complex*)malloc(sizeof(double complex)*(NQPFull*Nsize*2*NDelayUpdate));
+    InvMDelay_real = (double*)InvMDelay;
+  }
 
-  InvM_real      = (double*)malloc(sizeof(double)*(NQPFull*(Nsize*Nsize+1)) );
-  PfM_real       = InvM_real + NQPFull*Nsize*Nsize;
+  /***** Batched Green functions *****/
+  i = (NTransfer>NCisAjs) ? NTransfer : NCisAjs;
+  GreenBatchWork = (int*)malloc(sizeof(int)*(3*i+2*Nsize+2*Nsite2));
+  GreenTransfer = (double complex*)malloc(sizeof(double complex)*NTransfer);
+  GreenTransfer_real = (double*)GreenTransfer;
 
   /***** Quantum Projection *****/
   QPFullWeight = (double complex*)malloc(sizeof(double complex)*(NQPFull+NQPFix+5*NSPGaussLeg));
@@ -333,46 +472,56 @@ void SetMemory() {
   /***** Stocastic Reconfiguration *****/
   if(NVMCCalMode==0){
     //SR components are described by real and complex components of O
-    if(NSRCG==0){
+    if(!IsSROptOODiag()){
       SROptOO = (double complex*)malloc( sizeof(double complex)*((2*SROptSize)*(2*SROptSize+2))) ; //TBC
       SROptHO = SROptOO + (2*SROptSize)*(2*SROptSize); //TBC
       SROptO  = SROptHO + (2*SROptSize);  //TBC
     }else{
-      // OO contains only <O_i> and <O_i O_i> in SR-CG
+      // OO contains only <O_i> and <O_i O_i> in SR-CG and with the distributed S
       SROptOO = (double complex*)malloc( sizeof(double complex)*(2*SROptSize)*4) ; //TBC
       SROptHO = SROptOO + 2*SROptSize*2; //TBC
       SROptO  = SROptHO + 2*SROptSize;  //TBC
     }
 //for real
-    if(NSRCG==0){
+    if(!IsSROptOODiag()){
       SROptOO_real = (double*)malloc( sizeof(double )*SROptSize*(SROptSize+2)) ; //TBC
       SROptHO_real = SROptOO_real + (SROptSize)*(SROptSize); //TBC
       SROptO_real  = SROptHO_real + (SROptSize);  //TBC
     }else{
-      // OO contains only <O_i> and <O_i O_i> in SR-CG
+      // OO contains only <O_i> and <O_i O_i> in SR-CG and with the distributed S
       SROptOO_real = (double*)malloc( sizeof(double )*SROptSize*4) ; //TBC
       SROptHO_real = SROptOO_real + SROptSize*2; //TBC
       SROptO_real  = SROptHO_real + SROptSize;  //TBC
     }
 
-    if(NSRCG==1 || NStoreO!=0){
+    if(NSRCG!=0 || NStoreO!=0){
       //if(AllComplexFlag==0 && iFlgOrbitalGeneral==0){ //real & sz=0
       if(AllComplexFlag==0){ //real & sz=0
-        SROptO_Store_real = (double *)malloc(sizeof(double)*(SROptSize*NVMCSample) );
+        SROptO_Store_real = (double *)calloc(SROptSize*NVMCSample, sizeof(double));
       }else{
-        SROptO_Store      = (double complex*)malloc( sizeof(double complex)*(2*SROptSize*NVMCSample) );
+        SROptO_Store      = (double complex*)calloc(2*SROptSize*NVMCSample, sizeof(double complex));
       }
     }
+    if(!IsSROptOODiag() && NStoreO==0){
+      /* the panel of O is limited to D_SROptPanelMem bytes */
+      NSROptPanel = D_SROptPanelMem/(sizeof(double complex)*2*SROptSize);
+      if(NSROptPanel>NVMCSample) NSROptPanel = NVMCSample;
+      if(NSROptPanel<1) NSROptPanel = 1;
+      SROptO_Panel = (double complex*)malloc( sizeof(double complex)*(2*SROptSize*NSROptPanel) );
+      SROptO_Panel_real = (double*)SROptO_Panel;
+    }
+    SROptPanelCnt = 0;
     SROptData = (double complex*)malloc( sizeof(double complex)*(NSROptItrSmp*(2+NPara)) );
   }
 
   /***** Physical Quantity *****/
   if(NVMCCalMode==1){
     PhysCisAjs  = (double complex*)malloc(sizeof(double complex)
-                    *(NCisAjs+NCisAjsCktAlt+NCisAjsCktAltDC+NCisAjs));
+                    *(NCisAjs+NCisAjsCktAlt+NCisAjsCktAltDC+2*NCisAjs));
     PhysCisAjsCktAlt   = PhysCisAjs       + NCisAjs;
     PhysCisAjsCktAltDC = PhysCisAjsCktAlt + NCisAjsCktAlt;
     LocalCisAjs = PhysCisAjsCktAltDC + NCisAjsCktAltDC;
+    LocalCisAjs_real = (double*)(LocalCisAjs + NCisAjs);
 
     if(NLanczosMode>0){
       QQQQ = (double complex*)malloc(sizeof(double complex)
@@ -395,6 +544,8 @@ void SetMemory() {
         LSLCisAjs_real = QCisAjsCktAltQ_real + NLSHam*NLSHam*NCisAjsCktAltDC;
 
       }
+
+      setLSHopIdx();
     }
   }
 
@@ -403,6 +554,8 @@ void SetMemory() {
 }
 
 void FreeMemory() {
+  int i;
+
   FreeWorkSpaceAll();
 
   if(NVMCCalMode==1){
@@ -414,22 +567,57 @@ void FreeMemory() {
         free(QCisAjsQ);
         free(QCisAjsQ_real);
       }
+      free(LSHopIdx);
+      free(LSHopVal);
     }
   }
 
   if(NVMCCalMode==0){
     free(SROptData);
     free(SROptOO);
+    if(!IsSROptOODiag() && NStoreO==0) free(SROptO_Panel);
   }
 
   free(QPFullWeight);
 
+  free(GreenTransfer);
+  free(GreenBatchWork);
   free(InvM);
+  free(InvM_real);
   free(SlaterElm);
+  free(SlaterElm_real);
+  if(NDelayUpdate>0) free(InvMDelay);
+  if(NJastrowIdx>0) free(ProjSiteIdx);
+  if(SlaterElmBase!=NULL) {
+    free(SlaterElmTrans);
+    free(SlaterElmBase_real);
+    free(SlaterElmBase);
+  }
 
+  if(NMultiChain>0) {
+    free(ChainRandState);
+    free(ChainInvM);
+    free(ChainEleIdx);
+    free(ChainEleLst);
+  }
   free(BurnEleIdx);
+  free(TmpEleLst);
+  if(NHopProposal!=0) free(HopNbrIdx);
   free(TmpEleIdx);
+  if (NBackFlowIdx > 0) {
+    for(i=0;i<NrangeIdx;i++) free(BFSubIdx[i]);
+    free(BFSubIdx);
+    for(i=0;i<Nsite;i++) {
+      free(etaFlag[i]);
+      free(eta[i]);
+    }
+    free(etaFlag);
+    free(eta);
+    free(SlaterElmBF_real);
+    free(EleProjBFCnt);
+  }
   free(logSqPfFullSlater);
+  if(NAutoCorr!=0) free(LocalE);
   free(EleProjCnt);
   free(EleIdx);
   free(EleCfg);
@@ -34,215 +34,202 @@ void SubSlaterElmBF_fcmp(const int tri, const int trj, double complex*slt_ij, in
 
 void SubSlaterElmBF_real(const int tri, const int trj, double *slt_ij, int *ijcount, double *slt_ji, int *jicount, const int *eleProjBFCnt);
 
-void UpdateSlaterElm_fcmp() {
-  int ri,ori,tri,sgni,rsi0,rsi1;
-  int rj,orj,trj,sgnj,rsj0,rsj1;
-  int qpidx,mpidx,spidx,optidx;
-  double cs,cc,ss;
-  double complex slt_ij,slt_ji;
+/* SlaterElm, InvM and PfM are complex (1) or real (0). */
+/* The real wave function keeps the complex ones as well only for the */
+/* backflow and OrbitalGeneral paths, which measure with complex kernels. */
+int IsComplexSlaterElm() {
+  return (AllComplexFlag!=0 || NProjBF>0 || iFlgOrbitalGeneral>0);
+}
+
+/* Store the compressed SlaterElm. */
+/* SlaterElm[qpidx] differs from SlaterElmBase only by the permutation of */
+/* the translation mpidx (and optidx), its signs and the spin rotation spidx. */
+void updateSlaterElmCompress() {
+  const int nTrans = NMPTrans*NQPOptTrans;
+  int i,ri,ori,tri,trj,optidx,mpidx,spidx,tidx;
   int *xqp, *xqpSgn, *xqpOpt, *xqpOptSgn;
-  double complex *sltE,*sltE_i0,*sltE_i1;
 
-  #pragma omp parallel for default(shared)        \
-    private(qpidx,optidx,mpidx,spidx,                      \
-            xqpOpt,xqpOptSgn,xqp,xqpSgn,cs,cc,ss,sltE,     \
-            ri,ori,tri,sgni,rsi0,rsi1,sltE_i0,sltE_i1,      \
-            rj,orj,trj,sgnj,rsj0,rsj1,slt_ij,slt_ji)
-  #pragma loop noalias
-  for(qpidx=0;qpidx<NQPFull;qpidx++) {
-    // qpidx  = optidx*NQPFix+NSPGaussLeg*mpidx+spidx 
-    // NQPFix = NSPGaussLeg*NMPTrans
-    optidx    = qpidx / NQPFix;                // optidx -> optrans projection (will not be used ?)
-    mpidx     = (qpidx%NQPFix) / NSPGaussLeg;  // mpidx  -> momentum projection
-    spidx     = qpidx % NSPGaussLeg;           // spidx  -> spin     projection
-
-    xqpOpt    = QPOptTrans[optidx];    //
-    xqpOptSgn = QPOptTransSgn[optidx]; //
-    xqp       = QPTrans[mpidx];        //QPTrans[i][j]: i # of trans. op.,j origin of trans. op. 
+  #pragma omp parallel for default(shared) private(i,tri,trj)
+  for(i=0;i<Nsite*Nsite;i++) {
+    tri = i / Nsite;
+    trj = i % Nsite;
+    SlaterElmBase[i] = Slater[ OrbitalIdx[tri][trj] ] * (double)(OrbitalSgn[tri][trj]);
+    SlaterElmBase_real[i] = creal(SlaterElmBase[i]);
+  }
+
+  for(tidx=0;tidx<nTrans;tidx++) {
+    optidx    = tidx / NMPTrans;
+    mpidx     = tidx % NMPTrans;
+    xqpOpt    = QPOptTrans[optidx];
+    xqpOptSgn = QPOptTransSgn[optidx];
+    xqp       = QPTrans[mpidx];
     xqpSgn    = QPTransSgn[mpidx];
-    cs        = SPGLCosSin[spidx];
-    cc        = SPGLCosCos[spidx];
-    ss        = SPGLSinSin[spidx];
-    
-    sltE      = SlaterElm + qpidx*Nsite2*Nsite2;
-    
     for(ri=0;ri<Nsite;ri++) {
-      ori     = xqpOpt[ri];           // ri (OptTrans) -> ori (Trans)-> tri
-      tri     = xqp[ori];
-      sgni    = xqpSgn[ori]*xqpOptSgn[ri];
-      rsi0    = ri;
-      rsi1    = ri+Nsite;
-      sltE_i0 = sltE + rsi0*Nsite2;
-      sltE_i1 = sltE + rsi1*Nsite2;
-      
-      for(rj=0;rj<Nsite;rj++) {
-        orj = xqpOpt[rj];
-        trj = xqp[orj];
-        sgnj = xqpSgn[orj]*xqpOptSgn[rj];
-        rsj0 = rj;
-        rsj1 = rj+Nsite;
-        
-        slt_ij = Slater[ OrbitalIdx[tri][trj] ] * (double)(OrbitalSgn[tri][trj]*sgni*sgnj);
-        slt_ji = Slater[ OrbitalIdx[trj][tri] ] * (double)(OrbitalSgn[trj][tri]*sgni*sgnj);
-        
-        sltE_i0[rsj0] = -(slt_ij - slt_ji)*cs;   // up   - up
-        sltE_i0[rsj1] =   slt_ij*cc + slt_ji*ss; // up   - down
-        sltE_i1[rsj0] = -slt_ij*ss - slt_ji*cc;  // down - up
-        sltE_i1[rsj1] =  (slt_ij - slt_ji)*cs;   // down - down 
-      }
+      ori = xqpOpt[ri];
+      SlaterElmTrans[tidx*Nsite+ri]    = xqp[ori];
+      SlaterElmTransSgn[tidx*Nsite+ri] = xqpSgn[ori]*xqpOptSgn[ri];
     }
   }
 
+  for(spidx=0;spidx<NSPGaussLeg;spidx++) {
+    SlaterElmSPCoef[3*spidx  ] = creal(SPGLCosSin[spidx]);
+    SlaterElmSPCoef[3*spidx+1] = creal(SPGLCosCos[spidx]);
+    SlaterElmSPCoef[3*spidx+2] = creal(SPGLSinSin[spidx]);
+  }
+
   return;
 }
 
-// Calculating Tr[Inv[M]*D_k(X)]
-void SlaterElmDiff_fcmp(double complex *srOptO, const double complex ip, int *eleIdx) {
-  const int nBuf=NSlater*NQPFull;
-  const int nsize = Nsize;
-  const int ne = Ne;
-  const int nQPFull = NQPFull;
-  const int nMPTrans = NMPTrans; // number of translational operators
-  const int nSlater = NSlater;
-  const int nTrans = NMPTrans * NQPOptTrans; //usually NQPOptTrans=1
-
-  const double complex invIP = 1.0/ip;
-  int msi,msj,ri,rj,ori,orj,tri,trj,sgni,sgnj;
-  int mpidx,spidx,orbidx,qpidx,optidx,i;
-  double complex cs,cc,ss; // including Pf
-  int *xqp,*xqpSgn,*xqpOpt,*xqpOptSgn;
-  double complex *invM,*invM_i;
-
-  int *orbitalIdx_i;
-  int *transOrbIdx; /* transOrbIdx[mpidx][msi][msj] */
-  int *transOrbSgn; /* transOrbSgn[mpidx][msi][msj] */
-  int *tOrbIdx,*tOrbIdx_i;
-  int *tOrbSgn,*tOrbSgn_i;
-  double complex *buf, *buffer;
-  double complex tmp;
-
-  RequestWorkSpaceInt(2*nTrans*Nsize*Nsize);
-  RequestWorkSpaceComplex(NQPFull*NSlater);
-
-  transOrbIdx = GetWorkSpaceInt(nTrans*Nsize*Nsize); /* transOrbIdx[mpidx][msi][msj] */
-  transOrbSgn = GetWorkSpaceInt(nTrans*Nsize*Nsize); /* transOrbSgn[mpidx][msi][msj] */
-  buffer = GetWorkSpaceComplex(NQPFull*NSlater);
-
-  for(i=0;i<nBuf;i++) buffer[i]=0.0;
+/* SlaterElm[qpidx][rsi][rsj] */
+double complex SlaterElmAt_fcmp(const int qpidx, const int rsi, const int rsj) {
+  int tidx,spidx,si,sj,ri,rj,tri,trj;
+  double sgn,cs,cc,ss;
+  double complex slt_ij,slt_ji;
 
-  #pragma omp parallel for default(shared)                        \
-    private(qpidx,optidx,mpidx,msi,msj,xqp,xqpSgn,xqpOpt,xqpOptSgn,\
-            ri,ori,tri,sgni,rj,orj,trj,sgnj,                       \
-            tOrbIdx,tOrbIdx_i,tOrbSgn,tOrbSgn_i,orbitalIdx_i)
-  #pragma loop noalias
-  for(qpidx=0;qpidx<nTrans;qpidx++) {            // nTran=nMPTrans*NQPOptTrans: usually nMPTrans
-    optidx    = qpidx / nMPTrans;                // qpidx=mpidx+nMPTrans*optidx
-    mpidx     = qpidx % nMPTrans; 
-                                                 // QPOptTrans:     NQPOptTrans* Nsite matrix :  usually NQPOptTrans = 1
-                                                 // QPOptTransSgn:  NQPOptTrans* Nsite matrix :  usually NQPOptTrans = 1 
-    xqpOpt    = QPOptTrans[optidx];              // xqpOpt[]    = QPOptTrans[optidx][]    : usually optidx=0 and not be used
-    xqpOptSgn = QPOptTransSgn[optidx];           // xqpOptSgn[] = QPOptTransSgn[optidx][] : usually optidx=0 and not be used
-    xqp       = QPTrans[mpidx];                  // xqp    =  QPTrans[mpidx][]
-    xqpSgn    = QPTransSgn[mpidx];               // xqpSgn =  QPTransSgn[mpidx][]
-    tOrbIdx   = transOrbIdx + qpidx*nsize*nsize; // tOrbIdx : f_ij
-    tOrbSgn   = transOrbSgn + qpidx*nsize*nsize; // tOrbSgn : sign of f_ij
-    for(msi=0;msi<nsize;msi++) {                 // nsize=2*Ne
-      ri           = eleIdx[msi];                //  ri  : postion where the msi-th electron exists  
-      ori          = xqpOpt[ri];                 // ori  : 
-      tri          = xqp[ori];                   // tri  : 
-      sgni         = xqpSgn[ori]*xqpOptSgn[ri];  // sgni :
-      tOrbIdx_i    = tOrbIdx + msi*nsize;        // 
-      tOrbSgn_i    = tOrbSgn + msi*nsize;        //
-      orbitalIdx_i = OrbitalIdx[tri];            //
-      for(msj=0;msj<nsize;msj++) { //nsize=2*Ne //
-        rj             = eleIdx[msj];           //
-        orj            = xqpOpt[rj];         
-        trj            = xqp[orj];
-        sgnj           = xqpSgn[orj]*xqpOptSgn[rj];
-        tOrbIdx_i[msj] = orbitalIdx_i[trj];
-        tOrbSgn_i[msj] = sgni*sgnj*OrbitalSgn[tri][trj];
-      }
-    }
+  if(SlaterElmBase==NULL) return SlaterElm[(qpidx*Nsite2+rsi)*Nsite2+rsj];
+
+  /* qpidx = optidx*NQPFix+NSPGaussLeg*mpidx+spidx */
+  tidx  = qpidx / NSPGaussLeg;
+  spidx = qpidx % NSPGaussLeg;
+  si = (rsi<Nsite) ? 0 : 1;
+  sj = (rsj<Nsite) ? 0 : 1;
+  ri = rsi - si*Nsite;
+  rj = rsj - sj*Nsite;
+
+  tri = SlaterElmTrans[tidx*Nsite+ri];
+  trj = SlaterElmTrans[tidx*Nsite+rj];
+  sgn = (double)(SlaterElmTransSgn[tidx*Nsite+ri]*SlaterElmTransSgn[tidx*Nsite+rj]);
+  slt_ij = SlaterElmBase[tri*Nsite+trj]*sgn;
+  slt_ji = SlaterElmBase[trj*Nsite+tri]*sgn;
+  cs = SlaterElmSPCoef[3*spidx  ];
+  cc = SlaterElmSPCoef[3*spidx+1];
+  ss = SlaterElmSPCoef[3*spidx+2];
+
+  if(si==0) {
+    if(sj==0) return -(slt_ij - slt_ji)*cs; // up   - up
+    else      return   slt_ij*cc + slt_ji*ss; // up   - down
+  } else {
+    if(sj==0) return -slt_ij*ss - slt_ji*cc;  // down - up
+    else      return  (slt_ij - slt_ji)*cs;   // down - down
   }
-// calculating Tr(X^{-1}*dX/df_{msi,msj})=-2*alpha(sigma(msi),sigma(msj))(X^{-1})_{msi,msj}
-  #pragma omp parallel for default(shared)        \
-    private(qpidx,mpidx,spidx,cs,cc,ss,                   \
-            tOrbIdx,tOrbSgn,invM,buf,msi,msj,             \
-            tOrbIdx_i,tOrbSgn_i,invM_i,orbidx)
-  #pragma loop noalias
-  for(qpidx=0;qpidx<nQPFull;qpidx++) { // nQPFull = NQPFix * NQPOptTrans: usually = NSPGaussLeg * NMPTrans
-    mpidx = qpidx / NSPGaussLeg;       // qpidx   = NSPGaussLeg*mpidx + spidx
-    spidx = qpidx % NSPGaussLeg;
-
-    cs = PfM[qpidx] * SPGLCosSin[spidx]; // spin rotation + PfM
-    cc = PfM[qpidx] * SPGLCosCos[spidx]; // spin rotation + PfM
-    ss = PfM[qpidx] * SPGLSinSin[spidx]; // spin rotation + PfM
+}
 
-    tOrbIdx = transOrbIdx + mpidx*nsize*nsize; // tOrbIdx[msi][msj] = transOrbIdx[mpidx][msi][msj]
-    tOrbSgn = transOrbSgn + mpidx*nsize*nsize; // tOrbSgn[msi][msj] = transOrbSgn[mpidx][msi][msj]
-    invM    = InvM        + qpidx*Nsize*Nsize; // invM  M^-1 and PfM, InvM: NQPFull*(Nsize*Nsize)+PfM
-    buf     = buffer      + qpidx*NSlater;     // buf   fij, buffer: NSlater*NQPFull
+/* SlaterElm_real[qpidx][rsi][rsj] */
+double SlaterElmAt_real(const int qpidx, const int rsi, const int rsj) {
+  int tidx,spidx,si,sj,ri,rj,tri,trj;
+  double sgn,cs,cc,ss;
+  double slt_ij,slt_ji;
 
-    #pragma loop norecurrence
-    for(msi=0;msi<ne;msi++) {
-      tOrbIdx_i = tOrbIdx + msi*nsize;         // tOrbIdx_i[] = tOrbIdx[msi][msj]
-      tOrbSgn_i = tOrbSgn + msi*nsize;         // tOrbSgn_i[] = tOrbSgn[msi][msj]
-      invM_i    = invM + msi*nsize;            // invM[]      = invM[msi][]
-      for(msj=0;msj<ne;msj++) {                // up-up
-        /* si=0 sj=0*/
-        orbidx       = tOrbIdx_i[msj];         // 
-        buf[orbidx] += invM_i[msj]*cs*tOrbSgn_i[msj]; // invM[msi][msj]
-      }
-      for(msj=ne;msj<nsize;msj++) {            // up-down
-        /* si=0 sj=1*/
-        orbidx       = tOrbIdx_i[msj];
-        buf[orbidx] -= invM_i[msj]*cc*tOrbSgn_i[msj];
-      }
-    }
-    #pragma loop norecurrence
-    for(msi=ne;msi<nsize;msi++) { 
-      tOrbIdx_i = tOrbIdx + msi*nsize;
-      tOrbSgn_i = tOrbSgn + msi*nsize;
-      invM_i = invM + msi*nsize;
-      for(msj=0;msj<ne;msj++) {    // down-up
-        /* si=1 sj=0*/
-        orbidx = tOrbIdx_i[msj];
-        buf[orbidx] += invM_i[msj]*ss*tOrbSgn_i[msj];
-      }
-      for(msj=ne;msj<nsize;msj++) {// down-down
-        /* si=1 sj=1*/
-        orbidx = tOrbIdx_i[msj];
-        buf[orbidx] -= invM_i[msj]*cs*tOrbSgn_i[msj];
-      }
-    }
+  if(SlaterElmBase==NULL) return SlaterElm_real[(qpidx*Nsite2+rsi)*Nsite2+rsj];
+
+  tidx  = qpidx / NSPGaussLeg;
+  spidx = qpidx % NSPGaussLeg;
+  si = (rsi<Nsite) ? 0 : 1;
+  sj = (rsj<Nsite) ? 0 : 1;
+  ri = rsi - si*Nsite;
+  rj = rsj - sj*Nsite;
+
+  tri = SlaterElmTrans[tidx*Nsite+ri];
+  trj = SlaterElmTrans[tidx*Nsite+rj];
+  sgn = (double)(SlaterElmTransSgn[tidx*Nsite+ri]*SlaterElmTransSgn[tidx*Nsite+rj]);
+  slt_ij = SlaterElmBase_real[tri*Nsite+trj]*sgn;
+  slt_ji = SlaterElmBase_real[trj*Nsite+tri]*sgn;
+  cs = SlaterElmSPCoef[3*spidx  ];
+  cc = SlaterElmSPCoef[3*spidx+1];
+  ss = SlaterElmSPCoef[3*spidx+2];
+
+  if(si==0) {
+    if(sj==0) return -(slt_ij - slt_ji)*cs;
+    else      return   slt_ij*cc + slt_ji*ss;
+  } else {
+    if(sj==0) return -slt_ij*ss - slt_ji*cc;
+    else      return  (slt_ij - slt_ji)*cs;
   }
+}
 
-  /* store SROptO[] */
-  for(orbidx=0;orbidx<nSlater;orbidx++) {
-    srOptO[2*orbidx]   = 0.0+0.0*I; // 0
-    srOptO[2*orbidx+1] = 0.0+0.0*I; // 0
-  }
-  #pragma loop noalias
-  for(qpidx=0;qpidx<nQPFull;qpidx++) {
-    tmp = QPFullWeight[qpidx];
-    buf = buffer + qpidx*nSlater;
-    for(orbidx=0;orbidx<nSlater;orbidx++) {
-      srOptO[2*orbidx]   += tmp * buf[orbidx];   //real      TBC
-      srOptO[2*orbidx+1] += tmp * buf[orbidx]*I; //imaginary TBC
-      //printf("Re DEBUG: tmp=%lf :orbidx=%d srOptO=%lf %lf invIP=%lf %lf \n",tmp,orbidx,creal(srOptO[2*orbidx]),cimag(srOptO[2*orbidx]),creal(invIP),cimag(invIP));
-      //printf("Im DEBUG:orbidx=%d srOptO=%lf %lf invIP=%lf %lf \n",orbidx,creal(srOptO[2*orbidx+1]),cimag(srOptO[2*orbidx+1]),creal(invIP),cimag(invIP));
-    }
+/* Row rsi of SlaterElm[qpidx], i.e. SlaterElm[qpidx][rsi][0:Nsite2]. */
+/* The dense row is returned in place. The compressed one is expanded into */
+/* buf[Nsite2], so that the kernels read both forms by the same loop. */
+const double complex *SlaterElmRow_fcmp(const int qpidx, const int rsi, double complex *buf) {
+  const int tidx  = qpidx / NSPGaussLeg;
+  const int spidx = qpidx % NSPGaussLeg;
+  const int si = (rsi<Nsite) ? 0 : 1;
+  const int *trans = SlaterElmTrans + tidx*Nsite;
+  const int *transSgn = SlaterElmTransSgn + tidx*Nsite;
+  const double *coef = SlaterElmSPCoef + 3*spidx;
+  const double complex *sltB_i;
+  double complex *buf1 = buf + Nsite;
+  double complex slt_ij,slt_ji;
+  double c0_ij,c0_ji,c1_ij,c1_ji;
+  int rj,tri,trj,sgni;
+
+  if(SlaterElmBase==NULL) return SlaterElm + (qpidx*Nsite2+rsi)*Nsite2;
+
+  tri  = trans[rsi-si*Nsite];
+  sgni = transSgn[rsi-si*Nsite];
+  /* coefficients of slt_ij and slt_ji for the spin sj=0 and sj=1 */
+  if(si==0) {
+    c0_ij = -coef[0]; c0_ji = coef[0]; // up   - up
+    c1_ij =  coef[1]; c1_ji = coef[2]; // up   - down
+  } else {
+    c0_ij = -coef[2]; c0_ji = -coef[1]; // down - up
+    c1_ij =  coef[0]; c1_ji = -coef[0]; // down - down
   }
-  for(orbidx=0;orbidx<nSlater;orbidx++) {
-    srOptO[2*orbidx]   *= invIP;
-    srOptO[2*orbidx+1] *= invIP;
+  sltB_i = SlaterElmBase + tri*Nsite;
+  for(rj=0;rj<Nsite;rj++) {
+    trj = trans[rj];
+    slt_ij = sltB_i[trj]*(double)(sgni*transSgn[rj]);
+    slt_ji = SlaterElmBase[trj*Nsite+tri]*(double)(sgni*transSgn[rj]);
+    buf[rj]  = c0_ij*slt_ij + c0_ji*slt_ji;
+    buf1[rj] = c1_ij*slt_ij + c1_ji*slt_ji;
   }
+  return buf;
+}
 
-  ReleaseWorkSpaceInt();
-  ReleaseWorkSpaceComplex();
-  return;
+/* SlaterElmRow_fcmp for SlaterElm_real */
+const double *SlaterElmRow_real(const int qpidx, const int rsi, double *buf) {
+  const int tidx  = qpidx / NSPGaussLeg;
+  const int spidx = qpidx % NSPGaussLeg;
+  const int si = (rsi<Nsite) ? 0 : 1;
+  const int *trans = SlaterElmTrans + tidx*Nsite;
+  const int *transSgn = SlaterElmTransSgn + tidx*Nsite;
+  const double *coef = SlaterElmSPCoef + 3*spidx;
+  const double *sltB_i;
+  double *buf1 = buf + Nsite;
+  double slt_ij,slt_ji;
+  double c0_ij,c0_ji,c1_ij,c1_ji;
+  int rj,tri,trj,sgni;
+
+  if(SlaterElmBase==NULL) return SlaterElm_real + (qpidx*Nsite2+rsi)*Nsite2;
+
+  tri  = trans[rsi-si*Nsite];
+  sgni = transSgn[rsi-si*Nsite];
+  /* coefficients of slt_ij and slt_ji for the spin sj=0 and sj=1 */
+  if(si==0) {
+    c0_ij = -coef[0]; c0_ji = coef[0]; // up   - up
+    c1_ij =  coef[1]; c1_ji = coef[2]; // up   - down
+  } else {
+    c0_ij = -coef[2]; c0_ji = -coef[1]; // down - up
+    c1_ij =  coef[0]; c1_ji = -coef[0]; // down - down
+  }
+  sltB_i = SlaterElmBase_real + tri*Nsite;
+  for(rj=0;rj<Nsite;rj++) {
+    trj = trans[rj];
+    slt_ij = sltB_i[trj]*(double)(sgni*transSgn[rj]);
+    slt_ji = SlaterElmBase_real[trj*Nsite+tri]*(double)(sgni*transSgn[rj]);
+    buf[rj]  = c0_ij*slt_ij + c0_ji*slt_ji;
+    buf1[rj] = c1_ij*slt_ij + c1_ji*slt_ji;
+  }
+  return buf;
 }
 
+/* UpdateSlaterElm_fcmp, UpdateSlaterElm_real, */
+/* SlaterElmDiff_fcmp and SlaterElmDiff_real */
+#define MVMC_SLATER_REAL
+#include "slater_impl.c"
+#undef MVMC_SLATER_REAL
+#include "slater_impl.c"
+
 void SlaterElmBFDiff_fcmp(double complex*srOptO, const double complex ip, int *eleIdx, int *eleNum, int *eleCfg, int *eleProjConst,const int * eleProjBFCnt){
   const int nBuf=NSlater*NQPFull;
   const int nsize = Nsize;
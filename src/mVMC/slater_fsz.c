@@ -27,6 +27,7 @@ along with this program. If not, see http://www.gnu.org/licenses/.
  *-------------------------------------------------------------*/
 
 void UpdateSlaterElm_fsz();
+void UpdateSlaterElm_fsz_real();
 void SlaterElmDiff_fsz(double complex *srOptO, const double complex ip, int *eleIdx,int *eleSpn);
 
 void UpdateSlaterElm_fsz() {
@@ -115,6 +116,17 @@ void UpdateSlaterElm_fsz() {
   return;
 }
 
+/* SlaterElm_real of the real wave function is taken from SlaterElm, */
+/* which is kept for SlaterElmDiff_fsz. */
+void UpdateSlaterElm_fsz_real() {
+  const int n=NQPFull*Nsite2*Nsite2;
+  int i;
+
+  #pragma omp parallel for default(shared) private(i)
+  for(i=0;i<n;i++) SlaterElm_real[i] = creal(SlaterElm[i]);
+  return;
+}
+
 // Calculating Tr[Inv[M]*D_k(X)]
 void SlaterElmDiff_fsz(double complex *srOptO, const double complex ip, int *eleIdx,int *eleSpn) {
   const int nBuf=NSlater*NQPFull;
@@ -30,6 +30,17 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 
 #include "stcopt.h"
 
+/* SROptOO keeps only <O_i> and <O_i O_i> (1) or the whole <O_i O_j> (0). */
+/* In the former, S is made from SROptO_Store by the solver. */
+int IsSROptOODiag() {
+#ifdef _lapack
+  return (NSRCG!=0);
+#else
+  /* stcOptMain assembles the distributed S from SROptO_Store */
+  return (NSRCG!=0 || NStoreO!=0);
+#endif
+}
+
 int StochasticOpt(MPI_Comm comm) {
   const int nPara=NPara;
   const int srOptSize=SROptSize;
@@ -60,11 +71,33 @@ int StochasticOpt(MPI_Comm comm) {
   MPI_Comm_rank(comm,&rank);
   MPI_Comm_size(comm,&size);
 
+#ifdef _lapack
+  /* WeightAverageSROpt reduces S and g only to rank 0, which solves them and
+     updates Para. The other processes only receive the result of the check. */
+  if(rank!=0) {
+    MPI_Bcast(&info, 1, MPI_INT, 0, comm);
+    return info;
+  }
+#endif
+
   r = (double*)calloc(2*SROptSize, sizeof(double));
 
   StartTimer(50);
 //[s] for only real variables TBC
-  if(AllComplexFlag==0){ //real &  sz=0
+  if(AllComplexFlag==0 && IsSROptOODiag()){
+    /* <O_i>, <O_i O_i> and <HO_i> */
+    #pragma omp parallel for default(shared) private(i,int_x,int_y)
+    #pragma loop noalias
+    for(i=0;i<2*SROptSize*3;i++){
+      int_x  = i%(2*SROptSize);
+      int_y  = (i-int_x)/(2*SROptSize);
+      if(int_x%2==0){
+        SROptOO[i] = SROptOO_real[int_x/2+int_y*SROptSize];
+      }else{
+        SROptOO[i] = 0.0+0.0*I;
+      }
+    }
+  }else if(AllComplexFlag==0){ //real &  sz=0
   //if(AllComplexFlag==0 && iFlgOrbitalGeneral==0){ //real &  sz=0
     #pragma omp parallel for default(shared) private(i,int_x,int_y,j)
     #pragma loop noalias
@@ -86,7 +119,11 @@ int StochasticOpt(MPI_Comm comm) {
     //for(pi=0;pi<nPara;pi++) {
     /* r[i] is temporarily used for diagonal elements of S */
     /* S[i][i] = OO[pi+1][pi+1] - OO[0][pi+1] * OO[0][pi+1]; */
-    r[pi]   = creal(srOptOO[(pi+2)*(2*srOptSize)+(pi+2)]) - creal(srOptOO[pi+2]) * creal(srOptOO[pi+2]);
+    if(IsSROptOODiag()) {
+      r[pi] = creal(srOptOO[2*srOptSize+(pi+2)]) - creal(srOptOO[pi+2]) * creal(srOptOO[pi+2]);
+    } else {
+      r[pi] = creal(srOptOO[(pi+2)*(2*srOptSize)+(pi+2)]) - creal(srOptOO[pi+2]) * creal(srOptOO[pi+2]);
+    }
     //printf("DEBUG: pi=%d: %lf %lf \n",pi,creal(srOptOO[pi]),cimag(srOptOO[pi]));
 #ifdef _DEBUG_STCOPT
   fprintf(stderr, "DEBUG in %s (%d): r[%d] = %lf\n", __FILE__, __LINE__, pi, r[pi]);
@@ -24,6 +24,7 @@ along with this program. If not, see http://www.gnu.org/licenses/.
   #define fn_StochasticOptCG StochasticOptCG_real
   #define fn_StochasticOptCG_Init StochasticOptCG_Init_real
   #define fn_StochasticOptCG_Main StochasticOptCG_Main_real
+  #define fn_StochasticOptMinSR_Main StochasticOptMinSR_Main_real
   #define fn_operate_by_S operate_by_S_real
   #define fn_print_Smat_stderr print_Smat_stderr_real
 
@@ -32,11 +33,12 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 
   #define OFFSET (1)
   #define USE_IMAG (0)
-  #define SIZE_VecCG (nSmat*8 + NVMCSample*(nSmat+1))
+  #define SIZE_VecCG (nSmat*13 + NVMCSample*(nSmat+2))
 #else // MVMC_SRCG_REAL
   #define fn_StochasticOptCG StochasticOptCG_fcmp
   #define fn_StochasticOptCG_Init StochasticOptCG_Init_fcmp
   #define fn_StochasticOptCG_Main StochasticOptCG_Main_fcmp
+  #define fn_StochasticOptMinSR_Main StochasticOptMinSR_Main_fcmp
   #define fn_operate_by_S operate_by_S_fcmp
   #define fn_print_Smat_stderr print_Smat_stderr_fcmp
 
@@ -45,7 +47,7 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 
   #define OFFSET (2)
   #define USE_IMAG (1)
-  #define SIZE_VecCG (nSmat*8 + 2*NVMCSample*(nSmat+1))
+  #define SIZE_VecCG (nSmat*13 + 2*NVMCSample*(nSmat+2))
 #endif
 
 /*
@@ -56,18 +58,21 @@ along with this program. If not, see http://www.gnu.org/licenses/.
   stcO :: nSmat
   stcOs_real :: nSmat*NVMCSample
   stcOs_imag :: nSmat*NVMCSample (Complex) or 0 (Real)
-  y_real :: NVMCSample
-  y_imag :: NVMCSample (Complex) or 0 (Real)
-  z_local :: nSmat
-  q :: nSmat
-  d :: nSmat
+  y_real :: NVMCSample*2
+  y_imag :: NVMCSample*2 (Complex) or 0 (Real)
+  z_local :: nSmat*2
+  q :: nSmat*2 (S*d and S*x)
+  d :: nSmat*2 (d and a copy of x)
   r :: nSmat
+  s :: nSmat (preconditioned residual)
+  minv :: nSmat (inverse of the preconditioner)
 */
 
 int fn_StochasticOptCG(MPI_Comm comm);
 void fn_StochasticOptCG_Init(const int nSmat, int *const smatToParaIdx, double *VecCG); 
 int fn_StochasticOptCG_Main(const int nSmat, double *VecCG, MPI_Comm comm);
-int fn_operate_by_S(const int nSmat, double *x, double *z, double *VecCG, MPI_Comm comm);
+int fn_StochasticOptMinSR_Main(const int nSmat, double *VecCG, MPI_Comm comm);
+int fn_operate_by_S(const int nSmat, const int nVec, double *x, double *z, double *VecCG, MPI_Comm comm);
 void fn_print_Smat_stderr(const int nSmat, double *VecCG, MPI_Comm comm);
 
 int fn_StochasticOptCG(MPI_Comm comm) {
@@ -178,7 +183,12 @@ int fn_StochasticOptCG(MPI_Comm comm) {
   abort();
 #endif
 
-  info = fn_StochasticOptCG_Main(nSmat, VecCG, comm);
+  if(NSRCG==2) {
+    info = fn_StochasticOptMinSR_Main(nSmat, VecCG, comm);
+  } else {
+    info = fn_StochasticOptCG_Main(nSmat, VecCG, comm);
+  }
+  /* info is the number of CG iterations, or the info of DPOSV for NSRCG=2 */
 #ifdef _DEBUG_STCOPT_CG
   for(si=0; si<nSmat; ++si){
     fprintf(stderr, "%lg\n", VecCG[si]);
@@ -191,7 +201,7 @@ int fn_StochasticOptCG(MPI_Comm comm) {
   r = VecCG;
   /*** print zqp_SRinfo.dat ***/
   if(rank==0) {
-    //if(info!=0) fprintf(stderr, "StcOpt: DPOSV info=%d\n",info);
+    if(NSRCG==2 && info!=0) fprintf(stderr, "StcOpt: DPOSV info=%d\n",info);
     rmax = r[0]; simax=0;;
     for(si=0;si<nSmat;si++) {
       if(fabs(rmax) < fabs(r[si])) {
@@ -204,10 +214,11 @@ int fn_StochasticOptCG(MPI_Comm comm) {
     //fprintf(FileSRinfo, "%5d %5d %5d %5d % .5e %5d, %d\n",NPara,nSmat,optNum,cutNum,
     //        rmax,smatToParaIdx[simax], info);
   }
-  info=0;
+  /* a failed DPOSV stops the optimization as in StochasticOpt */
+  if(NSRCG!=2) info=0;
 
   /*** check inf and nan ***/
-  if(rank==0) {
+  if(rank==0 && info==0) {
     for(si=0;si<nSmat;si++) {
       if( !isfinite(r[si]) ) {
         fprintf(stderr, "StcOpt: r[%d]=%.10lf\n",si,r[si]);
@@ -254,20 +265,24 @@ int fn_StochasticOptCG(MPI_Comm comm) {
 }
 
 /* calculate the parameter change r[nSmat] from SOpt.
-   Solve S*x = g */
+   Solve S*x = g by the preconditioned CG method.
+   All vectors are replicated on every process and S*d is the only
+   collective operation in an iteration. */
 int fn_StochasticOptCG_Main(const int nSmat, double *VecCG, MPI_Comm comm) {
   int si;
-  int rank, size;
   int iter;
   int max_iter = (NSROptCGMaxIter > 0 ? NSROptCGMaxIter : nSmat);
-  double delta, beta;
+  const int refreshInterval = 20;
+  int refresh;
+  double delta, rs, rsNew, beta;
   double alpha;
   double cg_thresh = DSROptCGTol*DSROptCGTol * (double)nSmat * (double)nSmat;
   //double cg_thresh = DSROptRedCut;
 
   double *x, *g, *sdiag, *stcO, *stcOs_real;
   double *stcOs_imag, *y_real, *y_imag, *z_local;
-  double *q, *d, *r;
+  double *q, *d, *r, *s, *minv;
+  double *sx, *xcopy;
 
 #ifdef _DEBUG_STCOPT_CG
   fprintf(stderr, "DEBUG in %s (%d): Start stcOptCG_Main\n", __FILE__, __LINE__);
@@ -280,65 +295,76 @@ int fn_StochasticOptCG_Main(const int nSmat, double *VecCG, MPI_Comm comm) {
   stcOs_real = stcO + nSmat;
   stcOs_imag = stcOs_real + NVMCSample*nSmat;
   y_real = stcOs_imag + USE_IMAG*NVMCSample*nSmat;
-  y_imag = y_real + NVMCSample;
-  z_local = y_imag + USE_IMAG*NVMCSample;
-  q = z_local + nSmat;
-  d = q + nSmat;
-  r = d + nSmat;
-  
-  MPI_Comm_rank(comm,&rank);
-  MPI_Comm_size(comm,&size);
-
+  y_imag = y_real + 2*NVMCSample;
+  z_local = y_imag + USE_IMAG*2*NVMCSample;
+  q = z_local + 2*nSmat;
+  d = q + 2*nSmat;
+  r = d + 2*nSmat;
+  s = r + nSmat;
+  minv = s + nSmat;
+  /* S*x is evaluated together with S*d when the residual is refreshed */
+  sx = q + nSmat;
+  xcopy = d + nSmat;
+
+  /* Jacobi preconditioner: the diagonal of the shifted S */
   #pragma omp parallel for default(shared) private(si)
   #pragma loop noalias
   for(si=0;si<nSmat;++si) {
-    d[si] = r[si] = g[si];
+    if(NSROptCGPrecond==1 && sdiag[si]>0.0) {
+      minv[si] = 1.0/(sdiag[si]*(1.0+DSROptStaDel));
+    } else {
+      minv[si] = 1.0;
+    }
+    r[si] = g[si];
+    d[si] = s[si] = minv[si]*r[si];
   }
 
   delta = xdot(nSmat, r, r);
+  rs = xdot(nSmat, r, s);
 
   for(iter=0; iter < max_iter; iter++){
     //check convergence 
-    //if(rank==0) printf("%d: %d %.3e\n",rank, iter,delta);
 #ifdef _DEBUG_STCOPT_CG
     fprintf(stderr, "delta = %lg, cg_thresh = %lg\n", delta, cg_thresh);
 #endif
     if (delta < cg_thresh) break;
 
-    // compute vector q=S*d
-    fn_operate_by_S(nSmat, d, q, VecCG, comm);
-    alpha = delta/xdot(nSmat,d,q);
+    // compute vector q=S*d (and S*x before the update of x)
+    refresh = ((iter+1) % refreshInterval == 0);
+    if(refresh) {
+      #pragma omp parallel for default(shared) private(si)
+      #pragma loop noalias
+      for(si=0;si<nSmat;++si) {
+        xcopy[si] = x[si];
+      }
+    }
+    fn_operate_by_S(nSmat, 1+refresh, d, q, VecCG, comm);
+    alpha = rs/xdot(nSmat,d,q);
   
-    // update solution vector x=x+alpha*d
+    // update solution vector x=x+alpha*d and residual vector r=r-alpha*q
     #pragma omp parallel for default(shared) private(si)
     #pragma loop noalias
     for(si=0;si<nSmat;++si) {
       x[si] = x[si] + alpha*d[si];
-    }
-    // update residual vector r=r-alpha*q, q=S*d
-    if((iter+1) % 20 == 0){
-      fn_operate_by_S(nSmat, x, r, VecCG, comm);
-      #pragma omp parallel for default(shared) private(si)
-      #pragma loop noalias
-      for(si=0;si<nSmat;++si) {
-        r[si] = g[si] - r[si];
-      }
-    }else{
-      #pragma omp parallel for default(shared) private(si)
-      #pragma loop noalias
-      for(si=0;si<nSmat;++si) {
+      if(refresh) {
+        r[si] = g[si] - sx[si] - alpha*q[si];
+      } else {
         r[si] = r[si] - alpha*q[si];
       }
+      s[si] = minv[si]*r[si];
     }
-    beta = xdot(nSmat,r,r)/delta;
 
     //update the norm of residual vector r
-    delta = beta*delta;
+    delta = xdot(nSmat,r,r);
+    rsNew = xdot(nSmat,r,s);
+    beta = rsNew/rs;
+    rs = rsNew;
+
     // update direction vector d
     #pragma omp parallel for default(shared) private(si)
     #pragma loop noalias
     for(si=0;si<nSmat;++si) {
-      d[si] = r[si] + beta*d[si];
+      d[si] = s[si] + beta*d[si];
     }
   }
 
@@ -350,13 +376,130 @@ int fn_StochasticOptCG_Main(const int nSmat, double *VecCG, MPI_Comm comm) {
   return iter;
 }
 
-/* calculate  z = S*x */
+/* calculate the parameter change r[nSmat] from SOpt in the sample space.
+   With the columns a_k = (O_k - sqrt(w_k)*<O>)/sqrt(Wc) of the samples k
+   (the real and imaginary parts of O_k give separate columns) and
+   D = diag(sdiag*DSROptStaDel), the shifted S is A*A^T + D.
+   The Woodbury identity with B = D^{-1/2}*A gives
+     x = D^{-1/2} * (g' - B*(1 + B^T*B)^{-1}*B^T*g'),  g' = D^{-1/2}*g,
+   so that only the Gram matrix 1 + B^T*B of the size of the total number
+   of samples is factorized. Each process keeps the columns of its own
+   samples, and the blocks of the Gram matrix are made by broadcasting them.
+   The Gram matrix is gathered and factorized on rank 0 only, and u is
+   broadcast. DSROptStaDel must be positive (checked in ReadDefFile).
+   The return value is the info of DPOSV, which is identical on all processes. */
+int fn_StochasticOptMinSR_Main(const int nSmat, double *VecCG, MPI_Comm comm) {
+  const int nCol = (1+USE_IMAG)*NVMCSample; /* the number of local columns of B */
+  const double invSqrtW = 1.0/sqrt(Wc);
+  int nColTotal;
+  int i,si,root,info=0;
+  int rank,size;
+  double one = 1.0, zero = 0.0;
+  int ione = 1;
+  char transT='T';
+  char transN='N';
+  char uplo='U';
+
+#ifdef MVMC_SRCG_REAL
+  const double *srOptO_Store = SROptO_Store_real;
+#else
+  const double complex *srOptO_Store = SROptO_Store;
+#endif
+  double *x, *g, *sdiag, *stcO, *stcOs;
+  double *dinv, *bRoot, *gram, *gramLocal, *u, *uLocal, *z, *zLocal;
+  double sqrtw;
+
+  MPI_Comm_rank(comm,&rank);
+  MPI_Comm_size(comm,&size);
+  nColTotal = nCol*size;
+
+  x = VecCG;
+  g = x + nSmat;
+  sdiag = g + nSmat;
+  stcO = sdiag + nSmat;
+  stcOs = stcO + nSmat; /* stcOs_real and stcOs_imag are contiguous */
+
+  dinv = (double*)malloc(sizeof(double)*(nSmat*(2+nCol) + nColTotal*(nColTotal+nCol+1) + nCol));
+  z = dinv + nSmat;
+  bRoot = z + nSmat;
+  gram = bRoot + nSmat*nCol;
+  gramLocal = gram + nColTotal*nColTotal;
+  u = gramLocal + nColTotal*nCol;
+  uLocal = u + nColTotal;
+  zLocal = x; /* x is overwritten at the end */
+
+  StartTimer(56);
+  /* B = D^{-1/2}*A and g' = D^{-1/2}*g */
+  #pragma omp parallel for default(shared) private(si)
+  #pragma loop noalias
+  for(si=0;si<nSmat;++si) {
+    dinv[si] = (sdiag[si]>0.0) ? 1.0/sqrt(sdiag[si]*DSROptStaDel) : 0.0;
+    g[si] *= dinv[si];
+  }
+  for(i=0;i<NVMCSample;++i) {
+    /* the 0-th element of O is 1 */
+    sqrtw = CREAL(srOptO_Store[i*OFFSET*SROptSize]);
+    #pragma omp parallel for default(shared) private(si)
+    #pragma loop noalias
+    for(si=0;si<nSmat;++si) {
+      stcOs[si+i*nSmat] = (stcOs[si+i*nSmat] - sqrtw*stcO[si])*invSqrtW*dinv[si];
+#ifndef MVMC_SRCG_REAL
+      stcOs[si+(i+NVMCSample)*nSmat] *= invSqrtW*dinv[si];
+#endif
+    }
+  }
+
+  /* the local columns of B^T*B: gramLocal[j][k] = b_k^T b_j for the local j */
+  for(root=0;root<size;root++) {
+    if(rank==root) {
+      for(i=0;i<nSmat*nCol;i++) bRoot[i] = stcOs[i];
+    }
+    MPI_Bcast(bRoot, nSmat*nCol, MPI_DOUBLE, root, comm);
+    M_DGEMM(&transT, &transN, &nCol, &nCol, &nSmat, &one, bRoot, &nSmat,
+            stcOs, &nSmat, &zero, gramLocal+root*nCol, &nColTotal);
+  }
+  MPI_Gather(gramLocal, nColTotal*nCol, MPI_DOUBLE,
+             gram, nColTotal*nCol, MPI_DOUBLE, 0, comm);
+
+  /* u = B^T*g' */
+  M_DGEMV(&transT, &nSmat, &nCol, &one, stcOs, &nSmat, g, &ione, &zero, uLocal, &ione);
+  MPI_Gather(uLocal, nCol, MPI_DOUBLE, u, nCol, MPI_DOUBLE, 0, comm);
+  StopTimer(56);
+
+  StartTimer(57);
+  /* u = (1 + B^T*B)^{-1}*B^T*g' */
+  if(rank==0) {
+    for(i=0;i<nColTotal;i++) gram[i+i*nColTotal] += 1.0;
+    M_DPOSV(&uplo, &nColTotal, &ione, gram, &nColTotal, u, &nColTotal, &info);
+  }
+  MPI_Bcast(&info, 1, MPI_INT, 0, comm);
+  if(info==0) MPI_Bcast(u, nColTotal, MPI_DOUBLE, 0, comm);
+  StopTimer(57);
+
+  if(info!=0) {
+    for(si=0;si<nSmat;++si) x[si] = 0.0;
+  } else {
+    /* x = D^{-1/2}*(g' - B*u) */
+    M_DGEMV(&transN, &nSmat, &nCol, &one, stcOs, &nSmat, u+rank*nCol, &ione, &zero, zLocal, &ione);
+    SafeMpiAllReduce(zLocal, z, nSmat, comm);
+    #pragma omp parallel for default(shared) private(si)
+    #pragma loop noalias
+    for(si=0;si<nSmat;++si) {
+      x[si] = dinv[si]*(g[si] - z[si]);
+    }
+  }
+
+  free(dinv);
+  return info;
+}
+
+/* calculate  z = S*x for nVec vectors stored in x[nVec][nSmat] */
 /* S is the overlap matrix*/
 /* S[i][j] = OO[i+1][j+1] - OO[i+1][0] * OO[0][j+1]; */
-int fn_operate_by_S(int nSmat, double *x, double *z, double *VecCG, MPI_Comm comm) {
-  int rank,size,info=0;
-  int si;
-  int incx = 1, incy = 1;
+/* x must be identical on all processes; z is also identical on return */
+int fn_operate_by_S(int nSmat, const int nVec, double *x, double *z, double *VecCG, MPI_Comm comm) {
+  int info=0;
+  int si,iv;
   double coef;
   double one = 1.0, zero = 0.0;
   double invW = 1.0/Wc;
@@ -366,58 +509,52 @@ int fn_operate_by_S(int nSmat, double *x, double *z, double *VecCG, MPI_Comm com
   double *sdiag, *stcO, *stcOs_real, *stcOs_imag;
   double *y_real, *y_imag;
   double *z_local;
+  double *xv, *zv;
 
   sdiag = VecCG + 2*nSmat;
   stcO = sdiag + nSmat;
   stcOs_real = stcO + nSmat;
   stcOs_imag = stcOs_real + NVMCSample*nSmat;
   y_real = stcOs_imag + USE_IMAG*NVMCSample*nSmat;
-  y_imag = y_real + NVMCSample;
-  z_local = y_imag + USE_IMAG*NVMCSample;
+  y_imag = y_real + 2*NVMCSample;
+  z_local = y_imag + USE_IMAG*2*NVMCSample;
 
-  MPI_Comm_rank(comm,&rank);
-  MPI_Comm_size(comm,&size);
-
-  MPI_Bcast(x, nSmat, MPI_DOUBLE, 0, comm);
-  
   StartTimer(53);
-  #pragma omp parallel for default(shared) private(si)
-  #pragma loop noalias
-  for(si=0;si<nSmat;++si) {
-    z[si] = 0.0;
-    z_local[si] = 0.0;
-  }
 
-  // y_real[sample] = sum{si} x[si] * O_real[si][sample]
-  M_DGEMV(&transT, &nSmat, &NVMCSample, &one, stcOs_real, &nSmat, x, &incx, &zero, y_real, &incy);
+  // y_real[iv][sample] = sum{si} x[iv][si] * O_real[si][sample]
+  M_DGEMM(&transT, &transN, &NVMCSample, &nVec, &nSmat, &one, stcOs_real, &nSmat,
+          x, &nSmat, &zero, y_real, &NVMCSample);
 #ifndef MVMC_SRCG_REAL
-  // y_imag[sample] = sum{si} x[si] * O_imag[si][sample]
-  M_DGEMV(&transT, &nSmat, &NVMCSample, &one, stcOs_imag, &nSmat, x, &incx, &zero, y_imag, &incy);
+  // y_imag[iv][sample] = sum{si} x[iv][si] * O_imag[si][sample]
+  M_DGEMM(&transT, &transN, &NVMCSample, &nVec, &nSmat, &one, stcOs_imag, &nSmat,
+          x, &nSmat, &zero, y_imag, &NVMCSample);
 #endif
 
-  // z_local[si] = sum{sample} O_real[si][sample] * y_real[sample] + O_imag[si][sample] * y_imag[sample]
-  M_DGEMV(&transN, &nSmat, &NVMCSample, &one, stcOs_real, &nSmat, y_real, &incx, &zero, z_local, &incy);
-
+  // z_local[iv][si] = sum{sample} O_real[si][sample] * y_real[iv][sample] + O_imag[si][sample] * y_imag[iv][sample]
+  M_DGEMM(&transN, &transN, &nSmat, &nVec, &NVMCSample, &one, stcOs_real, &nSmat,
+          y_real, &NVMCSample, &zero, z_local, &nSmat);
 #ifndef MVMC_SRCG_REAL
-  M_DGEMV(&transN, &nSmat, &NVMCSample, &one, stcOs_imag, &nSmat, y_imag, &incx, &one, z_local, &incy);
+  M_DGEMM(&transN, &transN, &nSmat, &nVec, &NVMCSample, &one, stcOs_imag, &nSmat,
+          y_imag, &NVMCSample, &one, z_local, &nSmat);
 #endif
 
-  MPI_Barrier(comm);
   /* compute <OO>*x */
-  SafeMpiAllReduce(z_local, z, nSmat, comm);
- 
-  /* compute <O>*x */
-  coef = xdot(nSmat, stcO, x);
+  SafeMpiAllReduce(z_local, z, nVec*nSmat, comm);
 
-  /* y = S*x */
-  #pragma omp parallel for default(shared) private(si)
-  #pragma loop noalias
-  for(si=0;si<nSmat;++si) {
-    z[si] = invW*z[si] - coef*stcO[si];
-    /* modify diagonal elements */
-    // z[si] += DSROptStaDel * x[si];
+  for(iv=0;iv<nVec;iv++) {
+    xv = x + iv*nSmat;
+    zv = z + iv*nSmat;
+    /* compute <O>*x */
+    coef = xdot(nSmat, stcO, xv);
 
-    z[si] += sdiag[si]*DSROptStaDel*x[si];
+    /* y = S*x */
+    #pragma omp parallel for default(shared) private(si)
+    #pragma loop noalias
+    for(si=0;si<nSmat;++si) {
+      zv[si] = invW*zv[si] - coef*stcO[si];
+      /* modify diagonal elements */
+      zv[si] += sdiag[si]*DSROptStaDel*xv[si];
+    }
   }
 
   StopTimer(53);
@@ -512,7 +649,7 @@ void fn_print_Smat_stderr(const int nSmat, double *VecCG, MPI_Comm comm){
 
   for(si=0; si<nSmat; ++si){
     xs[si] = 1.0;
-    fn_operate_by_S(nSmat, xs, S+si*nSmat, VecCG, comm);
+    fn_operate_by_S(nSmat, 1, xs, S+si*nSmat, VecCG, comm);
     xs[si] = 0.0;
   }
 
@@ -530,6 +667,7 @@ void fn_print_Smat_stderr(const int nSmat, double *VecCG, MPI_Comm comm){
 #undef fn_StochasticOptCG
 #undef fn_StochasticOptCG_Init
 #undef fn_StochasticOptCG_Main
+#undef fn_StochasticOptMinSR_Main
 #undef fn_operate_by_S
 #undef fn_print_Smat_stderr
 
@@ -29,13 +29,19 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 #ifndef _SRC_STCOPT_DPOSV
 #define _SRC_STCOPT_DPOSV
 
-/* calculate the parameter change r[nSmat] from SOpt.*/
+/* calculate the parameter change r[nSmat] from SOpt.
+   S and g are reduced only to rank 0, which solves the equation. */
 int stcOptMain(double *g, const int nSmat, const int * const smatToParaIdx, MPI_Comm comm)
 {
   /* for DPOSV */
   char uplo;
   int n,nrhs,lds,ldg,info;
   double *S;
+  int rank;
+
+  MPI_Comm_rank(comm,&rank);
+  if(rank!=0) return 0;
+
   StartTimer(53);
 
   S = (double*)calloc(nSmat*nSmat, sizeof(double));
@@ -63,7 +69,8 @@ void stcOptInit(double *const S, double *const g, const int nSmat, const int *co
     offset = (pi+2)*(2*SROptSize);
     tmp = creal(SROptOO[pi+2]);
 
-    for(sj=0;sj<nSmat;++sj) {
+    /* DPOSV refers to the upper triangle of S, i.e. the lower one of SROptOO */
+    for(sj=si;sj<nSmat;++sj) {
       pj = smatToParaIdx[sj];
       idx = si + nSmat*sj; /* column major */
       S[idx] = creal(SROptOO[offset+(pj+2)]) - tmp * creal(SROptOO[pj+2]);
@@ -30,6 +30,223 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 #ifndef _SRC_STCOPT_PDPOSV
 #define _SRC_STCOPT_PDPOSV
 
+/* BLACS grids kept during the run (created by StcOptGridInit) */
+int SROptCtxt=-1;    /* nprow x npcol grid of S */
+int SROptCtxtRow=-1; /* 1 x size grid of SROptO_Store */
+int SROptNprow, SROptNpcol, SROptMyprow, SROptMypcol;
+int *SROptGridPos=NULL; /* prow and pcol of each rank in the grid of S [size][2] */
+MPI_Comm SROptCommCol; /* processes with the same mypcol */
+
+/* create the BLACS grids at the first call */
+void StcOptGridInit(MPI_Comm comm) {
+  int size;
+  int dims[2]={0,0};
+  int pos[2];
+  char procOrder='R';
+
+  if(SROptCtxt>=0) return;
+
+  MPI_Comm_size(comm,&size);
+  MPI_Dims_create(size,2,dims);
+
+  SROptNprow=dims[0]; SROptNpcol=dims[1];
+  SROptCtxt = Csys2blacs_handle(comm);
+  Cblacs_gridinit(&SROptCtxt, &procOrder, SROptNprow, SROptNpcol);
+  Cblacs_gridinfo(SROptCtxt, &SROptNprow, &SROptNpcol, &SROptMyprow, &SROptMypcol);
+
+  SROptGridPos = (int*)malloc(sizeof(int)*2*size);
+  pos[0] = SROptMyprow; pos[1] = SROptMypcol;
+  MPI_Allgather(pos, 2, MPI_INT, SROptGridPos, 2, MPI_INT, comm);
+
+  SROptCtxtRow = Csys2blacs_handle(comm);
+  Cblacs_gridinit(&SROptCtxtRow, &procOrder, 1, size);
+
+  /* create a communicator whose process has the same value of mypcol */
+  MPI_Comm_split(comm,SROptMypcol,SROptMyprow,&SROptCommCol);
+  return;
+}
+
+void StcOptGridFree() {
+  if(SROptCtxt<0) return;
+  MPI_Comm_free(&SROptCommCol);
+  free(SROptGridPos);
+  SROptGridPos=NULL;
+  Cblacs_gridexit(SROptCtxtRow);
+  Cblacs_gridexit(SROptCtxt);
+  SROptCtxt=SROptCtxtRow=-1;
+  return;
+}
+
+/* calculate the overlap matrix S from SROptOO without the diagonal modification.
+   Except for <O_i> and <O_i O_i>, SROptOO keeps the sums of each process (see WeightAverageSROpt).
+   Each process packs its sums of the strictly upper triangle of S in the order of the ranks
+   and MPI_Reduce_scatter gives each process only its own local elements.
+   The strictly lower triangle is not referenced by PDPOSV and is set to zero. */
+void stcOptReduceS(double *s, const int nSmat, const int *smatToParaIdx,
+                   const int mlocr, const int mlocc,
+                   const int *irToParaIdx, const int *icToParaIdx, MPI_Comm comm) {
+  const int srOptSize = SROptSize;
+  const double complex *srOptOO=SROptOO;
+  const double invW = 1.0/Wc;
+  int nprow=SROptNprow, npcol=SROptNpcol, myprow=SROptMyprow, mypcol=SROptMypcol;
+  int m=nSmat;
+  int mb=64, nb=64; /* blocking factor */
+  int irsrc=0, icsrc=0;
+  int size,rank,p,prow,pcol,locc,nr,ir,ic,si,sj,pi,pj,idx,k,n;
+  int *cnt, *disp, *colOff;
+  double *send, *recv;
+
+  MPI_Comm_size(comm,&size);
+  MPI_Comm_rank(comm,&rank);
+
+  cnt    = (int*)malloc(sizeof(int)*(2*size+mlocc));
+  disp   = cnt+size;
+  colOff = disp+size;
+
+  /* The local rows of a process are in ascending order of si, so that
+     the first NUMROC(sj) of them are in the strictly upper triangle of the column sj. */
+  n = 0;
+  for(p=0;p<size;p++) {
+    prow = SROptGridPos[2*p];
+    pcol = SROptGridPos[2*p+1];
+    locc = M_NUMROC(&m, &nb, &pcol, &icsrc, &npcol);
+    cnt[p] = 0;
+    for(ic=0;ic<locc;ic++) {
+      sj = (ic/nb)*npcol*nb + pcol*nb + (ic%nb);
+      cnt[p] += M_NUMROC(&sj, &mb, &prow, &irsrc, &nprow);
+    }
+    disp[p] = n;
+    n += cnt[p];
+  }
+
+  send = (double*)malloc(sizeof(double)*((n>0) ? n : 1));
+  recv = (double*)malloc(sizeof(double)*((cnt[rank]>0) ? cnt[rank] : 1));
+
+  #pragma omp parallel for default(shared) private(p,prow,pcol,locc,nr,ir,ic,si,sj,pi,pj,k) schedule(dynamic)
+  for(p=0;p<size;p++) {
+    prow = SROptGridPos[2*p];
+    pcol = SROptGridPos[2*p+1];
+    locc = M_NUMROC(&m, &nb, &pcol, &icsrc, &npcol);
+    k = disp[p];
+    for(ic=0;ic<locc;ic++) {
+      sj = (ic/nb)*npcol*nb + pcol*nb + (ic%nb);
+      pj = smatToParaIdx[sj];
+      nr = M_NUMROC(&sj, &mb, &prow, &irsrc, &nprow);
+      for(ir=0;ir<nr;ir++) {
+        si = (ir/mb)*nprow*mb + prow*mb + (ir%mb);
+        pi = smatToParaIdx[si]; /* pi < pj */
+        /* only the lower triangle of SROptOO is kept */
+        send[k++] = creal(srOptOO[(pi+2)*(2*srOptSize)+(pj+2)]);
+      }
+    }
+  }
+
+  MPI_Reduce_scatter(send, recv, cnt, MPI_DOUBLE, MPI_SUM, comm);
+
+  k = 0;
+  for(ic=0;ic<mlocc;ic++) {
+    colOff[ic] = k;
+    sj = (ic/nb)*npcol*nb + mypcol*nb + (ic%nb);
+    k += M_NUMROC(&sj, &mb, &myprow, &irsrc, &nprow);
+  }
+
+  #pragma omp parallel for default(shared) private(ic,ir,pi,pj,idx,k)
+  #pragma loop noalias
+  for(ic=0;ic<mlocc;ic++) {
+    pj = icToParaIdx[ic]; /* Para index (global) */
+    k = colOff[ic];
+    for(ir=0;ir<mlocr;ir++) {
+      pi = irToParaIdx[ir]; /* Para index (global) */
+      idx = ir + ic*mlocr; /* local index (row major) */
+
+      /* S[i][j] = xOO[i+1][j+1] - xOO[0][i+1] * xOO[0][j+1]; */
+      if(pi<pj) {
+        s[idx] = recv[k++] * invW - creal(srOptOO[pi+2]) * creal(srOptOO[pj+2]);
+      } else if(pi==pj) {
+        s[idx] = creal(srOptOO[(pi+2)*(2*srOptSize)+(pi+2)]) - creal(srOptOO[pi+2]) * creal(srOptOO[pi+2]);
+      } else {
+        s[idx] = 0.0;
+      }
+    }
+  }
+
+  free(recv);
+  free(send);
+  free(cnt);
+  return;
+}
+
+/* calculate the overlap matrix S from SROptO_Store without the diagonal modification.
+   S = (1/Wc)*O*O^T - <O><O>^T, where the columns of O are the samples of all processes.
+   Each process puts its own samples into the 1 x size grid, they are redistributed
+   to the grid of S and multiplied by PDSYRK; only the upper triangle is calculated.
+   o[nSmat*nCol] and a[mlocr x (the local columns of O)] are work arrays. */
+void stcOptMakeSStore(double *s, int *descs, double *o, double *a,
+                      const int nSmat, const int *smatToParaIdx, const int mlocr, const int mlocc,
+                      const int *irToParaIdx, const int *icToParaIdx, MPI_Comm comm) {
+  int nCol = (AllComplexFlag==0 ? 1 : 2)*NVMCSample; /* the number of local columns */
+  const int srOptSize = SROptSize;
+  const double complex *srOptOO=SROptOO;
+  double complex z;
+  double alpha=1.0/Wc, beta=0.0;
+  char uplo='U', trans='N';
+  int desco[9],desca[9];
+  int m,n,mbo,alld;
+  int mb=64, nb=64; /* blocking factor */
+  int irsrc=0, icsrc=0, ione=1;
+  int si,pi,pj,k,ir,ic,idx,info,size;
+
+  MPI_Comm_size(comm,&size);
+
+  /* descriptor of the local columns: one block of nCol columns per process */
+  m=nSmat; n=nCol*size; mbo=(nSmat>0) ? nSmat : 1;
+  M_DESCINIT(desco, &m, &n, &mbo, &nCol, &irsrc, &icsrc, &SROptCtxtRow, &mbo, &info);
+
+  /* descriptor of O on the grid of S */
+  alld = (mlocr>0) ? mlocr : 1;
+  M_DESCINIT(desca, &m, &n, &mb, &nb, &irsrc, &icsrc, &SROptCtxt, &alld, &info);
+
+  /* SROptO_Store keeps sqrt(w)*O of each sample */
+  if(AllComplexFlag==0) {
+    #pragma omp parallel for default(shared) private(k,si,pi)
+    for(k=0;k<NVMCSample;k++) {
+      for(si=0;si<nSmat;si++) {
+        pi = smatToParaIdx[si];
+        o[si+k*nSmat] = (pi%2==0) ? SROptO_Store_real[k*srOptSize+pi/2+1] : 0.0;
+      }
+    }
+  } else {
+    /* Re(O_i^* O_j) = Re(O_i)Re(O_j) + Im(O_i)Im(O_j) */
+    #pragma omp parallel for default(shared) private(k,si,pi,z)
+    for(k=0;k<NVMCSample;k++) {
+      for(si=0;si<nSmat;si++) {
+        pi = smatToParaIdx[si];
+        z = SROptO_Store[k*2*srOptSize+pi+2];
+        o[si+k*nSmat] = creal(z);
+        o[si+(k+NVMCSample)*nSmat] = cimag(z);
+      }
+    }
+  }
+
+  Cpdgemr2d(nSmat, n, o, 1, 1, desco, a, 1, 1, desca, SROptCtxt);
+
+  /* S = (1/Wc)*O*O^T */
+  M_PDSYRK(&uplo, &trans, &m, &n, &alpha, a, &ione, &ione, desca,
+           &beta, s, &ione, &ione, descs);
+
+  #pragma omp parallel for default(shared) private(ic,ir,pi,pj,idx)
+  #pragma loop noalias
+  for(ic=0;ic<mlocc;ic++) {
+    pj = icToParaIdx[ic]; /* Para index (global) */
+    for(ir=0;ir<mlocr;ir++) {
+      pi = irToParaIdx[ir]; /* Para index (global) */
+      idx = ir + ic*mlocr; /* local index (row major) */
+      s[idx] -= creal(srOptOO[pi+2]) * creal(srOptOO[pj+2]);
+    }
+  }
+  return;
+}
+
 /* calculate the parameter change r[nSmat] from SOpt.
    The result is gathered in rank 0. */
 int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm comm) {
@@ -38,14 +255,14 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
   /* distributed matrix (row x col) */
   double *s; /* overlap matrix (nSmat x nSmat) */
   double *g; /* energy gradient and parameter change (nSmat x 1) */
+  double *o, *a; /* samples of O (local and distributed) */
 
-  int sSize,gSize;
+  int sSize,gSize,oSize=0,aSize=0;
   int wSize=nSmat;
+  int nCol,alocc;
 
   /* for MPI */
   int rank,size;
-  int dims[2]={0,0};
-  MPI_Comm comm_col;
 
   /* index table */
   int *irToSmatIdx; /* table for local indx to Smat index */
@@ -53,7 +270,6 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
 
   /* for BLACS */
   int ictxt,nprow,npcol,myprow,mypcol;
-  char procOrder='R';
 
   /* for array descriptor of SCALAPACK */
   int m,n;
@@ -72,7 +288,6 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
   int si,pi,pj,idx;
   int ir,ic;
 
-  const int srOptSize = SROptSize;//TBC
   const double dSROptStepDt = DSROptStepDt;
   const double srOptHO_0 = creal(SROptHO[0]);
  // const double complex srOptHO_0 = SROptHO[0];
@@ -83,13 +298,12 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
 
   MPI_Comm_rank(comm,&rank);
   MPI_Comm_size(comm,&size);
-  MPI_Dims_create(size,2,dims);
 
-  /* initialize the BLACS context */
-  nprow=dims[0]; npcol=dims[1];
-  ictxt = Csys2blacs_handle(comm);
-  Cblacs_gridinit(&ictxt, &procOrder, nprow, npcol);
-  Cblacs_gridinfo(ictxt, &nprow, &npcol, &myprow, &mypcol);
+  /* the BLACS context is created only once */
+  StcOptGridInit(comm);
+  ictxt=SROptCtxt;
+  nprow=SROptNprow; npcol=SROptNpcol;
+  myprow=SROptMyprow; mypcol=SROptMypcol;
 
   /* initialize array descriptors for distributed matrix s */
   m=n=nSmat; /* matrix size */
@@ -107,13 +321,22 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
   M_DESCINIT(descg, &m, &n, &mb, &nb, &irsrc, &icsrc, &ictxt, &vlld, &info);
   gSize = (vlocr*vlocc>0) ? vlocr*vlocc : 1;
 
-  //printf("DEBUG: n=%d nSmat=%d gSize=%d  sSize=%d wSize=%d: srOptSize=%d \n",n,nSmat,gSize,sSize,wSize,srOptSize);
-  //printf("DEBUG: vlocc=%d mlocc=%d \n",vlocc,mlocc);
+  /* the columns of O of all the samples (nSmat x nCol*size) */
+  if(IsSROptOODiag()) {
+    nCol = (AllComplexFlag==0 ? 1 : 2)*NVMCSample;
+    n = nCol*size;
+    alocc = M_NUMROC(&n, &nb, &mypcol, &icsrc, &npcol);
+    oSize = nSmat*nCol;
+    aSize = (mlocr*alocc>0) ? mlocr*alocc : 1;
+  }
+
   /* allocate memory */
-  RequestWorkSpaceDouble(sSize+gSize+wSize);
+  RequestWorkSpaceDouble(sSize+gSize+wSize+oSize+aSize);
   s = GetWorkSpaceDouble(sSize);
   g = GetWorkSpaceDouble(gSize);
   w = GetWorkSpaceDouble(wSize);
+  o = GetWorkSpaceDouble(oSize);
+  a = GetWorkSpaceDouble(aSize);
 
   /* Para indices of the distributed vector and calculate them */
   RequestWorkSpaceInt(2*mlocr+mlocc);
@@ -135,20 +358,20 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
   StopTimer(55);
   StartTimer(56);
   /* calculate the overlap matrix S */
-  //printf("YDEBUG: %d %d %lf \n",mlocc,mlocr,ratioDiag);
+  if(IsSROptOODiag()) {
+    stcOptMakeSStore(s, descs, o, a, nSmat, smatToParaIdx, mlocr, mlocc,
+                     irToParaIdx, icToParaIdx, comm);
+  } else {
+    stcOptReduceS(s, nSmat, smatToParaIdx, mlocr, mlocc, irToParaIdx, icToParaIdx, comm);
+  }
+
+  /* modify diagonal elements */
   #pragma omp parallel for default(shared) private(ic,ir,pi,pj,idx)
-  #pragma loop noalias
   for(ic=0;ic<mlocc;ic++) {
     pj = icToParaIdx[ic]; /* Para index (global) */
     for(ir=0;ir<mlocr;ir++) {
       pi = irToParaIdx[ir]; /* Para index (global) */
       idx = ir + ic*mlocr; /* local index (row major) */
-
-      /* S[i][j] = xOO[i+1][j+1] - xOO[0][i+1] * xOO[0][j+1]; */
-      s[idx] = creal(srOptOO[(pi+2)*(2*srOptSize)+(pj+2)]) - creal(srOptOO[pi+2]) * creal(srOptOO[pj+2]);
-      /* modify diagonal elements */
-      //printf("DEBUG: idx=%d %d %d s[]=%lf \n",idx,pi,pj,s[idx]);
-      //printf("XDEBUG %d %d %lf \n",ic,ir,s[idx]);
       if(pi==pj) s[idx] *= ratioDiag; // TBC
     }
   }
@@ -164,7 +387,6 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
       /* energy gradient = 2.0*( xHO[i+1] - xHO[0] * xOO[0][i+1]) */
       /* g[i] = -dt * (energy gradient) */
       g[ir] = -dSROptStepDt*2.0*(creal(srOptHO[pi+2]) - srOptHO_0 * creal(srOptOO[pi+2]));
-      //printf("ZDEBUG: %d %lf \n",ir,g[ir]);
     }
   }
 
@@ -194,6 +416,8 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
   /* error handle */
   if(info!=0) {
     if(rank==0) fprintf(stderr,"error: PDPOSV info=%d\n",info);
+    ReleaseWorkSpaceInt();
+    ReleaseWorkSpaceDouble();
     return info;
   }
   /* end of diagonalization */
@@ -201,9 +425,6 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
   StopTimer(57);
   StartTimer(58);
 
-  /* create a communicator whose process has the same value of mypcol */
-  MPI_Comm_split(comm,mypcol,myprow,&comm_col); 
-
   /* clear workspace */
   for(si=0;si<nSmat;si++) w[si] = 0.0;
 
@@ -218,7 +439,7 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
     }
 
     /* gather the solution to r on rank=0 process */
-    SafeMpiReduce(w,r,nSmat,comm_col);
+    SafeMpiReduce(w,r,nSmat,SROptCommCol);
   }
 
   StopTimer(58);
@@ -232,8 +453,6 @@ int stcOptMain(double *r, const int nSmat, const int *smatToParaIdx, MPI_Comm co
 
   ReleaseWorkSpaceInt();
   ReleaseWorkSpaceDouble();
-  MPI_Comm_free(&comm_col);
-  Cblacs_gridexit(ictxt);
   return info;
 }
 
@@ -337,14 +556,11 @@ int stcOptMainDiag(double *const r, int const nSmat, int *const smatToParaIdx,
 
   /* for MPI */
   int rank,size;//,i;
-  int dims[2]={0,0};
   //int *rcounts, *displs; /* for gatherv */
   int *grIdx;//, *grIdxAll;
-  MPI_Comm comm_col;
 
   /* for BLACS */
   int ictxt,nprow,npcol,myprow,mypcol;
-  char procOrder='R';
 
   /* for array descriptor of SCALAPACK */
   int m,n;
@@ -388,14 +604,13 @@ int stcOptMainDiag(double *const r, int const nSmat, int *const smatToParaIdx,
 
   MPI_Comm_rank(comm,&rank);
   MPI_Comm_size(comm,&size);
-  MPI_Dims_create(size,2,dims);
 
   StartTimer(55);
-  /* initialize the BLACS context */
-  nprow=dims[0]; npcol=dims[1];
-  ictxt = Csys2blacs_handle(comm);
-  Cblacs_gridinit(&ictxt, &procOrder, nprow, npcol);
-  Cblacs_gridinfo(ictxt, &nprow, &npcol, &myprow, &mypcol);
+  /* the BLACS context is created only once */
+  StcOptGridInit(comm);
+  ictxt=SROptCtxt;
+  nprow=SROptNprow; npcol=SROptNpcol;
+  myprow=SROptMyprow; mypcol=SROptMypcol;
 
   /* initialize array descriptors for distributed matrix s and z */
   m=n=nSmat; /* matrix size */
@@ -450,7 +665,9 @@ int stcOptMainDiag(double *const r, int const nSmat, int *const smatToParaIdx,
 
   StopTimer(55);
   StartTimer(56);
-  /* calculate the overlap matrix S */
+  /* calculate the overlap matrix S (only the upper triangle is referenced by PDSYEVD) */
+  stcOptReduceS(s, nSmat, smatToParaIdx, mlocr, mlocc, irToParaIdx, icToParaIdx, comm);
+
   #pragma omp parallel for default(shared) private(ic,ir,pi,pj,idx)
   #pragma loop noalias
   for(ic=0;ic<mlocc;ic++) {
@@ -459,8 +676,6 @@ int stcOptMainDiag(double *const r, int const nSmat, int *const smatToParaIdx,
       pi = irToParaIdx[ir]; /* Para index (global) */
       idx = ir + ic*mlocr; /* local index (row major) */
 
-      /* S[i][j] = xOO[i+1][j+1] - xOO[0][i+1] * xOO[0][j+1]; */
-      s[idx] = creal(srOptOO[(pi+2)*2*srOptSize+(pj+2)]) - creal(srOptOO[pi+2]) * creal(srOptOO[pj+2]);
       /* modify diagonal elements */
       //if(pi==pj) s[idx] *= ratioDiag;
       if(pi==pj) s[idx] += 0.1;
@@ -554,9 +769,6 @@ int stcOptMainDiag(double *const r, int const nSmat, int *const smatToParaIdx,
            g, &ig, &jg, descg, &incg);
   /***** copy distributed vector g to global vector r *****/
 
-  /* create a communicator whose process has the same value of mypcol */
-  MPI_Comm_split(comm,mypcol,myprow,&comm_col); 
-
   /* clear workspace */
   for(si=0;si<nSmat;si++) w[si] = 0.0;
 
@@ -571,7 +783,7 @@ int stcOptMainDiag(double *const r, int const nSmat, int *const smatToParaIdx,
     }
 
     /* gather the solution to r on rank=0 process */
-    SafeMpiReduce(w,r,nSmat,comm_col);
+    SafeMpiReduce(w,r,nSmat,SROptCommCol);
   }
   
   /*** print zqp_SRinfo.dat ***/
@@ -598,8 +810,6 @@ int stcOptMainDiag(double *const r, int const nSmat, int *const smatToParaIdx,
 
   ReleaseWorkSpaceInt();
   ReleaseWorkSpaceDouble();
-  MPI_Comm_free(&comm_col);
-  Cblacs_gridexit(ictxt);
   
   return info;
 }
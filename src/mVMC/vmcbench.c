@@ -0,0 +1,507 @@
+/*
+mVMC - A numerical solver package for a wide range of quantum lattice models based on many-variable Variational Monte Carlo method
+Copyright (C) 2016 The University of Tokyo, All rights reserved.
+
+This program is developed based on the mVMC-mini program
+(https://github.com/fiber-miniapp/mVMC-mini)
+which follows "The BSD 3-Clause License".
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see http://www.gnu.org/licenses/.
+*/
+/*-------------------------------------------------------------
+ * Variational Monte Carlo
+ * microbenchmark of the Pfaffian and Green function kernels
+ *-------------------------------------------------------------*/
+/* The model is a periodic chain of Nsite sites with Ne up and Ne down */
+/* electrons, one Gutzwiller factor, random complex Slater orbitals   */
+/* f_ij (NSlater=Nsite*Nsite) and NQPFull translations. No def file is */
+/* read. Each kernel is repeated until it runs at least the given time. */
+/*                                                                     */
+/* GFLOP/s and GB/s are estimated from the following models per QP     */
+/* index (n=Nsize, real flops, x4 for complex, es=sizeof element):     */
+/*   CalculateMAll      8/3 n^3 flops (Pf, LU and inverse), 3 n^2 es   */
+/*   CalculateNewPfM2   2 n flops,            2 n es                   */
+/*   UpdateMAll         6 n^2 flops,          3 n^2 es                 */
+/*   GreenFunc1         2 n flops,            2 n es                   */
+/*   GreenFunc2         2 n^2 + 10 n flops,   n^2 + 4 n es             */
+/*   SlaterElmDiff      2 n^2 flops,          n^2 es + 2 n^2 int       */
+/* With _pf_block_update, the updated_tdi_v engine replaces the first  */
+/* three kernels and the same models give the effective rate.          */
+#include "vmcmain.h"
+
+void printBenchUsage();
+void setBenchModel(const int nSite, const int ne, const int nQPFull);
+void makeBenchSample(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt);
+void pickBenchHopping(int *mi, int *ri, int *rj, const int s,
+                      const int *eleIdx, const int *eleCfg, const int *eleNum);
+void outputBench(const char *name, const char *type, const int nCall, const double sec,
+                 const double flop, const double byte);
+
+/* the minimum time of each kernel */
+double BenchTimeMin;
+
+/*main program*/
+int main(int argc, char* argv[])
+{
+  int nSite=64, ne=32, nQPFull=8;
+  double tMin=0.5;
+  int option;
+  extern char *optarg;
+  int rank=0,info=0;
+
+  int *eleIdx,*eleCfg,*eleNum,*eleProjCnt,*projCntNew,*eleLst;
+  double complex *buffer, *srOptO;
+  double *buffer_real;
+  double complex ip;
+  double ip_real;
+  double n,nqp,es;
+  double t0,sec;
+  int nCall;
+  int mi,ri,rj,rk,rl,s,t;
+  int tmp;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  NThread = omp_get_max_threads();
+  InitTimer();
+
+  while((option=getopt(argc,argv,"n:e:q:t:h"))!=-1) {
+    switch(option) {
+    case 'n':
+      nSite = atoi(optarg);
+      break;
+    case 'e':
+      ne = atoi(optarg);
+      break;
+    case 'q':
+      nQPFull = atoi(optarg);
+      break;
+    case 't':
+      tMin = atof(optarg);
+      break;
+    case 'h':
+    default:
+      if(rank==0) printBenchUsage();
+      MPI_Finalize();
+      return (option=='h') ? 0 : -1;
+    }
+  }
+  if(nSite<2 || ne<1 || ne>=nSite || nQPFull<1 || nQPFull>nSite || tMin<=0.0) {
+    if(rank==0) {
+      fprintf(stderr,"error: 0 < Ne < Nsite and 0 < NQPFull <= Nsite are required.\n");
+      printBenchUsage();
+    }
+    MPI_Finalize();
+    return -1;
+  }
+  BenchTimeMin = tMin;
+
+  init_gen_rand(11272);
+  setBenchModel(nSite, ne, nQPFull);
+  SetMemory();
+  /* SetMemory keeps only the complex arrays for AllComplexFlag=1, */
+  /* but the real kernels are measured as well */
+  SlaterElm_real = (double*)malloc(sizeof(double)*(NQPFull*Nsite2*Nsite2));
+  InvM_real = (double*)malloc(sizeof(double)*(NQPFull*(Nsize*Nsize+1)));
+  PfM_real = InvM_real + NQPFull*Nsize*Nsize;
+  LapackLWork = getLWork_fcmp();
+  InitParameter();
+  InitQPWeight();
+  UpdateSlaterElm_fcmp();
+  UpdateSlaterElm_real();
+
+  eleIdx = (int*)malloc(sizeof(int)*(Nsize+2*Nsite2+2*NProj));
+  eleCfg = eleIdx + Nsize;
+  eleNum = eleCfg + Nsite2;
+  eleProjCnt = eleNum + Nsite2;
+  projCntNew = eleProjCnt + NProj;
+  eleLst = (int*)malloc(sizeof(int)*SizeEleLst());
+  buffer = (double complex*)malloc(sizeof(double complex)*(NQPFull+2*Nsize));
+  buffer_real = (double*)malloc(sizeof(double)*(NQPFull+2*Nsize));
+  srOptO = (double complex*)malloc(sizeof(double complex)*2*NSlater);
+  makeBenchSample(eleIdx, eleCfg, eleNum, eleProjCnt);
+  makeEleLst(eleLst, eleIdx, eleNum);
+
+  n = (double)Nsize;
+  nqp = (double)NQPFull;
+  if(rank==0) {
+    fprintf(stdout,"# vmcbench: Nsite=%d Ne=%d Nsize=%d NQPFull=%d NThread=%d block_update=%s\n",
+            Nsite, Ne, Nsize, NQPFull, NThread,
+#ifdef _pf_block_update
+            "on"
+#else
+            "off"
+#endif
+            );
+    fprintf(stdout,"# %-22s %-8s %10s %14s %10s %10s\n",
+            "kernel","type","calls","usec/call","GFLOP/s","GB/s");
+  }
+
+/* run STMT until it takes BenchTimeMin seconds at least */
+#define BENCH_LOOP(STMT) do {                            \
+    nCall=0;                                             \
+    STMT;                                                \
+    t0=getTime();                                        \
+    do { STMT; nCall++; sec=getTime()-t0; }              \
+    while(sec<BenchTimeMin);                             \
+  } while(0)
+
+  /***** complex *****/
+  es = sizeof(double complex);
+
+#ifdef _pf_block_update
+  {
+    void *pfOrbital[NQPFull];
+    void *pfUpdator[NQPFull];
+    if (NBlockUpdateSize < 1) NBlockUpdateSize = 4;
+    for (mi=0; mi<Ne;  mi++) EleSpn[mi] = 0;
+    for (mi=Ne;mi<Ne*2;mi++) EleSpn[mi] = 1;
+
+    BENCH_LOOP(
+      updated_tdi_v_init_z(NQPFull, Nsite, Nsite2, Nsize, SlaterElm, Nsite2*Nsite2,
+                           InvM, Nsize*Nsize, eleIdx, EleSpn, NBlockUpdateSize,
+                           pfUpdator, pfOrbital);
+      updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+      updated_tdi_v_free_z(NQPFull, pfUpdator, pfOrbital));
+    outputBench("updated_tdi_v_init","complex",nCall,sec,4.0*nqp*8.0/3.0*n*n*n,3.0*nqp*n*n*es);
+
+    updated_tdi_v_init_z(NQPFull, Nsite, Nsite2, Nsize, SlaterElm, Nsite2*Nsite2,
+                         InvM, Nsize*Nsize, eleIdx, EleSpn, NBlockUpdateSize,
+                         pfUpdator, pfOrbital);
+    BENCH_LOOP(
+      updated_tdi_v_reinit_z(NQPFull, Nsite, Nsite2, Nsize, SlaterElm, Nsite2*Nsite2,
+                             InvM, Nsize*Nsize, eleIdx, EleSpn, NBlockUpdateSize,
+                             pfUpdator, pfOrbital);
+      updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator));
+    outputBench("updated_tdi_v_reinit","complex",nCall,sec,4.0*nqp*8.0/3.0*n*n*n,3.0*nqp*n*n*es);
+
+    /* rejected hopping: push, Pfaffian and pop */
+    BENCH_LOOP(
+      s = nCall%2;
+      pickBenchHopping(&mi,&ri,&rj,s,eleIdx,eleCfg,eleNum);
+      updated_tdi_v_push_z(NQPFull, rj+s*Nsite, mi+s*Ne, 1, pfUpdator);
+      updated_tdi_v_get_pfa_z(NQPFull, buffer, pfUpdator);
+      updated_tdi_v_pop_z(NQPFull, 0, pfUpdator));
+    outputBench("updated_tdi_v_push_pop","complex",nCall,sec,4.0*nqp*2.0*n,2.0*nqp*n*es);
+
+    /* accepted hopping: push and Pfaffian */
+    BENCH_LOOP(
+      s = nCall%2;
+      pickBenchHopping(&mi,&ri,&rj,s,eleIdx,eleCfg,eleNum);
+      updated_tdi_v_push_z(NQPFull, rj+s*Nsite, mi+s*Ne, 1, pfUpdator);
+      updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+      updateEleConfig(mi,ri,rj,s,eleIdx,eleCfg,eleNum,eleLst));
+    outputBench("updated_tdi_v_push","complex",nCall,sec,4.0*nqp*6.0*n*n,3.0*nqp*n*n*es);
+    updated_tdi_v_free_z(NQPFull, pfUpdator, pfOrbital);
+    MakeProjCnt(eleProjCnt, eleNum);
+  }
+#endif
+
+  BENCH_LOOP(info=CalculateMAll_fcmp(eleIdx,0,NQPFull));
+  outputBench("CalculateMAll","complex",nCall,sec,4.0*nqp*8.0/3.0*n*n*n,3.0*nqp*n*n*es);
+
+  BENCH_LOOP(
+    s = nCall%2;
+    pickBenchHopping(&mi,&ri,&rj,s,eleIdx,eleCfg,eleNum);
+    tmp = eleIdx[mi+s*Ne];
+    eleIdx[mi+s*Ne] = rj;
+    CalculateNewPfM2(mi,s,buffer,eleIdx,0,NQPFull);
+    eleIdx[mi+s*Ne] = tmp);
+  outputBench("CalculateNewPfM2","complex",nCall,sec,4.0*nqp*2.0*n,2.0*nqp*n*es);
+
+  BENCH_LOOP(
+    s = nCall%2;
+    pickBenchHopping(&mi,&ri,&rj,s,eleIdx,eleCfg,eleNum);
+    updateEleConfig(mi,ri,rj,s,eleIdx,eleCfg,eleNum,eleLst);
+    UpdateMAll(mi,s,eleIdx,0,NQPFull));
+  outputBench("UpdateMAll","complex",nCall,sec,4.0*nqp*6.0*n*n,3.0*nqp*n*n*es);
+
+  /* the Green functions and SlaterElmDiff start from the accurate InvM */
+  MakeProjCnt(eleProjCnt, eleNum);
+  info += CalculateMAll_fcmp(eleIdx,0,NQPFull);
+  ip = CalculateIP_fcmp(PfM,0,NQPFull,MPI_COMM_SELF);
+
+  BENCH_LOOP(
+    s = nCall%2;
+    pickBenchHopping(&mi,&rj,&ri,s,eleIdx,eleCfg,eleNum);
+    GreenFunc1(ri,rj,s,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer));
+  outputBench("GreenFunc1","complex",nCall,sec,4.0*nqp*2.0*n,2.0*nqp*n*es);
+
+  BENCH_LOOP(
+    s = 0; t = 1;
+    pickBenchHopping(&mi,&rj,&ri,s,eleIdx,eleCfg,eleNum);
+    pickBenchHopping(&mi,&rl,&rk,t,eleIdx,eleCfg,eleNum);
+    GreenFunc2(ri,rj,rk,rl,s,t,ip,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer));
+  outputBench("GreenFunc2","complex",nCall,sec,4.0*nqp*(2.0*n*n+10.0*n),nqp*(n*n+4.0*n)*es);
+
+  BENCH_LOOP(SlaterElmDiff_fcmp(srOptO,ip,eleIdx));
+  outputBench("SlaterElmDiff_fcmp","complex",nCall,sec,nqp*8.0*n*n,nqp*(n*n*es+2.0*n*n*sizeof(int)));
+
+  /***** real *****/
+  es = sizeof(double);
+
+#ifdef _pf_block_update
+  {
+    void *pfOrbital[NQPFull];
+    void *pfUpdator[NQPFull];
+
+    BENCH_LOOP(
+      updated_tdi_v_init_d(NQPFull, Nsite, Nsite2, Nsize, SlaterElm_real, Nsite2*Nsite2,
+                           InvM_real, Nsize*Nsize, eleIdx, EleSpn, NBlockUpdateSize,
+                           pfUpdator, pfOrbital);
+      updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+      updated_tdi_v_free_d(NQPFull, pfUpdator, pfOrbital));
+    outputBench("updated_tdi_v_init","real",nCall,sec,nqp*8.0/3.0*n*n*n,3.0*nqp*n*n*es);
+
+    updated_tdi_v_init_d(NQPFull, Nsite, Nsite2, Nsize, SlaterElm_real, Nsite2*Nsite2,
+                         InvM_real, Nsize*Nsize, eleIdx, EleSpn, NBlockUpdateSize,
+                         pfUpdator, pfOrbital);
+    BENCH_LOOP(
+      updated_tdi_v_reinit_d(NQPFull, Nsite, Nsite2, Nsize, SlaterElm_real, Nsite2*Nsite2,
+                             InvM_real, Nsize*Nsize, eleIdx, EleSpn, NBlockUpdateSize,
+                             pfUpdator, pfOrbital);
+      updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator));
+    outputBench("updated_tdi_v_reinit","real",nCall,sec,nqp*8.0/3.0*n*n*n,3.0*nqp*n*n*es);
+
+    BENCH_LOOP(
+      s = nCall%2;
+      pickBenchHopping(&mi,&ri,&rj,s,eleIdx,eleCfg,eleNum);
+      updated_tdi_v_push_d(NQPFull, rj+s*Nsite, mi+s*Ne, 1, pfUpdator);
+      updated_tdi_v_get_pfa_d(NQPFull, buffer_real, pfUpdator);
+      updated_tdi_v_pop_d(NQPFull, 0, pfUpdator));
+    outputBench("updated_tdi_v_push_pop","real",nCall,sec,nqp*2.0*n,2.0*nqp*n*es);
+
+    BENCH_LOOP(
+      s = nCall%2;
+      pickBenchHopping(&mi,&ri,&rj,s,eleIdx,eleCfg,eleNum);
+      updated_tdi_v_push_d(NQPFull, rj+s*Nsite, mi+s*Ne, 1, pfUpdator);
+      updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+      updateEleConfig(mi,ri,rj,s,eleIdx,eleCfg,eleNum,eleLst));
+    outputBench("updated_tdi_v_push","real",nCall,sec,nqp*6.0*n*n,3.0*nqp*n*n*es);
+    updated_tdi_v_free_d(NQPFull, pfUpdator, pfOrbital);
+    MakeProjCnt(eleProjCnt, eleNum);
+  }
+#endif
+
+  BENCH_LOOP(info=CalculateMAll_real(eleIdx,0,NQPFull));
+  outputBench("CalculateMAll_real","real",nCall,sec,nqp*8.0/3.0*n*n*n,3.0*nqp*n*n*es);
+
+  BENCH_LOOP(
+    s = nCall%2;
+    pickBenchHopping(&mi,&ri,&rj,s,eleIdx,eleCfg,eleNum);
+    tmp = eleIdx[mi+s*Ne];
+    eleIdx[mi+s*Ne] = rj;
+    CalculateNewPfM2_real(mi,s,buffer_real,eleIdx,0,NQPFull);
+    eleIdx[mi+s*Ne] = tmp);
+  outputBench("CalculateNewPfM2_real","real",nCall,sec,nqp*2.0*n,2.0*nqp*n*es);
+
+  BENCH_LOOP(
+    s = nCall%2;
+    pickBenchHopping(&mi,&ri,&rj,s,eleIdx,eleCfg,eleNum);
+    updateEleConfig(mi,ri,rj,s,eleIdx,eleCfg,eleNum,eleLst);
+    UpdateMAll_real(mi,s,eleIdx,0,NQPFull));
+  outputBench("UpdateMAll_real","real",nCall,sec,nqp*6.0*n*n,3.0*nqp*n*n*es);
+
+  MakeProjCnt(eleProjCnt, eleNum);
+  info += CalculateMAll_real(eleIdx,0,NQPFull);
+  ip_real = CalculateIP_real(PfM_real,0,NQPFull,MPI_COMM_SELF);
+
+  BENCH_LOOP(
+    s = nCall%2;
+    pickBenchHopping(&mi,&rj,&ri,s,eleIdx,eleCfg,eleNum);
+    GreenFunc1_real(ri,rj,s,ip_real,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer_real));
+  outputBench("GreenFunc1_real","real",nCall,sec,nqp*2.0*n,2.0*nqp*n*es);
+
+  BENCH_LOOP(
+    s = 0; t = 1;
+    pickBenchHopping(&mi,&rj,&ri,s,eleIdx,eleCfg,eleNum);
+    pickBenchHopping(&mi,&rl,&rk,t,eleIdx,eleCfg,eleNum);
+    GreenFunc2_real(ri,rj,rk,rl,s,t,ip_real,eleIdx,eleCfg,eleNum,eleProjCnt,projCntNew,buffer_real));
+  outputBench("GreenFunc2_real","real",nCall,sec,nqp*(2.0*n*n+10.0*n),nqp*(n*n+4.0*n)*es);
+
+  BENCH_LOOP(SlaterElmDiff_real((double*)srOptO,ip_real,eleIdx));
+  outputBench("SlaterElmDiff_real","real",nCall,sec,nqp*2.0*n*n,nqp*(n*n*es+2.0*n*n*sizeof(int)));
+
+#undef BENCH_LOOP
+
+  if(info!=0 && rank==0) {
+    fprintf(stderr,"warning: the Pfaffian of the random sample is singular (info=%d).\n",info);
+  }
+
+  free(srOptO);
+  free(buffer_real);
+  free(buffer);
+  free(eleLst);
+  free(eleIdx);
+  FreeMemory();
+  FreeMemoryDef();
+  FreeTimer();
+  MPI_Finalize();
+  return 0;
+}
+
+void printBenchUsage() {
+  fprintf(stderr,"Usage: vmcbench.out [option]\n");
+  fprintf(stderr,"  -n N   the number of sites (default: 64)\n");
+  fprintf(stderr,"  -e N   the number of electrons per spin (default: 32)\n");
+  fprintf(stderr,"  -q N   the number of QP indices NQPFull (default: 8)\n");
+  fprintf(stderr,"  -t T   the minimum time [sec] of each kernel (default: 0.5)\n");
+  fprintf(stderr,"  -h     show this message\n");
+  return;
+}
+
+/* Set the counts read by ReadDefFileNInt() and the index arrays */
+/* read by ReadDefFileIdxPara() for the synthetic model. */
+void setBenchModel(const int nSite, const int ne, const int nQPFull) {
+  int i,j,idx;
+
+  Nsite = nSite;
+  Ne = ne;
+  NTransfer = 4*nSite;
+  NCoulombIntra = NCoulombInter = NHundCoupling = 0;
+  NPairHopping = NExchangeCoupling = NInterAll = 0;
+  NGutzwillerIdx = 1;
+  NJastrowIdx = NDoublonHolon2siteIdx = NDoublonHolon4siteIdx = 0;
+  NBackFlowIdx = 0;
+  iFlgOrbitalGeneral = 0;
+  NOrbitalIdx = nSite*nSite;
+  NQPTrans = NMPTrans = nQPFull;
+  NQPOptTrans = 1;
+  NSPGaussLeg = 1;
+  NSPStot = 0;
+  FlagOptTrans = 0;
+  NCisAjs = NCisAjsCktAlt = NCisAjsCktAltDC = 0;
+  NLanczosMode = 0;
+  NVMCCalMode = 1;
+  NVMCSample = 1;
+  NCompressSlater = 0;
+  NDelayUpdate = 0;
+  NMultiChain = 0;
+  AllComplexFlag = 1;
+
+  Nsize = 2*Ne;
+  Nsite2 = 2*Nsite;
+  NSlater = NOrbitalIdx;
+  NProj = NGutzwillerIdx;
+  NProjBF = 0;
+  NOptTrans = 0;
+  NPara = NProj + NSlater;
+  NQPFix = NSPGaussLeg * NMPTrans;
+  NQPFull = NQPFix * NQPOptTrans;
+  SROptSize = NPara + 1;
+
+  NTotalDefInt = Nsite /* LocSpn */
+    + 4*NTransfer /* Transfer */
+    + Nsite /* GutzwillerIdx */
+    + Nsite*Nsite /* JastrowIdx */
+    + Nsite*Nsite /* OrbitalIdx */
+    + Nsite*Nsite /* OrbitalSgn */
+    + 3*Nsite*NQPTrans /* QPTrans, QPTransInv, QPTransSgn */
+    + 2*Nsite*NQPOptTrans /* QPOptTrans, QPOptTransSgn */
+    + 2*NPara; /* OptFlag */
+  NTotalDefDouble = NQPOptTrans; /* ParaQPOptTrans */
+
+  SetMemoryDef();
+
+  for(i=0;i<Nsite;i++) LocSpn[i] = 0;
+  /* nearest-neighbor hopping of the periodic chain */
+  for(i=0;i<Nsite;i++) {
+    for(j=0;j<2;j++) {
+      idx = 4*i+2*j;
+      Transfer[idx][0] = i;
+      Transfer[idx][1] = j;
+      Transfer[idx][2] = (i+1)%Nsite;
+      Transfer[idx][3] = j;
+      Transfer[idx+1][0] = (i+1)%Nsite;
+      Transfer[idx+1][1] = j;
+      Transfer[idx+1][2] = i;
+      Transfer[idx+1][3] = j;
+      ParaTransfer[idx] = ParaTransfer[idx+1] = 1.0;
+    }
+  }
+  for(i=0;i<Nsite;i++) GutzwillerIdx[i] = 0;
+  for(i=0;i<Nsite;i++) {
+    for(j=0;j<Nsite;j++) {
+      JastrowIdx[i][j] = 0;
+      OrbitalIdx[i][j] = i*Nsite+j;
+      OrbitalSgn[i][j] = 1;
+    }
+  }
+  /* translations of the chain */
+  for(idx=0;idx<NQPTrans;idx++) {
+    for(i=0;i<Nsite;i++) {
+      QPTrans[idx][i] = (i+idx)%Nsite;
+      QPTransInv[idx][i] = (i-idx+Nsite)%Nsite;
+      QPTransSgn[idx][i] = 1;
+    }
+    ParaQPTrans[idx] = 1.0;
+  }
+  for(i=0;i<Nsite;i++) {
+    QPOptTrans[0][i] = i;
+    QPOptTransSgn[0][i] = 1;
+  }
+  ParaQPOptTrans[0] = 1.0;
+  for(i=0;i<2*NPara;i++) OptFlag[i] = 1;
+  return;
+}
+
+/* random electron configuration without double occupation bias */
+void makeBenchSample(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt) {
+  int i,j,s,ri,tmp;
+  int *site;
+
+  site = (int*)malloc(sizeof(int)*Nsite);
+  for(ri=0;ri<Nsite2;ri++) {
+    eleCfg[ri] = -1;
+    eleNum[ri] = 0;
+  }
+  for(s=0;s<2;s++) {
+    for(ri=0;ri<Nsite;ri++) site[ri] = ri;
+    for(i=0;i<Ne;i++) {
+      j = i + gen_rand32()%(Nsite-i);
+      tmp = site[i];
+      site[i] = site[j];
+      site[j] = tmp;
+      ri = site[i];
+      eleIdx[i+s*Ne] = ri;
+      eleCfg[ri+s*Nsite] = i;
+      eleNum[ri+s*Nsite] = 1;
+    }
+  }
+  MakeProjCnt(eleProjCnt, eleNum);
+  free(site);
+  return;
+}
+
+/* pick the mi-th electron with spin s at ri and an empty site rj */
+void pickBenchHopping(int *mi, int *ri, int *rj, const int s,
+                      const int *eleIdx, const int *eleCfg, const int *eleNum) {
+  *mi = gen_rand32()%Ne;
+  *ri = eleIdx[*mi+s*Ne];
+  do {
+    *rj = gen_rand32()%Nsite;
+  } while(eleNum[*rj+s*Nsite]==1);
+  return;
+}
+
+void outputBench(const char *name, const char *type, const int nCall, const double sec,
+                 const double flop, const double byte) {
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if(rank!=0) return;
+  fprintf(stdout,"  %-22s %-8s %10d %14.3lf %10.3lf %10.3lf\n", name, type, nCall,
+          1.0e6*sec/nCall, 1.0e-9*flop*nCall/sec, 1.0e-9*byte*nCall/sec);
+  fflush(stdout);
+  return;
+}
@@ -41,12 +41,15 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 void clearPhysQuantity();
 
 void calculateOptTransDiff(double complex *srOptO, const double complex ipAll);
+void calculateOptTransDiff_real(double complex *srOptO, const double ipAll);
 void calculateOO_matvec(double complex *srOptOO, double complex *srOptHO, const double complex *srOptO,
                  const double complex w, const double complex e, const int srOptSize);
 void calculateOO(double complex *srOptOO, double complex *srOptHO, const double complex *srOptO,
                  const double  w, const double complex e, const int srOptSize);
 void calculateOO_real(double *srOptOO, double *srOptHO, const double *srOptO,
                  const double w, const double e, const int srOptSize);
+void flushOO(double complex *srOptOO, const int srOptSize);
+void flushOO_real(double *srOptOO, const int srOptSize);
 void calculateOO_Store_real(double *srOptOO_real, double *srOptHO_real,  double *srOptO_real,
                  const double w, const double e,  int srOptSize, int sampleSize);
 void calculateOO_Store(double complex *srOptOO, double complex *srOptHO,  double complex *srOptO,
@@ -68,7 +71,29 @@ void calculateQCACAQ_real(double *qcacaq, const double *lslca, const double w,
                           const int nLSHam, const int nCA, const int nCACA,
                           int **cacaIdx);
 
-void VMCMainCal(MPI_Comm comm) {
+/* Return 1 if the physical quantities are measured inside VMCMakeSample(_real). */
+/* The sampler then hands its own InvM and PfM to VMCMainCalSample, */
+/* which is possible only when the QP indices are not split over comm. */
+/* With NSplitChain!=0, each process measures the samples of its own chain. */
+int IsInlineMeasure(MPI_Comm comm) {
+#ifdef _pf_block_update
+  /* InvM is not kept up to date by the block-update engine */
+  return 0;
+#else
+  int size;
+  if(NInlineMeasure==0 || NProjBF!=0 || iFlgOrbitalGeneral!=0) return 0;
+  if(IsMultiChain(comm)) return 0;
+  if(IsSplitChain(comm)) return 1;
+  MPI_Comm_size(comm,&size);
+  return (size==1) ? 1 : 0;
+#endif
+}
+
+/* Measure the physical quantities of the sample-th configuration.  */
+/* flagMAll==1: InvM and PfM are recalculated from EleIdx.           */
+/* flagMAll==0: InvM and PfM (or InvM_real and PfM_real) must already */
+/*              correspond to the sample-th configuration.            */
+void VMCMainCalSample(const int sample, const int flagMAll, const int rank) {
   int *eleIdx,*eleCfg,*eleNum,*eleProjCnt;
   double complex e,ip;
   double w;
@@ -77,222 +102,260 @@ void VMCMainCal(MPI_Comm comm) {
 
   const int qpStart=0;
   const int qpEnd=NQPFull;
-  int sample,sampleStart,sampleEnd,sampleSize;
-  int i,info,tmp_i;
+  int i,info=0;
 
   /* optimazation for Kei */
   const int nProj=NProj;
   double complex *srOptO = SROptO;
   double         *srOptO_real = SROptO_real;
 
-  int rank,size,int_i;
-  MPI_Comm_size(comm,&size);
-  MPI_Comm_rank(comm,&rank);
-#ifdef _DEBUG_VMCCAL
-  printf("  Debug: SplitLoop\n");
-#endif
-  SplitLoop(&sampleStart,&sampleEnd,NVMCSample,rank,size);
-
-  /* initialization */
-  StartTimer(24);
-  clearPhysQuantity();
-  StopTimer(24);
-  for(sample=sampleStart;sample<sampleEnd;sample++) {
+  int int_i;
 
-    eleIdx = EleIdx + sample*Nsize;
-    eleCfg = EleCfg + sample*Nsite2;
-    eleNum = EleNum + sample*Nsite2;
-    eleProjCnt = EleProjCnt + sample*NProj;
+  eleIdx = EleIdx + sample*Nsize;
+  eleCfg = EleCfg + sample*Nsite2;
+  eleNum = EleNum + sample*Nsite2;
+  eleProjCnt = EleProjCnt + sample*NProj;
 
-    StartTimer(40);
+  StartTimer(40);
 #ifdef _DEBUG_VMCCAL
-    printf("  Debug: sample=%d: CalculateMAll \n",sample);
+  printf("  Debug: sample=%d: CalculateMAll \n",sample);
 #endif
-    if(AllComplexFlag==0){
-      info = CalculateMAll_real(eleIdx,qpStart,qpEnd); // InvM_real,PfM_real will change
-#pragma omp parallel for default(shared) private(tmp_i)
-      for(tmp_i=0;tmp_i<NQPFull*(Nsize*Nsize+1);tmp_i++)  InvM[tmp_i]= InvM_real[tmp_i]; // InvM will be used in  SlaterElmDiff_fcmp
-    }else{
-      info = CalculateMAll_fcmp(eleIdx,qpStart,qpEnd); // InvM,PfM will change
-    }
-    StopTimer(40);
+  if(AllComplexFlag==0){
+    /* with flagMAll==0, InvM_real and PfM_real are kept by VMCMakeSample_real */
+    if(flagMAll) info = CalculateMAll_real(eleIdx,qpStart,qpEnd); // InvM_real,PfM_real will change
+  }else{
+    /* with flagMAll==0, InvM and PfM are kept by VMCMakeSample */
+    if(flagMAll) info = CalculateMAll_fcmp(eleIdx,qpStart,qpEnd); // InvM,PfM will change
+  }
+  StopTimer(40);
 
-    if(info!=0) {
-      fprintf(stderr,"warning: VMCMainCal rank:%d sample:%d info:%d (CalculateMAll)\n",rank,sample,info);
-      continue;
-    }
+  if(info!=0) {
+    fprintf(stderr,"warning: VMCMainCal rank:%d sample:%d info:%d (CalculateMAll)\n",rank,sample,info);
+    return;
+  }
 #ifdef _DEBUG_VMCCAL
-    printf("  Debug: sample=%d: CalculateIP \n",sample);
+  printf("  Debug: sample=%d: CalculateIP \n",sample);
 #endif
-    if(AllComplexFlag==0){
-      ip = CalculateIP_real(PfM_real,qpStart,qpEnd,MPI_COMM_SELF);
-    }else{
-      ip = CalculateIP_fcmp(PfM,qpStart,qpEnd,MPI_COMM_SELF);
-    } 
+  if(AllComplexFlag==0){
+    ip = CalculateIP_real(PfM_real,qpStart,qpEnd,MPI_COMM_SELF);
+  }else{
+    ip = CalculateIP_fcmp(PfM,qpStart,qpEnd,MPI_COMM_SELF);
+  } 
 
 #ifdef _DEBUG_VMCCAL
-    printf("  Debug: sample=%d: LogProjVal \n",sample);
+  printf("  Debug: sample=%d: LogProjVal \n",sample);
 #endif
-    /* calculate reweight */
-    //w = exp(2.0*(log(fabs(ip))+x) - logSqPfFullSlater[sample]);
-    w =1.0;
+  /* calculate reweight */
+  //w = exp(2.0*(log(fabs(ip))+x) - logSqPfFullSlater[sample]);
+  w =1.0;
 #ifdef _DEBUG_VMCCAL
-    printf("  Debug: sample=%d: isfinite \n",sample);
+  printf("  Debug: sample=%d: isfinite \n",sample);
 #endif
-    if( !isfinite(w) ) {
-      fprintf(stderr,"warning: VMCMainCal rank:%d sample:%d w=%e\n",rank,sample,w);
-      continue;
-    }
+  if( !isfinite(w) ) {
+    fprintf(stderr,"warning: VMCMainCal rank:%d sample:%d w=%e\n",rank,sample,w);
+    return;
+  }
 
-    StartTimer(41);
-    /* calculate energy */
+  StartTimer(41);
+  /* calculate energy */
 #ifdef _DEBUG_VMCCAL
-    printf("  Debug: sample=%d: calculateHam \n",sample);
+  printf("  Debug: sample=%d: calculateHam \n",sample);
 #endif
-    if(AllComplexFlag==0){
+  if(AllComplexFlag==0){
 #ifdef _DEBUG_VMCCAL
-      printf("  Debug: sample=%d: calculateHam_real \n",sample);
+    printf("  Debug: sample=%d: calculateHam_real \n",sample);
 #endif
-      e = CalculateHamiltonian_real(creal(ip),eleIdx,eleCfg,eleNum,eleProjCnt);
-    }else{
+    e = CalculateHamiltonian_real(creal(ip),eleIdx,eleCfg,eleNum,eleProjCnt);
+  }else{
 #ifdef _DEBUG_VMCCAL
-      printf("  Debug: sample=%d: calculateHam_cmp \n",sample);
+    printf("  Debug: sample=%d: calculateHam_cmp \n",sample);
 #endif
-      e = CalculateHamiltonian(ip,eleIdx,eleCfg,eleNum,eleProjCnt);
-    }
-    //printf("MDEBUG: %lf %lf \n",creal(e),cimag(e));
-    StopTimer(41);
+    e = CalculateHamiltonian(ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+  }
+  //printf("MDEBUG: %lf %lf \n",creal(e),cimag(e));
+  StopTimer(41);
 
 #ifdef _DEBUG_VMCCAL
-    printf("  Debug: sample=%d: e = %lf %lf \n",sample, creal(e), cimag(e));
+  printf("  Debug: sample=%d: e = %lf %lf \n",sample, creal(e), cimag(e));
 #endif
-    if( !isfinite(creal(e) + cimag(e)) ) {
-      fprintf(stderr,"warning: VMCMainCal rank:%d sample:%d e=%e\n",rank,sample,creal(e)); //TBC
-      continue;
-    }
+  if( !isfinite(creal(e) + cimag(e)) ) {
+    fprintf(stderr,"warning: VMCMainCal rank:%d sample:%d e=%e\n",rank,sample,creal(e)); //TBC
+    return;
+  }
 
-    Wc += w;
-    Etot  += w * e;
-    Etot2 += w * conj(e) * e;
+  Wc += w;
+  Etot  += w * e;
+  Etot2 += w * conj(e) * e;
+  if(NAutoCorr!=0) LocalE[sample] = creal(e);
 #ifdef _DEBUG_VMCCAL
-    printf("  Debug: sample=%d: calculateOpt \n",sample);
+  printf("  Debug: sample=%d: calculateOpt \n",sample);
 #endif
-    if(NVMCCalMode==0) {
-      /* Calculate O for correlation fauctors */
-      srOptO[0] = 1.0+0.0*I;//   real 
-      srOptO[1] = 0.0+0.0*I;//   real 
+  if(NVMCCalMode==0) {
+    /* Calculate O for correlation fauctors */
+    srOptO[0] = 1.0+0.0*I;//   real 
+    srOptO[1] = 0.0+0.0*I;//   real 
 #pragma loop noalias
-      for(i=0;i<nProj;i++){ 
-        srOptO[(i+1)*2]     = (double)(eleProjCnt[i]); // even real
-        srOptO[(i+1)*2+1]   = 0.0+0.0*I;               // odd  comp
-      }
+    for(i=0;i<nProj;i++){ 
+      srOptO[(i+1)*2]     = (double)(eleProjCnt[i]); // even real
+      srOptO[(i+1)*2+1]   = 0.0+0.0*I;               // odd  comp
+    }
 
-      StartTimer(42);
-      /* SlaterElmDiff */
-      SlaterElmDiff_fcmp(SROptO+2*NProj+2,ip,eleIdx); //TBC: using InvM not InvM_real
-      StopTimer(42);
+    StartTimer(42);
+    /* SlaterElmDiff */
+    if(AllComplexFlag==0){
+      SlaterElmDiff_real(SROptO_real+NProj+1,creal(ip),eleIdx); // using InvM_real
+    }else{
+      SlaterElmDiff_fcmp(SROptO+2*NProj+2,ip,eleIdx);
+    }
+    StopTimer(42);
 
-      if(FlagOptTrans>0) { // this part will be not used
+    if(FlagOptTrans>0) { // this part will be not used
+      if(AllComplexFlag==0){
+        calculateOptTransDiff_real(SROptO+2*NProj+2*NSlater+2, creal(ip)); // using PfM_real
+      }else{
         calculateOptTransDiff(SROptO+2*NProj+2*NSlater+2, ip); //TBC
       }
-      //[s] this part will be used for real varaibles
-      if(AllComplexFlag==0){
+    }
+    //[s] this part will be used for real varaibles
+    if(AllComplexFlag==0){
+      /* the Slater part is already stored by SlaterElmDiff_real */
 #pragma loop noalias
-        for(i=0;i<SROptSize;i++){ 
-          srOptO_real[i] = creal(srOptO[2*i]);       
-        }
+      for(i=0;i<NProj+1;i++){ 
+        srOptO_real[i] = creal(srOptO[2*i]);       
       }
-      //[e]
+#pragma loop noalias
+      for(i=NProj+1+NSlater;i<SROptSize;i++){ 
+        srOptO_real[i] = creal(srOptO[2*i]);       
+      }
+    }
+    //[e]
 
-      StartTimer(43);
-      /* Calculate OO and HO */
-      if(NSRCG==0 && NStoreO==0){
-        if(AllComplexFlag==0){
-          calculateOO_real(SROptOO_real,SROptHO_real,SROptO_real,w,creal(e),SROptSize);
-        }else{
-          calculateOO(SROptOO,SROptHO,SROptO,w,e,SROptSize);
-        } 
+    StartTimer(43);
+    /* Calculate OO and HO */
+    if(NSRCG==0 && NStoreO==0){
+      if(AllComplexFlag==0){
+        calculateOO_real(SROptOO_real,SROptHO_real,SROptO_real,w,creal(e),SROptSize);
       }else{
-        we    = w*e;
-        sqrtw = sqrt(w); 
-        if(AllComplexFlag==0){
-          #pragma omp parallel for default(shared) private(int_i)
-          for(int_i=0;int_i<SROptSize;int_i++){
-            // SROptO_Store for fortran
-            SROptO_Store_real[int_i+sample*SROptSize]  = sqrtw*SROptO_real[int_i];
-            SROptHO_real[int_i]                       += creal(we)*SROptO_real[int_i]; 
-          }
-        }else{
-          #pragma omp parallel for default(shared) private(int_i)
-          for(int_i=0;int_i<SROptSize*2;int_i++){
-            // SROptO_Store for fortran
-            SROptO_Store[int_i+sample*(2*SROptSize)]  = sqrtw*SROptO[int_i];
-            SROptHO[int_i]                           += we*SROptO[int_i]; 
-          }
-        }
+        calculateOO(SROptOO,SROptHO,SROptO,w,e,SROptSize);
       } 
-      StopTimer(43);
+    }else{
+      we    = w*e;
+      sqrtw = sqrt(w); 
+      if(AllComplexFlag==0){
+        #pragma omp parallel for default(shared) private(int_i)
+        for(int_i=0;int_i<SROptSize;int_i++){
+          // SROptO_Store for fortran
+          SROptO_Store_real[int_i+sample*SROptSize]  = sqrtw*SROptO_real[int_i];
+          SROptHO_real[int_i]                       += creal(we)*SROptO_real[int_i]; 
+        }
+      }else{
+        #pragma omp parallel for default(shared) private(int_i)
+        for(int_i=0;int_i<SROptSize*2;int_i++){
+          // SROptO_Store for fortran
+          SROptO_Store[int_i+sample*(2*SROptSize)]  = sqrtw*SROptO[int_i];
+          SROptHO[int_i]                           += we*SROptO[int_i]; 
+        }
+      }
+    } 
+    StopTimer(43);
 
-    } else if(NVMCCalMode==1) {
-      StartTimer(42);
-      /* Calculate Green Function */
+  } else if(NVMCCalMode==1) {
+    StartTimer(42);
+    /* Calculate Green Function */
 #ifdef _DEBUG_VMCCAL
-      fprintf(stdout, "Debug: Start: CalcGreenFunc\n");
+    fprintf(stdout, "Debug: Start: CalcGreenFunc\n");
 #endif
+    if(AllComplexFlag==0){
+      CalculateGreenFunc_real(w,creal(ip),eleIdx,eleCfg,eleNum,eleProjCnt);
+    }else{
       CalculateGreenFunc(w,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
-      StopTimer(42);
+    }
+    StopTimer(42);
 
-      if(NLanczosMode>0){
+    if(NLanczosMode>0){
 #ifdef _DEBUG_VMCCAL
-  fprintf(stdout, "Debug: Start: Lanczos\n");
+fprintf(stdout, "Debug: Start: Lanczos\n");
 #endif
-        // ignoring Lanczos: to be added
-        /* Calculate local QQQQ */
-        StartTimer(43);
+      // ignoring Lanczos: to be added
+      /* Calculate local QQQQ */
+      StartTimer(43);
+      if(AllComplexFlag==0) {
+        LSLocalQ_real(creal(e),creal(ip),eleIdx,eleCfg,eleNum,eleProjCnt, LSLQ_real);
+        calculateQQQQ_real(QQQQ_real,LSLQ_real,w,NLSHam);
+      }else{
+        LSLocalQ(e,ip,eleIdx,eleCfg,eleNum,eleProjCnt, LSLQ);
+        calculateQQQQ(QQQQ,LSLQ,w,NLSHam);
+      }
+      StopTimer(43);
+
+      // LanczosGreen
+      if(NLanczosMode>1){
+        // Calculate local QcisAjsQ
+        StartTimer(44);
         if(AllComplexFlag==0) {
-          LSLocalQ_real(creal(e),creal(ip),eleIdx,eleCfg,eleNum,eleProjCnt, LSLQ_real);
-          calculateQQQQ_real(QQQQ_real,LSLQ_real,w,NLSHam);
-        }else{
-          LSLocalQ(e,ip,eleIdx,eleCfg,eleNum,eleProjCnt, LSLQ);
-          calculateQQQQ(QQQQ,LSLQ,w,NLSHam);
+          
+          LSLocalCisAjs_real(creal(e),creal(ip),eleIdx,eleCfg,eleNum,eleProjCnt);
+          calculateQCAQ_real(QCisAjsQ_real,LSLCisAjs_real,LSLQ_real,w,NLSHam,NCisAjs);
+          calculateQCACAQ_real(QCisAjsCktAltQ_real,LSLCisAjs_real,w,NLSHam,NCisAjs,
+                          NCisAjsCktAltDC, CisAjsCktAltLzIdx);
+          
         }
-        StopTimer(43);
-
-        // LanczosGreen
-        if(NLanczosMode>1){
-          // Calculate local QcisAjsQ
-          StartTimer(44);
-          if(AllComplexFlag==0) {
-            
-            LSLocalCisAjs_real(creal(e),creal(ip),eleIdx,eleCfg,eleNum,eleProjCnt);
-            calculateQCAQ_real(QCisAjsQ_real,LSLCisAjs_real,LSLQ_real,w,NLSHam,NCisAjs);
-            calculateQCACAQ_real(QCisAjsCktAltQ_real,LSLCisAjs_real,w,NLSHam,NCisAjs,
-                            NCisAjsCktAltDC, CisAjsCktAltLzIdx);
-            
-          }
-          else{
-            LSLocalCisAjs(e,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
-            calculateQCAQ(QCisAjsQ,LSLCisAjs,LSLQ,w,NLSHam,NCisAjs);
-            calculateQCACAQ(QCisAjsCktAltQ,LSLCisAjs,w,NLSHam,NCisAjs,
-                            NCisAjsCktAltDC,CisAjsCktAltLzIdx);
-          }
-          StopTimer(44);
+        else{
+          LSLocalCisAjs(e,ip,eleIdx,eleCfg,eleNum,eleProjCnt);
+          calculateQCAQ(QCisAjsQ,LSLCisAjs,LSLQ,w,NLSHam,NCisAjs);
+          calculateQCACAQ(QCisAjsCktAltQ,LSLCisAjs,w,NLSHam,NCisAjs,
+                          NCisAjsCktAltDC,CisAjsCktAltLzIdx);
         }
+        StopTimer(44);
       }
     }
-  } /* end of for(sample) */
+  }
+  return;
+}
+
+void VMCMainCal(MPI_Comm comm) {
+  int sample,sampleStart,sampleEnd,sampleSize;
+
+  int rank,size;
+  MPI_Comm_size(comm,&size);
+  MPI_Comm_rank(comm,&rank);
+#ifdef _DEBUG_VMCCAL
+  printf("  Debug: SplitLoop\n");
+#endif
+  SplitLoop(&sampleStart,&sampleEnd,NVMCSample,rank,size);
+
+  /* samples have already been measured by VMCMakeSample */
+  if(IsInlineMeasure(comm)==0) {
+    /* initialization */
+    StartTimer(24);
+    clearPhysQuantity();
+    StopTimer(24);
+    for(sample=sampleStart;sample<sampleEnd;sample++) {
+      VMCMainCalSample(sample,1,rank);
+    } /* end of for(sample) */
+  }
 
 // calculate OO and HO at NVMCCalMode==0
   if(NVMCCalMode==0){
-    if(NSRCG!=0 || NStoreO!=0){
+    if(NSRCG==0 && NStoreO==0){
+      /* the rest of the panel */
+      StartTimer(45);
+      if(AllComplexFlag==0){
+        flushOO_real(SROptOO_real,SROptSize);
+      }else{
+        flushOO(SROptOO,SROptSize);
+      }
+      StopTimer(45);
+    }else{
+      /* SROptO_Store is indexed by the sample, and this process fills [sampleStart,sampleEnd) */
       sampleSize=sampleEnd-sampleStart;
       if(AllComplexFlag==0){
         StartTimer(45);
-        calculateOO_Store_real(SROptOO_real,SROptHO_real,SROptO_Store_real,creal(w),creal(e),SROptSize,sampleSize);
+        calculateOO_Store_real(SROptOO_real,SROptHO_real,SROptO_Store_real+sampleStart*SROptSize,1.0,0.0,SROptSize,sampleSize);
         StopTimer(45);
       }else{
         StartTimer(45);
-        calculateOO_Store(SROptOO,SROptHO,SROptO_Store,w,e,2*SROptSize,sampleSize);
+        calculateOO_Store(SROptOO,SROptHO,SROptO_Store+sampleStart*(2*SROptSize),1.0,0.0,2*SROptSize,sampleSize);
         StopTimer(45);
       }
     }
@@ -409,6 +472,7 @@ void VMC_BF_MainCal(MPI_Comm comm) {
     Wc += w;
     Etot += w * e;
     Etot2 += w * e * e;
+    if (NAutoCorr != 0) LocalE[sample] = creal(e);
     Dbtot += w * db;
     Dbtot2 += w * db * db;
 
@@ -523,15 +587,24 @@ for(i=0;i<nProj;i++) srOptO[i+1] = (double)(eleProjCnt[i]);
 
   // calculate OO and HO at NVMCCalMode==0
   if(NVMCCalMode==0){
-    if(NStoreO!=0 || NSRCG!=0){
+    if(NSRCG==0 && NStoreO==0){
+      StartTimer(45);
+      if(AllComplexFlag==0){
+        flushOO_real(SROptOO_real,SROptSize);
+      }else{
+        flushOO(SROptOO,SROptSize);
+      }
+      StopTimer(45);
+    }else{
+      /* SROptO_Store is indexed by the sample, and this process fills [sampleStart,sampleEnd) */
       sampleSize=sampleEnd-sampleStart;
       if(AllComplexFlag==0){
         StartTimer(45);
-        calculateOO_Store_real(SROptOO_real,SROptHO_real,SROptO_Store_real,creal(w),creal(e),SROptSize,sampleSize);
+        calculateOO_Store_real(SROptOO_real,SROptHO_real,SROptO_Store_real+sampleStart*SROptSize,creal(w),creal(e),SROptSize,sampleSize);
         StopTimer(45);
       }else{
         StartTimer(45);
-        calculateOO_Store(SROptOO,SROptHO,SROptO_Store,w,e,2*SROptSize,sampleSize);
+        calculateOO_Store(SROptOO,SROptHO,SROptO_Store+sampleStart*(2*SROptSize),w,e,2*SROptSize,sampleSize);
         StopTimer(45);
       }
     }
@@ -553,9 +626,13 @@ void clearPhysQuantity(){
   //Wc = Etot = Etot2 = 0.0;
   Dbtot = Dbtot2 = 0.0;
 //[e] MERGE BY TM
+  if(NAutoCorr!=0) {
+    /* LocalE of the samples measured by this process are set */
+    for(i=0;i<NVMCSample;i++) LocalE[i] = NAN;
+  }
   if(NVMCCalMode==0) {
     /* SROptOO, SROptHO, SROptO */
-    if(NSRCG!=0){
+    if(IsSROptOODiag()){
       n = (2*SROptSize)*4; // TBC
     }else{
       n = (2*SROptSize)*(2*SROptSize+2); // TBC
@@ -564,7 +641,7 @@ void clearPhysQuantity(){
     #pragma omp parallel for default(shared) private(i)
     for(i=0;i<n;i++) vec[i] = 0.0+0.0*I;
 // only for real variables
-    if(NSRCG!=0){
+    if(IsSROptOODiag()){
       n = (SROptSize)*4; // TBC
     }else{
       n = (SROptSize)*(SROptSize+2); // TBC
@@ -572,6 +649,7 @@ void clearPhysQuantity(){
     vec_real = SROptOO_real;
     #pragma omp parallel for default(shared) private(i)
     for(i=0;i<n;i++) vec_real[i] = 0.0;
+    SROptPanelCnt = 0;
   } else if(NVMCCalMode==1) {
     /* CisAjs, CisAjsCktAlt, CisAjsCktAltDC */
     n = NCisAjs+NCisAjsCktAlt+NCisAjsCktAltDC;
@@ -629,20 +707,39 @@ void calculateOptTransDiff(double complex *srOptO, const double complex ipAll) {
   return;
 }
 
+/* the same as calculateOptTransDiff, but PfM_real is used for the real wave function */
+void calculateOptTransDiff_real(double complex *srOptO, const double ipAll) {
+  int i,j;
+  double ip;
+  double *pfM;
+
+  for(i=0;i<NQPOptTrans;++i) {
+    ip = 0.0;
+    pfM = PfM_real + i*NQPFix;
+    for(j=0;j<NQPFix;++j) {
+      ip += creal(QPFixWeight[j]) * pfM[j];
+    }
+    srOptO[i] = ip/ipAll;
+  }
+
+  return;
+}
+
 void calculateOO_Store_real(double *srOptOO_real, double *srOptHO_real, double *srOptO_Store_real,
                  const double w, const double e, int srOptSize, int sampleSize) {
 
   int i,j;
-  char jobz, uplo;
+  char uplo, trans;
   double alpha,beta,o;
   
   alpha = 1.0;
   beta  = 0.0;
   
-  jobz = 'N';
-  uplo = 'T';
-  if(NSRCG==0){
-    M_DGEMM(&jobz,&uplo,&srOptSize,&srOptSize,&sampleSize,&alpha,srOptO_Store_real,&srOptSize,srOptO_Store_real,&srOptSize,&beta,srOptOO_real,&srOptSize);
+  /* only the lower triangle of OO */
+  uplo  = 'L';
+  trans = 'N';
+  if(!IsSROptOODiag()){
+    M_DSYRK(&uplo,&trans,&srOptSize,&sampleSize,&alpha,srOptO_Store_real,&srOptSize,&beta,srOptOO_real,&srOptSize);
   }else{
 #pragma omp parallel for default(shared) private(i)
 #pragma loop noalias
@@ -669,16 +766,18 @@ void calculateOO_Store(double complex *srOptOO, double complex *srOptHO, double
                  const double w, const double complex e, int srOptSize, int sampleSize) {
 
   int i,j;
-  char jobz, uplo;
-  double complex alpha,beta,o;
+  char uplo, trans;
+  double alpha,beta;
+  double complex o;
   
   alpha = 1.0;
   beta  = 0.0;
   
-  jobz = 'N';
-  uplo = 'C';
-  if(NSRCG==0){
-    M_ZGEMM(&jobz,&uplo,&srOptSize,&srOptSize,&sampleSize,&alpha,srOptO_Store,&srOptSize,srOptO_Store,&srOptSize,&beta,srOptOO,&srOptSize);
+  /* only the lower triangle of OO */
+  uplo  = 'L';
+  trans = 'N';
+  if(!IsSROptOODiag()){
+    M_ZHERK(&uplo,&trans,&srOptSize,&sampleSize,&alpha,srOptO_Store,&srOptSize,&beta,srOptOO,&srOptSize);
   }else{
 #pragma omp parallel for default(shared) private(i)
 #pragma loop noalias
@@ -742,46 +841,68 @@ void calculateOO_matvec(double complex *srOptOO, double complex *srOptHO, const
   return;
 }
 
+/* sqrt(w)*O is kept in the panel SROptO_Panel and HO[i] += w*e*O[i]. */
+/* The panel is added to the lower triangle of OO by ZHERK when it is full. */
 void calculateOO(double complex *srOptOO, double complex *srOptHO, const double complex *srOptO,
                  const double w, const double complex e, const int srOptSize){
-  int i,j;
-  double complex tmp;
-  #pragma omp parallel for default(shared) private(j,tmp)
-  //    private(i,j,tmp,srOptOO)
-#pragma loop noalias
-  for(j=0;j<2*srOptSize;j++) {
-    tmp                            = w * srOptO[j];
-    srOptOO[0*(2*srOptSize)+j]    += tmp;      // update O
-    srOptOO[1*(2*srOptSize)+j]    += 0.0;      // update 
-    srOptHO[j]                    += e * tmp;  // update HO
-  }
-  
-  #pragma omp parallel for default(shared) private(i,j,tmp)
+  const int n=2*srOptSize;
+  const double complex we=w*e;
+  const double sqrtw=sqrt(w);
+  double complex *o = SROptO_Panel + SROptPanelCnt*n;
+  int i;
+
+  #pragma omp parallel for default(shared) private(i)
 #pragma loop noalias
-  for(i=2;i<2*srOptSize;i++) {
-    tmp            = w * srOptO[i];
-    for(j=0;j<2*srOptSize;j++) {
-      srOptOO[i*(2*srOptSize)+j] += w*(srOptO[j])*conj(srOptO[i]); // TBC
-      //srOptOO[j+i*(2*srOptSize)] += w*(srOptO[j])*(srOptO[i]); // TBC
-    }
+  for(i=0;i<n;i++) {
+    o[i]        = sqrtw * srOptO[i];
+    srOptHO[i] += we * srOptO[i];  // update HO
   }
 
+  SROptPanelCnt++;
+  if(SROptPanelCnt==NSROptPanel) flushOO(srOptOO,srOptSize);
+  return;
+}
+
+/* OO[i][j] += sum_k P[i][k] conj(P[j][k]) for i>=j, where P is the panel */
+void flushOO(double complex *srOptOO, const int srOptSize){
+  const int n=2*srOptSize;
+  const double alpha=1.0, beta=1.0;
+  char uplo='L', trans='N';
+  int k=SROptPanelCnt;
+
+  if(k==0) return;
+  M_ZHERK(&uplo, &trans, &n, &k, &alpha, SROptO_Panel, &n, &beta, srOptOO, &n);
+  SROptPanelCnt = 0;
   return;
 }
 
 void calculateOO_real(double *srOptOO, double *srOptHO, const double *srOptO,
                  const double w, const double e, const int srOptSize) {
-  double we=w*e;
-  int m,n,incx,incy,lda;
-  m=n=lda=srOptSize;
-  incx=incy=1;
+  const double we=w*e;
+  const double sqrtw=sqrt(w);
+  double *o = SROptO_Panel_real + SROptPanelCnt*srOptSize;
+  int i;
 
-  /* OO[i][j] += w*O[i]*O[j] */
-  M_DGER(&m, &n, &w, srOptO, &incx, srOptO, &incy, srOptOO, &lda);
+  #pragma omp parallel for default(shared) private(i)
+#pragma loop noalias
+  for(i=0;i<srOptSize;i++) {
+    o[i]        = sqrtw * srOptO[i];
+    srOptHO[i] += we * srOptO[i];  // update HO
+  }
+
+  SROptPanelCnt++;
+  if(SROptPanelCnt==NSROptPanel) flushOO_real(srOptOO,srOptSize);
+  return;
+}
 
-  /* HO[i] += w*e*O[i] */
-  M_DAXPY(&n, &we, srOptO, &incx, srOptHO, &incy);
+void flushOO_real(double *srOptOO, const int srOptSize){
+  const double alpha=1.0, beta=1.0;
+  char uplo='L', trans='N';
+  int n=srOptSize, k=SROptPanelCnt;
 
+  if(k==0) return;
+  M_DSYRK(&uplo, &trans, &n, &k, &alpha, SROptO_Panel_real, &n, &beta, srOptOO, &n);
+  SROptPanelCnt = 0;
   return;
 }
 
@@ -146,6 +146,7 @@ void VMCMainCal_fsz(MPI_Comm comm) {
     Sztot += w * Sz;
     Sztot2 += w * Sz*Sz;
     Etot2 += w * conj(e) * e;
+    if(NAutoCorr!=0) LocalE[sample] = creal(e);
 #ifdef _DEBUG_DETAIL
     printf("  Debug: sample=%d: calculateOpt \n",sample);
 #endif
@@ -165,7 +166,11 @@ void VMCMainCal_fsz(MPI_Comm comm) {
       StopTimer(42);
       
       if(FlagOptTrans>0) { // this part will be not used
-        calculateOptTransDiff(SROptO+2*NProj+2*NSlater+2, ip); //TBC
+        if(AllComplexFlag==0){
+          calculateOptTransDiff_real(SROptO+2*NProj+2*NSlater+2, creal(ip)); // using PfM_real
+        }else{
+          calculateOptTransDiff(SROptO+2*NProj+2*NSlater+2, ip); //TBC
+        }
       }
       //[s] this part will be used for real varaibles
       if(AllComplexFlag==0){
@@ -225,18 +230,27 @@ void VMCMainCal_fsz(MPI_Comm comm) {
 
 // calculate OO and HO at NVMCCalMode==0
   if(NVMCCalMode==0){
-    if(NStoreO!=0 || NSRCG!=0){
+    if(NSRCG==0 && NStoreO==0){
+      StartTimer(45);
+      if(AllComplexFlag==0){
+        flushOO_real(SROptOO_real,SROptSize);
+      }else{
+        flushOO(SROptOO,SROptSize);
+      }
+      StopTimer(45);
+    }else{
+      /* SROptO_Store is indexed by the sample, and this process fills [sampleStart,sampleEnd) */
       sampleSize=sampleEnd-sampleStart;
       /*StartTimer(45);
       calculateOO_Store(SROptOO,SROptHO,SROptO_Store,w,e,2*SROptSize,sampleSize);
       StopTimer(45);*/
       if(AllComplexFlag==0){
         StartTimer(45);
-        calculateOO_Store_real(SROptOO_real,SROptHO_real,SROptO_Store_real,creal(w),creal(e),SROptSize,sampleSize);
+        calculateOO_Store_real(SROptOO_real,SROptHO_real,SROptO_Store_real+sampleStart*SROptSize,creal(w),creal(e),SROptSize,sampleSize);
         StopTimer(45);
       }else{
         StartTimer(45);
-        calculateOO_Store(SROptOO,SROptHO,SROptO_Store,w,e,2*SROptSize,sampleSize);
+        calculateOO_Store(SROptOO,SROptHO,SROptO_Store+sampleStart*(2*SROptSize),w,e,2*SROptSize,sampleSize);
         StopTimer(45);
       }
     }
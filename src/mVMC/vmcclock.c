@@ -47,147 +47,265 @@ void OutputTime(int step) {
   }
 }
 
+/* the regions of zvo_CalcTimer.dat: {index of Timer, depth, name} */
+typedef struct {
+  int idx;
+  int depth;
+  const char *name;
+} TimerRegion;
+
+TimerRegion TimerRegionParaOpt[] = {
+  {  0, 0, "All"},
+  {  1, 0, "Initialization"},
+  { 10, 1, "read options"},
+  { 11, 1, "ReadDefFile"},
+  { 12, 1, "SetMemory"},
+  { 13, 1, "InitParameter"},
+  {  2, 0, "VMCParaOpt"},
+  {  3, 1, "VMCMakeSample"},
+  { 30, 2, "makeInitialSample"},
+  { 31, 2, "make candidate"},
+  { 32, 2, "hopping update"},
+  { 60, 3, "UpdateProjCnt"},
+  { 61, 3, "CalculateNewPfM2"},
+  { 62, 3, "CalculateLogIP"},
+  { 63, 3, "UpdateMAll"},
+  { 33, 2, "exchange update"},
+  { 65, 3, "UpdateProjCnt"},
+  { 66, 3, "CalculateNewPfMTwo2"},
+  { 67, 3, "CalculateLogIP"},
+  { 68, 3, "UpdateMAllTwo"},
+  { 36, 2, "lspinflip update"},
+  {600, 3, "UpdateProjCnt"},
+  {601, 3, "CalculateNewPfMTwo2"},
+  {602, 3, "CalculateLogIP"},
+  {603, 3, "UpdateMAllTwo"},
+  { 34, 2, "recal PfM and InvM"},
+  { 35, 2, "save electron config"},
+  {  4, 1, "VMCMainCal"},
+  { 40, 2, "CalculateMAll"},
+  { 41, 2, "LocEnergyCal"},
+  { 73, 3, "GreenFunc1Batch"},
+  { 70, 3, "CalHamiltonian0"},
+  { 71, 3, "CalHamiltonian1"},
+  { 72, 3, "CalHamiltonian2"},
+  { 42, 2, "ReturnSlaterElmDiff"},
+  { 43, 2, "calculate OO and HO"},
+  { 45, 2, "multiply store OO"},
+  {  5, 1, "StochasticOpt"},
+  { 50, 2, "preprocess"},
+  { 51, 2, "stcOptMain"},
+  { 55, 3, "initBLACS"},
+  { 56, 3, "calculate S and g"},
+  { 57, 3, "DPOSV"},
+  { 58, 3, "gatherParaChange"},
+  { 52, 2, "postprocess"},
+  { 20, 1, "UpdateSlaterElm"},
+  { 21, 1, "WeightAverage"},
+  { 22, 1, "outputData"},
+  { 23, 1, "SyncModifiedParameter"},
+  { 24, 1, "cal"},
+  { 25, 1, "SR"},
+  { 27, 2, "MPI_Allreduce"},
+  { 26, 1, "WriteCheckpoint"},
+  { 69, 1, "MAll"},
+  { -1, 0, NULL}
+};
+
+TimerRegion TimerRegionPhysCal[] = {
+  {  0, 0, "All"},
+  {  1, 0, "Initialization"},
+  { 10, 1, "read options"},
+  { 11, 1, "ReadDefFile"},
+  { 12, 1, "SetMemory"},
+  { 13, 1, "InitParameter"},
+  {  2, 0, "VMCPhysCal"},
+  {  3, 1, "VMCMakeSample"},
+  { 30, 2, "makeInitialSample"},
+  { 31, 2, "make candidate"},
+  { 32, 2, "hopping update"},
+  { 60, 3, "UpdateProjCnt"},
+  { 61, 3, "CalculateNewPfM2"},
+  { 62, 3, "CalculateLogIP"},
+  { 63, 3, "UpdateMAll"},
+  { 33, 2, "exchange update"},
+  { 65, 3, "UpdateProjCnt"},
+  { 66, 3, "CalculateNewPfMTwo2"},
+  { 67, 3, "CalculateLogIP"},
+  { 68, 3, "UpdateMAllTwo"},
+  { 36, 2, "lspinflip update"},
+  {600, 3, "UpdateProjCnt"},
+  {601, 3, "CalculateNewPfMTwo2"},
+  {602, 3, "CalculateLogIP"},
+  {603, 3, "UpdateMAllTwo"},
+  { 34, 2, "recal PfM and InvM"},
+  { 35, 2, "save electron config"},
+  {  4, 1, "VMCMainCal"},
+  { 40, 2, "CalculateMAll"},
+  { 41, 2, "LocEnergyCal"},
+  { 73, 3, "GreenFunc1Batch"},
+  { 70, 3, "CalHamiltonian0"},
+  { 71, 3, "CalHamiltonian1"},
+  { 72, 3, "CalHamiltonian2"},
+  { 42, 2, "CalculateGreenFunc"},
+  { 50, 3, "GreenFunc1"},
+  { 51, 3, "GreenFunc2"},
+  { 52, 3, "addPhysCA"},
+  { 53, 3, "addPhysCACA"},
+  { 43, 2, "Lanczos1"},
+  { 44, 2, "Lanczos2"},
+  { 20, 1, "UpdateSlaterElm"},
+  { 21, 1, "WeightAverage"},
+  { 22, 1, "outputData"},
+  { -1, 0, NULL}
+};
+
+/* statistics over the processes used when NProfile!=0 */
+/* TimerStat[k*n+i] (k=0: min, 1: max, 2: mean, n=NTimer*(1+NThreadStat)) */
+/* i<NTimer: Timer[i], i=NTimer*(1+t)+j: j-th timer of thread t */
+double *TimerStat=NULL;
+int NThreadStat=0;
+
+double getTime() {
+#ifdef _mpi_use
+  return MPI_Wtime();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME,&ts);
+  return ts.tv_sec + ts.tv_nsec*1.0e-9;
+#endif
+}
+
 void InitTimer() {
   int i;
   for(i=0;i<NTimer;i++) Timer[i]=0.0;
   for(i=0;i<NTimer;i++) TimerStart[i]=0.0;
+
+  TimerThread = (double*)malloc(sizeof(double)*2*NThread*NTimer);
+  TimerThreadStart = TimerThread + NThread*NTimer;
+  for(i=0;i<2*NThread*NTimer;i++) TimerThread[i]=0.0;
+  return;
+}
+
+void FreeTimer() {
+  free(TimerThread);
+  free(TimerStat);
   return;
 }
 
 void StartTimer(int n) {
-#ifdef _mpi_use
-  TimerStart[n]=MPI_Wtime();
-#else
-  struct timespec ts;
-  clock_gettime(CLOCK_REALTIME,&ts);
-  TimerStart[n]=ts.tv_sec + ts.tv_nsec*1.0e-9;
-#endif
+  TimerStart[n]=getTime();
   return;
 }
 
 void StopTimer(int n) {
+  Timer[n] += getTime() - TimerStart[n];
+  return;
+}
+
+/* StartTimerThread() and StopTimerThread() are called by every thread */
+/* in a parallel region. The master thread also updates Timer[n]. */
+void StartTimerThread(int n) {
+  const int thread = omp_get_thread_num();
+  if(thread==0) StartTimer(n);
+  if(NProfile==0) return;
+  TimerThreadStart[thread*NTimer+n] = getTime();
+  return;
+}
+
+void StopTimerThread(int n) {
+  const int thread = omp_get_thread_num();
+  if(thread==0) StopTimer(n);
+  if(NProfile==0) return;
+  TimerThread[thread*NTimer+n] += getTime() - TimerThreadStart[thread*NTimer+n];
+  return;
+}
+
+/* calculate min, max and mean of the timers over the processes */
+/* All processes must call this function. Rank 0 has the result. */
+void ReduceTimer(MPI_Comm comm) {
+  double *buf;
+  int i,n,size;
+
+  if(NProfile==0) return;
+  MPI_Comm_size(comm,&size);
 #ifdef _mpi_use
-  Timer[n] += MPI_Wtime() - TimerStart[n];
+  /* the number of threads may be different among processes */
+  MPI_Allreduce(&NThread,&NThreadStat,1,MPI_INT,MPI_MAX,comm);
 #else
-  struct timespec ts;
-  clock_gettime(CLOCK_REALTIME,&ts);
-  Timer[n] += ts.tv_sec + ts.tv_nsec*1.0e-9 - TimerStart[n];
+  NThreadStat = NThread;
+#endif
+  n = NTimer*(1+NThreadStat);
+
+  TimerStat = (double*)malloc(sizeof(double)*4*n);
+  buf = TimerStat + 3*n;
+  for(i=0;i<NTimer;i++) buf[i] = Timer[i];
+  for(i=0;i<NThread*NTimer;i++) buf[NTimer+i] = TimerThread[i];
+  for(i=(1+NThread)*NTimer;i<n;i++) buf[i] = 0.0;
+
+#ifdef _mpi_use
+  MPI_Reduce(buf,TimerStat,    n,MPI_DOUBLE,MPI_MIN,0,comm);
+  MPI_Reduce(buf,TimerStat+n,  n,MPI_DOUBLE,MPI_MAX,0,comm);
+  MPI_Reduce(buf,TimerStat+2*n,n,MPI_DOUBLE,MPI_SUM,0,comm);
+#else
+  for(i=0;i<n;i++) TimerStat[i] = TimerStat[n+i] = TimerStat[2*n+i] = buf[i];
 #endif
+  for(i=0;i<n;i++) TimerStat[2*n+i] /= (double)size;
   return;
 }
 
-void OutputTimerParaOpt() {
+void outputTimerRegion(const TimerRegion *region) {
   char fileName[D_FileNameMax];
+  char label[64], idx[16];
   FILE *fp;
+  int i,t,j,n;
+  const double *stat;
+
   sprintf(fileName, "%s_CalcTimer.dat", CDataFileHead); 
   fp = fopen(fileName, "w");
+  for(i=0;region[i].idx>=0;i++) {
+    sprintf(idx, "[%d]", region[i].idx);
+    sprintf(label, "%*s%s", 2*region[i].depth, "", region[i].name);
+    fprintf(fp,"%-*s%s %12.5lf\n", 31-(int)strlen(idx), label, idx, Timer[region[i].idx]);
+  }
+  fclose(fp);
 
-  fprintf(fp,"All                         [0] %12.5lf\n",Timer[0]);
-  fprintf(fp,"Initialization              [1] %12.5lf\n",Timer[1]);
-  fprintf(fp,"  read options             [10] %12.5lf\n",Timer[10]);
-  fprintf(fp,"  ReadDefFile              [11] %12.5lf\n",Timer[11]);
-  fprintf(fp,"  SetMemory                [12] %12.5lf\n",Timer[12]);
-  fprintf(fp,"  InitParameter            [13] %12.5lf\n",Timer[13]);
-  fprintf(fp,"VMCParaOpt                  [2] %12.5lf\n",Timer[2]);
-  fprintf(fp,"  VMCMakeSample             [3] %12.5lf\n",Timer[3]);
-  fprintf(fp,"    makeInitialSample      [30] %12.5lf\n",Timer[30]);
-  fprintf(fp,"    make candidate         [31] %12.5lf\n",Timer[31]);
-  fprintf(fp,"    hopping update         [32] %12.5lf\n",Timer[32]);
-  fprintf(fp,"      UpdateProjCnt        [60] %12.5lf\n",Timer[60]);
-  fprintf(fp,"      CalculateNewPfM2     [61] %12.5lf\n",Timer[61]);
-  fprintf(fp,"      CalculateLogIP       [62] %12.5lf\n",Timer[62]);
-  fprintf(fp,"      UpdateMAll           [63] %12.5lf\n",Timer[63]);
-  fprintf(fp,"    exchange update        [33] %12.5lf\n",Timer[33]);
-  fprintf(fp,"      UpdateProjCnt        [65] %12.5lf\n",Timer[65]);
-  fprintf(fp,"      CalculateNewPfMTwo2  [66] %12.5lf\n",Timer[66]);
-  fprintf(fp,"      CalculateLogIP       [67] %12.5lf\n",Timer[67]);
-  fprintf(fp,"      UpdateMAllTwo        [68] %12.5lf\n",Timer[68]);
-  fprintf(fp,"    lspinflip update       [36] %12.5lf\n",Timer[36]);
-  fprintf(fp,"      UpdateProjCnt       [600] %12.5lf\n",Timer[600]);
-  fprintf(fp,"      CalculateNewPfMTwo2 [601] %12.5lf\n",Timer[601]);
-  fprintf(fp,"      CalculateLogIP      [602] %12.5lf\n",Timer[602]);
-  fprintf(fp,"      UpdateMAllTwo       [603] %12.5lf\n",Timer[603]);
-  fprintf(fp,"    recal PfM and InvM     [34] %12.5lf\n",Timer[34]);
-  fprintf(fp,"    save electron config   [35] %12.5lf\n",Timer[35]);
-  fprintf(fp,"  VMCMainCal                [4] %12.5lf\n",Timer[4]);
-  fprintf(fp,"    CalculateMAll          [40] %12.5lf\n",Timer[40]);
-  fprintf(fp,"    LocEnergyCal           [41] %12.5lf\n",Timer[41]);
-  fprintf(fp,"      CalHamiltonian0      [70] %12.5lf\n",Timer[70]);
-  fprintf(fp,"      CalHamiltonian1      [71] %12.5lf\n",Timer[71]);
-  fprintf(fp,"      CalHamiltonian2      [72] %12.5lf\n",Timer[72]);
-  fprintf(fp,"    ReturnSlaterElmDiff    [42] %12.5lf\n",Timer[42]);
-  fprintf(fp,"    calculate OO and HO    [43] %12.5lf\n",Timer[43]);
-  fprintf(fp,"    multiply store OO      [45] %12.5lf\n",Timer[45]);
-  fprintf(fp,"  StochasticOpt             [5] %12.5lf\n",Timer[5]);
-  fprintf(fp,"    preprocess             [50] %12.5lf\n",Timer[50]);
-  fprintf(fp,"    stcOptMain             [51] %12.5lf\n",Timer[51]);
-  fprintf(fp,"      initBLACS            [55] %12.5lf\n",Timer[55]);
-  fprintf(fp,"      calculate S and g    [56] %12.5lf\n",Timer[56]);
-  fprintf(fp,"      DPOSV                [57] %12.5lf\n",Timer[57]);
-  fprintf(fp,"      gatherParaChange     [58] %12.5lf\n",Timer[58]);
-  fprintf(fp,"    postprocess            [52] %12.5lf\n",Timer[52]);
-  fprintf(fp,"  UpdateSlaterElm          [20] %12.5lf\n",Timer[20]);
-  fprintf(fp,"  WeightAverage            [21] %12.5lf\n",Timer[21]);
-  fprintf(fp,"  outputData               [22] %12.5lf\n",Timer[22]);
-  fprintf(fp,"  SyncModifiedParameter    [23] %12.5lf\n",Timer[23]);
-  fprintf(fp,"  cal                      [24] %12.5lf\n",Timer[24]);
-  fprintf(fp,"  SR                       [25] %12.5lf\n",Timer[25]);
-  fprintf(fp,"  MAll                     [69] %12.5lf\n",Timer[69]);
+  if(NProfile==0 || TimerStat==NULL) return;
 
+  /* machine-readable statistics over the processes and the threads */
+  n = NTimer*(1+NThreadStat);
+  sprintf(fileName, "%s_CalcTimerStat.dat", CDataFileHead);
+  fp = fopen(fileName, "w");
+  fprintf(fp,"# idx parent depth %12s %12s %12s name\n","min","max","mean");
+  for(i=0;region[i].idx>=0;i++) {
+    /* the parent is the last region with a smaller depth */
+    for(j=i-1;j>=0 && region[j].depth>=region[i].depth;j--);
+    stat = TimerStat + region[i].idx;
+    fprintf(fp,"%5d %6d %5d %12.5lf %12.5lf %12.5lf %s\n", region[i].idx,
+            (j>=0) ? region[j].idx : -1, region[i].depth,
+            stat[0], stat[n], stat[2*n], region[i].name);
+  }
+  fprintf(fp,"\n# idx thread %12s %12s %12s name\n","min","max","mean");
+  for(i=0;region[i].idx>=0;i++) {
+    for(t=0;t<NThreadStat;t++) {
+      stat = TimerStat + NTimer*(1+t) + region[i].idx;
+      if(stat[n]==0.0) continue;
+      fprintf(fp,"%5d %6d %12.5lf %12.5lf %12.5lf %s\n", region[i].idx, t,
+              stat[0], stat[n], stat[2*n], region[i].name);
+    }
+  }
   fclose(fp);
+  return;
 }
 
-void OutputTimerPhysCal() {
-  char fileName[D_FileNameMax];
-  FILE *fp;
-  sprintf(fileName, "%s_CalcTimer.dat", CDataFileHead); 
-  fp = fopen(fileName, "w");
-
-  fprintf(fp,"All                         [0] %12.5lf\n",Timer[0]);
-  fprintf(fp,"Initialization              [1] %12.5lf\n",Timer[1]);
-  fprintf(fp,"  read options             [10] %12.5lf\n",Timer[10]);
-  fprintf(fp,"  ReadDefFile              [11] %12.5lf\n",Timer[11]);
-  fprintf(fp,"  SetMemory                [12] %12.5lf\n",Timer[12]);
-  fprintf(fp,"  InitParameter            [13] %12.5lf\n",Timer[13]);
-  fprintf(fp,"VMCPhysCal                  [2] %12.5lf\n",Timer[2]);
-  fprintf(fp,"  VMCMakeSample             [3] %12.5lf\n",Timer[3]);
-  fprintf(fp,"    makeInitialSample      [30] %12.5lf\n",Timer[30]);
-  fprintf(fp,"    make candidate         [31] %12.5lf\n",Timer[31]);
-  fprintf(fp,"    hopping update         [32] %12.5lf\n",Timer[32]);
-  fprintf(fp,"      UpdateProjCnt        [60] %12.5lf\n",Timer[60]);
-  fprintf(fp,"      CalculateNewPfM2     [61] %12.5lf\n",Timer[61]);
-  fprintf(fp,"      CalculateLogIP       [62] %12.5lf\n",Timer[62]);
-  fprintf(fp,"      UpdateMAll           [63] %12.5lf\n",Timer[63]);
-  fprintf(fp,"    exchange update        [33] %12.5lf\n",Timer[33]);
-  fprintf(fp,"      UpdateProjCnt        [65] %12.5lf\n",Timer[65]);
-  fprintf(fp,"      CalculateNewPfMTwo2  [66] %12.5lf\n",Timer[66]);
-  fprintf(fp,"      CalculateLogIP       [67] %12.5lf\n",Timer[67]);
-  fprintf(fp,"      UpdateMAllTwo        [68] %12.5lf\n",Timer[68]);
-  fprintf(fp,"    lspinflip update       [36] %12.5lf\n",Timer[36]);
-  fprintf(fp,"      UpdateProjCnt       [600] %12.5lf\n",Timer[600]);
-  fprintf(fp,"      CalculateNewPfMTwo2 [601] %12.5lf\n",Timer[601]);
-  fprintf(fp,"      CalculateLogIP      [602] %12.5lf\n",Timer[602]);
-  fprintf(fp,"      UpdateMAllTwo       [603] %12.5lf\n",Timer[603]);
-  fprintf(fp,"    recal PfM and InvM     [34] %12.5lf\n",Timer[34]);
-  fprintf(fp,"    save electron config   [35] %12.5lf\n",Timer[35]);
-  fprintf(fp,"  VMCMainCal                [4] %12.5lf\n",Timer[4]);
-  fprintf(fp,"    CalculateMAll          [40] %12.5lf\n",Timer[40]);
-  fprintf(fp,"    LocEnergyCal           [41] %12.5lf\n",Timer[41]);
-  fprintf(fp,"      CalHamiltonian0      [70] %12.5lf\n",Timer[70]);
-  fprintf(fp,"      CalHamiltonian1      [71] %12.5lf\n",Timer[71]);
-  fprintf(fp,"      CalHamiltonian2      [72] %12.5lf\n",Timer[72]);
-  fprintf(fp,"    CalculateGreenFunc     [42] %12.5lf\n",Timer[42]);
-  fprintf(fp,"      GreenFunc1           [50] %12.5lf\n",Timer[50]);
-  fprintf(fp,"      GreenFunc2           [51] %12.5lf\n",Timer[51]);
-  fprintf(fp,"      addPhysCA            [52] %12.5lf\n",Timer[52]);
-  fprintf(fp,"      addPhysCACA          [53] %12.5lf\n",Timer[53]);
-  fprintf(fp,"    Lanczos1               [43] %12.5lf\n",Timer[43]);
-  fprintf(fp,"    Lanczos2               [44] %12.5lf\n",Timer[44]);
-  fprintf(fp,"  UpdateSlaterElm          [20] %12.5lf\n",Timer[20]);
-  fprintf(fp,"  WeightAverage            [21] %12.5lf\n",Timer[21]);
-  fprintf(fp,"  outputData               [22] %12.5lf\n",Timer[22]);
+void OutputTimerParaOpt() {
+  outputTimerRegion(TimerRegionParaOpt);
+  return;
+}
 
-  fclose(fp);
+void OutputTimerPhysCal() {
+  outputTimerRegion(TimerRegionPhysCal);
+  return;
 }
 
 #endif
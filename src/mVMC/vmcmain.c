@@ -80,12 +80,16 @@ int main(int argc, char* argv[])
   StartTimer(10);
 
   /* read options */
-  while((option=getopt(argc,argv,"bhm:oF:esv"))!=-1) {
+  while((option=getopt(argc,argv,"bchm:oF:esvr"))!=-1) {
     switch(option) {
     case 'b': /* BinaryMode */
       FlagBinary=1;
       break;
 
+    case 'c': /* DefConvert mode */
+      FlagDefConvert=1;
+      break;
+
     case 'h': /* Print Help Message*/
       printUsageError();
       printOption();
@@ -152,6 +156,10 @@ int main(int argc, char* argv[])
       flagMultiDef = 0;
       break;
 
+    case 'r': /* Restart mode */
+      FlagRestart=1;
+      break;
+
     case 's': /* Standard mode */
       flagMultiDef = 0;
       flagStandard = 1;
@@ -226,6 +234,13 @@ int main(int argc, char* argv[])
   ReadDefFileIdxPara(fileDefList, comm0);
   if(rank0==0) fprintf(stdout,"End  : Read parameters from *def files.\n");
   StopTimer(11);
+
+  if(FlagDefConvert) {
+    info = WriteDefBinary(comm0);
+    FreeMemoryDef();
+    MPI_Finalize();
+    return info;
+  }
   
   StartTimer(12);
   if(rank0==0) fprintf(stdout,"Start: Set memories.\n");
@@ -280,6 +295,10 @@ int main(int argc, char* argv[])
   if(rank0==0) fprintf(stdout,"Start: Initialize variables for quantum projection.\n");
   InitQPWeight();
   if(rank0==0) fprintf(stdout,"End  : Initialize variables for quantum projection.\n");
+  /* each process in comm1 runs its own Markov chain */
+  if(IsSplitChain(comm1)) initSplitChainRand(rank1);
+  /* the random number streams of the chains run by the threads */
+  if(NMultiChain>0) InitChainRand();
   /* initialize output files */
   if(rank0==0) InitFile(fileDefList, rank0);
 
@@ -305,6 +324,7 @@ int main(int argc, char* argv[])
   }
 
   StopTimer(0);
+  ReduceTimer(comm0);
   if(rank0==0) {
     if(NVMCCalMode==0) {
       OutputTimerParaOpt();
@@ -317,8 +337,15 @@ int main(int argc, char* argv[])
   if(rank0==0) CloseFile(rank0);
 
   if(rank0==0) fprintf(stdout,"Start: Free Memory.\n");
+#ifndef _lapack
+  StcOptGridFree();
+#endif
+#ifdef _pf_block_update
+  FreePfUpdator();
+#endif
   FreeMemory();
   FreeMemoryDef();
+  FreeTimer();
   if(rank0==0) fprintf(stdout,"End: Free Memory.\n");
 
   MPI_Finalize();
@@ -329,14 +356,18 @@ int main(int argc, char* argv[])
 
 /*-- VMC Parameter Optimization --*/
 int VMCParaOpt(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2) {
-  int step;
+  int step,stepStart=0;
   int info;
   int rank;
-  int tmp_i;//DEBUG
   int iprogress;
   MPI_Comm_rank(comm_parent, &rank);
 
-  for(step=0;step<NSROptItrStep;step++) {
+  if(FlagRestart) {
+    stepStart = ReadCheckpoint(comm_parent);
+    if(rank==0) fprintf(stdout, "Restart: resume the optimization from step %d.\n", stepStart);
+  }
+
+  for(step=stepStart;step<NSROptItrStep;step++) {
     //printf("0 DUBUG make:step=%d TwoSz=%d\n",step,TwoSz);
     if(rank==0){
       OutputTime(step);
@@ -353,7 +384,8 @@ int VMCParaOpt(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
     StartTimer(20);
     //printf("1 DUBUG make:step=%d \n",step);
     if(iFlgOrbitalGeneral==0){//sz is conserved
-      UpdateSlaterElm_fcmp();
+      /* SlaterElm_real is stored by UpdateSlaterElm_real below */
+      if(IsComplexSlaterElm()) UpdateSlaterElm_fcmp();
     }else{
       UpdateSlaterElm_fsz();
     } 
@@ -368,10 +400,11 @@ int VMCParaOpt(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
     if(AllComplexFlag==0){ // real
       // only for real TBC
       StartTimer(69);
-#pragma omp parallel for default(shared) private(tmp_i)
-      for(tmp_i=0;tmp_i<NQPFull*(2*Nsite)*(2*Nsite);tmp_i++) SlaterElm_real[tmp_i]= creal(SlaterElm[tmp_i]);
-#pragma omp parallel for default(shared) private(tmp_i)
-      for(tmp_i=0;tmp_i<NQPFull*(Nsize*Nsize+1);tmp_i++)     InvM_real[tmp_i]= creal(InvM[tmp_i]);
+      if(iFlgOrbitalGeneral==0){
+        UpdateSlaterElm_real();
+      }else{
+        UpdateSlaterElm_fsz_real();
+      }
       StopTimer(69);
       if(iFlgOrbitalGeneral==0){ // Orbital
         if(NProjBF ==0){
@@ -383,12 +416,6 @@ int VMCParaOpt(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
       }else{//OrbitalPara, OrbitalGeneral
         VMCMakeSample_fsz_real(comm_child1);
       }
-      // only for real TBC
-      StartTimer(69);
-#pragma omp parallel for default(shared) private(tmp_i)
-      for(tmp_i=0;tmp_i<NQPFull*(Nsize*Nsize+1);tmp_i++)     InvM[tmp_i]      = InvM_real[tmp_i]+0.0*I;
-      StopTimer(69);
-      // only for real TBC
     }else{// complex
       if(NProjBF ==0) {
         if(iFlgOrbitalGeneral==0){// sz =0 & complex
@@ -432,7 +459,10 @@ int VMCParaOpt(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
       WeightAverageSROpt(comm_parent);
     }
     StopTimer(25);
-    ReduceCounter(comm_child2);
+    /* every process of comm_child1 has its own counters with NSplitChain!=0 */
+    ReduceCounter(IsSplitChain(comm_child1) ? comm_parent : comm_child2);
+    /* NVMCInterval of the next step may be changed */
+    if(NAutoCorr!=0) UpdateAutoCorr(step,comm_parent);
     StopTimer(21);
     StartTimer(22);
     /* output zvo_out and zvo_var */
@@ -458,7 +488,7 @@ int VMCParaOpt(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
     if(rank==0){
       if(AllComplexFlag==0){ //real
       //if(AllComplexFlag==0 && iFlgOrbitalGeneral==0){ //real & sz=0
-        for(i=0;i<(NSRCG==0 ? SROptSize*SROptSize: SROptSize*2);i++){
+        for(i=0;i<(!IsSROptOODiag() ? SROptSize*SROptSize: SROptSize*2);i++){
           fprintf(stderr, "DEBUG: SROptOO_real[%d]=%lf +I*%lf\n",i,creal(SROptOO_real[i]),cimag(SROptOO_real[i]));
         } 
         for(i=0;i<SROptSize;i++){
@@ -468,7 +498,7 @@ int VMCParaOpt(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
           fprintf(stderr, "DEBUG: SROptO_real[%d]=%lf +I*%lf\n",i,creal(SROptO_real[i]),cimag(SROptO_real[i]));
         } 
       }else{
-        for(i=0;i<(NSRCG==0 ? 2*SROptSize*(2*SROptSize): 2*SROptSize*2);i++){
+        for(i=0;i<(!IsSROptOODiag() ? 2*SROptSize*(2*SROptSize): 2*SROptSize*2);i++){
           fprintf(stderr, "DEBUG: SROptOO[%d]=%lf +I*%lf\n",i,creal(SROptOO[i]),cimag(SROptOO[i]));
         } 
         for(i=0;i<2*SROptSize;i++){
@@ -513,6 +543,13 @@ int VMCParaOpt(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
     }
 
     FlushFile(step,rank);
+
+    if(NCheckpoint>0 && (step+1)%NCheckpoint==0 && step+1<NSROptItrStep) {
+      StartTimer(26);
+      FlushFile(0,rank);
+      WriteCheckpoint(step,comm_parent);
+      StopTimer(26);
+    }
   }
 
   if(rank==0) OutputTime(NSROptItrStep);
@@ -529,20 +566,24 @@ int VMCParaOpt(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
 
 /*-- VMC Physical Quantity Calculation --*/
 int VMCPhysCal(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2) {
-  int ismp, tmp_i;
+  int ismp;
   int rank;
+  double errE,errE2=0.0; /* the errors of Etot of the bins */
   MPI_Comm_rank(comm_parent, &rank);
 
   if(rank==0) fprintf(stdout, "Start: UpdateSlaterElm.\n");
   StartTimer(20);
   if(iFlgOrbitalGeneral==0){//sz is conserved
-    UpdateSlaterElm_fcmp();
+    /* SlaterElm_real is stored by UpdateSlaterElm_real below */
+    if(IsComplexSlaterElm()) UpdateSlaterElm_fcmp();
   }else{
     UpdateSlaterElm_fsz();
   } 
   StopTimer(20);
   if(rank==0) fprintf(stdout, "End  : UpdateSlaterElm.\n");
 
+  AsyncOutInit(rank);
+
   if(rank==0) fprintf(stdout, "Start: Sampling.\n");
   for(ismp=0;ismp<NDataQtySmp;ismp++) {
     if(rank==0) OutputTime(ismp);
@@ -554,10 +595,11 @@ int VMCPhysCal(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
       if(AllComplexFlag==0){//real
         // only for real TBC
         StartTimer(69);
-#pragma omp parallel for default(shared) private(tmp_i)
-        for(tmp_i=0;tmp_i<NQPFull*(2*Nsite)*(2*Nsite);tmp_i++) SlaterElm_real[tmp_i]= creal(SlaterElm[tmp_i]);
-#pragma omp parallel for default(shared) private(tmp_i)
-        for(tmp_i=0;tmp_i<NQPFull*(Nsize*Nsize+1);tmp_i++)     InvM_real[tmp_i]= creal(InvM[tmp_i]);
+        if(iFlgOrbitalGeneral==0){
+          UpdateSlaterElm_real();
+        }else{
+          UpdateSlaterElm_fsz_real();
+        }
         StopTimer(69);
         // SlaterElm_real will be used in CalculateMAll, note that SlaterElm will not change before SR
         if(iFlgOrbitalGeneral==0){
@@ -565,12 +607,6 @@ int VMCPhysCal(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
         }else{
           VMCMakeSample_fsz_real(comm_child1);
         }
-        // only for real TBC
-        StartTimer(69);
-#pragma omp parallel for default(shared) private(tmp_i)
-        for(tmp_i=0;tmp_i<NQPFull*(Nsize*Nsize+1);tmp_i++)     InvM[tmp_i]      = InvM_real[tmp_i]+0.0*I;
-        StopTimer(69);
-        // only for real TBC
       }else{
         if(iFlgOrbitalGeneral==0){
           VMCMakeSample(comm_child1);
@@ -582,18 +618,10 @@ int VMCPhysCal(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
       if(AllComplexFlag==0){
         // only for real TBC
         StartTimer(69);
-        for(tmp_i=0;tmp_i<NQPFull*(2*Nsite)*(2*Nsite);tmp_i++) SlaterElm_real[tmp_i]= creal(SlaterElm[tmp_i]);
-#pragma omp parallel for default(shared) private(tmp_i)
-        for(tmp_i=0;tmp_i<NQPFull*(Nsize*Nsize+1);tmp_i++)     InvM_real[tmp_i]= creal(InvM[tmp_i]);
+        UpdateSlaterElm_real();
         StopTimer(69);
         // SlaterElm_real will be used in CalculateMAll, note that SlaterElm will not change before SR
         VMC_BF_MakeSample_real(comm_child1);
-        // only for real TBC
-        StartTimer(69);
-#pragma omp parallel for default(shared) private(tmp_i)
-        for(tmp_i=0;tmp_i<NQPFull*(Nsize*Nsize+1);tmp_i++)     InvM[tmp_i]      = InvM_real[tmp_i]+0.0*I;
-        StopTimer(69);
-        // only for real TBC
       }else{
         VMC_BF_MakeSample(comm_child1);
       }
@@ -619,19 +647,32 @@ int VMCPhysCal(MPI_Comm comm_parent, MPI_Comm comm_child1, MPI_Comm comm_child2)
 
     WeightAverageWE(comm_parent);
     WeightAverageGreenFunc(comm_parent);
-    ReduceCounter(comm_child2);
+    ReduceCounter(IsSplitChain(comm_child1) ? comm_parent : comm_child2);
+    if(NAutoCorr!=0) {
+      errE = UpdateAutoCorr(ismp,comm_parent);
+      errE2 += errE*errE;
+    }
 
     StopTimer(21);
     StartTimer(22);
     /* output zvo_out and green functions */
     if(rank==0) outputData();
+    if(NAsyncOutput!=0) AsyncOutPush(ismp+NDataIdxStart, rank);
     CloseFilePhysCal(rank);
 
     StopTimer(22);
     StopTimer(5);
+
+    /* the error of the average of Etot over the bins reaches the target */
+    if(NAutoCorr!=0 && DVMCErrorTarget>0.0 && sqrt(errE2)/(double)(ismp+1)<DVMCErrorTarget) {
+      if(rank==0) fprintf(stdout, "  remark: the error of Etot reached DVMCErrorTarget after %d bins.\n", ismp+1);
+      ismp++;
+      break;
+    }
   }
 
-  if(rank==0) OutputTime(NDataQtySmp);
+  AsyncOutFinalize(rank);
+  if(rank==0) OutputTime(ismp);
 
   return 0;
 }
@@ -661,42 +702,10 @@ void outputData() {
   }
 
   if (NVMCCalMode == 1) {
-    /* zvo_cisajs.dat */
-    if (NCisAjs > 0) {
-      if(NLanczosMode <2) {
-        for (i = 0; i < NCisAjs; i++) {
-          fprintf(FileCisAjs, "%d %d %d %d % .18e  % .18e \n", CisAjsIdx[i][0], CisAjsIdx[i][1], CisAjsIdx[i][2],
-                  CisAjsIdx[i][3], creal(PhysCisAjs[i]), cimag(PhysCisAjs[i]));
-        }
-      }
-      else{
-        int idx=0;
-        for (i = 0; i < NCisAjsLz; i++) {
-          idx = iOneBodyGIdx[CisAjsLzIdx[i][0] + CisAjsLzIdx[i][1] * Nsite][CisAjsLzIdx[i][2] +
-                                                                            CisAjsLzIdx[i][3] * Nsite];
-          //fprintf(stdout, "Debug: idx= %d value= % .18e % .18e\n", idx, creal(PhysCisAjs[idx]), cimag(PhysCisAjs[idx]));
-          fprintf(FileCisAjs, "%d %d %d %d % .18e % .18e \n", CisAjsLzIdx[idx][0], CisAjsLzIdx[idx][1],
-                  CisAjsLzIdx[idx][2], CisAjsLzIdx[idx][3], creal(PhysCisAjs[idx]), cimag(PhysCisAjs[idx]));
-        }
-      }
-      fprintf(FileCisAjs, "\n");
-    }
-    /* zvo_cisajscktalt.dat */
-    if (NCisAjsCktAlt > 0) {
-      for (i = 0; i < NCisAjsCktAlt; i++)
-        fprintf(FileCisAjsCktAlt, "% .18e  % .18e ", creal(PhysCisAjsCktAlt[i]), cimag(PhysCisAjsCktAlt[i]));
-      fprintf(FileCisAjsCktAlt, "\n");
-    }
-
-    /* zvo_cisajscktaltdc.dat */
-    if (NCisAjsCktAltDC > 0) {
-      for (i = 0; i < NCisAjsCktAltDC; i++) {
-        fprintf(FileCisAjsCktAltDC, "%d %d %d %d %d %d %d %d % .18e % .18e\n",
-                CisAjsCktAltDCIdx[i][0], CisAjsCktAltDCIdx[i][1], CisAjsCktAltDCIdx[i][2], CisAjsCktAltDCIdx[i][3],
-                CisAjsCktAltDCIdx[i][4], CisAjsCktAltDCIdx[i][5], CisAjsCktAltDCIdx[i][6], CisAjsCktAltDCIdx[i][7],
-                creal(PhysCisAjsCktAltDC[i]), cimag(PhysCisAjsCktAltDC[i]));
-      }
-      fprintf(FileCisAjsCktAltDC, "\n");
+    /* zvo_cisajs.dat, zvo_cisajscktaltex.dat and zvo_cisajscktalt.dat */
+    /* They are written by the writer thread when NAsyncOutput!=0. */
+    if (NAsyncOutput == 0) {
+      WriteGreenFuncText(FileCisAjs, FileCisAjsCktAlt, FileCisAjsCktAltDC, PhysCisAjs);
     }
 
     if (NLanczosMode > 0) {
@@ -726,9 +735,11 @@ void printUsageError() {
 
 void printOption() {
   fprintf(stderr,"  -b     binary mode\n");
+  fprintf(stderr,"  -c     convert the def files into zvo_def.bin and exit\n");
   fprintf(stderr,"  -m N   multiDef mode\n");
   fprintf(stderr,"  -o     optTrans mode\n");
   fprintf(stderr,"  -F N   set interval of file flush\n");
+  fprintf(stderr,"  -r     restart optimization from checkpoint files\n");
   fprintf(stderr,"  -s     Standard mode\n");
   fprintf(stderr,"  -e     Expert mode\n");
   fprintf(stderr,"  -h     show this message\n");
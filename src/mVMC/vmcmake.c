@@ -35,12 +35,55 @@ along with this program. If not, see http://www.gnu.org/licenses/.
 #include "matrix.c"
 #include "splitloop.h"
 #include "qp.h"
+#include "vmccal.h"
 
 #ifdef _pf_block_update
 // Block-update extension.
 #include "../pfupdates/pf_interface.h"
 #endif
 
+#ifdef _pf_block_update
+/* The engines of the block update are kept over the calls of VMCMakeSample */
+/* and reinitialized in place instead of being created for every refresh.   */
+void **PfOrbital=NULL, **PfUpdator=NULL;
+int PfUpdatorType=0; /* 0: not created, 1: real, 2: complex */
+
+/* Set up the engines for the configuration eleIdx and eleSpn and read PfM. */
+void InitPfUpdator_fcmp(int *eleIdx, int *eleSpn) {
+  if(PfUpdatorType!=2) {
+    FreePfUpdator();
+    PfOrbital = (void**)malloc(sizeof(void*)*2*NQPFull);
+    PfUpdator = PfOrbital + NQPFull;
+    updated_tdi_v_init_z(NQPFull, Nsite, Nsite2, Nsize,
+                         SlaterElm, Nsite2*Nsite2,
+                         InvM, Nsize*Nsize,
+                         eleIdx, eleSpn,
+                         NBlockUpdateSize,
+                         PfUpdator, PfOrbital);
+    PfUpdatorType = 2;
+  } else {
+    updated_tdi_v_reinit_z(NQPFull, Nsite, Nsite2, Nsize,
+                           SlaterElm, Nsite2*Nsite2,
+                           InvM, Nsize*Nsize,
+                           eleIdx, eleSpn,
+                           NBlockUpdateSize,
+                           PfUpdator, PfOrbital);
+  }
+  updated_tdi_v_get_pfa_z(NQPFull, PfM, PfUpdator);
+  return;
+}
+
+void FreePfUpdator() {
+  if(PfUpdatorType==1) updated_tdi_v_free_d(NQPFull, PfUpdator, PfOrbital);
+  else if(PfUpdatorType==2) updated_tdi_v_free_z(NQPFull, PfUpdator, PfOrbital);
+  free(PfOrbital);
+  PfOrbital = NULL;
+  PfUpdator = NULL;
+  PfUpdatorType = 0;
+  return;
+}
+#endif
+
 void VMCMakeSample(MPI_Comm comm) {
   int outStep,nOutStep;
   int inStep,nInStep;
@@ -51,17 +94,49 @@ void VMCMakeSample(MPI_Comm comm) {
 
   double complex logIpOld,logIpNew; /* logarithm of inner product <phi|L|x> */ // is this ok ? TBC
   int projCntNew[NProj];
+  int projDelta[4*(2*Nsite+1)]; /* sparse change of projCnt for two hops */
+  int nDelta=0;
   double complex pfMNew[NQPFull];
-  double x,w; // TBC x will be complex number
+  double x,w,qRatio; // TBC x will be complex number
 
   int qpStart,qpEnd;
+  int sampleStart,sampleEnd,nSample;
   int rejectFlag;
+  int inlineMeasure;
+  int delayUpdate;
+  int sparseProj;
   int rank,size;
   MPI_Comm_size(comm,&size);
   MPI_Comm_rank(comm,&rank);
 
+  if(IsMultiChain(comm)) {
+    VMCMakeSampleChain(comm);
+    return;
+  }
+
+  inlineMeasure = IsInlineMeasure(comm);
+  if(IsSplitChain(comm)) {
+    /* the own chain of this process */
+    SplitLoop(&sampleStart,&sampleEnd,NVMCSample,rank,size);
+    comm = MPI_COMM_SELF;
+    rank = 0;
+    size = 1;
+  } else {
+    sampleStart = 0;
+    sampleEnd = NVMCSample;
+  }
+  nSample = sampleEnd-sampleStart;
+
   SplitLoop(&qpStart,&qpEnd,NQPFull,rank,size);
 
+  delayUpdate = (NDelayUpdate>0);
+  sparseProj = IsProjCntDelta();
+  if(inlineMeasure) {
+    StartTimer(24);
+    clearPhysQuantity();
+    StopTimer(24);
+  }
+
   StartTimer(30);
   if(BurnFlag==0) {
     makeInitialSample(TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleProjCnt,
@@ -72,8 +147,6 @@ void VMCMakeSample(MPI_Comm comm) {
   
 #ifdef _pf_block_update
   // TODO: Compute from qpStart to qpEnd to support loop splitting.
-  void *pfOrbital[NQPFull];
-  void *pfUpdator[NQPFull];
   // Read block size from input.
   const char *optBlockSize = getenv("VMC_BLOCK_UPDATE_SIZE");
   if (optBlockSize)
@@ -89,13 +162,7 @@ void VMCMakeSample(MPI_Comm comm) {
   for (mi=0; mi<Ne;  mi++) EleSpn[mi] = 0;
   for (mi=Ne;mi<Ne*2;mi++) EleSpn[mi] = 1;
   // Initialize.
-  updated_tdi_v_init_z(NQPFull, Nsite, Nsite2, Nsize,
-                       SlaterElm, Nsite2*Nsite2,
-                       InvM, Nsize*Nsize,
-                       TmpEleIdx, EleSpn,
-                       NBlockUpdateSize,
-                       pfUpdator, pfOrbital);
-  updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+  InitPfUpdator_fcmp(TmpEleIdx, EleSpn);
 #else
   CalculateMAll_fcmp(TmpEleIdx,qpStart,qpEnd);
 #endif
@@ -107,15 +174,8 @@ void VMCMakeSample(MPI_Comm comm) {
     makeInitialSample(TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleProjCnt,
                       qpStart,qpEnd,comm);
 #ifdef _pf_block_update
-    // Clear and reinitialize.
-    updated_tdi_v_free_z(NQPFull, pfUpdator, pfOrbital);
-    updated_tdi_v_init_z(NQPFull, Nsite, Nsite2, Nsize,
-                         SlaterElm, Nsite2*Nsite2,
-                         InvM, Nsize*Nsize,
-                         TmpEleIdx, EleSpn,
-                         NBlockUpdateSize,
-                         pfUpdator, pfOrbital);
-    updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+    // Reinitialize in place.
+    InitPfUpdator_fcmp(TmpEleIdx, EleSpn);
 #else
     CalculateMAll_fcmp(TmpEleIdx,qpStart,qpEnd);
 #endif
@@ -123,9 +183,10 @@ void VMCMakeSample(MPI_Comm comm) {
     logIpOld = CalculateLogIP_fcmp(PfM,qpStart,qpEnd,comm);
     BurnFlag = 0;
   }
+  makeEleLst(TmpEleLst,TmpEleIdx,TmpEleNum);
   StopTimer(30);
 
-  nOutStep = (BurnFlag==0) ? NVMCWarmUp+NVMCSample : NVMCSample+1;
+  nOutStep = (BurnFlag==0) ? NVMCWarmUp+nSample : nSample+1;
   nInStep = NVMCInterval * Nsite;
 
   for(i=0;i<Counter_max;i++) Counter[i]=0;  /* reset counter */
@@ -139,8 +200,8 @@ void VMCMakeSample(MPI_Comm comm) {
         Counter[0]++;
 
         StartTimer(31);
-        makeCandidate_hopping(&mi, &ri, &rj, &s, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg);
+        makeCandidate_hopping(&mi, &ri, &rj, &s, &rejectFlag, &qRatio,
+                              TmpEleIdx, TmpEleLst);
         StopTimer(31);
 
         if(rejectFlag) continue;
@@ -148,17 +209,19 @@ void VMCMakeSample(MPI_Comm comm) {
         StartTimer(32);
         StartTimer(60);
         /* The mi-th electron with spin s hops to site rj */
-        updateEleConfig(mi,ri,rj,s,TmpEleIdx,TmpEleCfg,TmpEleNum);
-        UpdateProjCnt(ri,rj,s,projCntNew,TmpEleProjCnt,TmpEleNum);
+        updateEleConfig(mi,ri,rj,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleLst);
+        if(sparseProj) nDelta = UpdateProjCntDelta(ri,rj,s,projDelta,0,TmpEleNum);
+        else UpdateProjCnt(ri,rj,s,projCntNew,TmpEleProjCnt,TmpEleNum);
         StopTimer(60);
 
         StartTimer(61);
 #ifdef _pf_block_update
-        updated_tdi_v_push_z(NQPFull, rj+s*Nsite, mi+s*Ne, 1, pfUpdator);
-        updated_tdi_v_get_pfa_z(NQPFull, pfMNew, pfUpdator);
+        updated_tdi_v_push_z(NQPFull, rj+s*Nsite, mi+s*Ne, 1, PfUpdator);
+        updated_tdi_v_get_pfa_z(NQPFull, pfMNew, PfUpdator);
 #else
         //CalculateNewPfM2(mi,s,pfMNew,TmpEleIdx,qpStart,qpEnd);
-        CalculateNewPfM2(mi,s,pfMNew,TmpEleIdx,qpStart,qpEnd);
+        if(delayUpdate) CalculateNewPfMDelay(mi,s,pfMNew,TmpEleIdx,qpStart,qpEnd);
+        else CalculateNewPfM2(mi,s,pfMNew,TmpEleIdx,qpStart,qpEnd);
 #endif
         //printf("DEBUG: out %d in %d pfMNew=%lf \n",outStep,inStep,creal(pfMNew[0]));
         StopTimer(61);
@@ -170,30 +233,33 @@ void VMCMakeSample(MPI_Comm comm) {
         StopTimer(62);
 
         /* Metroplis */
-        x = LogProjRatio(projCntNew,TmpEleProjCnt);
-        w = exp(2.0*(x+creal(logIpNew-logIpOld)));
+        if(sparseProj) x = LogProjRatioDelta(projDelta,nDelta);
+        else x = LogProjRatio(projCntNew,TmpEleProjCnt);
+        w = qRatio*exp(2.0*(x+creal(logIpNew-logIpOld)));
         if( !isfinite(w) ) w = -1.0; /* should be rejected */
 
         if(w > genrand_real2()) { /* accept */
           StartTimer(63);
 #ifdef _pf_block_update
           // Inv already updated. Only need to get PfM again.
-          updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+          updated_tdi_v_get_pfa_z(NQPFull, PfM, PfUpdator);
 #else
           // UpdateMAll will change SlaterElm, InvM (including PfM)
-          UpdateMAll(mi,s,TmpEleIdx,qpStart,qpEnd);
+          if(delayUpdate) UpdateMAllDelay(mi,s,TmpEleIdx,qpStart,qpEnd);
+          else UpdateMAll(mi,s,TmpEleIdx,qpStart,qpEnd);
 #endif
           StopTimer(63);
 
-          for(i=0;i<NProj;i++) TmpEleProjCnt[i] = projCntNew[i];
+          if(sparseProj) AddProjCntDelta(TmpEleProjCnt,projDelta,nDelta);
+          else for(i=0;i<NProj;i++) TmpEleProjCnt[i] = projCntNew[i];
           logIpOld = logIpNew;
           nAccept++;
           Counter[1]++;
         } else { /* reject */
 #ifdef _pf_block_update
-          updated_tdi_v_pop_z(NQPFull, 0, pfUpdator);
+          updated_tdi_v_pop_z(NQPFull, 0, PfUpdator);
 #endif
-          revertEleConfig(mi,ri,rj,s,TmpEleIdx,TmpEleCfg,TmpEleNum);
+          revertEleConfig(mi,ri,rj,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleLst);
         }
         StopTimer(32);
 
@@ -202,7 +268,7 @@ void VMCMakeSample(MPI_Comm comm) {
 
         StartTimer(31);
         makeCandidate_exchange(&mi, &ri, &rj, &s, &rejectFlag,
-                               TmpEleIdx, TmpEleCfg, TmpEleNum);
+                               TmpEleIdx, TmpEleCfg, TmpEleLst);
         StopTimer(31);
 
         if(rejectFlag) continue;
@@ -215,11 +281,13 @@ void VMCMakeSample(MPI_Comm comm) {
         mj = TmpEleCfg[rj+t*Nsite];
 
         /* The mi-th electron with spin s hops to rj */
-        updateEleConfig(mi,ri,rj,s,TmpEleIdx,TmpEleCfg,TmpEleNum);
-        UpdateProjCnt(ri,rj,s,projCntNew,TmpEleProjCnt,TmpEleNum);
+        updateEleConfig(mi,ri,rj,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleLst);
+        if(sparseProj) nDelta = UpdateProjCntDelta(ri,rj,s,projDelta,0,TmpEleNum);
+        else UpdateProjCnt(ri,rj,s,projCntNew,TmpEleProjCnt,TmpEleNum);
         /* The mj-th electron with spin t hops to ri */
-        updateEleConfig(mj,rj,ri,t,TmpEleIdx,TmpEleCfg,TmpEleNum);
-        UpdateProjCnt(rj,ri,t,projCntNew,projCntNew,TmpEleNum);
+        updateEleConfig(mj,rj,ri,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleLst);
+        if(sparseProj) nDelta = UpdateProjCntDelta(rj,ri,t,projDelta,nDelta,TmpEleNum);
+        else UpdateProjCnt(rj,ri,t,projCntNew,projCntNew,TmpEleNum);
 
         StopTimer(65);
         StartTimer(66);
@@ -228,9 +296,11 @@ void VMCMakeSample(MPI_Comm comm) {
         updated_tdi_v_push_pair_z(NQPFull,
                                   rj+s*Nsite, mi+s*Ne,
                                   ri+t*Nsite, mj+t*Ne,
-                                  1, pfUpdator);
-        updated_tdi_v_get_pfa_z(NQPFull, pfMNew, pfUpdator);
+                                  1, PfUpdator);
+        updated_tdi_v_get_pfa_z(NQPFull, pfMNew, PfUpdator);
 #else
+        /* the two-electron update reads InvM directly */
+        if(delayUpdate) FlushMAllDelay(qpStart,qpEnd);
         CalculateNewPfMTwo2_fcmp(mi, s, mj, t, pfMNew, TmpEleIdx, qpStart, qpEnd);
 #endif
         StopTimer(66);
@@ -242,7 +312,8 @@ void VMCMakeSample(MPI_Comm comm) {
         StopTimer(67);
 
         /* Metroplis */
-        x = LogProjRatio(projCntNew,TmpEleProjCnt);
+        if(sparseProj) x = LogProjRatioDelta(projDelta,nDelta);
+        else x = LogProjRatio(projCntNew,TmpEleProjCnt);
         w = exp(2.0*(x+creal(logIpNew-logIpOld))); //TBC
         if( !isfinite(w) ) w = -1.0; /* should be rejected */
 
@@ -250,23 +321,24 @@ void VMCMakeSample(MPI_Comm comm) {
           StartTimer(68);
 #ifdef _pf_block_update
           // Inv already updated. Only need to get PfM again.
-          updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+          updated_tdi_v_get_pfa_z(NQPFull, PfM, PfUpdator);
 #else
           UpdateMAllTwo_fcmp(mi, s, mj, t, ri, rj, TmpEleIdx,qpStart,qpEnd);
 #endif
           StopTimer(68);
 
-          for(i=0;i<NProj;i++) TmpEleProjCnt[i] = projCntNew[i];
+          if(sparseProj) AddProjCntDelta(TmpEleProjCnt,projDelta,nDelta);
+          else for(i=0;i<NProj;i++) TmpEleProjCnt[i] = projCntNew[i];
           logIpOld = logIpNew;
           nAccept++;
           Counter[3]++;
         } else { /* reject */
 #ifdef _pf_block_update
-          updated_tdi_v_pop_z(NQPFull, 0, pfUpdator);
-          updated_tdi_v_pop_z(NQPFull, 0, pfUpdator);
+          updated_tdi_v_pop_z(NQPFull, 0, PfUpdator);
+          updated_tdi_v_pop_z(NQPFull, 0, PfUpdator);
 #endif
-          revertEleConfig(mj,rj,ri,t,TmpEleIdx,TmpEleCfg,TmpEleNum);
-          revertEleConfig(mi,ri,rj,s,TmpEleIdx,TmpEleCfg,TmpEleNum);
+          revertEleConfig(mj,rj,ri,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleLst);
+          revertEleConfig(mi,ri,rj,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleLst);
         }
         StopTimer(33);
       }
@@ -275,15 +347,8 @@ void VMCMakeSample(MPI_Comm comm) {
         // Recalculate PfM and InvM.
         StartTimer(34);
 #ifdef _pf_block_update
-        // Clear and reinitialize.
-        updated_tdi_v_free_z(NQPFull, pfUpdator, pfOrbital);
-        updated_tdi_v_init_z(NQPFull, Nsite, Nsite2, Nsize,
-                             SlaterElm, Nsite2*Nsite2,
-                             InvM, Nsize*Nsize,
-                             TmpEleIdx, EleSpn,
-                             NBlockUpdateSize,
-                             pfUpdator, pfOrbital);
-        updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+        // Reinitialize in place.
+        InitPfUpdator_fcmp(TmpEleIdx, EleSpn);
 #else
         CalculateMAll_fcmp(TmpEleIdx,qpStart,qpEnd);
 #endif
@@ -296,75 +361,367 @@ void VMCMakeSample(MPI_Comm comm) {
 
     StartTimer(35);
     /* save Electron Configuration */
-    if(outStep >= nOutStep-NVMCSample) {
-      sample = outStep-(nOutStep-NVMCSample);
+    if(outStep >= nOutStep-nSample) {
+      sample = sampleStart+outStep-(nOutStep-nSample);
       saveEleConfig(sample,logIpOld,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleProjCnt);
     }
     StopTimer(35);
 
+    /* InvM and PfM are valid for the saved configuration */
+    if(inlineMeasure && outStep >= nOutStep-nSample) {
+      if(delayUpdate) FlushMAllDelay(qpStart,qpEnd);
+      VMCMainCalSample(sampleStart+outStep-(nOutStep-nSample),0,rank);
+    }
+
   } /* end of outstep */
 
+  if(delayUpdate) FlushMAllDelay(qpStart,qpEnd);
   copyToBurnSample(TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleProjCnt);
   BurnFlag=1;
 
+  return;
+}
+
+/* Return 1 if VMCMakeSample runs one Markov chain per OpenMP thread. */
+int IsMultiChain(MPI_Comm comm) {
 #ifdef _pf_block_update
-  // Free-up updator space.
-  updated_tdi_v_free_z(NQPFull, pfUpdator, pfOrbital);
+  return 0;
+#else
+  int size;
+  if(NMultiChain==0 || NThread<2 || NProjBF!=0 || iFlgOrbitalGeneral!=0) return 0;
+  MPI_Comm_size(comm,&size);
+  return (size==1) ? 1 : 0;
 #endif
+}
 
+/* Return 1 if every process of comm runs its own Markov chain over all */
+/* the QP indices instead of sharing one chain (NSplitChain!=0).        */
+/* The sampler then needs no communication, and each process makes   */
+/* the samples from sampleStart to sampleEnd-1 measured by VMCMainCal. */
+int IsSplitChain(MPI_Comm comm) {
+  int size;
+  if(NSplitChain==0 || NProjBF!=0 || iFlgOrbitalGeneral!=0) return 0;
+  MPI_Comm_size(comm,&size);
+  return (size>1) ? 1 : 0;
+}
+
+/* Seed the random number stream of the rank-th process of comm */
+/* running its own chain. The 0-th process continues the stream of the group. */
+void initSplitChainRand(const int rank) {
+  uint32_t key[2];
+  int rankWorld;
+  if(rank==0) return;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rankWorld);
+  key[0] = (uint32_t)RndSeed;
+  key[1] = (uint32_t)rankWorld;
+  init_by_array(key,2);
   return;
 }
 
-int makeInitialSample(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt,
-                      const int qpStart, const int qpEnd, MPI_Comm comm) {
+/* Seed the random number stream of each chain from (RndSeed, rank, chain) */
+/* into ChainRandState. The 0-th chain continues the stream of the master   */
+/* thread. The thread running a chain loads its stream at the beginning    */
+/* and stores it at the end of the chain, so that the streams do not rely  */
+/* on the threadprivate state of SFMT persisting over parallel regions.    */
+void InitChainRand() {
+  const int stateSize = get_state_size32();
+  uint32_t key[3];
+  int rank,chain;
+
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  get_gen_state(ChainRandState); /* the stream of the master thread */
+  for(chain=1;chain<NThread;chain++) {
+    key[0] = (uint32_t)RndSeed;
+    key[1] = (uint32_t)rank;
+    key[2] = (uint32_t)chain;
+    init_by_array(key,3);
+    get_gen_state(ChainRandState + chain*stateSize);
+  }
+  set_gen_state(ChainRandState);
+  return;
+}
+
+/* Multi-chain version of VMCMakeSample.                              */
+/* Each thread runs an independent Markov chain with its own InvM,    */
+/* PfM and random number stream, and saves the samples from           */
+/* sampleStart to sampleEnd-1 given by SplitLoop over the chains.     */
+void VMCMakeSampleChain(MPI_Comm comm) {
+  const int nChain = NThread;
+  int chain,i;
+  int *myIWork;
+  double complex *myBuffer;
+  double *myRWork;
+
+  StartTimer(30);
+  for(i=0;i<Counter_max;i++) Counter[i]=0;  /* reset counter */
+
+  RequestWorkSpaceThreadInt(Nsize+NProj);
+  RequestWorkSpaceThreadComplex(Nsize*Nsize+LapackLWork+4*Nsize+NQPFull);
+  RequestWorkSpaceThreadDouble(LapackLWork);
+
+  /* the 0-th chain continues the stream of the master thread */
+  get_gen_state(ChainRandState);
+#pragma omp parallel default(shared) private(myIWork,myBuffer,myRWork)
+  {
+    myIWork  = GetWorkSpaceThreadInt(Nsize+NProj);
+    myBuffer = GetWorkSpaceThreadComplex(Nsize*Nsize+LapackLWork+4*Nsize+NQPFull);
+    myRWork  = GetWorkSpaceThreadDouble(LapackLWork);
+
+#pragma omp for private(chain) schedule(static,1)
+    for(chain=0;chain<nChain;chain++) {
+      makeSampleChain_child(chain,nChain,myIWork,myBuffer,myRWork);
+    }
+  }
+
+  ReleaseWorkSpaceThreadInt();
+  ReleaseWorkSpaceThreadComplex();
+  ReleaseWorkSpaceThreadDouble();
+  set_gen_state(ChainRandState);
+
+  BurnFlag=1;
+  StopTimer(30);
+  return;
+}
+
+/* iwork: Nsize+NProj, buffer: Nsize*Nsize+LapackLWork+4*Nsize+NQPFull, rwork: LapackLWork */
+void makeSampleChain_child(const int chain, const int nChain,
+                           int *iwork, double complex *buffer, double *rwork) {
+  const int nBlock = Nsize+2*Nsite2+NProj;
+  int *eleIdx = ChainEleIdx + chain*nBlock;
+  int *eleCfg = eleIdx + Nsize;
+  int *eleNum = eleCfg + Nsite2;
+  int *eleProjCnt = eleNum + Nsite2;
+  int *burnEleIdx = ChainBurnEleIdx + chain*nBlock;
+  int *eleLst = ChainEleLst + chain*SizeEleLst();
+  int *projCntNew = iwork + Nsize;
+  int projDelta[4*(2*Nsite+1)];
+  int nDelta=0;
+  const int sparseProj = IsProjCntDelta();
+
+  double complex *invM = ChainInvM + chain*NQPFull*(Nsize*Nsize+1);
+  double complex *pfM = invM + NQPFull*Nsize*Nsize;
+  double complex *bufM = buffer;
+  double complex *work = bufM + Nsize*Nsize;
+  double complex *vec = work + LapackLWork;
+  double complex *pfMNew = vec + 4*Nsize;
+
+  int outStep,nOutStep;
+  int inStep,nInStep;
+  UpdateType updateType;
+  int mi,mj,ri,rj,s,t,i;
+  int nAccept=0;
+  int burnFlag=BurnFlag;
+  int sampleStart,sampleEnd,nSample;
+  int rejectFlag;
+  int counter[Counter_max];
+
+  double complex logIpOld,logIpNew; /* logarithm of inner product <phi|L|x> */
+  double x,w,qRatio;
+
+  SplitLoop(&sampleStart,&sampleEnd,NVMCSample,chain,nChain);
+  nSample = sampleEnd-sampleStart;
+
+  /* the random number stream of this chain */
+  set_gen_state(ChainRandState + chain*get_state_size32());
+
+  if(burnFlag==0) {
+    makeInitialSampleChain(eleIdx,eleCfg,eleNum,eleProjCnt,pfM,invM,bufM,iwork,work,rwork);
+  } else {
+    for(i=0;i<nBlock;i++) eleIdx[i] = burnEleIdx[i];
+    CalculateMAllChain_fcmp(eleIdx,pfM,invM,bufM,iwork,work,rwork);
+  }
+  logIpOld = CalculateLogIPChain_fcmp(pfM);
+
+  if( !isfinite(creal(logIpOld) + cimag(logIpOld)) ) {
+    fprintf(stderr,"waring: VMCMakeSampleChain chain:%d remakeSample logIpOld=%e\n",chain,creal(logIpOld));
+    makeInitialSampleChain(eleIdx,eleCfg,eleNum,eleProjCnt,pfM,invM,bufM,iwork,work,rwork);
+    logIpOld = CalculateLogIPChain_fcmp(pfM);
+    burnFlag = 0;
+  }
+  makeEleLst(eleLst,eleIdx,eleNum);
+
+  nOutStep = (burnFlag==0) ? NVMCWarmUp+nSample : nSample+1;
+  nInStep = NVMCInterval * Nsite;
+
+  for(i=0;i<Counter_max;i++) counter[i]=0;
+
+  for(outStep=0;outStep<nOutStep;outStep++) {
+    for(inStep=0;inStep<nInStep;inStep++) {
+
+      updateType = getUpdateType(NExUpdatePath);
+
+      if(updateType==HOPPING) { /* hopping */
+        counter[0]++;
+
+        makeCandidate_hopping(&mi, &ri, &rj, &s, &rejectFlag, &qRatio, eleIdx, eleLst);
+        if(rejectFlag) continue;
+
+        /* The mi-th electron with spin s hops to site rj */
+        updateEleConfig(mi,ri,rj,s,eleIdx,eleCfg,eleNum,eleLst);
+        if(sparseProj) nDelta = UpdateProjCntDelta(ri,rj,s,projDelta,0,eleNum);
+        else UpdateProjCnt(ri,rj,s,projCntNew,eleProjCnt,eleNum);
+
+        CalculateNewPfMChain(mi,s,pfMNew,eleIdx,pfM,invM);
+        logIpNew = CalculateLogIPChain_fcmp(pfMNew);
+
+        /* Metroplis */
+        if(sparseProj) x = LogProjRatioDelta(projDelta,nDelta);
+        else x = LogProjRatio(projCntNew,eleProjCnt);
+        w = qRatio*exp(2.0*(x+creal(logIpNew-logIpOld)));
+        if( !isfinite(w) ) w = -1.0; /* should be rejected */
+
+        if(w > genrand_real2()) { /* accept */
+          UpdateMAllChain(mi,s,eleIdx,pfM,invM,vec);
+          if(sparseProj) AddProjCntDelta(eleProjCnt,projDelta,nDelta);
+          else for(i=0;i<NProj;i++) eleProjCnt[i] = projCntNew[i];
+          logIpOld = logIpNew;
+          nAccept++;
+          counter[1]++;
+        } else { /* reject */
+          revertEleConfig(mi,ri,rj,s,eleIdx,eleCfg,eleNum,eleLst);
+        }
+
+      } else if(updateType==EXCHANGE) { /* exchange */
+        counter[2]++;
+
+        makeCandidate_exchange(&mi, &ri, &rj, &s, &rejectFlag, eleIdx, eleCfg, eleLst);
+        if(rejectFlag) continue;
+
+        /* The mi-th electron with spin s exchanges with the electron on site rj with spin 1-s */
+        t = 1-s;
+        mj = eleCfg[rj+t*Nsite];
+
+        updateEleConfig(mi,ri,rj,s,eleIdx,eleCfg,eleNum,eleLst);
+        if(sparseProj) nDelta = UpdateProjCntDelta(ri,rj,s,projDelta,0,eleNum);
+        else UpdateProjCnt(ri,rj,s,projCntNew,eleProjCnt,eleNum);
+        updateEleConfig(mj,rj,ri,t,eleIdx,eleCfg,eleNum,eleLst);
+        if(sparseProj) nDelta = UpdateProjCntDelta(rj,ri,t,projDelta,nDelta,eleNum);
+        else UpdateProjCnt(rj,ri,t,projCntNew,projCntNew,eleNum);
+
+        CalculateNewPfMTwoChain_fcmp(mi,s,mj,t,pfMNew,eleIdx,pfM,invM,vec);
+        logIpNew = CalculateLogIPChain_fcmp(pfMNew);
+
+        /* Metroplis */
+        if(sparseProj) x = LogProjRatioDelta(projDelta,nDelta);
+        else x = LogProjRatio(projCntNew,eleProjCnt);
+        w = exp(2.0*(x+creal(logIpNew-logIpOld)));
+        if( !isfinite(w) ) w = -1.0; /* should be rejected */
+
+        if(w > genrand_real2()) { /* accept */
+          UpdateMAllTwoChain_fcmp(mi,s,mj,t,ri,rj,eleIdx,pfM,invM,vec);
+          if(sparseProj) AddProjCntDelta(eleProjCnt,projDelta,nDelta);
+          else for(i=0;i<NProj;i++) eleProjCnt[i] = projCntNew[i];
+          logIpOld = logIpNew;
+          nAccept++;
+          counter[3]++;
+        } else { /* reject */
+          revertEleConfig(mj,rj,ri,t,eleIdx,eleCfg,eleNum,eleLst);
+          revertEleConfig(mi,ri,rj,s,eleIdx,eleCfg,eleNum,eleLst);
+        }
+      }
+
+      if(nAccept>Nsite) {
+        /* Recalculate PfM and InvM */
+        CalculateMAllChain_fcmp(eleIdx,pfM,invM,bufM,iwork,work,rwork);
+        logIpOld = CalculateLogIPChain_fcmp(pfM);
+        nAccept=0;
+      }
+    } /* end of instep */
+
+    /* save Electron Configuration */
+    if(outStep >= nOutStep-nSample) {
+      saveEleConfig(sampleStart+outStep-(nOutStep-nSample),logIpOld,eleIdx,eleCfg,eleNum,eleProjCnt);
+    }
+  } /* end of outstep */
+
+  for(i=0;i<nBlock;i++) burnEleIdx[i] = eleIdx[i];
+  get_gen_state(ChainRandState + chain*get_state_size32());
+
+  for(i=0;i<Counter_max;i++) {
+#pragma omp atomic
+    Counter[i] += counter[i];
+  }
+
+  return;
+}
+
+/* makeInitialSample for one Markov chain owning pfM and invM */
+int makeInitialSampleChain(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt,
+                           double complex *pfM, double complex *invM, double complex *bufM,
+                           int *iwork, double complex *work, double *rwork) {
+  int flag=1,loop=0;
+
+  do {
+    makeInitialEleConfig(eleIdx,eleCfg,eleNum,eleProjCnt);
+    flag = CalculateMAllChain_fcmp(eleIdx,pfM,invM,bufM,iwork,work,rwork);
+
+    loop++;
+    if(loop>100) {
+      fprintf(stderr, "error: makeInitialSampleChain: Too many loops\n");
+      MPI_Abort(MPI_COMM_WORLD,EXIT_FAILURE);
+    }
+  } while (flag>0);
+
+  return 0;
+}
+
+/* Generate a random electron configuration and its projection counts. */
+void makeInitialEleConfig(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt) {
   const int nsize = Nsize;
   const int nsite2 = Nsite2;
-  int flag=1,flagRdc,loop=0;
   int ri,mi,si,msi,rsi;
-  int rank,size;
-  MPI_Comm_size(comm,&size);
-  MPI_Comm_rank(comm,&rank);
-  
-  do {
-    /* initialize */
-    #pragma omp parallel for default(shared) private(msi)
-    for(msi=0;msi<nsize;msi++) eleIdx[msi] = -1;
-    #pragma omp parallel for default(shared) private(rsi)
-    for(rsi=0;rsi<nsite2;rsi++) eleCfg[rsi] = -1;
-    
-    /* local spin */
-    for(ri=0;ri<Nsite;ri++) {
-      if(LocSpn[ri]==1) {
+
+  /* initialize */
+  #pragma omp parallel for default(shared) private(msi)
+  for(msi=0;msi<nsize;msi++) eleIdx[msi] = -1;
+  #pragma omp parallel for default(shared) private(rsi)
+  for(rsi=0;rsi<nsite2;rsi++) eleCfg[rsi] = -1;
+
+  /* local spin */
+  for(ri=0;ri<Nsite;ri++) {
+    if(LocSpn[ri]==1) {
+      do {
+        mi = gen_rand32()%Ne;
+        si = (genrand_real2()<0.5) ? 0 : 1;
+      } while(eleIdx[mi+si*Ne]!=-1);
+      eleCfg[ri+si*Nsite] = mi;
+      eleIdx[mi+si*Ne] = ri;
+    }
+  }
+
+  /* itinerant electron */
+  for(si=0;si<2;si++) {
+    for(mi=0;mi<Ne;mi++) {
+      if(eleIdx[mi+si*Ne]== -1) {
         do {
-          mi = gen_rand32()%Ne;
-          si = (genrand_real2()<0.5) ? 0 : 1;
-        } while(eleIdx[mi+si*Ne]!=-1);
+          ri = gen_rand32()%Nsite;
+        } while (eleCfg[ri+si*Nsite]!= -1 || LocSpn[ri]==1);
         eleCfg[ri+si*Nsite] = mi;
         eleIdx[mi+si*Ne] = ri;
       }
     }
-    
-    /* itinerant electron */
-    for(si=0;si<2;si++) {
-      for(mi=0;mi<Ne;mi++) {
-        if(eleIdx[mi+si*Ne]== -1) {
-          do {
-            ri = gen_rand32()%Nsite;
-          } while (eleCfg[ri+si*Nsite]!= -1 || LocSpn[ri]==1);
-          eleCfg[ri+si*Nsite] = mi;
-          eleIdx[mi+si*Ne] = ri;
-        }
-      }
-    }
-    
-    /* EleNum */
-    #pragma omp parallel for default(shared) private(rsi)
-    #pragma loop noalias
-    for(rsi=0;rsi<nsite2;rsi++) {
-      eleNum[rsi] = (eleCfg[rsi] < 0) ? 0 : 1;
-    }
-    
-    MakeProjCnt(eleProjCnt,eleNum);
+  }
+
+  /* EleNum */
+  #pragma omp parallel for default(shared) private(rsi)
+  #pragma loop noalias
+  for(rsi=0;rsi<nsite2;rsi++) {
+    eleNum[rsi] = (eleCfg[rsi] < 0) ? 0 : 1;
+  }
+
+  MakeProjCnt(eleProjCnt,eleNum);
+  return;
+}
+
+int makeInitialSample(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt,
+                      const int qpStart, const int qpEnd, MPI_Comm comm) {
+  int flag=1,flagRdc,loop=0;
+  int rank,size;
+  MPI_Comm_size(comm,&size);
+  MPI_Comm_rank(comm,&rank);
+  
+  do {
+    makeInitialEleConfig(eleIdx,eleCfg,eleNum,eleProjCnt);
 
     flag = CalculateMAll_fcmp(eleIdx,qpStart,qpEnd);
     //printf("DEBUG: maker4: PfM=%lf\n",creal(PfM[0]));
@@ -471,93 +828,208 @@ void ReduceCounter(MPI_Comm comm) {
 
 
 /* The mi-th electron with spin s hops to site rj */
-void makeCandidate_hopping(int *mi_, int *ri_, int *rj_, int *s_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg) {
-  const int icnt_max = Nsite*Nsite;
-  int icnt;
-  int mi, ri, rj, s, flag;
-
-  flag = 0; // FALSE
-  do {
-    mi = gen_rand32()%Ne;
-    s = (genrand_real2()<0.5) ? 0 : 1;
-    ri = eleIdx[mi+s*Ne];
-  } while (LocSpn[ri] == 1);
+/* With NHopProposal!=0, rj is drawn from the sites connected to ri by Transfer */
+/* with the probability D_HopNbrRatio, and qRatio = q(x'->x)/q(x->x') corrects */
+/* the Metropolis ratio. Otherwise qRatio = 1. */
+void makeCandidate_hopping(int *mi_, int *ri_, int *rj_, int *s_, int *rejectFlag_, double *qRatio_,
+                           const int *eleIdx, const int *eleLst) {
+  const int *itn = eleLst;
+  const int *emp;
+  int msi, mi, ri, rj, s, nNbr;
+
+  /* an electron on the conduction sites and an empty conduction site */
+  if(itn[0]==0) {
+    *rejectFlag_ = 1; // TRUE
+    return;
+  }
+  msi = itn[1+gen_rand32()%itn[0]];
+  mi = msi%Ne;
+  s = msi/Ne;
+  ri = eleIdx[msi];
+
+  emp = getEleLstSet(eleLst,2+s);
+  if(emp[0]==0) {
+    *rejectFlag_ = 1; // TRUE
+    return;
+  }
 
-  icnt = 0;
-  do {
-    rj = gen_rand32()%Nsite;
-    if(icnt> icnt_max){
-      flag = 1; // TRUE
-      break;
+  if(NHopProposal==0) {
+    rj = emp[1+gen_rand32()%emp[0]];
+    *qRatio_ = 1.0;
+  } else {
+    if(genrand_real2()<D_HopNbrRatio) {
+      nNbr = HopNbrIdx[ri+1]-HopNbrIdx[ri];
+      if(nNbr==0) {
+        *rejectFlag_ = 1; // TRUE
+        return;
+      }
+      rj = HopNbr[HopNbrIdx[ri]+gen_rand32()%nNbr];
+      /* rj is occupied by an electron with spin s */
+      if(emp[1+Nsite+rj]<0) {
+        *rejectFlag_ = 1; // TRUE
+        return;
+      }
+    } else {
+      rj = emp[1+gen_rand32()%emp[0]];
     }
-    icnt+=1;
-  } while (eleCfg[rj+s*Nsite] != -1 || LocSpn[rj]==1);
+    *qRatio_ = hopProposalRatio(ri,rj,emp[0]);
+  }
 
   *mi_ = mi;
   *ri_ = ri;
   *rj_ = rj;
   *s_ = s;
-  *rejectFlag_ = flag;
+  *rejectFlag_ = 0; // FALSE
 
   return;
 }
 
-/* The mi-th electron with spin s exchanges with the electron on site rj with spin 1-s */
-void makeCandidate_exchange(int *mi_, int *ri_, int *rj_, int *s_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg, const int *eleNum) {
-  int mi, mj, ri, rj, s, t, flag;
-
-  flag = 1; // TRUE
-  for(ri=0;ri<Nsite;ri++){
-    if((eleNum[ri]+eleNum[ri+Nsite]) == 1){
-      flag = 0; // FALSE
-      break;
+/* q(x'->x)/q(x->x') of the hopping ri -> rj, where nEmp is the number of the */
+/* empty conduction sites with spin s, which is the same in x and x'. */
+/* q(x->x') = (1-p)/nEmp + p/nNbr(ri) if ri and rj are connected, (1-p)/nEmp otherwise */
+double hopProposalRatio(const int ri, const int rj, const int nEmp) {
+  const double qUni = (1.0-D_HopNbrRatio)/(double)nEmp;
+  const int nNbrI = HopNbrIdx[ri+1]-HopNbrIdx[ri];
+  const int nNbrJ = HopNbrIdx[rj+1]-HopNbrIdx[rj];
+  int k;
+
+  for(k=HopNbrIdx[ri];k<HopNbrIdx[ri+1];k++) {
+    if(HopNbr[k]==rj) {
+      return (qUni + D_HopNbrRatio/(double)nNbrJ) / (qUni + D_HopNbrRatio/(double)nNbrI);
     }
   }
-  if(flag) {
-    *rejectFlag_ = flag;
+  return 1.0;
+}
+
+/* The mi-th electron with spin s exchanges with the electron on site rj with spin 1-s */
+void makeCandidate_exchange(int *mi_, int *ri_, int *rj_, int *s_, int *rejectFlag_,
+                           const int *eleIdx, const int *eleCfg, const int *eleLst) {
+  const int *sgl0 = getEleLstSet(eleLst,4);
+  const int *sgl1 = getEleLstSet(eleLst,5);
+  int k, ri, rj, s;
+
+  /* singly occupied sites with spin s and 1-s */
+  if(sgl0[0]==0 || sgl1[0]==0) {
+    *rejectFlag_ = 1; // TRUE
     return;
   }
+  k = gen_rand32()%(sgl0[0]+sgl1[0]);
+  if(k<sgl0[0]) {
+    s = 0;
+    ri = sgl0[1+k];
+    rj = sgl1[1+gen_rand32()%sgl1[0]];
+  } else {
+    s = 1;
+    ri = sgl1[1+k-sgl0[0]];
+    rj = sgl0[1+gen_rand32()%sgl0[0]];
+  }
 
-  do {
-    mi = gen_rand32()%Ne;
-    s = (genrand_real2()<0.5) ? 0 : 1;
-    ri = eleIdx[mi+s*Ne];
-  } while (eleCfg[ri+(1-s)*Nsite] != -1);
-  do {
-    mj = gen_rand32()%Ne;
-    t = 1-s;
-    rj = eleIdx[mj+t*Ne];
-  } while (eleCfg[rj+(1-t)*Nsite] != -1);
-
-  *mi_ = mi;
+  *mi_ = eleCfg[ri+s*Nsite];
   *ri_ = ri;
   *rj_ = rj;
   *s_ = s;
-  *rejectFlag_ = flag;
+  *rejectFlag_ = 0; // FALSE
 
   return;
 }
 
 /* The mi-th electron with spin s hops to site rj */
 void updateEleConfig(int mi, int ri, int rj, int s,
-                     int *eleIdx, int *eleCfg, int *eleNum) {
+                     int *eleIdx, int *eleCfg, int *eleNum, int *eleLst) {
   eleIdx[mi+s*Ne] = rj;
   eleCfg[ri+s*Nsite] = -1;
   eleCfg[rj+s*Nsite] = mi;
   eleNum[ri+s*Nsite] = 0;
   eleNum[rj+s*Nsite] = 1;
+  updateEleLst(eleLst,mi+s*Ne,ri,rj,eleNum);
   return;
 }
 
 void revertEleConfig(int mi, int ri, int rj, int s,
-                     int *eleIdx, int *eleCfg, int *eleNum) {
+                     int *eleIdx, int *eleCfg, int *eleNum, int *eleLst) {
   eleIdx[mi+s*Ne] = ri;
   eleCfg[ri+s*Nsite] = mi;
   eleCfg[rj+s*Nsite] = -1;
   eleNum[ri+s*Nsite] = 1;
   eleNum[rj+s*Nsite] = 0;
+  updateEleLst(eleLst,mi+s*Ne,rj,ri,eleNum);
+  return;
+}
+
+/* eleLst keeps the following sets of a walker so that makeCandidate_* are O(1). */
+/*   0: electrons on the conduction sites (msi=mi+s*Ne, or mi with fsz)         */
+/*   1: electrons on the local spin sites                                       */
+/*   2,3: conduction sites without the electron with spin 0,1                   */
+/*   4,5: sites occupied only by one electron with spin 0,1                     */
+/*   6: conduction sites occupied only by one electron                          */
+/* Each set is stored as {n, elm[u], pos[u]} with pos[x]=-1 for x not in it.     */
+int SizeEleLst() {
+  return 2*(1+2*Nsize) + 5*(1+2*Nsite);
+}
+
+int *getEleLstSet(const int *eleLst, const int k) {
+  if(k<2) return (int*)eleLst + k*(1+2*Nsize);
+  return (int*)eleLst + 2*(1+2*Nsize) + (k-2)*(1+2*Nsite);
+}
+
+/* add x to the set (flag=1) or remove it (flag=0) */
+static void setEleLst(int *set, const int u, const int x, const int flag) {
+  int *elm = set+1;
+  int *pos = set+1+u;
+  int p=pos[x], y;
+
+  if(flag) {
+    if(p<0) {
+      pos[x] = set[0];
+      elm[set[0]] = x;
+      set[0]++;
+    }
+  } else if(p>=0) {
+    set[0]--;
+    y = elm[set[0]];
+    elm[p] = y;
+    pos[y] = p;
+    pos[x] = -1;
+  }
+  return;
+}
+
+static void updateEleLstSite(int *eleLst, const int ri, const int *eleNum) {
+  const int n0=eleNum[ri], n1=eleNum[ri+Nsite];
+  const int cond=(LocSpn[ri]!=1);
+
+  setEleLst(getEleLstSet(eleLst,2), Nsite, ri, cond && n0==0);
+  setEleLst(getEleLstSet(eleLst,3), Nsite, ri, cond && n1==0);
+  setEleLst(getEleLstSet(eleLst,4), Nsite, ri, n0==1 && n1==0);
+  setEleLst(getEleLstSet(eleLst,5), Nsite, ri, n0==0 && n1==1);
+  setEleLst(getEleLstSet(eleLst,6), Nsite, ri, cond && n0+n1==1);
+  return;
+}
+
+static void updateEleLstEle(int *eleLst, const int msi, const int ri) {
+  setEleLst(getEleLstSet(eleLst,0), Nsize, msi, LocSpn[ri]!=1);
+  setEleLst(getEleLstSet(eleLst,1), Nsize, msi, LocSpn[ri]==1);
+  return;
+}
+
+/* make eleLst from scratch; eleIdx[msi] is the site of the msi-th electron */
+void makeEleLst(int *eleLst, const int *eleIdx, const int *eleNum) {
+  const int n=SizeEleLst();
+  int k,msi,ri;
+
+  for(k=0;k<n;k++) eleLst[k] = -1;
+  for(k=0;k<7;k++) getEleLstSet(eleLst,k)[0] = 0;
+
+  for(msi=0;msi<Nsize;msi++) updateEleLstEle(eleLst,msi,eleIdx[msi]);
+  for(ri=0;ri<Nsite;ri++) updateEleLstSite(eleLst,ri,eleNum);
+  return;
+}
+
+/* the msi-th electron has hopped from ri to rj and eleNum is updated */
+void updateEleLst(int *eleLst, const int msi, const int ri, const int rj, const int *eleNum) {
+  updateEleLstSite(eleLst,ri,eleNum);
+  if(rj!=ri) updateEleLstSite(eleLst,rj,eleNum);
+  updateEleLstEle(eleLst,msi,rj);
   return;
 }
 
@@ -601,7 +1073,7 @@ void VMC_BF_MakeSample(MPI_Comm comm)
   int projBFCntNew[16 * Nsite * Nrange]; // For BackFlow
   int msaTmp[NQPFull * Nsite], icount[NQPFull]; // For BackFlow
   double complex pfMNew[NQPFull];
-  double x, w; // TBC x will be complex number
+  double x, w, qRatio; // TBC x will be complex number
 
   int qpStart, qpEnd;
   int rejectFlag;
@@ -630,6 +1102,7 @@ void VMC_BF_MakeSample(MPI_Comm comm)
     logIpOld = CalculateLogIP_fcmp(PfM, qpStart, qpEnd, comm);
     BurnFlag = 0;
   }
+  makeEleLst(TmpEleLst,TmpEleIdx,TmpEleNum);
   StopTimer(30);
 
   nOutStep = (BurnFlag == 0) ? NVMCWarmUp + NVMCSample : NVMCSample + 1;
@@ -646,8 +1119,8 @@ void VMC_BF_MakeSample(MPI_Comm comm)
         Counter[0]++;
 
         StartTimer(31);
-        makeCandidate_hopping(&mi, &ri, &rj, &s, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg);
+        makeCandidate_hopping(&mi, &ri, &rj, &s, &rejectFlag, &qRatio,
+                              TmpEleIdx, TmpEleLst);
         StopTimer(31);
 
         if (rejectFlag) continue;
@@ -655,7 +1128,7 @@ void VMC_BF_MakeSample(MPI_Comm comm)
         StartTimer(32);
         StartTimer(60);
         /* The mi-th electron with spin s hops to site rj */
-        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
+        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
         UpdateProjCnt(ri, rj, s, projCntNew, TmpEleProjCnt, TmpEleNum);
         MakeProjBFCnt(projBFCntNew, TmpEleNum);
         StopTimer(60);
@@ -677,7 +1150,7 @@ void VMC_BF_MakeSample(MPI_Comm comm)
 
         /* Metroplis */
         x = LogProjRatio(projCntNew, TmpEleProjCnt);
-        w = exp(2.0 * (x + (logIpNew - logIpOld)));
+        w = qRatio * exp(2.0 * (x + (logIpNew - logIpOld)));
         if (!isfinite(w)) w = -1.0; /* should be rejected */
 
         if (w > genrand_real2()) { /* accept */
@@ -694,7 +1167,7 @@ void VMC_BF_MakeSample(MPI_Comm comm)
           nAccept++;
           Counter[1]++;
         } else { /* reject */
-          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
+          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
           //TODO: Add Timer
           UpdateSlaterElmBF_fcmp(mi, rj, ri, s, TmpEleCfg, TmpEleNum, TmpEleProjBFCnt, msaTmp, icount,
                                  SlaterElmBF);
@@ -706,7 +1179,7 @@ void VMC_BF_MakeSample(MPI_Comm comm)
 
         StartTimer(31);
         makeCandidate_exchange(&mi, &ri, &rj, &s, &rejectFlag,
-                               TmpEleIdx, TmpEleCfg, TmpEleNum);
+                               TmpEleIdx, TmpEleCfg, TmpEleLst);
         StopTimer(31);
 
         if (rejectFlag) continue;
@@ -719,10 +1192,10 @@ void VMC_BF_MakeSample(MPI_Comm comm)
         mj = TmpEleCfg[rj + t * Nsite];
 
         /* The mi-th electron with spin s hops to rj */
-        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
+        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
         UpdateProjCnt(ri, rj, s, projCntNew, TmpEleProjCnt, TmpEleNum);
         /* The mj-th electron with spin t hops to ri */
-        updateEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum);
+        updateEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
         UpdateProjCnt(rj, ri, t, projCntNew, projCntNew, TmpEleNum);
 
         StopTimer(65);
@@ -752,8 +1225,8 @@ void VMC_BF_MakeSample(MPI_Comm comm)
           nAccept++;
           Counter[3]++;
         } else { /* reject */
-          revertEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum);
-          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
+          revertEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
+          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
         }
         StopTimer(33);
       }
@@ -902,29 +1375,6 @@ void saveEleConfigBF(const int sample, const double logIp,
   x = LogProjVal(eleProjCnt);
   logSqPfFullSlater[sample] = 2.0 * (x + logIp);
 
-  /*
-  if (NStoreM != 0) {
-    offset = sample * nQPFull * nsize * nsize;
-#pragma loop noalias
-    for (i = 0; i < nQPFull * nsize * nsize; i++) InvM_Store[offset + i] = InvM[i];
-    offset = sample * nQPFull;
-#pragma loop noalias
-    for (i = 0; i < nQPFull; i++) PfM_Store[offset + i] = PfM[i];
-    offset = sample * nsite2 * nsite2 * NQPFull;
-#pragma loop noalias
-    for (i = 0; i < nsite2 * nsite2 * nQPFull; i++) {
-      SmpSltElmBF_real[offset + i] = SlaterElmBF_real[i];
-    }
-    offset = sample * NQPFull * nsite * nsite;
-#pragma loop noalias
-    for (i = 0; i < nsite; i++) {
-      for (j = 0; j < nsite; j++) {
-        SmpEta[offset + i * nsite + j] = eta[i][j];
-        SmpEtaFlag[offset + i * nsite + j] = etaFlag[i][j];
-      }
-    }
-  }
-  */
   return;
 }
 #endif
@@ -81,8 +81,6 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
 
 #ifdef _pf_block_update
   // TODO: Compute from qpStart to qpEnd to support loop splitting.
-  void *pfOrbital[NQPFull];
-  void *pfUpdator[NQPFull];
   // Read block size from input.
   const char *optBlockSize = getenv("VMC_BLOCK_UPDATE_SIZE");
   if (optBlockSize)
@@ -95,13 +93,7 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
       NBlockUpdateSize = 20;
 
   // Initialize with free spin configuration.
-  updated_tdi_v_init_z(NQPFull, Nsite, Nsite2, Nsize,
-                       SlaterElm, Nsite2*Nsite2,
-                       InvM, Nsize*Nsize,
-                       TmpEleIdx, TmpEleSpn,
-                       NBlockUpdateSize,
-                       pfUpdator, pfOrbital);
-  updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+  InitPfUpdator_fcmp(TmpEleIdx, TmpEleSpn);
 #else
   CalculateMAll_fsz(TmpEleIdx,TmpEleSpn,qpStart,qpEnd);
 #endif
@@ -116,15 +108,8 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
                       qpStart,qpEnd,comm);
 
 #ifdef _pf_block_update
-    // Clear and reinitialize.
-    updated_tdi_v_free_z(NQPFull, pfUpdator, pfOrbital);
-    updated_tdi_v_init_z(NQPFull, Nsite, Nsite2, Nsize,
-                         SlaterElm, Nsite2*Nsite2,
-                         InvM, Nsize*Nsize,
-                         TmpEleIdx, TmpEleSpn,
-                         NBlockUpdateSize,
-                         pfUpdator, pfOrbital);
-    updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+    // Reinitialize in place.
+    InitPfUpdator_fcmp(TmpEleIdx, TmpEleSpn);
 #else
     CalculateMAll_fsz(TmpEleIdx,TmpEleSpn,qpStart,qpEnd);
 #endif
@@ -134,6 +119,7 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
     logIpOld = CalculateLogIP_fcmp(PfM,qpStart,qpEnd,comm);
     BurnFlag = 0;
   }
+  makeEleLst(TmpEleLst,TmpEleIdx,TmpEleNum);
   StopTimer(30);
 
   nOutStep = (BurnFlag==0) ? NVMCWarmUp+NVMCSample : NVMCSample+1;
@@ -165,17 +151,17 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
             flag_hop = 1;
             Counter[0]++;
             makeCandidate_hopping_fsz(&mi, &ri, &rj, &s,&t, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg,TmpEleNum,TmpEleSpn);
+                              TmpEleIdx, TmpEleSpn, TmpEleLst);
           }else{
             Counter[4]++;
             makeCandidate_LocalSpinFlip_conduction(&mi, &ri, &rj, &s,&t, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg,TmpEleNum,TmpEleSpn);
+                              TmpEleIdx, TmpEleCfg, TmpEleLst);
           } 
         }else{ //csz : t=s
           flag_hop = 1;
           Counter[0]++;
           makeCandidate_hopping_csz(&mi, &ri, &rj, &s,&t, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg,TmpEleNum,TmpEleSpn);
+                              TmpEleIdx, TmpEleSpn, TmpEleLst);
         } 
         StopTimer(31);
 
@@ -184,7 +170,7 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
         StartTimer(32);
         StartTimer(60);
         /* The mi-th electron with spin s hops to site rj with t */
-        updateEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+        updateEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         if(s==t){
           UpdateProjCnt(ri,rj,s,projCntNew,TmpEleProjCnt,TmpEleNum);
         }else{
@@ -194,8 +180,8 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
 
         StartTimer(61);
 #ifdef _pf_block_update
-        updated_tdi_v_push_z(NQPFull, rj+t*Nsite, mi, 1, pfUpdator);
-        updated_tdi_v_get_pfa_z(NQPFull, pfMNew, pfUpdator);
+        updated_tdi_v_push_z(NQPFull, rj+t*Nsite, mi, 1, PfUpdator);
+        updated_tdi_v_get_pfa_z(NQPFull, pfMNew, PfUpdator);
 #else
         CalculateNewPfM2_fsz(mi,t,pfMNew,TmpEleIdx,TmpEleSpn,qpStart,qpEnd); // fsz: s->t 
 #endif
@@ -216,7 +202,7 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
           StartTimer(63);
 #ifdef _pf_block_update
           // Inv already updated. Only need to get PfM again.
-          updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+          updated_tdi_v_get_pfa_z(NQPFull, PfM, PfUpdator);
 #else
           // UpdateMAll will change SlaterElm, InvM (including PfM)
           UpdateMAll_fsz(mi,t,TmpEleIdx,TmpEleSpn,qpStart,qpEnd); // fsz : s->t
@@ -233,9 +219,9 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
           }
         } else { /* reject */ //(ri,s) <- (rj,t)
 #ifdef _pf_block_update
-          updated_tdi_v_pop_z(NQPFull, 0, pfUpdator);
+          updated_tdi_v_pop_z(NQPFull, 0, PfUpdator);
 #endif
-          revertEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+          revertEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         }
         StopTimer(32);
       } else if(updateType==EXCHANGE) { /* exchange */
@@ -243,7 +229,7 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
 
         StartTimer(31);
         makeCandidate_exchange_fsz(&mi, &ri, &rj, &s, &rejectFlag,
-                               TmpEleIdx, TmpEleCfg, TmpEleNum,TmpEleSpn);
+                               TmpEleIdx, TmpEleCfg, TmpEleLst);
         StopTimer(31);
         if(rejectFlag) continue;
 
@@ -255,10 +241,10 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
         mj = TmpEleCfg[rj+t*Nsite];
 
         /* The mi-th electron with spin s hops to rj */
-        updateEleConfig_fsz(mi,ri,rj,s,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+        updateEleConfig_fsz(mi,ri,rj,s,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         UpdateProjCnt(ri,rj,s,projCntNew,TmpEleProjCnt,TmpEleNum);
         /* The mj-th electron with spin t hops to ri */
-        updateEleConfig_fsz(mj,rj,ri,t,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+        updateEleConfig_fsz(mj,rj,ri,t,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         UpdateProjCnt(rj,ri,t,projCntNew,projCntNew,TmpEleNum);
 
         StopTimer(65);
@@ -268,8 +254,8 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
         updated_tdi_v_push_pair_z(NQPFull,
                                   rj+s*Nsite, mi,
                                   ri+t*Nsite, mj,
-                                  1, pfUpdator);
-        updated_tdi_v_get_pfa_z(NQPFull, pfMNew, pfUpdator);
+                                  1, PfUpdator);
+        updated_tdi_v_get_pfa_z(NQPFull, pfMNew, PfUpdator);
 #else
         CalculateNewPfMTwo2_fsz(mi, s, mj, t, pfMNew, TmpEleIdx,TmpEleSpn, qpStart, qpEnd);
 #endif
@@ -290,7 +276,7 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
           StartTimer(68);
 #ifdef _pf_block_update
           // Inv already updated. Only need to get PfM again.
-          updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+          updated_tdi_v_get_pfa_z(NQPFull, PfM, PfUpdator);
 #else
           UpdateMAllTwo_fsz(mi, s, mj, t, ri, rj, TmpEleIdx,TmpEleSpn,qpStart,qpEnd);
 #endif
@@ -302,11 +288,11 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
           Counter[3]++;
         } else { /* reject */
 #ifdef _pf_block_update
-          updated_tdi_v_pop_z(NQPFull, 0, pfUpdator);
-          updated_tdi_v_pop_z(NQPFull, 0, pfUpdator);
+          updated_tdi_v_pop_z(NQPFull, 0, PfUpdator);
+          updated_tdi_v_pop_z(NQPFull, 0, PfUpdator);
 #endif
-          revertEleConfig_fsz(mj,rj,ri,t,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
-          revertEleConfig_fsz(mi,ri,rj,s,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+          revertEleConfig_fsz(mj,rj,ri,t,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
+          revertEleConfig_fsz(mi,ri,rj,s,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         }
         StopTimer(33);
       }else if (updateType==LOCALSPINFLIP){
@@ -314,7 +300,7 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
 
         StartTimer(31);
         makeCandidate_LocalSpinFlip_localspin(&mi, &ri, &rj, &s,&t, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg,TmpEleNum,TmpEleSpn);
+                              TmpEleIdx, TmpEleSpn, TmpEleLst);
         StopTimer(31);
 
         if(rejectFlag) continue; 
@@ -324,14 +310,14 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
         /* The mi-th electron with spin s hops to site rj with t */
         // note we assume t=1-s,rj = ri
         //
-        updateEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+        updateEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         UpdateProjCnt_fsz(ri,rj,s,t,projCntNew,TmpEleProjCnt,TmpEleNum);
         StopTimer(600);
 
         StartTimer(601);
 #ifdef _pf_block_update
-        updated_tdi_v_push_z(NQPFull, rj+t*Nsite, mi, 1, pfUpdator);
-        updated_tdi_v_get_pfa_z(NQPFull, pfMNew, pfUpdator);
+        updated_tdi_v_push_z(NQPFull, rj+t*Nsite, mi, 1, PfUpdator);
+        updated_tdi_v_get_pfa_z(NQPFull, pfMNew, PfUpdator);
 #else
         CalculateNewPfM2_fsz(mi,t,pfMNew,TmpEleIdx,TmpEleSpn,qpStart,qpEnd); // fsz: s->t 
 #endif
@@ -357,7 +343,7 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
           StartTimer(603);
 #ifdef _pf_block_update
           // Inv already updated. Only need to get PfM again.
-          updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+          updated_tdi_v_get_pfa_z(NQPFull, PfM, PfUpdator);
 #else
           // UpdateMAll will change SlaterElm, InvM (including PfM)
           UpdateMAll_fsz(mi,t,TmpEleIdx,TmpEleSpn,qpStart,qpEnd); // fsz : s->t
@@ -370,9 +356,9 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
           Counter[5]++;
         } else { /* reject */ //(ri,s) <- (rj,t)
 #ifdef _pf_block_update
-          updated_tdi_v_pop_z(NQPFull, 0, pfUpdator);
+          updated_tdi_v_pop_z(NQPFull, 0, PfUpdator);
 #endif
-          revertEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+          revertEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         }
         StopTimer(36);
       }
@@ -381,15 +367,8 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
         // Recalculate PfM and InvM.
         StartTimer(34);
 #ifdef _pf_block_update
-        // Clear and reinitialize.
-        updated_tdi_v_free_z(NQPFull, pfUpdator, pfOrbital);
-        updated_tdi_v_init_z(NQPFull, Nsite, Nsite2, Nsize,
-                             SlaterElm, Nsite2*Nsite2,
-                             InvM, Nsize*Nsize,
-                             TmpEleIdx, TmpEleSpn,
-                             NBlockUpdateSize,
-                             pfUpdator, pfOrbital);
-        updated_tdi_v_get_pfa_z(NQPFull, PfM, pfUpdator);
+        // Reinitialize in place.
+        InitPfUpdator_fcmp(TmpEleIdx, TmpEleSpn);
 #else
         CalculateMAll_fsz(TmpEleIdx,TmpEleSpn,qpStart,qpEnd);
 #endif
@@ -424,11 +403,6 @@ void VMCMakeSample_fsz(MPI_Comm comm) {
 #endif
   BurnFlag=1;
 
-#ifdef _pf_block_update
-  // Free-up updator space.
-  updated_tdi_v_free_z(NQPFull, pfUpdator, pfOrbital);
-#endif
-
   return;
 }
 
@@ -592,73 +566,70 @@ void saveEleConfig_fsz(const int sample, const double complex logIp,
 
 // mi (ri,s) -> mi (rj,t)
 void makeCandidate_hopping_fsz(int *mi_, int *ri_, int *rj_, int *s_,int *t_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg,const int *eleNum,const int *eleSpn) {
-  const int icnt_max = Nsite*Nsite;
-  int icnt;
-  int mi, ri, rj, s, flag;
+                           const int *eleIdx, const int *eleSpn, const int *eleLst) {
+  const int *itn  = eleLst;
+  const int *emp0 = getEleLstSet(eleLst,2);
+  const int *emp1 = getEleLstSet(eleLst,3);
+  int mi, ri, rj, s, k;
   int t; //fsz
 
-  flag = 0; // FALSE
-  do {
-    mi = gen_rand32()%Nsize;
-    s  = eleSpn[mi] ; //fsz 
-    //t  = (genrand_real2()<0.5) ? s : 1-s; //fsz
-    ri = eleIdx[mi];  //fsz
-  } while (LocSpn[ri] == 1);
-
-  icnt = 0;
-  do {
-    rj = gen_rand32()%Nsite;
-    t  = (genrand_real2()<0.5) ? 0 : 1; //fsz
-    if(icnt> icnt_max){
-      flag = 1; // TRUE
-      break;
-    }
-    icnt+=1;
-  } while (eleCfg[rj+t*Nsite] != -1 || LocSpn[rj]==1);
+  /* an electron on the conduction sites and an empty conduction site with any spin */
+  if(itn[0]==0 || emp0[0]+emp1[0]==0) {
+    *rejectFlag_ = 1; // TRUE
+    return;
+  }
+  mi = itn[1+gen_rand32()%itn[0]];
+  s  = eleSpn[mi] ; //fsz 
+  ri = eleIdx[mi];  //fsz
+
+  k = gen_rand32()%(emp0[0]+emp1[0]);
+  if(k<emp0[0]) {
+    rj = emp0[1+k];
+    t  = 0;
+  } else {
+    rj = emp1[1+k-emp0[0]];
+    t  = 1;
+  }
 
   *mi_ = mi;
   *ri_ = ri;
   *rj_ = rj;
   *s_  = s;
   *t_  = t;
-  *rejectFlag_ = flag;
+  *rejectFlag_ = 0; // FALSE
 
   return;
 }
 // mi (ri,s) -> mi (rj,s)
 void makeCandidate_hopping_csz(int *mi_, int *ri_, int *rj_, int *s_,int *t_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg,const int *eleNum,const int *eleSpn) {
-  const int icnt_max = Nsite*Nsite;
-  int icnt;
-  int mi, ri, rj, s, flag;
+                           const int *eleIdx, const int *eleSpn, const int *eleLst) {
+  const int *itn = eleLst;
+  const int *emp;
+  int mi, ri, rj, s;
   int t; //fsz
 
-  flag = 0; // FALSE
-  do {
-    mi = gen_rand32()%Nsize;
-    s  = eleSpn[mi] ; //fsz 
-    //t  = (genrand_real2()<0.5) ? s : 1-s; //fsz
-    t  = s;//csz
-    ri = eleIdx[mi];  //fsz
-  } while (LocSpn[ri] == 1);
-
-  icnt = 0;
-  do {
-    rj = gen_rand32()%Nsite;
-    if(icnt> icnt_max){
-      flag = 1; // TRUE
-      break;
-    }
-    icnt+=1;
-  } while (eleCfg[rj+t*Nsite] != -1 || LocSpn[rj]==1);
+  if(itn[0]==0) {
+    *rejectFlag_ = 1; // TRUE
+    return;
+  }
+  mi = itn[1+gen_rand32()%itn[0]];
+  s  = eleSpn[mi] ; //fsz 
+  t  = s;//csz
+  ri = eleIdx[mi];  //fsz
+
+  emp = getEleLstSet(eleLst,2+t);
+  if(emp[0]==0) {
+    *rejectFlag_ = 1; // TRUE
+    return;
+  }
+  rj = emp[1+gen_rand32()%emp[0]];
 
   *mi_ = mi;
   *ri_ = ri;
   *rj_ = rj;
   *s_  = s;
   *t_  = t;
-  *rejectFlag_ = flag;
+  *rejectFlag_ = 0; // FALSE
 
   return;
 }
@@ -668,121 +639,63 @@ void makeCandidate_hopping_csz(int *mi_, int *ri_, int *rj_, int *s_,int *t_, in
 
 /* The mi-th electron with spin s exchanges with the electron on site rj with spin 1-s */
 void makeCandidate_exchange_fsz(int *mi_, int *ri_, int *rj_, int *s_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg, const int *eleNum,const int *eleSpn) {
-  int mi, mj, ri, rj, s, t, flag,spn_0,spn_1;
-
-// DEBUG!!!!!!!!!!!!!!!!!!!!!
-/*
-  for(mi=0;mi<Nsize;mi++){
-    printf("XDEBUG: mi=%d spn=%d idx=%d\n",mi,eleSpn[mi],eleIdx[mi]);
-  }
-  for(ri=0;ri<Nsite;ri++){
-    printf("XDEBUG: ri=%d up=%d down=%d\n",ri,eleNum[ri],eleNum[ri+Nsite]);
-  }
-*/
-// DEBUG!!!!!!!!!!!!!!!!!!!!!
-
-  flag = 1; // TRUE
-  spn_0 = 0;//
-  spn_1 = 0;//
-  for(ri=0;ri<Nsite;ri++){
-    if((eleNum[ri]+eleNum[ri+Nsite]) == 1  ){// up or down exists
-      if(spn_0==0){
-        spn_0  = 2*eleNum[ri]-1;// 0 (up)-> 1, 1(down)-> -1
-      }else{
-        spn_1 =  2*eleNum[ri]-1;// 0 (up)-> 1, 1(down)-> -1
-      }
-      //printf("ri =%d %d %d : spn0 %d spn1 %d\n",ri,eleNum[ri],eleNum[ri+Nsite],spn_0,spn_1);
-      if(spn_0*spn_1<0){
-        flag = 0; // FALSE
-        break;
-      }
-    }
-  }
-  //printf("flag= %d spn_0=%d spn_1=%d \n",flag,spn_0,spn_1);
-  if(flag) {
-    *rejectFlag_ = flag;
-    return;
-  }
-
-  do {
-    mi = gen_rand32()%Nsize;//fsz
-    s  = eleSpn[mi];// fsz //s = (genrand_real2()<0.5) ? 0 : 1;
-    ri = eleIdx[mi]; //fsz
-  } while (eleCfg[ri+(1-s)*Nsite] != -1);
-  t = 1-s;
-  do {
-    mj = gen_rand32()%Nsize; //fsz
-    rj = eleIdx[mj]; //fsz
-  } while (eleCfg[rj+(1-t)*Nsite] != -1 || eleSpn[mj]!=t); // is it OK ?
-
-  *mi_ = mi;
-  *ri_ = ri;
-  *rj_ = rj;
-  *s_ = s;
-  *rejectFlag_ = flag;
+                           const int *eleIdx, const int *eleCfg, const int *eleLst) {
+  /* the same as the Sz conserved case since eleCfg keeps mi */
+  makeCandidate_exchange(mi_,ri_,rj_,s_,rejectFlag_,eleIdx,eleCfg,eleLst);
   return;
 }
 //
 // mi (ri,s) -> mi (ri,1-s) // local spin flip for conduction
 void makeCandidate_LocalSpinFlip_localspin(int *mi_, int *ri_, int *rj_, int *s_,int *t_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg,const int *eleNum,const int *eleSpn) {
-  int mi, ri, rj, s, flag;
+                           const int *eleIdx, const int *eleSpn, const int *eleLst) {
+  const int *loc = getEleLstSet(eleLst,1);
+  int mi, ri, rj, s;
   int t; //fsz
 
-  flag = 0; // FALSE
-  do {
-    mi = gen_rand32()%Nsize;
-    s  = eleSpn[mi] ; //fsz 
-    t  = 1-s;
-    //t  = (genrand_real2()<0.5) ? s : 1-s; //fsz
-    ri = eleIdx[mi];  //fsz
-    rj = ri;  //fsz // note ! we assume local spin
-  } while (LocSpn[ri] == 0);
-
-  //if(t==s) flag=1;
+  if(loc[0]==0) {
+    *rejectFlag_ = 1; // TRUE
+    return;
+  }
+  mi = loc[1+gen_rand32()%loc[0]];
+  s  = eleSpn[mi] ; //fsz 
+  t  = 1-s;
+  ri = eleIdx[mi];  //fsz
+  rj = ri;  //fsz // note ! we assume local spin
 
   *mi_ = mi;
   *ri_ = ri;
   *rj_ = rj;
   *s_  = s;
   *t_  = t;
-  *rejectFlag_ = flag;
+  *rejectFlag_ = 0; // FALSE
 
   return;
 }
 //
 // mi (ri,s) -> mi (ri,1-s) // local spin flip for conduction electrons
 void makeCandidate_LocalSpinFlip_conduction(int *mi_, int *ri_, int *rj_, int *s_,int *t_, int *rejectFlag_,
-                           const int *eleIdx, const int *eleCfg,const int *eleNum,const int *eleSpn) {
-  const int icnt_max = Nsite*Nsite;
-  int icnt=0;
-  int mi, ri, rj, s, flag;
+                           const int *eleIdx, const int *eleCfg, const int *eleLst) {
+  const int *sgl = getEleLstSet(eleLst,6);
+  int mi, ri, rj, s;
   int t; //fsz
 
-  flag = 0; // FALSE
-  do {
-    mi = gen_rand32()%Nsize;
-    s  = eleSpn[mi] ; //fsz 
-    t  = 1-s;
-    //t  = (genrand_real2()<0.5) ? s : 1-s; //fsz
-    ri = eleIdx[mi];  //fsz
-    rj = ri;  //fsz // note ! we assume local spin
-    if(icnt> icnt_max){ // all doublons can not be accepted
-      flag = 1; // TRUE
-      break;
-    }
-    icnt+=1;
-  } while (LocSpn[ri] == 1 || eleCfg[ri+t*Nsite] != -1);
-
-  //if(t==s) flag=1;
+  /* singly occupied conduction sites; all doublons can not be accepted */
+  if(sgl[0]==0) {
+    *rejectFlag_ = 1; // TRUE
+    return;
+  }
+  ri = sgl[1+gen_rand32()%sgl[0]];
+  s  = (eleCfg[ri] != -1) ? 0 : 1;
+  t  = 1-s;
+  mi = eleCfg[ri+s*Nsite];
+  rj = ri;  //fsz
 
   *mi_ = mi;
   *ri_ = ri;
   *rj_ = rj;
   *s_  = s;
   *t_  = t;
-  *rejectFlag_ = flag;
+  *rejectFlag_ = 0; // FALSE
 
   return;
 }
@@ -793,7 +706,7 @@ void makeCandidate_LocalSpinFlip_conduction(int *mi_, int *ri_, int *rj_, int *s
 
 /* The mi-th electron with spin s hops to site rj and t */
 void updateEleConfig_fsz(int mi, int org_r, int dst_r, int org_spn,int dst_spn,
-                     int *eleIdx, int *eleCfg, int *eleNum, int *eleSpn) {
+                     int *eleIdx, int *eleCfg, int *eleNum, int *eleSpn, int *eleLst) {
   eleIdx[mi]         = dst_r; 
   eleSpn[mi]         = dst_spn;  //fsz 
 //
@@ -802,11 +715,12 @@ void updateEleConfig_fsz(int mi, int org_r, int dst_r, int org_spn,int dst_spn,
 //
   eleNum[org_r+org_spn*Nsite] = 0;
   eleNum[dst_r+dst_spn*Nsite] = 1;
+  updateEleLst(eleLst,mi,org_r,dst_r,eleNum);
   return;
 }
 
 void revertEleConfig_fsz(int mi, int org_r, int dst_r, int org_spn,int dst_spn,
-                     int *eleIdx, int *eleCfg, int *eleNum,int *eleSpn) {
+                     int *eleIdx, int *eleCfg, int *eleNum,int *eleSpn, int *eleLst) {
   eleIdx[mi]         = org_r; 
   eleSpn[mi]         = org_spn; //fsz 
 //
@@ -815,6 +729,7 @@ void revertEleConfig_fsz(int mi, int org_r, int dst_r, int org_spn,int dst_spn,
 //
   eleNum[org_r+org_spn*Nsite] = 1;
   eleNum[dst_r+dst_spn*Nsite] = 0;
+  updateEleLst(eleLst,mi,dst_r,org_r,eleNum);
   return;
 }
 
@@ -77,8 +77,6 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
 
 #ifdef _pf_block_update
   // TODO: Compute from qpStart to qpEnd to support loop splitting.
-  void *pfOrbital[NQPFull];
-  void *pfUpdator[NQPFull];
   // TODO: Make it input parameter.
   if (NExUpdatePath == 0)
     NBlockUpdateSize = 4;
@@ -86,13 +84,7 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
     NBlockUpdateSize = 20;
 
   // Initialize with free spin configuration.
-  updated_tdi_v_init_d(NQPFull, Nsite, Nsite2, Nsize,
-                       SlaterElm_real, Nsite2*Nsite2,
-                       InvM_real, Nsize*Nsize,
-                       TmpEleIdx, TmpEleSpn,
-                       NBlockUpdateSize,
-                       pfUpdator, pfOrbital);
-  updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+  InitPfUpdator_real(TmpEleIdx, TmpEleSpn);
 #else
   CalculateMAll_fsz_real(TmpEleIdx,TmpEleSpn,qpStart,qpEnd);
 #endif
@@ -107,15 +99,8 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
                       qpStart,qpEnd,comm);
 
 #ifdef _pf_block_update
-    // Clear and reinitialize.
-    updated_tdi_v_free_d(NQPFull, pfUpdator, pfOrbital);
-    updated_tdi_v_init_d(NQPFull, Nsite, Nsite2, Nsize,
-                         SlaterElm_real, Nsite2*Nsite2,
-                         InvM_real, Nsize*Nsize,
-                         TmpEleIdx, TmpEleSpn,
-                         NBlockUpdateSize,
-                         pfUpdator, pfOrbital);
-    updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+    // Reinitialize in place.
+    InitPfUpdator_real(TmpEleIdx, TmpEleSpn);
 #else
     CalculateMAll_fsz_real(TmpEleIdx,TmpEleSpn,qpStart,qpEnd);
 #endif
@@ -125,6 +110,7 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
     logIpOld = CalculateLogIP_real(PfM_real,qpStart,qpEnd,comm);
     BurnFlag = 0;
   }
+  makeEleLst(TmpEleLst,TmpEleIdx,TmpEleNum);
   StopTimer(30);
 
   nOutStep = (BurnFlag==0) ? NVMCWarmUp+NVMCSample : NVMCSample+1;
@@ -156,17 +142,17 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
             flag_hop = 1;
             Counter[0]++;
             makeCandidate_hopping_fsz(&mi, &ri, &rj, &s,&t, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg,TmpEleNum,TmpEleSpn);
+                              TmpEleIdx, TmpEleSpn, TmpEleLst);
           }else{
             Counter[4]++;
             makeCandidate_LocalSpinFlip_conduction(&mi, &ri, &rj, &s,&t, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg,TmpEleNum,TmpEleSpn);
+                              TmpEleIdx, TmpEleCfg, TmpEleLst);
           } 
         }else{ //csz : t=s
           flag_hop = 1;
           Counter[0]++;
           makeCandidate_hopping_csz(&mi, &ri, &rj, &s,&t, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg,TmpEleNum,TmpEleSpn);
+                              TmpEleIdx, TmpEleSpn, TmpEleLst);
         } 
         StopTimer(31);
 
@@ -175,7 +161,7 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
         StartTimer(32);
         StartTimer(60);
         /* The mi-th electron with spin s hops to site rj with t */
-        updateEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+        updateEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         if(s==t){
           UpdateProjCnt(ri,rj,s,projCntNew,TmpEleProjCnt,TmpEleNum);
         }else{
@@ -185,8 +171,8 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
 
         StartTimer(61);
 #ifdef _pf_block_update
-        updated_tdi_v_push_d(NQPFull, rj+t*Nsite, mi, 1, pfUpdator);
-        updated_tdi_v_get_pfa_d(NQPFull, pfMNew, pfUpdator);
+        updated_tdi_v_push_d(NQPFull, rj+t*Nsite, mi, 1, PfUpdator);
+        updated_tdi_v_get_pfa_d(NQPFull, pfMNew, PfUpdator);
 #else
         CalculateNewPfM2_fsz_real(mi,t,pfMNew,TmpEleIdx,TmpEleSpn,qpStart,qpEnd); // fsz: s->t 
 #endif
@@ -207,7 +193,7 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
           StartTimer(63);
 #ifdef _pf_block_update
           // Inv already updated. Only need to get PfM again.
-          updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+          updated_tdi_v_get_pfa_d(NQPFull, PfM_real, PfUpdator);
 #else
           // UpdateMAll will change SlaterElm, InvM (including PfM)
           UpdateMAll_fsz_real(mi,t,TmpEleIdx,TmpEleSpn,qpStart,qpEnd); // fsz : s->t
@@ -224,9 +210,9 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
           }
         } else { /* reject */ //(ri,s) <- (rj,t)
 #ifdef _pf_block_update
-          updated_tdi_v_pop_d(NQPFull, 0, pfUpdator);
+          updated_tdi_v_pop_d(NQPFull, 0, PfUpdator);
 #endif
-          revertEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+          revertEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         }
         StopTimer(32);
       } else if(updateType==EXCHANGE) { /* exchange */
@@ -234,7 +220,7 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
 
         StartTimer(31);
         makeCandidate_exchange_fsz(&mi, &ri, &rj, &s, &rejectFlag,
-                               TmpEleIdx, TmpEleCfg, TmpEleNum,TmpEleSpn);
+                               TmpEleIdx, TmpEleCfg, TmpEleLst);
         StopTimer(31);
         if(rejectFlag) continue;
 
@@ -246,10 +232,10 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
         mj = TmpEleCfg[rj+t*Nsite];
 
         /* The mi-th electron with spin s hops to rj */
-        updateEleConfig_fsz(mi,ri,rj,s,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+        updateEleConfig_fsz(mi,ri,rj,s,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         UpdateProjCnt(ri,rj,s,projCntNew,TmpEleProjCnt,TmpEleNum);
         /* The mj-th electron with spin t hops to ri */
-        updateEleConfig_fsz(mj,rj,ri,t,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+        updateEleConfig_fsz(mj,rj,ri,t,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         UpdateProjCnt(rj,ri,t,projCntNew,projCntNew,TmpEleNum);
 
         StopTimer(65);
@@ -259,8 +245,8 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
         updated_tdi_v_push_pair_d(NQPFull,
                                   rj+s*Nsite, mi,
                                   ri+t*Nsite, mj,
-                                  1, pfUpdator);
-        updated_tdi_v_get_pfa_d(NQPFull, pfMNew, pfUpdator);
+                                  1, PfUpdator);
+        updated_tdi_v_get_pfa_d(NQPFull, pfMNew, PfUpdator);
 #else
         CalculateNewPfMTwo2_fsz_real(mi, s, mj, t, pfMNew, TmpEleIdx,TmpEleSpn, qpStart, qpEnd);
 #endif
@@ -281,7 +267,7 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
           StartTimer(68);
 #ifdef _pf_block_update
           // Inv already updated. Only need to get PfM again.
-          updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+          updated_tdi_v_get_pfa_d(NQPFull, PfM_real, PfUpdator);
 #else
           UpdateMAllTwo_fsz_real(mi, s, mj, t, ri, rj, TmpEleIdx,TmpEleSpn,qpStart,qpEnd);
 #endif
@@ -293,11 +279,11 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
           Counter[3]++;
         } else { /* reject */
 #ifdef _pf_block_update
-          updated_tdi_v_pop_d(NQPFull, 0, pfUpdator);
-          updated_tdi_v_pop_d(NQPFull, 0, pfUpdator);
+          updated_tdi_v_pop_d(NQPFull, 0, PfUpdator);
+          updated_tdi_v_pop_d(NQPFull, 0, PfUpdator);
 #endif
-          revertEleConfig_fsz(mj,rj,ri,t,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
-          revertEleConfig_fsz(mi,ri,rj,s,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+          revertEleConfig_fsz(mj,rj,ri,t,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
+          revertEleConfig_fsz(mi,ri,rj,s,s,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         }
         StopTimer(33);
       }else if (updateType==LOCALSPINFLIP){
@@ -305,7 +291,7 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
 
         StartTimer(31);
         makeCandidate_LocalSpinFlip_localspin(&mi, &ri, &rj, &s,&t, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg,TmpEleNum,TmpEleSpn);
+                              TmpEleIdx, TmpEleSpn, TmpEleLst);
         StopTimer(31);
 
         if(rejectFlag) continue; 
@@ -315,14 +301,14 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
         /* The mi-th electron with spin s hops to site rj with t */
         // note we assume t=1-s,rj = ri
         //
-        updateEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+        updateEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         UpdateProjCnt_fsz(ri,rj,s,t,projCntNew,TmpEleProjCnt,TmpEleNum);
         StopTimer(600);
 
         StartTimer(601);
 #ifdef _pf_block_update
-        updated_tdi_v_push_d(NQPFull, rj+t*Nsite, mi, 1, pfUpdator);
-        updated_tdi_v_get_pfa_d(NQPFull, pfMNew, pfUpdator);
+        updated_tdi_v_push_d(NQPFull, rj+t*Nsite, mi, 1, PfUpdator);
+        updated_tdi_v_get_pfa_d(NQPFull, pfMNew, PfUpdator);
 #else
         CalculateNewPfM2_fsz_real(mi,t,pfMNew,TmpEleIdx,TmpEleSpn,qpStart,qpEnd); // fsz: s->t 
 #endif
@@ -343,7 +329,7 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
           StartTimer(603);
 #ifdef _pf_block_update
           // Inv already updated. Only need to get PfM again.
-          updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+          updated_tdi_v_get_pfa_d(NQPFull, PfM_real, PfUpdator);
 #else
           // UpdateMAll will change SlaterElm, InvM (including PfM)
           UpdateMAll_fsz_real(mi,t,TmpEleIdx,TmpEleSpn,qpStart,qpEnd); // fsz : s->t
@@ -356,9 +342,9 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
           Counter[5]++;
         } else { /* reject */ //(ri,s) <- (rj,t)
 #ifdef _pf_block_update
-          updated_tdi_v_pop_d(NQPFull, 0, pfUpdator);
+          updated_tdi_v_pop_d(NQPFull, 0, PfUpdator);
 #endif
-          revertEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn);
+          revertEleConfig_fsz(mi,ri,rj,s,t,TmpEleIdx,TmpEleCfg,TmpEleNum,TmpEleSpn,TmpEleLst);
         }
         StopTimer(36);
       }
@@ -367,15 +353,8 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
         // Recalculate PfM and InvM.
         StartTimer(34);
 #ifdef _pf_block_update
-        // Clear and reinitialize.
-        updated_tdi_v_free_d(NQPFull, pfUpdator, pfOrbital);
-        updated_tdi_v_init_d(NQPFull, Nsite, Nsite2, Nsize,
-                             SlaterElm_real, Nsite2*Nsite2,
-                             InvM_real, Nsize*Nsize,
-                             TmpEleIdx, TmpEleSpn,
-                             NBlockUpdateSize,
-                             pfUpdator, pfOrbital);
-        updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+        // Reinitialize in place.
+        InitPfUpdator_real(TmpEleIdx, TmpEleSpn);
 #else
         CalculateMAll_fsz_real(TmpEleIdx,TmpEleSpn,qpStart,qpEnd);
 #endif
@@ -410,11 +389,6 @@ void VMCMakeSample_fsz_real(MPI_Comm comm) {
 #endif
   BurnFlag=1;
 
-#ifdef _pf_block_update
-  // Free-up updator space.
-  updated_tdi_v_free_d(NQPFull, pfUpdator, pfOrbital);
-#endif
-
   return;
 }
 
@@ -36,12 +36,40 @@ which follows "The BSD 3-Clause License".
 #include "qp_real.h"
 #include "splitloop.h"
 #include "vmcmake.h"
+#include "vmccal.h"
 
 #ifdef _pf_block_update
 // Block-update extension.
 #include "../pfupdates/pf_interface.h"
 #endif
 
+#ifdef _pf_block_update
+/* Set up the engines for the configuration eleIdx and eleSpn and read PfM_real. */
+void InitPfUpdator_real(int *eleIdx, int *eleSpn) {
+  if(PfUpdatorType!=1) {
+    FreePfUpdator();
+    PfOrbital = (void**)malloc(sizeof(void*)*2*NQPFull);
+    PfUpdator = PfOrbital + NQPFull;
+    updated_tdi_v_init_d(NQPFull, Nsite, Nsite2, Nsize,
+                         SlaterElm_real, Nsite2*Nsite2,
+                         InvM_real, Nsize*Nsize,
+                         eleIdx, eleSpn,
+                         NBlockUpdateSize,
+                         PfUpdator, PfOrbital);
+    PfUpdatorType = 1;
+  } else {
+    updated_tdi_v_reinit_d(NQPFull, Nsite, Nsite2, Nsize,
+                           SlaterElm_real, Nsite2*Nsite2,
+                           InvM_real, Nsize*Nsize,
+                           eleIdx, eleSpn,
+                           NBlockUpdateSize,
+                           PfUpdator, PfOrbital);
+  }
+  updated_tdi_v_get_pfa_d(NQPFull, PfM_real, PfUpdator);
+  return;
+}
+#endif
+
 void VMCMakeSample_real(MPI_Comm comm) {
   int outStep, nOutStep;
   int inStep, nInStep;
@@ -52,30 +80,59 @@ void VMCMakeSample_real(MPI_Comm comm) {
 
   double logIpOld, logIpNew; /* logarithm of inner product <phi|L|x> */ // is this ok ? TBC
   int projCntNew[NProj];
+  int projDelta[4 * (2 * Nsite + 1)]; /* sparse change of projCnt for two hops */
+  int nDelta = 0;
   double pfMNew_real[NQPFull];
-  double x, w; // TBC x will be complex number
+  double x, w, qRatio; // TBC x will be complex number
 
   int qpStart, qpEnd;
+  int sampleStart, sampleEnd, nSample;
   int rejectFlag;
+  int inlineMeasure;
+  int delayUpdate;
+  int sparseProj;
   int rank, size;
   MPI_Comm_size(comm, &size);
   MPI_Comm_rank(comm, &rank);
 
+  if (IsMultiChain(comm)) {
+    VMCMakeSampleChain_real(comm);
+    return;
+  }
+
+  inlineMeasure = IsInlineMeasure(comm);
+  if (IsSplitChain(comm)) {
+    /* the own chain of this process */
+    SplitLoop(&sampleStart, &sampleEnd, NVMCSample, rank, size);
+    comm = MPI_COMM_SELF;
+    rank = 0;
+    size = 1;
+  } else {
+    sampleStart = 0;
+    sampleEnd = NVMCSample;
+  }
+  nSample = sampleEnd - sampleStart;
+
   SplitLoop(&qpStart, &qpEnd, NQPFull, rank, size);
 
+  delayUpdate = (NDelayUpdate > 0);
+  sparseProj = IsProjCntDelta();
+  if (inlineMeasure) {
+    StartTimer(24);
+    clearPhysQuantity();
+    StopTimer(24);
+  }
 
   StartTimer(30);
   if (BurnFlag == 0) {
-    makeInitialSample(TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleProjCnt,
-                      qpStart, qpEnd, comm);
+    makeInitialSample_real(TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleProjCnt,
+                           qpStart, qpEnd, comm);
   } else {
     copyFromBurnSample(TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleProjCnt);
   }
 
 #ifdef _pf_block_update
   // TODO: Compute from qpStart to qpEnd to support loop splitting.
-  void *pfOrbital[NQPFull];
-  void *pfUpdator[NQPFull];
   // Read block size from input.
   const char *optBlockSize = getenv("VMC_BLOCK_UPDATE_SIZE");
   if (optBlockSize)
@@ -91,13 +148,7 @@ void VMCMakeSample_real(MPI_Comm comm) {
   for (mi=0; mi<Ne;  mi++) EleSpn[mi] = 0;
   for (mi=Ne;mi<Ne*2;mi++) EleSpn[mi] = 1;
   // Initialize.
-  updated_tdi_v_init_d(NQPFull, Nsite, Nsite2, Nsize,
-                       SlaterElm_real, Nsite2*Nsite2,
-                       InvM_real, Nsize*Nsize,
-                       TmpEleIdx, EleSpn,
-                       NBlockUpdateSize,
-                       pfUpdator, pfOrbital);
-  updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+  InitPfUpdator_real(TmpEleIdx, EleSpn);
 #else
   CalculateMAll_real(TmpEleIdx, qpStart, qpEnd);
 #endif
@@ -106,18 +157,11 @@ void VMCMakeSample_real(MPI_Comm comm) {
 
   if (!isfinite(logIpOld)) {
     if (rank == 0) fprintf(stderr, "waring: VMCMakeSample remakeSample logIpOld=%e\n", creal(logIpOld)); //TBC
-    makeInitialSample(TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleProjCnt,
-                      qpStart, qpEnd, comm);
+    makeInitialSample_real(TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleProjCnt,
+                           qpStart, qpEnd, comm);
 #ifdef _pf_block_update
-    // Clear and reinitialize.
-    updated_tdi_v_free_d(NQPFull, pfUpdator, pfOrbital);
-    updated_tdi_v_init_d(NQPFull, Nsite, Nsite2, Nsize,
-                         SlaterElm_real, Nsite2*Nsite2,
-                         InvM_real, Nsize*Nsize,
-                         TmpEleIdx, EleSpn,
-                         NBlockUpdateSize,
-                         pfUpdator, pfOrbital);
-    updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+    // Reinitialize in place.
+    InitPfUpdator_real(TmpEleIdx, EleSpn);
 #else
     CalculateMAll_real(TmpEleIdx, qpStart, qpEnd);
 #endif
@@ -125,9 +169,10 @@ void VMCMakeSample_real(MPI_Comm comm) {
     logIpOld = CalculateLogIP_real(PfM_real, qpStart, qpEnd, comm);
     BurnFlag = 0;
   }
+  makeEleLst(TmpEleLst, TmpEleIdx, TmpEleNum);
   StopTimer(30);
 
-  nOutStep = (BurnFlag == 0) ? NVMCWarmUp + NVMCSample : NVMCSample + 1;
+  nOutStep = (BurnFlag == 0) ? NVMCWarmUp + nSample : nSample + 1;
   nInStep = NVMCInterval * Nsite;
 
   for (i = 0; i < Counter_max; i++) Counter[i] = 0;  /* reset counter */
@@ -141,8 +186,8 @@ void VMCMakeSample_real(MPI_Comm comm) {
         Counter[0]++;
 
         StartTimer(31);
-        makeCandidate_hopping(&mi, &ri, &rj, &s, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg);
+        makeCandidate_hopping(&mi, &ri, &rj, &s, &rejectFlag, &qRatio,
+                              TmpEleIdx, TmpEleLst);
         StopTimer(31);
 
         if (rejectFlag) continue;
@@ -150,17 +195,19 @@ void VMCMakeSample_real(MPI_Comm comm) {
         StartTimer(32);
         StartTimer(60);
         /* The mi-th electron with spin s hops to site rj */
-        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
-        UpdateProjCnt(ri, rj, s, projCntNew, TmpEleProjCnt, TmpEleNum);
+        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
+        if (sparseProj) nDelta = UpdateProjCntDelta(ri, rj, s, projDelta, 0, TmpEleNum);
+        else UpdateProjCnt(ri, rj, s, projCntNew, TmpEleProjCnt, TmpEleNum);
         StopTimer(60);
 
         StartTimer(61);
 #ifdef _pf_block_update
-        updated_tdi_v_push_d(NQPFull, rj+s*Nsite, mi+s*Ne, 1, pfUpdator);
-        updated_tdi_v_get_pfa_d(NQPFull, pfMNew_real, pfUpdator);
+        updated_tdi_v_push_d(NQPFull, rj+s*Nsite, mi+s*Ne, 1, PfUpdator);
+        updated_tdi_v_get_pfa_d(NQPFull, pfMNew_real, PfUpdator);
 #else
         //CalculateNewPfM2(mi,s,pfMNew,TmpEleIdx,qpStart,qpEnd);
-        CalculateNewPfM2_real(mi, s, pfMNew_real, TmpEleIdx, qpStart, qpEnd);
+        if (delayUpdate) CalculateNewPfMDelay_real(mi, s, pfMNew_real, TmpEleIdx, qpStart, qpEnd);
+        else CalculateNewPfM2_real(mi, s, pfMNew_real, TmpEleIdx, qpStart, qpEnd);
 #endif
         //printf("DEBUG: out %d in %d pfMNew=%lf \n",outStep,inStep,creal(pfMNew[0]));
         StopTimer(61);
@@ -172,33 +219,36 @@ void VMCMakeSample_real(MPI_Comm comm) {
         StopTimer(62);
 
         /* Metroplis */
-        x = LogProjRatio(projCntNew, TmpEleProjCnt);
-        w = exp(2.0 * (x + (logIpNew - logIpOld)));
+        if (sparseProj) x = LogProjRatioDelta(projDelta, nDelta);
+        else x = LogProjRatio(projCntNew, TmpEleProjCnt);
+        w = qRatio * exp(2.0 * (x + (logIpNew - logIpOld)));
         if (!isfinite(w)) w = -1.0; /* should be rejected */
 
         if (w > genrand_real2()) { /* accept */
           StartTimer(63);
 #ifdef _pf_block_update
           // Inv already updated. Only need to get PfM again.
-          updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+          updated_tdi_v_get_pfa_d(NQPFull, PfM_real, PfUpdator);
 #else
           // UpdateMAll will change SlaterElm, InvM (including PfM)
-          UpdateMAll_real(mi, s, TmpEleIdx, qpStart, qpEnd);
+          if (delayUpdate) UpdateMAllDelay_real(mi, s, TmpEleIdx, qpStart, qpEnd);
+          else UpdateMAll_real(mi, s, TmpEleIdx, qpStart, qpEnd);
           //            UpdateMAll(mi,s,TmpEleIdx,qpStart,qpEnd);
 #endif
           StopTimer(63);
 
-          for (i = 0; i < NProj; i++) TmpEleProjCnt[i] = projCntNew[i];
+          if (sparseProj) AddProjCntDelta(TmpEleProjCnt, projDelta, nDelta);
+          else for (i = 0; i < NProj; i++) TmpEleProjCnt[i] = projCntNew[i];
           logIpOld = logIpNew;
           nAccept++;
           Counter[1]++;
         } else { /* reject */
 #ifdef _pf_block_update
           StartTimer(61);
-          updated_tdi_v_pop_d(NQPFull, 0, pfUpdator);
+          updated_tdi_v_pop_d(NQPFull, 0, PfUpdator);
           StopTimer(61);
 #endif
-          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
+          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
         }
         StopTimer(32);
 
@@ -207,7 +257,7 @@ void VMCMakeSample_real(MPI_Comm comm) {
 
         StartTimer(31);
         makeCandidate_exchange(&mi, &ri, &rj, &s, &rejectFlag,
-                               TmpEleIdx, TmpEleCfg, TmpEleNum);
+                               TmpEleIdx, TmpEleCfg, TmpEleLst);
         StopTimer(31);
 
         if (rejectFlag) continue;
@@ -220,11 +270,13 @@ void VMCMakeSample_real(MPI_Comm comm) {
         mj = TmpEleCfg[rj + t * Nsite];
 
         /* The mi-th electron with spin s hops to rj */
-        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
-        UpdateProjCnt(ri, rj, s, projCntNew, TmpEleProjCnt, TmpEleNum);
+        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
+        if (sparseProj) nDelta = UpdateProjCntDelta(ri, rj, s, projDelta, 0, TmpEleNum);
+        else UpdateProjCnt(ri, rj, s, projCntNew, TmpEleProjCnt, TmpEleNum);
         /* The mj-th electron with spin t hops to ri */
-        updateEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum);
-        UpdateProjCnt(rj, ri, t, projCntNew, projCntNew, TmpEleNum);
+        updateEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
+        if (sparseProj) nDelta = UpdateProjCntDelta(rj, ri, t, projDelta, nDelta, TmpEleNum);
+        else UpdateProjCnt(rj, ri, t, projCntNew, projCntNew, TmpEleNum);
 
         StopTimer(65);
         StartTimer(66);
@@ -233,9 +285,11 @@ void VMCMakeSample_real(MPI_Comm comm) {
         updated_tdi_v_push_pair_d(NQPFull,
                                   rj+s*Nsite, mi+s*Ne,
                                   ri+t*Nsite, mj+t*Ne,
-                                  1, pfUpdator);
-        updated_tdi_v_get_pfa_d(NQPFull, pfMNew_real, pfUpdator);
+                                  1, PfUpdator);
+        updated_tdi_v_get_pfa_d(NQPFull, pfMNew_real, PfUpdator);
 #else
+        /* the two-electron update reads InvM_real directly */
+        if (delayUpdate) FlushMAllDelay_real(qpStart, qpEnd);
         CalculateNewPfMTwo2_real(mi, s, mj, t, pfMNew_real, TmpEleIdx, qpStart, qpEnd);
 #endif
         StopTimer(66);
@@ -247,7 +301,8 @@ void VMCMakeSample_real(MPI_Comm comm) {
         StopTimer(67);
 
         /* Metroplis */
-        x = LogProjRatio(projCntNew, TmpEleProjCnt);
+        if (sparseProj) x = LogProjRatioDelta(projDelta, nDelta);
+        else x = LogProjRatio(projCntNew, TmpEleProjCnt);
         w = exp(2.0 * (x + (logIpNew - logIpOld))); //TBC
         if (!isfinite(w)) w = -1.0; /* should be rejected */
 
@@ -255,25 +310,26 @@ void VMCMakeSample_real(MPI_Comm comm) {
           StartTimer(68);
 #ifdef _pf_block_update
           // Inv already updated. Only need to get PfM again.
-          updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+          updated_tdi_v_get_pfa_d(NQPFull, PfM_real, PfUpdator);
 #else
           UpdateMAllTwo_real(mi, s, mj, t, ri, rj, TmpEleIdx, qpStart, qpEnd);
 #endif
           StopTimer(68);
 
-          for (i = 0; i < NProj; i++) TmpEleProjCnt[i] = projCntNew[i];
+          if (sparseProj) AddProjCntDelta(TmpEleProjCnt, projDelta, nDelta);
+          else for (i = 0; i < NProj; i++) TmpEleProjCnt[i] = projCntNew[i];
           logIpOld = logIpNew;
           nAccept++;
           Counter[3]++;
         } else { /* reject */
 #ifdef _pf_block_update
           StartTimer(66);
-          updated_tdi_v_pop_d(NQPFull, 0, pfUpdator);
-          updated_tdi_v_pop_d(NQPFull, 0, pfUpdator);
+          updated_tdi_v_pop_d(NQPFull, 0, PfUpdator);
+          updated_tdi_v_pop_d(NQPFull, 0, PfUpdator);
           StopTimer(66);
 #endif
-          revertEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum);
-          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
+          revertEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
+          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
         }
         StopTimer(33);
       }
@@ -282,15 +338,8 @@ void VMCMakeSample_real(MPI_Comm comm) {
         // Recalculate PfM and InvM.
         StartTimer(34);
 #ifdef _pf_block_update
-        // Clear and reinitialize.
-        updated_tdi_v_free_d(NQPFull, pfUpdator, pfOrbital);
-        updated_tdi_v_init_d(NQPFull, Nsite, Nsite2, Nsize,
-                             SlaterElm_real, Nsite2*Nsite2,
-                             InvM_real, Nsize*Nsize,
-                             TmpEleIdx, EleSpn,
-                             NBlockUpdateSize,
-                             pfUpdator, pfOrbital);
-        updated_tdi_v_get_pfa_d(NQPFull, PfM_real, pfUpdator);
+        // Reinitialize in place.
+        InitPfUpdator_real(TmpEleIdx, EleSpn);
 #else
         CalculateMAll_real(TmpEleIdx, qpStart, qpEnd);
 #endif
@@ -303,75 +352,251 @@ void VMCMakeSample_real(MPI_Comm comm) {
 
     StartTimer(35);
     /* save Electron Configuration */
-    if (outStep >= nOutStep - NVMCSample) {
-      sample = outStep - (nOutStep - NVMCSample);
+    if (outStep >= nOutStep - nSample) {
+      sample = sampleStart + outStep - (nOutStep - nSample);
       saveEleConfig(sample, logIpOld, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleProjCnt);
     }
     StopTimer(35);
 
+    /* InvM_real and PfM_real are valid for the saved configuration */
+    if (inlineMeasure && outStep >= nOutStep - nSample) {
+      if (delayUpdate) FlushMAllDelay_real(qpStart, qpEnd);
+      VMCMainCalSample(sampleStart + outStep - (nOutStep - nSample), 0, rank);
+    }
+
   } /* end of outstep */
 
+  if (delayUpdate) FlushMAllDelay_real(qpStart, qpEnd);
   copyToBurnSample(TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleProjCnt);
   BurnFlag = 1;
 
-#ifdef _pf_block_update
-  // Free-up updator space.
-  updated_tdi_v_free_d(NQPFull, pfUpdator, pfOrbital);
-#endif
-
   return;
 }
 
-int makeInitialSample_real(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt,
-                           const int qpStart, const int qpEnd, MPI_Comm comm) {
-  const int nsize = Nsize;
-  const int nsite2 = Nsite2;
-  int flag = 1, flagRdc, loop = 0;
-  int ri, mi, si, msi, rsi;
-  int rank, size;
-  MPI_Comm_size(comm, &size);
-  MPI_Comm_rank(comm, &rank);
+/* Multi-chain version of VMCMakeSample_real. See VMCMakeSampleChain. */
+void VMCMakeSampleChain_real(MPI_Comm comm) {
+  const int nChain = NThread;
+  int chain, i;
+  int *myIWork;
+  double *myBuffer;
 
-  do {
-    /* initialize */
-#pragma omp parallel for default(shared) private(msi)
-    for (msi = 0; msi < nsize; msi++) eleIdx[msi] = -1;
-#pragma omp parallel for default(shared) private(rsi)
-    for (rsi = 0; rsi < nsite2; rsi++) eleCfg[rsi] = -1;
+  StartTimer(30);
+  for (i = 0; i < Counter_max; i++) Counter[i] = 0;  /* reset counter */
 
-    /* local spin */
-    for (ri = 0; ri < Nsite; ri++) {
-      if (LocSpn[ri] == 1) {
-        do {
-          mi = gen_rand32() % Ne;
-          si = (genrand_real2() < 0.5) ? 0 : 1;
-        } while (eleIdx[mi + si * Ne] != -1);
-        eleCfg[ri + si * Nsite] = mi;
-        eleIdx[mi + si * Ne] = ri;
-      }
+  RequestWorkSpaceThreadInt(Nsize + NProj);
+  RequestWorkSpaceThreadDouble(Nsize * Nsize + LapackLWork + 4 * Nsize + NQPFull);
+
+  /* the 0-th chain continues the stream of the master thread */
+  get_gen_state(ChainRandState);
+#pragma omp parallel default(shared) private(myIWork, myBuffer)
+  {
+    myIWork = GetWorkSpaceThreadInt(Nsize + NProj);
+    myBuffer = GetWorkSpaceThreadDouble(Nsize * Nsize + LapackLWork + 4 * Nsize + NQPFull);
+
+#pragma omp for private(chain) schedule(static, 1)
+    for (chain = 0; chain < nChain; chain++) {
+      makeSampleChain_child_real(chain, nChain, myIWork, myBuffer);
     }
+  }
 
-    /* itinerant electron */
-    for (si = 0; si < 2; si++) {
-      for (mi = 0; mi < Ne; mi++) {
-        if (eleIdx[mi + si * Ne] == -1) {
-          do {
-            ri = gen_rand32() % Nsite;
-          } while (eleCfg[ri + si * Nsite] != -1 || LocSpn[ri] == 1);
-          eleCfg[ri + si * Nsite] = mi;
-          eleIdx[mi + si * Ne] = ri;
+  ReleaseWorkSpaceThreadInt();
+  ReleaseWorkSpaceThreadDouble();
+  set_gen_state(ChainRandState);
+
+  BurnFlag = 1;
+  StopTimer(30);
+  return;
+}
+
+/* iwork: Nsize+NProj, buffer: Nsize*Nsize+LapackLWork+4*Nsize+NQPFull */
+void makeSampleChain_child_real(const int chain, const int nChain, int *iwork, double *buffer) {
+  const int nBlock = Nsize + 2 * Nsite2 + NProj;
+  int *eleIdx = ChainEleIdx + chain * nBlock;
+  int *eleCfg = eleIdx + Nsize;
+  int *eleNum = eleCfg + Nsite2;
+  int *eleProjCnt = eleNum + Nsite2;
+  int *burnEleIdx = ChainBurnEleIdx + chain * nBlock;
+  int *eleLst = ChainEleLst + chain * SizeEleLst();
+  int *projCntNew = iwork + Nsize;
+  int projDelta[4 * (2 * Nsite + 1)];
+  int nDelta = 0;
+  const int sparseProj = IsProjCntDelta();
+
+  double *invM = ChainInvM_real + chain * NQPFull * (Nsize * Nsize + 1);
+  double *pfM = invM + NQPFull * Nsize * Nsize;
+  double *bufM = buffer;
+  double *work = bufM + Nsize * Nsize;
+  double *vec = work + LapackLWork;
+  double *pfMNew_real = vec + 4 * Nsize;
+
+  int outStep, nOutStep;
+  int inStep, nInStep;
+  UpdateType updateType;
+  int mi, mj, ri, rj, s, t, i;
+  int nAccept = 0;
+  int burnFlag = BurnFlag;
+  int sampleStart, sampleEnd, nSample;
+  int rejectFlag;
+  int counter[Counter_max];
+
+  double logIpOld, logIpNew; /* logarithm of inner product <phi|L|x> */
+  double x, w, qRatio;
+
+  SplitLoop(&sampleStart, &sampleEnd, NVMCSample, chain, nChain);
+  nSample = sampleEnd - sampleStart;
+
+  /* the random number stream of this chain */
+  set_gen_state(ChainRandState + chain * get_state_size32());
+
+  if (burnFlag == 0) {
+    makeInitialSampleChain_real(eleIdx, eleCfg, eleNum, eleProjCnt, pfM, invM, bufM, iwork, work);
+  } else {
+    for (i = 0; i < nBlock; i++) eleIdx[i] = burnEleIdx[i];
+    CalculateMAllChain_real(eleIdx, pfM, invM, bufM, iwork, work);
+  }
+  logIpOld = CalculateLogIPChain_real(pfM);
+
+  if (!isfinite(logIpOld)) {
+    fprintf(stderr, "waring: VMCMakeSampleChain_real chain:%d remakeSample logIpOld=%e\n", chain, logIpOld);
+    makeInitialSampleChain_real(eleIdx, eleCfg, eleNum, eleProjCnt, pfM, invM, bufM, iwork, work);
+    logIpOld = CalculateLogIPChain_real(pfM);
+    burnFlag = 0;
+  }
+  makeEleLst(eleLst, eleIdx, eleNum);
+
+  nOutStep = (burnFlag == 0) ? NVMCWarmUp + nSample : nSample + 1;
+  nInStep = NVMCInterval * Nsite;
+
+  for (i = 0; i < Counter_max; i++) counter[i] = 0;
+
+  for (outStep = 0; outStep < nOutStep; outStep++) {
+    for (inStep = 0; inStep < nInStep; inStep++) {
+
+      updateType = getUpdateType(NExUpdatePath);
+
+      if (updateType == HOPPING) { /* hopping */
+        counter[0]++;
+
+        makeCandidate_hopping(&mi, &ri, &rj, &s, &rejectFlag, &qRatio, eleIdx, eleLst);
+        if (rejectFlag) continue;
+
+        /* The mi-th electron with spin s hops to site rj */
+        updateEleConfig(mi, ri, rj, s, eleIdx, eleCfg, eleNum, eleLst);
+        if (sparseProj) nDelta = UpdateProjCntDelta(ri, rj, s, projDelta, 0, eleNum);
+        else UpdateProjCnt(ri, rj, s, projCntNew, eleProjCnt, eleNum);
+
+        CalculateNewPfMChain_real(mi, s, pfMNew_real, eleIdx, pfM, invM);
+        logIpNew = CalculateLogIPChain_real(pfMNew_real);
+
+        /* Metroplis */
+        if (sparseProj) x = LogProjRatioDelta(projDelta, nDelta);
+        else x = LogProjRatio(projCntNew, eleProjCnt);
+        w = qRatio * exp(2.0 * (x + (logIpNew - logIpOld)));
+        if (!isfinite(w)) w = -1.0; /* should be rejected */
+
+        if (w > genrand_real2()) { /* accept */
+          UpdateMAllChain_real(mi, s, eleIdx, pfM, invM, vec);
+          if (sparseProj) AddProjCntDelta(eleProjCnt, projDelta, nDelta);
+          else for (i = 0; i < NProj; i++) eleProjCnt[i] = projCntNew[i];
+          logIpOld = logIpNew;
+          nAccept++;
+          counter[1]++;
+        } else { /* reject */
+          revertEleConfig(mi, ri, rj, s, eleIdx, eleCfg, eleNum, eleLst);
+        }
+
+      } else if (updateType == EXCHANGE) { /* exchange */
+        counter[2]++;
+
+        makeCandidate_exchange(&mi, &ri, &rj, &s, &rejectFlag, eleIdx, eleCfg, eleLst);
+        if (rejectFlag) continue;
+
+        /* The mi-th electron with spin s exchanges with the electron on site rj with spin 1-s */
+        t = 1 - s;
+        mj = eleCfg[rj + t * Nsite];
+
+        updateEleConfig(mi, ri, rj, s, eleIdx, eleCfg, eleNum, eleLst);
+        if (sparseProj) nDelta = UpdateProjCntDelta(ri, rj, s, projDelta, 0, eleNum);
+        else UpdateProjCnt(ri, rj, s, projCntNew, eleProjCnt, eleNum);
+        updateEleConfig(mj, rj, ri, t, eleIdx, eleCfg, eleNum, eleLst);
+        if (sparseProj) nDelta = UpdateProjCntDelta(rj, ri, t, projDelta, nDelta, eleNum);
+        else UpdateProjCnt(rj, ri, t, projCntNew, projCntNew, eleNum);
+
+        CalculateNewPfMTwoChain_real(mi, s, mj, t, pfMNew_real, eleIdx, pfM, invM, vec);
+        logIpNew = CalculateLogIPChain_real(pfMNew_real);
+
+        /* Metroplis */
+        if (sparseProj) x = LogProjRatioDelta(projDelta, nDelta);
+        else x = LogProjRatio(projCntNew, eleProjCnt);
+        w = exp(2.0 * (x + (logIpNew - logIpOld)));
+        if (!isfinite(w)) w = -1.0; /* should be rejected */
+
+        if (w > genrand_real2()) { /* accept */
+          UpdateMAllTwoChain_real(mi, s, mj, t, ri, rj, eleIdx, pfM, invM, vec);
+          if (sparseProj) AddProjCntDelta(eleProjCnt, projDelta, nDelta);
+          else for (i = 0; i < NProj; i++) eleProjCnt[i] = projCntNew[i];
+          logIpOld = logIpNew;
+          nAccept++;
+          counter[3]++;
+        } else { /* reject */
+          revertEleConfig(mj, rj, ri, t, eleIdx, eleCfg, eleNum, eleLst);
+          revertEleConfig(mi, ri, rj, s, eleIdx, eleCfg, eleNum, eleLst);
         }
       }
+
+      if (nAccept > Nsite) {
+        /* Recalculate PfM and InvM */
+        CalculateMAllChain_real(eleIdx, pfM, invM, bufM, iwork, work);
+        logIpOld = CalculateLogIPChain_real(pfM);
+        nAccept = 0;
+      }
+    } /* end of instep */
+
+    /* save Electron Configuration */
+    if (outStep >= nOutStep - nSample) {
+      saveEleConfig(sampleStart + outStep - (nOutStep - nSample), logIpOld, eleIdx, eleCfg, eleNum, eleProjCnt);
     }
+  } /* end of outstep */
 
-    /* EleNum */
-#pragma omp parallel for default(shared) private(rsi)
-#pragma loop noalias
-    for (rsi = 0; rsi < nsite2; rsi++) {
-      eleNum[rsi] = (eleCfg[rsi] < 0) ? 0 : 1;
+  for (i = 0; i < nBlock; i++) burnEleIdx[i] = eleIdx[i];
+  get_gen_state(ChainRandState + chain * get_state_size32());
+
+  for (i = 0; i < Counter_max; i++) {
+#pragma omp atomic
+    Counter[i] += counter[i];
+  }
+
+  return;
+}
+
+/* makeInitialSample_real for one Markov chain owning pfM and invM */
+int makeInitialSampleChain_real(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt,
+                                double *pfM, double *invM, double *bufM, int *iwork, double *work) {
+  int flag = 1, loop = 0;
+
+  do {
+    makeInitialEleConfig(eleIdx, eleCfg, eleNum, eleProjCnt);
+    flag = CalculateMAllChain_real(eleIdx, pfM, invM, bufM, iwork, work);
+
+    loop++;
+    if (loop > 100) {
+      fprintf(stderr, "error: makeInitialSampleChain_real: Too many loops\n");
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
+  } while (flag > 0);
 
-    MakeProjCnt(eleProjCnt, eleNum);
+  return 0;
+}
+
+int makeInitialSample_real(int *eleIdx, int *eleCfg, int *eleNum, int *eleProjCnt,
+                           const int qpStart, const int qpEnd, MPI_Comm comm) {
+  int flag = 1, flagRdc, loop = 0;
+  int rank, size;
+  MPI_Comm_size(comm, &size);
+  MPI_Comm_rank(comm, &rank);
+
+  do {
+    makeInitialEleConfig(eleIdx, eleCfg, eleNum, eleProjCnt);
 
     flag = CalculateMAll_real(eleIdx, qpStart, qpEnd);
     //printf("DEBUG: maker4: PfM=%lf\n",creal(PfM[0]));
@@ -404,7 +629,7 @@ void VMC_BF_MakeSample_real(MPI_Comm comm) {
   int projBFCntNew[16 * Nsite * Nrange]; // For BackFlow
   int msaTmp[NQPFull * Nsite], icount[NQPFull]; // For BackFlow
   double pfMNew_real[NQPFull];
-  double x, w; // TBC x will be complex number
+  double x, w, qRatio; // TBC x will be complex number
 
   int qpStart, qpEnd;
   int rejectFlag;
@@ -443,6 +668,7 @@ void VMC_BF_MakeSample_real(MPI_Comm comm) {
     logIpOld = CalculateLogIP_real(PfM_real, qpStart, qpEnd, comm);
     BurnFlag = 0;
   }
+  makeEleLst(TmpEleLst, TmpEleIdx, TmpEleNum);
   StopTimer(30);
 
   nOutStep = (BurnFlag == 0) ? NVMCWarmUp + NVMCSample : NVMCSample + 1;
@@ -459,8 +685,8 @@ void VMC_BF_MakeSample_real(MPI_Comm comm) {
         Counter[0]++;
 
         StartTimer(31);
-        makeCandidate_hopping(&mi, &ri, &rj, &s, &rejectFlag,
-                              TmpEleIdx, TmpEleCfg);
+        makeCandidate_hopping(&mi, &ri, &rj, &s, &rejectFlag, &qRatio,
+                              TmpEleIdx, TmpEleLst);
         StopTimer(31);
 
         if (rejectFlag) continue;
@@ -468,7 +694,7 @@ void VMC_BF_MakeSample_real(MPI_Comm comm) {
         StartTimer(32);
         StartTimer(60);
         /* The mi-th electron with spin s hops to site rj */
-        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
+        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
         UpdateProjCnt(ri, rj, s, projCntNew, TmpEleProjCnt, TmpEleNum);
         MakeProjBFCnt(projBFCntNew, TmpEleNum);
         StopTimer(60);
@@ -493,7 +719,7 @@ void VMC_BF_MakeSample_real(MPI_Comm comm) {
 
         /* Metroplis */
         x = LogProjRatio(projCntNew, TmpEleProjCnt);
-        w = exp(2.0 * (x + (logIpNew - logIpOld)));
+        w = qRatio * exp(2.0 * (x + (logIpNew - logIpOld)));
         if (!isfinite(w)) w = -1.0; /* should be rejected */
 
         if (w > genrand_real2()) { /* accept */
@@ -510,7 +736,7 @@ void VMC_BF_MakeSample_real(MPI_Comm comm) {
           nAccept++;
           Counter[1]++;
         } else { /* reject */
-          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
+          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
           //TODO: Add Timer
           UpdateSlaterElmBF_fcmp(mi, rj, ri, s, TmpEleCfg, TmpEleNum, TmpEleProjBFCnt, msaTmp, icount,
                                  SlaterElmBF);
@@ -524,7 +750,7 @@ void VMC_BF_MakeSample_real(MPI_Comm comm) {
 
         StartTimer(31);
         makeCandidate_exchange(&mi, &ri, &rj, &s, &rejectFlag,
-                               TmpEleIdx, TmpEleCfg, TmpEleNum);
+                               TmpEleIdx, TmpEleCfg, TmpEleLst);
         StopTimer(31);
 
         if (rejectFlag) continue;
@@ -537,10 +763,10 @@ void VMC_BF_MakeSample_real(MPI_Comm comm) {
         mj = TmpEleCfg[rj + t * Nsite];
 
         /* The mi-th electron with spin s hops to rj */
-        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
+        updateEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
         UpdateProjCnt(ri, rj, s, projCntNew, TmpEleProjCnt, TmpEleNum);
         /* The mj-th electron with spin t hops to ri */
-        updateEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum);
+        updateEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
         UpdateProjCnt(rj, ri, t, projCntNew, projCntNew, TmpEleNum);
 
         StopTimer(65);
@@ -570,8 +796,8 @@ void VMC_BF_MakeSample_real(MPI_Comm comm) {
           nAccept++;
           Counter[3]++;
         } else { /* reject */
-          revertEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum);
-          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum);
+          revertEleConfig(mj, rj, ri, t, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
+          revertEleConfig(mi, ri, rj, s, TmpEleIdx, TmpEleCfg, TmpEleNum, TmpEleLst);
         }
         StopTimer(33);
       }
@@ -45,6 +45,22 @@ struct orbital_mat
   orbital_mat(uplo_t uplo_, dim_t nsite_, matrix_t<T> &X_)
   : uplo(uplo_), nsite(nsite_), X(X_) { }
 
+  // Whether X_ is the matrix this object refers to.
+  // With Boost the copy is refreshed instead.
+  bool rebind(dim_t nsite_, T *X_, inc_t ldX) {
+    if (nsite_ != nsite)
+      return false;
+  #ifdef UseBoost
+    colmaj<T> X_tmp(X_, ldX);
+    for (dim_t j = 0; j < nsite; ++j)
+      for (dim_t i = 0; i < nsite; ++i)
+        X(i, j) = X_tmp(i, j);
+    return true;
+  #else
+    return &X(0, 0) == X_ && X.ld == ldX;
+  #endif
+  }
+
   void randomize(double amplitude, unsigned seed) { 
     using namespace std;
     mt19937_64 rng(seed);
@@ -57,6 +57,48 @@ GENIMPL( ccscmplx, c )
 GENIMPL( ccdcmplx, z )
 #undef GENIMPL
 
+// Reinitialize the objects created by updated_tdi_v_init in place.
+// Objects that do not fit the given sizes or buffers are created again.
+#define GENIMPL( ctype, cblachar ) \
+  void EXPANDNAME( updated_tdi_v_reinit, cblachar ) \
+    ( uint64_t  num_qp, \
+      uint64_t  nsite, \
+      uint64_t  norbs, \
+      uint64_t  nelec, \
+      ctype    *orbmat_base, \
+      int64_t   orbmat_stride, \
+      ctype    *invmat_base, \
+      int64_t   invmat_stride, \
+      int32_t  *eleidx, \
+      int32_t  *elespn, \
+      uint64_t  mmax, \
+      void     *objv[], \
+      void     *orbv[] ) \
+{ \
+  OMP_PARALLEL_FOR_SHARED \
+  for (int iqp = 0; iqp < num_qp; ++iqp) { \
+    if (!orbv(iqp, ctype)->rebind(norbs, orbmat_base + iqp * orbmat_stride, norbs) || \
+        !objv(iqp, ctype)->reusable(nelec, invmat_base + iqp * invmat_stride, nelec, mmax)) { \
+      delete objv(iqp, ctype); \
+      delete orbv(iqp, ctype); \
+      orbv[iqp] = new orbital_mat<ctype>( \
+          BLIS_UPPER, norbs, orbmat_base + iqp * orbmat_stride, norbs); \
+      objv[iqp] = new updated_tdi<ctype>( \
+          *orbv(iqp, ctype), nelec, invmat_base + iqp * invmat_stride, nelec, mmax); \
+    } \
+\
+    auto &cfg_i = objv(iqp, ctype)->elem_cfg; \
+    for (int msi = 0; msi < nelec; ++msi) \
+      cfg_i.at(msi) = eleidx[msi] + elespn[msi]*nsite; \
+    objv(iqp, ctype)->initialize(); \
+  } \
+}
+GENIMPL( float,    s )
+GENIMPL( double,   d )
+GENIMPL( ccscmplx, c )
+GENIMPL( ccdcmplx, z )
+#undef GENIMPL
+
 #define GENIMPL( ctype, cblachar ) \
   void EXPANDNAME( updated_tdi_v_free, cblachar ) \
     ( uint64_t  num_qp, \
@@ -46,6 +46,28 @@ GENDEF( ccscmplx, c )
 GENDEF( ccdcmplx, z )
 #undef GENDEF
 
+#define GENDEF( ctype, cblachar ) \
+   void EXPANDNAME( updated_tdi_v_reinit, cblachar ) \
+    ( uint64_t  num_qp, \
+      uint64_t  nsite, \
+      uint64_t  norbs, \
+      uint64_t  nelec, \
+      ctype    *orbmat_base, \
+      int64_t   orbmat_stride, \
+      ctype    *invmat_base, \
+      int64_t   invmat_stride, \
+      int32_t  *eleidx, \
+      int32_t  *elespn, \
+      uint64_t  mmax, \
+      void     *objv[], \
+      void     *orbv[] );
+
+GENDEF( float,    s )
+GENDEF( double,   d )
+GENDEF( ccscmplx, c )
+GENDEF( ccdcmplx, z )
+#undef GENDEF
+
 #define GENDEF( ctype, cblachar ) \
    void EXPANDNAME( updated_tdi_v_free, cblachar ) \
     ( uint64_t  num_qp, \
@@ -10,13 +10,15 @@
 #include "blalink.hh"
 #include <vector>
 
+// Z: scratchpad of length m.
 template <typename T>
 void skmv(uplo_t uploA,
           dim_t m,
           T alpha,
           T *_A, inc_t ldA,
           T *X,
-          T *Y) {
+          T *Y,
+          T *Z) {
   using namespace std;
   colmaj<T> A(_A, ldA);
 
@@ -25,7 +27,6 @@ void skmv(uplo_t uploA,
   //      T(1.0), &A(0, 0), A.ld, &X[0], ldA, T(0.0), &Y[0], ldA);
 
   // Way 2:
-  vector<T> Z(m);
   for (dim_t i = 0; i < m; ++i) {
     Z[i] = X[i];
     Y[i] = X[i];
@@ -53,3 +54,14 @@ void skmv(uplo_t uploA,
   
 }
 
+template <typename T>
+void skmv(uplo_t uploA,
+          dim_t m,
+          T alpha,
+          T *_A, inc_t ldA,
+          T *X,
+          T *Y) {
+  std::vector<T> Z(m);
+  skmv(uploA, m, alpha, _A, ldA, X, Y, &Z[0]);
+}
+
@@ -16,6 +16,19 @@
 #include "optpanel.hh"
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+// Workspaces of updated_tdi are aligned to the cache line for BLIS kernels.
+template <typename T> inline T *alloc_aligned(size_t n) {
+  void *p = nullptr;
+  if (posix_memalign(&p, 64, sizeof(T) * (n > 0 ? n : 1)) != 0)
+    throw std::bad_alloc();
+  return static_cast<T *>(p);
+}
+
+template <typename T> inline void free_aligned(T *p) { free(p); }
 
 template <typename T> struct updated_tdi {
   orbital_mat<T> &Xij;
@@ -51,19 +64,23 @@ template <typename T> struct updated_tdi {
   std::vector<dim_t> elem_cfg;
   std::vector<dim_t> from_idx;
   std::vector<dim_t> to_site;
+  std::vector<signed> site_idx; ///< Inverse of elem_cfg. -1 for empty sites.
+
+  // Scratchpads kept over the updates and reinitializations.
+  matrix_t<T> G;        ///< Gaussian vectors when factorizing M.
+  signed *const iPivFull;
+  const dim_t lpfwork;
+  T *const pfwork;
+  T *const mvwork;      ///< Scratchpad of SKMV.
 
   void initialize() {
     using namespace std;
     auto &cfg = elem_cfg;
-    #ifdef UseBoost
-    matrix_t<T> G(nelec, nelec);
-    #else
-    matrix_t<T> G(new T[nelec * nelec], nelec);
-    #endif
     from_idx.clear();
     to_site.clear();
-    from_idx.reserve(mmax * sizeof(dim_t));
-    to_site.reserve(mmax * sizeof(dim_t));
+    nq_updated = 0;
+    PfaRatio = 1.0;
+    config_to_site(elem_cfg, site_idx, true);
 
     switch (uplo) {
     case BLIS_UPPER:
@@ -80,44 +97,51 @@ template <typename T> struct updated_tdi {
            << endl;
     }
 
-    // Allocate scratchpad.
-    signed *iPivFull = new signed[nelec + 1];
-    dim_t lwork = nelec * npanel_big;
-    T *pfwork = new T[lwork];
-
     #ifdef UseBoost
     signed info = skpfa(uplo, nelec, &M(0, 0), M.size1(), &G(0, 0), G.size1(), iPivFull,
-                        true, &Pfa, pfwork, lwork);
+                        true, &Pfa, pfwork, lpfwork);
     #else
     signed info = skpfa(uplo, nelec, &M(0, 0), M.ld, &G(0, 0), G.ld, iPivFull,
-                        true, &Pfa, pfwork, lwork);
+                        true, &Pfa, pfwork, lpfwork);
     #endif
 #ifdef _DEBUG
     cerr << "SKPFA+INV: n=" << nelec << " info=" << info << endl;
 #endif
+  }
 
-    delete[] iPivFull;
-    delete[] pfwork;
-    #ifndef UseBoost
-    delete[](&G(0, 0));
+  // Whether M_ is the buffer this object works on, i.e. whether the object
+  // can be reinitialized in place by setting elem_cfg and calling initialize().
+  bool reusable(dim_t nelec_, T *M_, inc_t ldM, dim_t mmax_) {
+    if (nelec_ != nelec || mmax_ != mmax)
+      return false;
+    #ifdef UseBoost
+    // M is an own copy rebuilt by initialize().
+    return true;
+    #else
+    return &M(0, 0) == M_ && M.ld == ldM;
     #endif
   }
 
   ~updated_tdi() {
     #ifndef UseBoost
-    delete[](&U(0, 0));
-    delete[](&Q(0, 0));
+    free_aligned(&U(0, 0));
+    free_aligned(&Q(0, 0));
+
+    free_aligned(&Cp(0, 0));
+    free_aligned(&Gc(0, 0));
 
-    delete[](&Cp(0, 0));
-    delete[](&Gc(0, 0));
+    free_aligned(&W(0, 0));
+    free_aligned(&UMU(0, 0));
+    free_aligned(&UMV(0, 0));
+    free_aligned(&VMV(0, 0));
 
-    delete[](&W(0, 0));
-    delete[](&UMU(0, 0));
-    delete[](&UMV(0, 0));
-    delete[](&VMV(0, 0));
+    free_aligned(&G(0, 0));
     #endif
 
     delete[] cPov;
+    delete[] iPivFull;
+    free_aligned(pfwork);
+    free_aligned(mvwork);
   }
 
   updated_tdi(orbital_mat<T> &Xij_, std::vector<dim_t> &cfg, T *M_, inc_t ldM,
@@ -133,14 +157,25 @@ template <typename T> struct updated_tdi {
         Gc(2 * mmax, 2 * mmax),
     #else
         M(M_, ldM),
-        U(new T[nelec * mmax * 2], nelec), Q(new T[nelec * mmax * 2], nelec),
-        P(&Q(0, mmax), Q.ld), W(new T[mmax * mmax], mmax),
-        UMU(new T[mmax * mmax], mmax), UMV(new T[mmax * mmax], mmax),
-        VMV(new T[mmax * mmax], mmax), Cp(new T[2 * mmax * 2 * mmax], 2 * mmax),
-        Gc(new T[2 * mmax * 2 * mmax], 2 * mmax),
+        U(alloc_aligned<T>(nelec * mmax * 2), nelec), Q(alloc_aligned<T>(nelec * mmax * 2), nelec),
+        P(&Q(0, mmax), Q.ld), W(alloc_aligned<T>(mmax * mmax), mmax),
+        UMU(alloc_aligned<T>(mmax * mmax), mmax), UMV(alloc_aligned<T>(mmax * mmax), mmax),
+        VMV(alloc_aligned<T>(mmax * mmax), mmax), Cp(alloc_aligned<T>(2 * mmax * 2 * mmax), 2 * mmax),
+        Gc(alloc_aligned<T>(2 * mmax * 2 * mmax), 2 * mmax),
     #endif
         cPov(new signed[2 * mmax + 1]), Pfa(0.0), PfaRatio(1.0), elem_cfg(cfg),
-        from_idx(0), to_site(0), uplo(BLIS_UPPER) {
+        from_idx(0), to_site(0), site_idx(Xij_.nsite, -1),
+    #ifdef UseBoost
+        G(nelec, nelec),
+    #else
+        G(alloc_aligned<T>(nelec * nelec), nelec),
+    #endif
+        iPivFull(new signed[nelec + 1]),
+        lpfwork(std::max(nelec * npanel_big, 2 * mmax * npanel_sub)),
+        pfwork(alloc_aligned<T>(lpfwork)), mvwork(alloc_aligned<T>(nelec)),
+        uplo(BLIS_UPPER) {
+    from_idx.reserve(mmax);
+    to_site.reserve(mmax);
     #ifdef UseBoost
     colmaj<T> M_tmp(M_, ldM);
     for (dim_t j = 0; j < nelec; ++j)
@@ -179,14 +214,25 @@ template <typename T> struct updated_tdi {
         Gc(2 * mmax, 2 * mmax),
     #else
         M(M_, ldM),
-        U(new T[nelec * mmax * 2], nelec), Q(new T[nelec * mmax * 2], nelec),
-        P(&Q(0, mmax), Q.ld), W(new T[mmax * mmax], mmax),
-        UMU(new T[mmax * mmax], mmax), UMV(new T[mmax * mmax], mmax),
-        VMV(new T[mmax * mmax], mmax), Cp(new T[2 * mmax * 2 * mmax], 2 * mmax),
-        Gc(new T[2 * mmax * 2 * mmax], 2 * mmax),
+        U(alloc_aligned<T>(nelec * mmax * 2), nelec), Q(alloc_aligned<T>(nelec * mmax * 2), nelec),
+        P(&Q(0, mmax), Q.ld), W(alloc_aligned<T>(mmax * mmax), mmax),
+        UMU(alloc_aligned<T>(mmax * mmax), mmax), UMV(alloc_aligned<T>(mmax * mmax), mmax),
+        VMV(alloc_aligned<T>(mmax * mmax), mmax), Cp(alloc_aligned<T>(2 * mmax * 2 * mmax), 2 * mmax),
+        Gc(alloc_aligned<T>(2 * mmax * 2 * mmax), 2 * mmax),
     #endif
         cPov(new signed[2 * mmax + 1]), Pfa(0.0), PfaRatio(1.0), elem_cfg(nelec, 0),
-        from_idx(0), to_site(0), uplo(BLIS_UPPER) { 
+        from_idx(0), to_site(0), site_idx(Xij_.nsite, -1),
+    #ifdef UseBoost
+        G(nelec, nelec),
+    #else
+        G(alloc_aligned<T>(nelec * nelec), nelec),
+    #endif
+        iPivFull(new signed[nelec + 1]),
+        lpfwork(std::max(nelec * npanel_big, 2 * mmax * npanel_sub)),
+        pfwork(alloc_aligned<T>(lpfwork)), mvwork(alloc_aligned<T>(nelec)),
+        uplo(BLIS_UPPER) {
+    from_idx.reserve(mmax);
+    to_site.reserve(mmax);
     #ifdef UseBoost
     colmaj<T> M_tmp(M_, ldM);
     for (dim_t j = 0; j < nelec; ++j)
@@ -242,9 +288,9 @@ template <typename T> struct updated_tdi {
     for (; nq_updated < k_cal; ++nq_updated) {
       // Update single column. Use SKMV.
       #ifdef UseBoost
-      skmv(uplo, n, T(1.0), &M(0, 0), M.size1(), &U(0, nq_updated), &Q(0, nq_updated));
+      skmv(uplo, n, T(1.0), &M(0, 0), M.size1(), &U(0, nq_updated), &Q(0, nq_updated), mvwork);
       #else
-      skmv(uplo, n, T(1.0), &M(0, 0), M.ld, &U(0, nq_updated), &Q(0, nq_updated));
+      skmv(uplo, n, T(1.0), &M(0, 0), M.ld, &U(0, nq_updated), &Q(0, nq_updated), mvwork);
       #endif
     } /* else {
       // Update multiple columns. Use SKMM.
@@ -320,14 +366,12 @@ template <typename T> struct updated_tdi {
     // This can only be handled by cancellation.
     // Singularity will emerge otherwise.
 
-    // Speed-up lookup of Xij.
-    std::vector<signed> sitecfg(Xij.nsite, -1);
-    config_to_site(elem_cfg, sitecfg, false);
+    // Speed-up lookup of Xij. site_idx is kept in sync with elem_cfg.
     for (dim_t i = 0; i < Xij.nsite; ++i)
       // U(i, k) = Xij(elem_cfg.at(i), osi) - Xij(elem_cfg.at(i), osj);
-      if (sitecfg.at(i) >= 0)
+      if (site_idx[i] >= 0)
         // Direct access: special case when installed into VMC.
-        U(sitecfg.at(i), k) = Xij.X(i, osi) - Xij.X(i, osj);
+        U(site_idx[i], k) = Xij.X(i, osi) - Xij.X(i, osj);
 
     skslc(uplo, n, msj, &P(0, k), &M(0, 0), M.ld);
 
@@ -372,9 +416,7 @@ template <typename T> struct updated_tdi {
     if (compute_pfa) {
       // NOTE: Update k to be new size.
       k += 1;
-      // Allocate scratchpad.
       dim_t lwork = 2 * k * npanel_sub;
-      T *pfwork = new T[lwork];
 
       // Calculate unupdated columns of U.
       require_Q(false);
@@ -386,7 +428,6 @@ template <typename T> struct updated_tdi {
       // If it's the first update Pfafian can be directly read out.
       if (k == 1) {
         PfaRatio = -UMV(0, 0) + T(1.0);
-        delete[] pfwork;
         return;
       }
 
@@ -403,8 +444,6 @@ template <typename T> struct updated_tdi {
 #endif
       // Pfaffian of C = [ W -I; I 0 ].
       PfaRatio *= pow(-1.0, k * (k + 1) / 2);
-
-      delete[] pfwork;
     } else
       // Set to 0.0 to denote dirty.
       PfaRatio = 0.0;
@@ -484,7 +523,6 @@ template <typename T> struct updated_tdi {
       // Reassemble C and scratchpads.
       assemble_C_BMB();
       dim_t lwork = 2 * k * npanel_sub;
-      T *pfwork = new T[lwork];
 
       #ifdef UseBoost
       signed info = skpfa(uplo, 2 * k, &Cp(0, 0), Cp.size1(), &Gc(0, 0), Gc.size1(), cPov,
@@ -494,8 +532,6 @@ template <typename T> struct updated_tdi {
                           false, &PfaRatio, pfwork, lwork);
       #endif
       PfaRatio *= pow(-1.0, k * (k + 1) / 2);
-
-      delete[] pfwork;
     } else
       // Set to 0.0 to denote dirty.
       PfaRatio = 0.0;
@@ -509,10 +545,8 @@ template <typename T> struct updated_tdi {
     if (k == 0)
       return;
 
-    // Allocate scratchpad.
     dim_t lwork = 2 * k * npanel_sub;
-    T *pfwork = new T[lwork];
-    
+
     // Update whole Q.
     require_Q(true);
 
@@ -544,16 +578,19 @@ template <typename T> struct updated_tdi {
       #endif
     inv_update(k, Cp);
 
-    // Apply hopping.
+    // Apply hopping. Vacate all the old sites first since an electron
+    // may hop onto the site left by another one.
     for (int j = 0; j < k; ++j)
+      site_idx[elem_cfg.at(from_idx.at(j))] = -1;
+    for (int j = 0; j < k; ++j) {
       elem_cfg.at(from_idx.at(j)) = to_site.at(j);
+      site_idx[to_site.at(j)] = from_idx.at(j);
+    }
     from_idx.clear();
     to_site.clear();
     nq_updated = 0;
     Pfa *= PfaRatio;
     PfaRatio = 1.0;
-
-    delete[] pfwork;
   }
 
   void inv_update(dim_t k, matrix_t<T> &C) {
@@ -71,16 +71,27 @@ typedef struct W128_T w128_t;
 /** the 128-bit internal state array */
 static w128_t sfmt[N];
 /** the 32bit integer pointer to the 128-bit internal state array */
-static uint32_t *psfmt32 = &sfmt[0].u[0];
+#define psfmt32 (&sfmt[0].u[0])
 #if !defined(BIG_ENDIAN64) || defined(ONLY64)
 /** the 64bit integer pointer to the 128-bit internal state array */
-static uint64_t *psfmt64 = (uint64_t *)&sfmt[0].u[0];
+#define psfmt64 ((uint64_t *)&sfmt[0].u[0])
 #endif
 /** index counter to the 32-bit internal state array */
 static int idx;
 /** a flag: it is 0 if and only if the internal state is not yet
  * initialized. */
 static int initialized = 0;
+#ifdef _OPENMP
+/* Each OpenMP thread owns its generator state so that independent
+ * Markov chains can draw random numbers concurrently.
+ * The master thread keeps the state initialized outside parallel regions.
+ * OpenMP keeps the state of the other threads between parallel regions
+ * only under conditions such as an unchanged team size and dynamic
+ * threads off. The callers therefore must not rely on it: a thread loads
+ * the state of its chain by set_gen_state() before drawing numbers and
+ * saves it by get_gen_state() afterwards (see ChainRandState in mVMC). */
+#pragma omp threadprivate(sfmt, idx, initialized)
+#endif
 /** a parity check vector which certificate the period of 2^{MEXP} */
 static uint32_t parity[4] = {PARITY1, PARITY2, PARITY3, PARITY4};
 
@@ -401,6 +412,36 @@ int get_min_array_size64(void) {
     return N64;
 }
 
+/**
+ * This function returns the number of 32-bit integers needed to
+ * store the internal state by get_gen_state() function.
+ * @return size of the state array used for get_gen_state() function.
+ */
+int get_state_size32(void) {
+    return N32 + 1;
+}
+
+/**
+ * This function copies the internal state array and the index counter
+ * of the calling thread to the array.
+ * @param state the array of get_state_size32() 32-bit integers.
+ */
+void get_gen_state(uint32_t *state) {
+    memcpy(state, psfmt32, sizeof(uint32_t) * N32);
+    state[N32] = (uint32_t)idx;
+}
+
+/**
+ * This function restores the internal state array and the index counter
+ * of the calling thread saved by get_gen_state() function.
+ * @param state the array of get_state_size32() 32-bit integers.
+ */
+void set_gen_state(const uint32_t *state) {
+    memcpy(psfmt32, state, sizeof(uint32_t) * N32);
+    idx = (int)state[N32];
+    initialized = 1;
+}
+
 #ifndef ONLY64
 /**
  * This function generates and returns 32-bit pseudorandom number.
@@ -81,6 +81,9 @@ void init_by_array(uint32_t *init_key, int key_length);
 const char *get_idstring(void);
 int get_min_array_size32(void);
 int get_min_array_size64(void);
+int get_state_size32(void);
+void get_gen_state(uint32_t *state);
+void set_gen_state(const uint32_t *state);
 
 /* These real versions are due to Isaku Wada */
 /** generates a random number on [0,1]-real-interval */
@@ -0,0 +1,189 @@
+from __future__ import print_function
+
+import glob
+import os
+import shutil
+import subprocess
+import sys
+
+import numpy as np
+
+
+def read_out(filename):
+    # drop the first two columns
+    array = np.loadtxt(filename, dtype="float").astype("float")
+    return array
+
+
+def set_modpara(filename, options):
+    # overwrite the keywords in modpara.def, and append the others
+    with open(filename) as f:
+        lines = f.readlines()
+    rest = dict(options)
+    for i, line in enumerate(lines):
+        words = line.split()
+        if len(words) == 2 and words[0] in rest:
+            lines[i] = "{0:<14s} {1}\n".format(words[0], rest.pop(words[0]))
+    for key, value in options:
+        if key in rest:
+            lines.append("{0:<14s} {1}\n".format(key, value))
+    with open(filename, "w") as f:
+        f.writelines(lines)
+
+
+def get_modpara(filename, key):
+    with open(filename) as f:
+        for line in f:
+            words = line.split()
+            if len(words) == 2 and words[0] == key:
+                return words[1]
+    return None
+
+
+def run_vmc(args):
+    command = [bin_to_test] + args
+    if nproc > 1:
+        mpi_command = (os.environ.get("MPIEXEC") or "mpiexec").split()
+        command = mpi_command + ["-np", str(nproc)] + command
+    return subprocess.call(command)
+
+
+def prepare(dirname, options):
+    # the def files of <model name> with the keywords of modpara.def overwritten
+    os.makedirs(dirname)
+    os.chdir(dirname)
+    result = subprocess.call([os.path.join(bin_dir, "vmcdry.out"), "%s/StdFace.def" % refdir])
+    if result != 0:
+        sys.exit(result)
+    set_modpara("modpara.def", options)
+
+    # the binary container is written from the text def files in advance
+    if ["NDefBinary", "1"] in options:
+        result = run_vmc(["-c", "namelist.def"])
+        if result != 0:
+            sys.exit(result)
+
+
+def green_files(dirname):
+    # zvo_out and the Green functions of each bin, converted from the binary form
+    for binfile in glob.glob(os.path.join(dirname, "output", "*.bin")):
+        if binfile.endswith("_def.bin") or "_checkpoint_" in binfile:
+            continue
+        result = subprocess.call([greenbin2txt, binfile])
+        if result != 0:
+            sys.exit(result)
+    files = []
+    for head in ["zvo_out_", "zvo_cisajs_", "zvo_cisajscktalt_", "zvo_cisajscktaltex_"]:
+        files += glob.glob(os.path.join(dirname, "output", head + "*.dat"))
+    return sorted(os.path.basename(f) for f in files)
+
+
+def check_autocorr(dirname):
+    # zvo_autocorr.dat has a line for each step or bin when NAutoCorr != 0
+    if dict(options).get("NAutoCorr", "0") == "0":
+        return 0
+    filename = os.path.join(dirname, "output", "zvo_autocorr.dat")
+    if not os.path.exists(filename) or np.loadtxt(filename, ndmin=2).shape[0] == 0:
+        print("no autocorrelation in {}".format(filename))
+        return -1
+    return 0
+
+
+if len(sys.argv) < 3:
+    print("usage: {} <test name> <model name> [<keyword>=<value> ...] [-r] [-np <n>]".format(sys.argv[0]))
+    sys.exit(-1)
+
+# -r  : the optimization is stopped at the half of NSROptItrStep and resumed by vmc.out -r
+# -np : the number of MPI processes
+options = []
+restart = False
+nproc = 1
+args = sys.argv[3:]
+while args:
+    arg = args.pop(0)
+    if arg == "-r":
+        restart = True
+    elif arg == "-np":
+        nproc = int(args.pop(0))
+    else:
+        options.append(arg.split("=", 1))
+
+# the reference outputs of <model name> are used as they are,
+# since the options do not change the sampled distribution
+rootdir = os.getcwd()
+refdir = os.path.join(rootdir, "data", sys.argv[2])
+workdir = os.path.join(rootdir, "work", sys.argv[1])
+if os.path.exists(workdir):
+    shutil.rmtree(workdir)
+
+bin_dir = os.path.join(rootdir, "..", "..", "src", "mVMC")
+bin_to_test = os.path.join(bin_dir, "vmc.out")
+greenbin2txt = os.path.join(rootdir, "..", "..", "tool", "greenbin2txt")
+initial = "%s/initial.def" % refdir
+
+if ["NVMCCalMode", "1"] in options:
+    # the physical quantities of each bin are compared with those of the run
+    # without the options of the output, which do not change the samples
+    output_keys = ["NAsyncOutput", "NAutoCorr", "DVMCErrorTarget"]
+    plain = [o for o in options if o[0] not in output_keys]
+    prepare(os.path.join(workdir, "plain"), plain)
+    result = run_vmc(["namelist.def", initial])
+    if result != 0:
+        sys.exit(result)
+    prepare(os.path.join(workdir, "test"), options)
+    result = run_vmc(["namelist.def", initial])
+    if result != 0:
+        sys.exit(result)
+
+    files_plain = green_files(os.path.join(workdir, "plain"))
+    files_test = green_files(os.path.join(workdir, "test"))
+    result = 0
+    if len(files_test) == 0 or not set(files_test) <= set(files_plain):
+        print("missing output: {}".format(sorted(set(files_plain) ^ set(files_test))))
+        result = -1
+    for f in files_test:
+        if f not in files_plain:
+            continue
+        array_plain = read_out(os.path.join(workdir, "plain", "output", f))
+        array_test = read_out(os.path.join(workdir, "test", "output", f))
+        if array_plain.shape != array_test.shape or not np.allclose(array_test, array_plain, rtol=1e-10, atol=1e-12):
+            print("{} differs".format(f))
+            result = -1
+
+    # the bins stop before NDataQtySmp once the error reaches DVMCErrorTarget
+    if float(dict(options).get("DVMCErrorTarget", "0")) > 0.0:
+        nbin_plain = len([f for f in files_plain if f.startswith("zvo_out_")])
+        nbin_test = len([f for f in files_test if f.startswith("zvo_out_")])
+        if nbin_test >= nbin_plain:
+            print("{} bins of {} with DVMCErrorTarget".format(nbin_test, nbin_plain))
+            result = -1
+    if check_autocorr(os.path.join(workdir, "test")) != 0:
+        result = -1
+    sys.exit(result)
+
+prepare(workdir, options)
+
+if restart:
+    nstep = get_modpara("modpara.def", "NSROptItrStep")
+    set_modpara("modpara.def", [["NSROptItrStep", str(int(nstep) // 2)]])
+    result = run_vmc(["namelist.def", initial])
+    if result != 0:
+        sys.exit(result)
+    set_modpara("modpara.def", [["NSROptItrStep", nstep]])
+    result = run_vmc(["-r", "namelist.def", initial])
+else:
+    result = run_vmc(["namelist.def", initial])
+if result != 0:
+    sys.exit(result)
+
+array_calc = read_out("./output/zqp_opt.dat")[0:2]
+ref_ave = read_out("%s/ref/ref_mean.dat" % refdir)[0:2]
+ref_std = read_out("%s/ref/ref_std.dat" % refdir)[0:2]
+
+result = check_autocorr(workdir)
+for diff, s in zip(array_calc - ref_ave, ref_std):
+    diff = abs(diff)
+    if diff >= 3 * s and diff >= 1e-8:
+        result = -1
+
+sys.exit(result)
@@ -0,0 +1,112 @@
+/*
+mVMC - A numerical solver package for a wide range of quantum lattice models based on many-variable Variational Monte Carlo method
+Copyright (C) 2016 The University of Tokyo, All rights reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see http://www.gnu.org/licenses/.
+*/
+/*-------------------------------------------------------------
+ * convert the binary Green functions written with NAsyncOutput=2
+ * (zvo_cisajs_001.bin, ...) into the text files of mVMC
+ *   greenbin2txt zvo_cisajs_001.bin [...]
+ * writes zvo_cisajs_001.dat, ...
+ *-------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define D_GreenBinaryVersion 1
+
+static int convert(const char *fileIn) {
+  const char magic[8] = "mVMCgrn";
+  char mag[8];
+  char *fileOut;
+  int32_t head[4], *idx=NULL;
+  double *val=NULL;
+  FILE *fp, *fo;
+  size_t len, n, nIdx, i;
+  int layout, info=0;
+
+  if((fp=fopen(fileIn, "rb"))==NULL) {
+    fprintf(stderr, "error: cannot open %s.\n", fileIn);
+    return 1;
+  }
+  if(fread(mag, 1, sizeof(mag), fp)!=sizeof(mag) || memcmp(mag, magic, sizeof(magic))!=0
+     || fread(head, sizeof(int32_t), 4, fp)!=4 || head[0]!=D_GreenBinaryVersion
+     || head[1]<0 || head[1]>3 || head[2]<0 || head[3]<0) {
+    fprintf(stderr, "error: %s is not a Green function file of mVMC.\n", fileIn);
+    fclose(fp);
+    return 1;
+  }
+  layout = head[1]; n = head[2]; nIdx = head[3];
+  idx = (int32_t*)malloc(sizeof(int32_t)*(n*nIdx+1));
+  val = (double*)malloc(sizeof(double)*(2*n+1));
+  if(fread(idx, sizeof(int32_t), n*nIdx, fp)!=n*nIdx || fread(val, sizeof(double), 2*n, fp)!=2*n) {
+    fprintf(stderr, "error: %s is truncated.\n", fileIn);
+    info = 1;
+  }
+  fclose(fp);
+
+  len = strlen(fileIn);
+  fileOut = (char*)malloc(len+5);
+  strcpy(fileOut, fileIn);
+  if(len>4 && strcmp(fileOut+len-4, ".bin")==0) fileOut[len-4] = '\0';
+  strcat(fileOut, ".dat");
+
+  if(info==0 && (fo=fopen(fileOut, "w"))==NULL) {
+    fprintf(stderr, "error: cannot open %s.\n", fileOut);
+    info = 1;
+  }
+  if(info==0) {
+    /* the same layouts as outputData of vmc.out */
+    for(i=0;i<n;i++) {
+      const int32_t *q = idx + i*nIdx;
+      switch(layout) {
+      case 0:
+        fprintf(fo, "%d %d %d %d % .18e  % .18e \n", q[0], q[1], q[2], q[3], val[2*i], val[2*i+1]);
+        break;
+      case 1:
+        fprintf(fo, "%d %d %d %d % .18e % .18e \n", q[0], q[1], q[2], q[3], val[2*i], val[2*i+1]);
+        break;
+      case 2:
+        fprintf(fo, "% .18e  % .18e ", val[2*i], val[2*i+1]);
+        break;
+      case 3:
+        fprintf(fo, "%d %d %d %d %d %d %d %d % .18e % .18e\n",
+                q[0], q[1], q[2], q[3], q[4], q[5], q[6], q[7], val[2*i], val[2*i+1]);
+        break;
+      }
+    }
+    fprintf(fo, "\n");
+    if(fclose(fo)!=0) info = 1;
+  }
+
+  free(fileOut);
+  free(val);
+  free(idx);
+  return info;
+}
+
+int main(int argc, char *argv[]) {
+  int i, info=0;
+
+  if(argc<2) {
+    fprintf(stderr, "Usage: greenbin2txt zvo_cisajs_001.bin [...]\n");
+    return 1;
+  }
+  for(i=1;i<argc;i++) {
+    if(convert(argv[i])!=0) info = 1;
+  }
+  return info;
+}